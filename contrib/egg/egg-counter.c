@@ -126,6 +126,23 @@ egg_counter_get (EggCounter *counter)
   return value;
 }
 
+/**
+ * egg_counter_add:
+ * @counter: An #EggCounter
+ * @count: the amount to add to the counter
+ *
+ * Like EGG_COUNTER_ADD(), but for use when only a pointer to the counter
+ * is available, such as when counters are kept in a table.
+ */
+void
+egg_counter_add (EggCounter *counter,
+                 gint64      count)
+{
+  g_return_if_fail (counter);
+
+  __sync_add_and_fetch ((gint64 *)&counter->values[0].value, count);
+}
+
 void
 egg_counter_reset (EggCounter *counter)
 {
@@ -281,6 +281,8 @@ void             egg_counter_arena_register     (EggCounterArena       *arena,
 void             egg_counter_arena_foreach      (EggCounterArena       *arena,
                                                  EggCounterForeachFunc  func,
                                                  gpointer               user_data);
+void             egg_counter_add                (EggCounter            *counter,
+                                                 gint64                 count);
 void             egg_counter_reset              (EggCounter            *counter);
 gint64           egg_counter_get                (EggCounter            *counter);
 
@@ -431,6 +431,35 @@ egg_task_cache_populate (EggTaskCache  *self,
     evict_source_rearm (self->evict_source);
 }
 
+/**
+ * egg_task_cache_insert:
+ * @self: An #EggTaskCache
+ * @key: The key for the cache
+ * @value: The value to cache for @key
+ *
+ * Inserts @value into the cache for @key, replacing any existing value.
+ * This is useful when the value for many keys can be discovered at once
+ * and they should be cached without dispatching a fetch for each key.
+ *
+ * If a fetch for @key is already in flight, @value is ignored so that the
+ * result of that fetch is what is delivered to the queued callers.
+ *
+ * Like egg_task_cache_peek(), this may only be called from the main thread.
+ */
+void
+egg_task_cache_insert (EggTaskCache  *self,
+                       gconstpointer  key,
+                       gpointer       value)
+{
+  g_return_if_fail (EGG_IS_TASK_CACHE (self));
+  g_return_if_fail (value != NULL);
+
+  if (g_hash_table_contains (self->in_flight, key))
+    return;
+
+  egg_task_cache_populate (self, key, value);
+}
+
 static void
 egg_task_cache_propagate_pointer (EggTaskCache  *self,
                                   gconstpointer  key,
@@ -75,6 +75,9 @@ gboolean      egg_task_cache_evict      (EggTaskCache          *self,
 void          egg_task_cache_evict_all  (EggTaskCache          *self);
 gpointer      egg_task_cache_peek       (EggTaskCache          *self,
                                          gconstpointer          key);
+void          egg_task_cache_insert     (EggTaskCache          *self,
+                                         gconstpointer          key,
+                                         gpointer               value);
 GPtrArray    *egg_task_cache_get_values (EggTaskCache          *self);
 
 G_END_DECLS
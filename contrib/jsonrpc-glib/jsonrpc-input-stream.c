@@ -36,14 +36,38 @@ typedef struct
 
 typedef struct
 {
-  gssize max_size_bytes;
-  guint  has_seen_gvariant : 1;
+  gssize  max_size_bytes;
+  gssize  thread_threshold;
+
+  /*
+   * The body of JSON messages is read into this buffer, which is reused
+   * between messages rather than allocating a new buffer per message.
+   */
+  gchar  *scratch;
+  gsize   scratch_size;
+
+  guint   has_seen_gvariant : 1;
 } JsonrpcInputStreamPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (JsonrpcInputStream, jsonrpc_input_stream, G_TYPE_DATA_INPUT_STREAM)
 
+/* Large enough to contain the headers and the body of most messages */
+#define DEFAULT_BUFFER_SIZE (16 * 1024)
+
+/* Headers larger than this are considered a protocol error */
+#define MAX_HEADERS_SIZE (64 * 1024)
+
+/* Larger scratch buffers are released after each message */
+#define MAX_RETAINED_SCRATCH_SIZE (1024 * 1024)
+
+/* Bodies at least this large are parsed in a worker thread */
+#define DEFAULT_THREAD_THRESHOLD (64 * 1024)
+
 static gboolean jsonrpc_input_stream_debug;
 
+static void jsonrpc_input_stream_read_headers (JsonrpcInputStream *self,
+                                               GTask              *task);
+
 static void
 read_state_free (gpointer data)
 {
@@ -54,9 +78,24 @@ read_state_free (gpointer data)
   g_slice_free (ReadState, state);
 }
 
+static void
+jsonrpc_input_stream_finalize (GObject *object)
+{
+  JsonrpcInputStream *self = (JsonrpcInputStream *)object;
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
+
+  g_clear_pointer (&priv->scratch, g_free);
+
+  G_OBJECT_CLASS (jsonrpc_input_stream_parent_class)->finalize (object);
+}
+
 static void
 jsonrpc_input_stream_class_init (JsonrpcInputStreamClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = jsonrpc_input_stream_finalize;
+
   jsonrpc_input_stream_debug = !!g_getenv ("JSONRPC_DEBUG");
 }
 
@@ -67,6 +106,7 @@ jsonrpc_input_stream_init (JsonrpcInputStream *self)
 
   /* 16 MB */
   priv->max_size_bytes = 16 * 1024 * 1024;
+  priv->thread_threshold = DEFAULT_THREAD_THRESHOLD;
 
   g_data_input_stream_set_newline_type (G_DATA_INPUT_STREAM (self),
                                         G_DATA_STREAM_NEWLINE_TYPE_ANY);
@@ -77,18 +117,140 @@ jsonrpc_input_stream_new (GInputStream *base_stream)
 {
   return g_object_new (JSONRPC_TYPE_INPUT_STREAM,
                        "base-stream", base_stream,
+                       "buffer-size", DEFAULT_BUFFER_SIZE,
                        NULL);
 }
 
+/**
+ * jsonrpc_input_stream_set_thread_threshold:
+ * @self: a #JsonrpcInputStream
+ * @threshold: the size in bytes, or -1
+ *
+ * Sets the size of message bodies at which JSON deserialization is
+ * performed in a worker thread rather than the thread that is reading
+ * from the stream. Set to -1 to always deserialize messages in the
+ * reading thread.
+ */
+void
+jsonrpc_input_stream_set_thread_threshold (JsonrpcInputStream *self,
+                                           gssize              threshold)
+{
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
+
+  g_return_if_fail (JSONRPC_IS_INPUT_STREAM (self));
+
+  priv->thread_threshold = threshold;
+}
+
+static GVariant *
+jsonrpc_input_stream_deserialize (const gchar  *data,
+                                  gsize         length,
+                                  GError      **error)
+{
+  if G_UNLIKELY (jsonrpc_input_stream_debug)
+    g_message ("<<< %.*s", (gint)length, data);
+
+  return json_gvariant_deserialize_data (data, length, NULL, error);
+}
+
+static void
+jsonrpc_input_stream_deserialize_worker (GTask        *task,
+                                         gpointer      source_object,
+                                         gpointer      task_data,
+                                         GCancellable *cancellable)
+{
+  JsonrpcInputStream *self = source_object;
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
+  ReadState *state = task_data;
+  GVariant *message;
+  GError *error = NULL;
+
+  g_assert (JSONRPC_IS_INPUT_STREAM (self));
+  g_assert (state != NULL);
+
+  /*
+   * The scratch buffer is not touched from the reading thread until the
+   * task has completed, since the next read cannot be started until then.
+   */
+  message = jsonrpc_input_stream_deserialize (priv->scratch, state->content_length, &error);
+
+  g_assert (message != NULL || error != NULL);
+
+  if (message == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, message, (GDestroyNotify)g_variant_unref);
+}
+
+/*
+ * Completes @task with the message in @data. If @data is within the buffer
+ * of the stream, @skip is the number of bytes to consume from the stream
+ * once we are done with it, which must happen before the task completes
+ * since the caller may immediately begin reading the next message.
+ */
+static void
+jsonrpc_input_stream_complete (JsonrpcInputStream *self,
+                               GTask              *task,
+                               const gchar        *data,
+                               gsize               skip)
+{
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
+  g_autoptr(GVariant) message = NULL;
+  g_autoptr(GError) error = NULL;
+  ReadState *state;
+
+  g_assert (JSONRPC_IS_INPUT_STREAM (self));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  if (state->use_gvariant)
+    {
+      /* The GVariant takes ownership of the buffer */
+      message = g_variant_new_from_data (state->gvariant_type ?  state->gvariant_type
+                                                              : G_VARIANT_TYPE_VARDICT,
+                                         state->buffer,
+                                         state->content_length,
+                                         FALSE,
+                                         g_free,
+                                         state->buffer);
+      state->buffer = NULL;
+    }
+  else if (skip == 0 &&
+           priv->thread_threshold >= 0 &&
+           state->content_length >= priv->thread_threshold)
+    {
+      g_task_run_in_thread (task, jsonrpc_input_stream_deserialize_worker);
+      return;
+    }
+  else
+    {
+      message = jsonrpc_input_stream_deserialize (data, state->content_length, &error);
+    }
+
+  g_assert (message != NULL || error != NULL);
+
+  if (error == NULL && skip > 0)
+    g_input_stream_skip (G_INPUT_STREAM (self), skip, NULL, &error);
+
+  if (error != NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  g_task_return_pointer (task, g_steal_pointer (&message), (GDestroyNotify)g_variant_unref);
+}
+
 static void
 jsonrpc_input_stream_read_body_cb (GObject      *object,
                                    GAsyncResult *result,
                                    gpointer      user_data)
 {
   JsonrpcInputStream *self = (JsonrpcInputStream *)object;
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
   g_autoptr(GTask) task = user_data;
   g_autoptr(GError) error = NULL;
-  g_autoptr(GVariant) message = NULL;
   ReadState *state;
   gsize n_read;
 
@@ -113,151 +275,286 @@ jsonrpc_input_stream_read_body_cb (GObject      *object,
       return;
     }
 
-  state->buffer [state->content_length] = '\0';
+  jsonrpc_input_stream_complete (self, task, state->use_gvariant ? state->buffer : priv->scratch, 0);
+}
+
+static void
+jsonrpc_input_stream_read_body (JsonrpcInputStream *self,
+                                GTask              *task)
+{
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
+  GBufferedInputStream *buffered = (GBufferedInputStream *)self;
+  ReadState *state;
+  const gchar *data;
+  gchar *buffer;
+  gsize available;
+
+  g_assert (JSONRPC_IS_INPUT_STREAM (self));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  data = g_buffered_input_stream_peek_buffer (buffered, &available);
 
-  if G_UNLIKELY (jsonrpc_input_stream_debug && state->use_gvariant == FALSE)
-    g_message ("<<< %s", state->buffer);
+  /*
+   * If the whole JSON body is already in our read buffer and small enough
+   * to be parsed here, we can avoid copying it anywhere.
+   */
+  if (!state->use_gvariant &&
+      (gssize)available >= state->content_length &&
+      (priv->thread_threshold < 0 || state->content_length < priv->thread_threshold))
+    {
+      jsonrpc_input_stream_complete (self, task, data, state->content_length);
+      return;
+    }
 
   if (state->use_gvariant)
     {
-      message = g_variant_new_from_data (state->gvariant_type ?  state->gvariant_type
-                                                              : G_VARIANT_TYPE_VARDICT,
-                                         state->buffer,
-                                         state->content_length,
-                                         FALSE,
-                                         g_free,
-                                         state->buffer);
-      state->buffer = NULL;
+      state->buffer = g_malloc (state->content_length);
+      buffer = state->buffer;
     }
   else
     {
-      message = json_gvariant_deserialize_data (state->buffer, state->content_length, NULL, &error);
+      if (priv->scratch_size < (gsize)state->content_length)
+        {
+          g_free (priv->scratch);
+          priv->scratch_size = state->content_length;
+          priv->scratch = g_malloc (priv->scratch_size);
+        }
+
+      buffer = priv->scratch;
     }
 
-  g_assert (message != NULL || error != NULL);
+  g_input_stream_read_all_async (G_INPUT_STREAM (self),
+                                 buffer,
+                                 state->content_length,
+                                 state->priority,
+                                 g_task_get_cancellable (task),
+                                 jsonrpc_input_stream_read_body_cb,
+                                 g_object_ref (task));
+}
 
-  if (error != NULL)
+static gboolean
+jsonrpc_input_stream_parse_header (JsonrpcInputStream  *self,
+                                   ReadState           *state,
+                                   const gchar         *line,
+                                   gsize                length,
+                                   GError             **error)
+{
+  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
+
+  g_assert (JSONRPC_IS_INPUT_STREAM (self));
+  g_assert (state != NULL);
+  g_assert (line != NULL);
+
+  if (length >= 16 && strncasecmp ("Content-Length: ", line, 16) == 0)
     {
-      g_task_return_error (task, g_steal_pointer (&error));
-      return;
+      gint64 content_length = 0;
+      gsize i;
+
+      for (i = 16; i < length && g_ascii_isdigit (line [i]); i++)
+        {
+          content_length = (content_length * 10) + (line [i] - '0');
+
+          if (content_length > priv->max_size_bytes)
+            break;
+        }
+
+      if (i == 16 || i != length || content_length > priv->max_size_bytes)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Invalid Content-Length received from peer");
+          return FALSE;
+        }
+
+      state->content_length = content_length;
     }
+  else if (length >= 14 && strncasecmp ("Content-Type: ", line, 14) == 0)
+    {
+      if (NULL != g_strstr_len (line, length, "application/gvariant"))
+        state->use_gvariant = TRUE;
+    }
+  else if (length >= 17 && strncasecmp ("X-GVariant-Type: ", line, 17) == 0)
+    {
+      g_autofree gchar *type_string = g_strndup (line + 17, length - 17);
 
-  g_task_return_pointer (task, g_steal_pointer (&message), (GDestroyNotify)g_variant_unref);
+      if (!g_variant_type_string_is_valid (type_string))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Invalid X-GVariant-Type received from peer");
+          return FALSE;
+        }
+
+      g_clear_pointer (&state->gvariant_type, g_free);
+      state->gvariant_type = (GVariantType *)g_steal_pointer (&type_string);
+    }
+
+  return TRUE;
 }
 
 static void
-jsonrpc_input_stream_read_headers_cb (GObject      *object,
-                                      GAsyncResult *result,
-                                      gpointer      user_data)
+jsonrpc_input_stream_fill_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
 {
   JsonrpcInputStream *self = (JsonrpcInputStream *)object;
-  JsonrpcInputStreamPrivate *priv = jsonrpc_input_stream_get_instance_private (self);
   g_autoptr(GTask) task = user_data;
   g_autoptr(GError) error = NULL;
-  g_autofree gchar *line = NULL;
-  GCancellable *cancellable = NULL;
-  ReadState *state;
-  gsize length = 0;
+  gssize n_read;
 
   g_assert (JSONRPC_IS_INPUT_STREAM (self));
-  g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (G_IS_TASK (task));
 
-  state = g_task_get_task_data (task);
-  cancellable = g_task_get_cancellable (task);
-
-  line = g_data_input_stream_read_line_finish_utf8 (G_DATA_INPUT_STREAM (self), result, &length, &error);
+  n_read = g_buffered_input_stream_fill_finish (G_BUFFERED_INPUT_STREAM (self), result, &error);
 
-  if (line == NULL)
+  if (n_read < 0)
     {
-      if (error != NULL)
-        g_task_return_error (task, g_steal_pointer (&error));
-      else
-        g_task_return_new_error (task,
-                                 G_IO_ERROR,
-                                 G_IO_ERROR_FAILED,
-                                 "No data to read from peer");
+      g_task_return_error (task, g_steal_pointer (&error));
       return;
     }
 
-  if (strncasecmp ("Content-Length: ", line, 16) == 0)
+  if (n_read == 0)
     {
-      const gchar *lenptr = line + 16;
-      gint64 content_length;
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_FAILED,
+                               "No data to read from peer");
+      return;
+    }
 
-      content_length = g_ascii_strtoll (lenptr, NULL, 10);
+  jsonrpc_input_stream_read_headers (self, task);
+}
 
-      if (((content_length == G_MININT64 || content_length == G_MAXINT64) && errno == ERANGE) ||
-          (content_length < 0) ||
-          (content_length > G_MAXSSIZE) ||
-          (content_length > priv->max_size_bytes))
-        {
-          g_task_return_new_error (task,
-                                   G_IO_ERROR,
-                                   G_IO_ERROR_INVALID_DATA,
-                                   "Invalid Content-Length received from peer");
-          return;
-        }
+static gboolean
+jsonrpc_input_stream_parse_headers (JsonrpcInputStream  *self,
+                                    ReadState           *state,
+                                    GError             **error)
+{
+  const gchar *data;
+  const gchar *iter;
+  const gchar *end;
+  gsize available;
 
-      state->content_length = content_length;
-    }
+  g_assert (JSONRPC_IS_INPUT_STREAM (self));
+  g_assert (state != NULL);
 
-  if (strncasecmp ("Content-Type: ", line, 14) == 0)
+  data = g_buffered_input_stream_peek_buffer (G_BUFFERED_INPUT_STREAM (self), &available);
+
+  for (iter = data, end = data + available; iter < end;)
     {
-      if (NULL != strstr (line, "application/gvariant"))
-        state->use_gvariant = TRUE;
+      const gchar *eol = memchr (iter, '\n', end - iter);
+      gsize length;
+
+      if (eol == NULL)
+        break;
+
+      length = eol - iter;
+      if (length > 0 && iter [length - 1] == '\r')
+        length--;
+
+      if (length == 0)
+        break;
+
+      if (!jsonrpc_input_stream_parse_header (self, state, iter, length, error))
+        return FALSE;
+
+      iter = eol + 1;
     }
 
-  if (strncasecmp ("X-GVariant-Type: ", line, 17) == 0)
+  return TRUE;
+}
+
+/*
+ * Parses the headers directly from the buffer of our GBufferedInputStream
+ * once all of them have arrived, instead of reading (and allocating) them
+ * one line at a time.
+ */
+static void
+jsonrpc_input_stream_read_headers (JsonrpcInputStream *self,
+                                   GTask              *task)
+{
+  GBufferedInputStream *buffered = (GBufferedInputStream *)self;
+  g_autoptr(GError) error = NULL;
+  const gchar *data;
+  const gchar *iter;
+  const gchar *end;
+  ReadState *state;
+  gsize available;
+  gsize size;
+
+  g_assert (JSONRPC_IS_INPUT_STREAM (self));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  data = g_buffered_input_stream_peek_buffer (buffered, &available);
+
+  for (iter = data, end = data + available; iter < end;)
     {
-      const gchar *type_string = line + 17;
+      const gchar *eol = memchr (iter, '\n', end - iter);
+      gsize length;
 
-      if (!g_variant_type_string_is_valid (type_string))
+      if (eol == NULL)
+        break;
+
+      length = eol - iter;
+      if (length > 0 && iter [length - 1] == '\r')
+        length--;
+
+      /* An empty line terminates the headers */
+      if (length == 0)
         {
-          g_task_return_new_error (task,
-                                   G_IO_ERROR,
-                                   G_IO_ERROR_INVALID_DATA,
-                                   "Invalid X-GVariant-Type received from peer");
+          if (!jsonrpc_input_stream_parse_headers (self, state, &error) ||
+              !g_input_stream_skip (G_INPUT_STREAM (self), eol + 1 - data, NULL, &error))
+            {
+              g_task_return_error (task, g_steal_pointer (&error));
+              return;
+            }
+
+          if (state->content_length <= 0)
+            {
+              g_task_return_new_error (task,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_INVALID_DATA,
+                                       "Invalid or missing Content-Length header from peer");
+              return;
+            }
+
+          jsonrpc_input_stream_read_body (self, task);
           return;
         }
 
-      g_clear_pointer (&state->gvariant_type, g_free);
-      state->gvariant_type = (GVariantType *)g_strdup (type_string);
+      iter = eol + 1;
     }
 
   /*
-   * If we are at the end of the headers, we can make progress towards
-   * parsing the JSON content. Otherwise we need to continue parsing
-   * the next header.
+   * We do not have all of the headers yet, so wait for more data. If our
+   * buffer is already full, grow it so that it can hold the headers.
    */
+  size = g_buffered_input_stream_get_buffer_size (buffered);
 
-  if (line[0] == '\0')
+  if (available >= size)
     {
-      if (state->content_length <= 0)
+      if (size >= MAX_HEADERS_SIZE)
         {
           g_task_return_new_error (task,
                                    G_IO_ERROR,
                                    G_IO_ERROR_INVALID_DATA,
-                                   "Invalid or missing Content-Length header from peer");
+                                   "Headers from peer are too large");
           return;
         }
 
-      state->buffer = g_malloc (state->content_length + 1);
-      g_input_stream_read_all_async (G_INPUT_STREAM (self),
-                                     state->buffer,
-                                     state->content_length,
-                                     state->priority,
-                                     cancellable,
-                                     jsonrpc_input_stream_read_body_cb,
-                                     g_steal_pointer (&task));
-      return;
+      g_buffered_input_stream_set_buffer_size (buffered, size * 2);
     }
 
-  g_data_input_stream_read_line_async (G_DATA_INPUT_STREAM (self),
-                                       state->priority,
-                                       cancellable,
-                                       jsonrpc_input_stream_read_headers_cb,
-                                       g_steal_pointer (&task));
+  g_buffered_input_stream_fill_async (buffered,
+                                      -1,
+                                      state->priority,
+                                      g_task_get_cancellable (task),
+                                      jsonrpc_input_stream_fill_cb,
+                                      g_object_ref (task));
 }
 
 void
@@ -281,11 +578,7 @@ jsonrpc_input_stream_read_message_async (JsonrpcInputStream  *self,
   g_task_set_task_data (task, state, read_state_free);
   g_task_set_priority (task, state->priority);
 
-  g_data_input_stream_read_line_async (G_DATA_INPUT_STREAM (self),
-                                       state->priority,
-                                       cancellable,
-                                       jsonrpc_input_stream_read_headers_cb,
-                                       g_steal_pointer (&task));
+  jsonrpc_input_stream_read_headers (self, task);
 }
 
 gboolean
@@ -306,6 +599,13 @@ jsonrpc_input_stream_read_message_finish (JsonrpcInputStream  *self,
   state = g_task_get_task_data (G_TASK (result));
   priv->has_seen_gvariant |= state->use_gvariant;
 
+  /* Don't hold on to the memory from an unusually large message */
+  if (priv->scratch_size > MAX_RETAINED_SCRATCH_SIZE)
+    {
+      g_clear_pointer (&priv->scratch, g_free);
+      priv->scratch_size = 0;
+    }
+
   local_message = g_task_propagate_pointer (G_TASK (result), error);
   ret = local_message != NULL;
 
@@ -41,19 +41,21 @@ struct _JsonrpcInputStreamClass
   gpointer _reserved8;
 };
 
-JsonrpcInputStream *jsonrpc_input_stream_new                 (GInputStream         *base_stream);
-gboolean            jsonrpc_input_stream_read_message        (JsonrpcInputStream   *self,
-                                                              GCancellable         *cancellable,
-                                                              GVariant            **message,
-                                                              GError              **error);
-void                jsonrpc_input_stream_read_message_async  (JsonrpcInputStream   *self,
-                                                              GCancellable         *cancellable,
-                                                              GAsyncReadyCallback   callback,
-                                                              gpointer              user_data);
-gboolean            jsonrpc_input_stream_read_message_finish (JsonrpcInputStream   *self,
-                                                              GAsyncResult         *result,
-                                                              GVariant            **message,
-                                                              GError              **error);
+JsonrpcInputStream *jsonrpc_input_stream_new                  (GInputStream         *base_stream);
+void                jsonrpc_input_stream_set_thread_threshold (JsonrpcInputStream   *self,
+                                                               gssize                threshold);
+gboolean            jsonrpc_input_stream_read_message         (JsonrpcInputStream   *self,
+                                                               GCancellable         *cancellable,
+                                                               GVariant            **message,
+                                                               GError              **error);
+void                jsonrpc_input_stream_read_message_async   (JsonrpcInputStream   *self,
+                                                               GCancellable         *cancellable,
+                                                               GAsyncReadyCallback   callback,
+                                                               gpointer              user_data);
+gboolean            jsonrpc_input_stream_read_message_finish  (JsonrpcInputStream   *self,
+                                                               GAsyncResult         *result,
+                                                               GVariant            **message,
+                                                               GError              **error);
 
 G_END_DECLS
 
@@ -19,6 +19,10 @@
 #include <ctype.h>
 #include <string.h>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+# include <immintrin.h>
+#endif
+
 #include "fuzzy.h"
 
 /**
@@ -26,7 +30,17 @@
  * @title: Fuzzy Matching
  * @short_description: Fuzzy matching for GLib based programs.
  *
- * TODO:
+ * The index is stored in columns indexed by the id of each key: the
+ * offset of the key within the string heap, the offset of the casefolded
+ * key within the folded heap, and a 64-bit mask of the characters found
+ * in the key.
+ *
+ * Matching first compares the character mask of the needle against every
+ * key (several at a time using SIMD when available) to discard keys that
+ * cannot possibly match. The remaining candidates are scored by scanning
+ * the folded key. Large indexes are partitioned and scored in parallel,
+ * and each partition only keeps the best @max_matches results in a
+ * bounded heap.
  *
  * It is a programming error to modify #Fuzzy while holding onto an array
  * of #FuzzyMatch elements. The position of strings within the FuzzyMatch
@@ -39,47 +53,64 @@ struct _Fuzzy
   GByteArray     *heap;
   GArray         *id_to_text_offset;
   GPtrArray      *id_to_value;
-  GHashTable     *char_tables;
-  GHashTable     *removed;
+  /* Only used when !case_sensitive, otherwise @heap is used */
+  GByteArray     *folded_heap;
+  GArray         *id_to_folded_offset;
+  /* A mask of 0 is a tombstone for a removed key */
+  GArray         *id_to_mask;
+  /* Incremented whenever keys are inserted or removed */
+  guint           generation;
   guint           in_bulk_insert : 1;
   guint           case_sensitive : 1;
 };
 
-#pragma pack(push, 1)
+#define FUZZY_VARIANT_VERSION 2
+#define FUZZY_VARIANT_TYPE    "(uubayatayatat)"
+
+/*
+ * Indexes smaller than this are scored on the calling thread. Larger
+ * indexes are split into partitions of at least this many keys.
+ */
+#define FUZZY_MIN_PARTITION   16384
+#define FUZZY_MAX_PARTITIONS  16
+
 typedef struct
 {
-  guint id;
-  guint pos : 16;
-} FuzzyItem;
-#pragma pack(pop)
-
-G_STATIC_ASSERT (sizeof(FuzzyItem) == 6);
+  const gchar *str;
+  guint8      *char_lens;
+  guint        n_chars;
+  guint        min_span;
+  guint64      mask;
+} FuzzyNeedle;
 
 typedef struct
 {
-   Fuzzy        *fuzzy;
-   GArray      **tables;
-   gint         *state;
-   guint         n_tables;
-   gsize         max_matches;
-   const gchar  *needle;
-   GHashTable   *matches;
+  Fuzzy             *fuzzy;
+  const FuzzyNeedle *needle;
+  gsize              max_matches;
+  GMutex             mutex;
+  GCond              cond;
+  guint              n_active;
 } FuzzyLookup;
 
-static gint
-fuzzy_item_compare (gconstpointer a,
-                    gconstpointer b)
+typedef struct
 {
-  gint ret;
-
-  const FuzzyItem *fa = a;
-  const FuzzyItem *fb = b;
-
-  if ((ret = fa->id - fb->id) == 0)
-    ret = fa->pos - fb->pos;
-
-  return ret;
-}
+  FuzzyLookup *lookup;
+  /* If set, only these ids are scored; @begin and @end index into it */
+  const guint *candidates;
+  guint        begin;
+  guint        end;
+  GArray      *matches;
+  GArray      *survivors;
+} FuzzyPartition;
+
+struct _FuzzyRefinement
+{
+  Fuzzy  *fuzzy;
+  gchar  *needle;
+  GArray *candidates;
+  guint   generation;
+};
 
 static gint
 fuzzy_match_compare (gconstpointer a,
@@ -97,6 +128,74 @@ fuzzy_match_compare (gconstpointer a,
   return strcmp (ma->key, mb->key);
 }
 
+static inline guint64
+fuzzy_char_mask (gunichar ch)
+{
+  guint bit;
+
+  if (ch >= 'a' && ch <= 'z')
+    bit = ch - 'a';
+  else if (ch >= '0' && ch <= '9')
+    bit = 26 + (ch - '0');
+  else if (ch >= 'A' && ch <= 'Z')
+    bit = 36 + (ch - 'A') % 16;
+  else
+    bit = 52 + (ch % 12);
+
+  return G_GUINT64_CONSTANT (1) << bit;
+}
+
+static guint64
+fuzzy_string_mask (const gchar *str)
+{
+  guint64 mask = 0;
+
+  for (; *str; str = g_utf8_next_char (str))
+    mask |= fuzzy_char_mask (g_utf8_get_char (str));
+
+  return mask;
+}
+
+/*
+ * Returns a bitmask of which of the next FUZZY_PREFILTER_WIDTH keys
+ * contain every character of the needle.
+ */
+#if defined(__AVX2__)
+# define FUZZY_PREFILTER_WIDTH 4
+static inline guint
+fuzzy_prefilter (const guint64 *masks,
+                 guint64        needle_mask)
+{
+  __m256i needle = _mm256_set1_epi64x (needle_mask);
+  __m256i keys = _mm256_loadu_si256 ((const __m256i *)masks);
+  __m256i missing = _mm256_andnot_si256 (keys, needle);
+  __m256i found = _mm256_cmpeq_epi64 (missing, _mm256_setzero_si256 ());
+
+  return _mm256_movemask_pd (_mm256_castsi256_pd (found));
+}
+#elif defined(__SSE2__)
+# define FUZZY_PREFILTER_WIDTH 2
+static inline guint
+fuzzy_prefilter (const guint64 *masks,
+                 guint64        needle_mask)
+{
+  __m128i needle = _mm_set1_epi64x (needle_mask);
+  __m128i keys = _mm_loadu_si128 ((const __m128i *)masks);
+  __m128i missing = _mm_andnot_si128 (keys, needle);
+  guint found = _mm_movemask_epi8 (_mm_cmpeq_epi32 (missing, _mm_setzero_si128 ()));
+
+  return ((found & 0x00FF) == 0x00FF) | (((found & 0xFF00) == 0xFF00) << 1);
+}
+#else
+# define FUZZY_PREFILTER_WIDTH 1
+static inline guint
+fuzzy_prefilter (const guint64 *masks,
+                 guint64        needle_mask)
+{
+  return (masks [0] & needle_mask) == needle_mask;
+}
+#endif
+
 Fuzzy *
 fuzzy_ref (Fuzzy *fuzzy)
 {
@@ -126,9 +225,14 @@ fuzzy_new (gboolean case_sensitive)
   fuzzy->heap = g_byte_array_new ();
   fuzzy->id_to_value = g_ptr_array_new ();
   fuzzy->id_to_text_offset = g_array_new (FALSE, FALSE, sizeof (gsize));
-  fuzzy->char_tables = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_array_unref);
+  fuzzy->id_to_mask = g_array_new (FALSE, FALSE, sizeof (guint64));
   fuzzy->case_sensitive = case_sensitive;
-  fuzzy->removed = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  if (!case_sensitive)
+    {
+      fuzzy->folded_heap = g_byte_array_new ();
+      fuzzy->id_to_folded_offset = g_array_new (FALSE, FALSE, sizeof (gsize));
+    }
 
   return fuzzy;
 }
@@ -155,17 +259,17 @@ fuzzy_set_free_func (Fuzzy          *fuzzy,
 }
 
 static gsize
-fuzzy_heap_insert (Fuzzy       *fuzzy,
+fuzzy_heap_insert (GByteArray  *heap,
                    const gchar *text)
 {
   gsize ret;
 
-  g_assert (fuzzy != NULL);
+  g_assert (heap != NULL);
   g_assert (text != NULL);
 
-  ret = fuzzy->heap->len;
+  ret = heap->len;
 
-  g_byte_array_append (fuzzy->heap, (guint8 *)text, strlen (text) + 1);
+  g_byte_array_append (heap, (guint8 *)text, strlen (text) + 1);
 
   return ret;
 }
@@ -178,7 +282,7 @@ fuzzy_heap_insert (Fuzzy       *fuzzy,
  * fuzzy_end_bulk_insert() has been called.
  *
  * This allows for inserting large numbers of strings and deferring
- * the final sort until fuzzy_end_bulk_insert().
+ * any index maintenance until fuzzy_end_bulk_insert().
  */
 void
 fuzzy_begin_bulk_insert (Fuzzy *fuzzy)
@@ -193,27 +297,15 @@ fuzzy_begin_bulk_insert (Fuzzy *fuzzy)
  * fuzzy_end_bulk_insert:
  * @fuzzy: (in): A #Fuzzy.
  *
- * Complete a bulk insert and resort the index.
+ * Complete a bulk insert.
  */
 void
 fuzzy_end_bulk_insert (Fuzzy *fuzzy)
 {
-   GHashTableIter iter;
-   gpointer key;
-   gpointer value;
-
    g_return_if_fail(fuzzy);
    g_return_if_fail(fuzzy->in_bulk_insert);
 
    fuzzy->in_bulk_insert = FALSE;
-
-   g_hash_table_iter_init (&iter, fuzzy->char_tables);
-
-   while (g_hash_table_iter_next (&iter, &key, &value)) {
-      GArray *table = value;
-
-      g_array_sort (table, fuzzy_item_compare);
-   }
 }
 
 /**
@@ -229,57 +321,29 @@ fuzzy_insert (Fuzzy       *fuzzy,
               const gchar *key,
               gpointer     value)
 {
-  const gchar *tmp;
   gchar *downcase = NULL;
   gsize offset;
-  guint id;
+  guint64 mask;
 
   if (G_UNLIKELY (!key || !*key || (fuzzy->id_to_text_offset->len == G_MAXUINT)))
     return;
 
-  if (!fuzzy->case_sensitive)
-    downcase = g_utf8_casefold (key, -1);
-
-  offset = fuzzy_heap_insert (fuzzy, key);
-  id = fuzzy->id_to_text_offset->len;
+  offset = fuzzy_heap_insert (fuzzy->heap, key);
   g_array_append_val (fuzzy->id_to_text_offset, offset);
   g_ptr_array_add (fuzzy->id_to_value, value);
 
   if (!fuzzy->case_sensitive)
-    key = downcase;
-
-  for (tmp = key; *tmp; tmp = g_utf8_next_char (tmp))
     {
-      gunichar ch = g_utf8_get_char (tmp);
-      GArray *table;
-      FuzzyItem item;
-
-      table = g_hash_table_lookup (fuzzy->char_tables, GINT_TO_POINTER (ch));
-
-      if (G_UNLIKELY (table == NULL))
-        {
-          table = g_array_new (FALSE, FALSE, sizeof (FuzzyItem));
-          g_hash_table_insert (fuzzy->char_tables, GINT_TO_POINTER (ch), table);
-        }
-
-      item.id = id;
-      item.pos = (guint)(gsize)(tmp - key);
-
-      g_array_append_val (table, item);
+      downcase = g_utf8_casefold (key, -1);
+      offset = fuzzy_heap_insert (fuzzy->folded_heap, downcase);
+      g_array_append_val (fuzzy->id_to_folded_offset, offset);
+      key = downcase;
     }
 
-  if (G_UNLIKELY (!fuzzy->in_bulk_insert))
-    {
-      for (tmp = key; *tmp; tmp = g_utf8_next_char (tmp))
-        {
-          GArray *table;
-          gunichar ch;
+  mask = fuzzy_string_mask (key);
+  g_array_append_val (fuzzy->id_to_mask, mask);
 
-          ch = g_utf8_get_char (tmp);
-          table = g_hash_table_lookup (fuzzy->char_tables, GINT_TO_POINTER (ch));
-          g_array_sort (table, fuzzy_item_compare);
-        }
-    }
+  fuzzy->generation++;
 
   g_free (downcase);
 }
@@ -308,70 +372,430 @@ fuzzy_unref (Fuzzy *fuzzy)
       g_ptr_array_unref (fuzzy->id_to_value);
       fuzzy->id_to_value = NULL;
 
-      g_hash_table_unref (fuzzy->char_tables);
-      fuzzy->char_tables = NULL;
+      g_clear_pointer (&fuzzy->folded_heap, g_byte_array_unref);
+      g_clear_pointer (&fuzzy->id_to_folded_offset, g_array_unref);
 
-      g_hash_table_unref (fuzzy->removed);
-      fuzzy->removed = NULL;
+      g_array_unref (fuzzy->id_to_mask);
+      fuzzy->id_to_mask = NULL;
 
       g_slice_free (Fuzzy, fuzzy);
     }
 }
 
+static inline const gchar *
+fuzzy_get_string (Fuzzy *fuzzy,
+                  guint  id)
+{
+  gsize offset;
+
+  offset = g_array_index (fuzzy->id_to_text_offset, gsize, id);
+
+  return (const gchar *)&fuzzy->heap->data [offset];
+}
+
+static inline const gchar *
+fuzzy_get_folded_string (Fuzzy *fuzzy,
+                         guint  id)
+{
+  gsize offset;
+
+  if (fuzzy->case_sensitive)
+    return fuzzy_get_string (fuzzy, id);
+
+  offset = g_array_index (fuzzy->id_to_folded_offset, gsize, id);
+
+  return (const gchar *)&fuzzy->folded_heap->data [offset];
+}
+
+static void
+fuzzy_needle_init (FuzzyNeedle *needle,
+                   const gchar *str)
+{
+  const gchar *tmp;
+  guint i;
+
+  g_assert (needle != NULL);
+  g_assert (str != NULL);
+
+  needle->str = str;
+  needle->n_chars = g_utf8_strlen (str, -1);
+  needle->char_lens = g_new (guint8, MAX (1, needle->n_chars));
+  needle->mask = 0;
+
+  for (i = 0, tmp = str; *tmp; i++)
+    {
+      const gchar *next = g_utf8_next_char (tmp);
+
+      needle->mask |= fuzzy_char_mask (g_utf8_get_char (tmp));
+      needle->char_lens [i] = next - tmp;
+      tmp = next;
+    }
+
+  /* The shortest possible distance between the first and last character */
+  needle->min_span = strlen (str) - (needle->n_chars ? needle->char_lens [needle->n_chars - 1] : 0);
+}
+
+static void
+fuzzy_needle_clear (FuzzyNeedle *needle)
+{
+  g_clear_pointer (&needle->char_lens, g_free);
+}
+
+static inline const gchar *
+fuzzy_find_char (const gchar *haystack,
+                 const gchar *ch,
+                 guint        ch_len)
+{
+  /*
+   * UTF-8 lead bytes never look like continuation bytes, so any byte
+   * match of a whole encoded character starts on a character boundary.
+   */
+  while (NULL != (haystack = strchr (haystack, ch [0])))
+    {
+      if (ch_len == 1 || strncmp (haystack, ch, ch_len) == 0)
+        return haystack;
+      haystack++;
+    }
+
+  return NULL;
+}
+
+/*
+ * Finds the smallest distance (in bytes) between the first and last
+ * character of @needle within @haystack, matching each character of
+ * @needle greedily from every occurrence of its first character.
+ */
 static gboolean
-fuzzy_do_match (FuzzyLookup *lookup,
-                FuzzyItem   *item,
-                guint        table_index,
-                gint         score)
+fuzzy_needle_score (const FuzzyNeedle *needle,
+                    const gchar       *haystack,
+                    gint              *score)
 {
-  FuzzyItem *iter;
-  gpointer key;
-  GArray *table;
-  gint *state;
-  gint iter_score;
+  const gchar *begin = haystack;
+  gint best = G_MAXINT;
+
+  while (NULL != (begin = fuzzy_find_char (begin, needle->str, needle->char_lens [0])))
+    {
+      const gchar *ch = needle->str;
+      const gchar *pos = begin;
+      guint i;
+
+      for (i = 1; i < needle->n_chars; i++)
+        {
+          pos = fuzzy_find_char (pos + needle->char_lens [i - 1],
+                                 ch + needle->char_lens [i - 1],
+                                 needle->char_lens [i]);
 
-  table = lookup->tables [table_index];
-  state = &lookup->state [table_index];
+          /* A later start cannot complete the match either */
+          if (pos == NULL)
+            goto finish;
 
-  for (; state [0] < (gint)table->len; state [0]++)
+          ch += needle->char_lens [i - 1];
+        }
+
+      best = MIN (best, pos - begin);
+
+      if (best == (gint)needle->min_span)
+        break;
+
+      begin += needle->char_lens [0];
+    }
+
+finish:
+  if (best == G_MAXINT)
+    return FALSE;
+
+  *score = best;
+
+  return TRUE;
+}
+
+static void
+fuzzy_top_push (GArray           *heap,
+                gsize             max_matches,
+                const FuzzyMatch *match)
+{
+  FuzzyMatch *items;
+  guint i;
+
+  g_assert (heap != NULL);
+  g_assert (match != NULL);
+
+  if (max_matches == 0)
     {
-      iter = &g_array_index (table, FuzzyItem, state[0]);
+      g_array_append_vals (heap, match, 1);
+      return;
+    }
 
-      if ((iter->id < item->id) || ((iter->id == item->id) && (iter->pos <= item->pos)))
-        continue;
-      else if (iter->id > item->id)
+  /*
+   * @heap is a binary heap with the worst match at the root, so we can
+   * cheaply reject anything that would not make the top @max_matches.
+   */
+  if (heap->len < max_matches)
+    {
+      g_array_append_vals (heap, match, 1);
+      items = (FuzzyMatch *)(gpointer)heap->data;
+
+      for (i = heap->len - 1; i > 0; i = (i - 1) / 2)
+        {
+          FuzzyMatch tmp;
+          guint parent = (i - 1) / 2;
+
+          if (fuzzy_match_compare (&items [i], &items [parent]) <= 0)
+            break;
+
+          tmp = items [i];
+          items [i] = items [parent];
+          items [parent] = tmp;
+        }
+
+      return;
+    }
+
+  items = (FuzzyMatch *)(gpointer)heap->data;
+
+  if (fuzzy_match_compare (match, &items [0]) >= 0)
+    return;
+
+  items [0] = *match;
+
+  for (i = 0;;)
+    {
+      FuzzyMatch tmp;
+      guint left = i * 2 + 1;
+      guint right = left + 1;
+      guint worst = i;
+
+      if (left < heap->len && fuzzy_match_compare (&items [left], &items [worst]) > 0)
+        worst = left;
+
+      if (right < heap->len && fuzzy_match_compare (&items [right], &items [worst]) > 0)
+        worst = right;
+
+      if (worst == i)
         break;
 
-      iter_score = score + (iter->pos - item->pos);
+      tmp = items [i];
+      items [i] = items [worst];
+      items [worst] = tmp;
+      i = worst;
+    }
+}
+
+static inline void
+fuzzy_partition_score (FuzzyPartition *partition,
+                       guint           id)
+{
+  FuzzyLookup *lookup = partition->lookup;
+  Fuzzy *fuzzy = lookup->fuzzy;
+  FuzzyMatch match;
+  gint span;
+
+  if (!fuzzy_needle_score (lookup->needle, fuzzy_get_folded_string (fuzzy, id), &span))
+    return;
+
+  if (partition->survivors != NULL)
+    g_array_append_val (partition->survivors, id);
+
+  match.id = id;
+  match.key = fuzzy_get_string (fuzzy, id);
+  match.value = g_ptr_array_index (fuzzy->id_to_value, id);
+
+  /* Single character needles always match equally well */
+  if (lookup->needle->n_chars > 1)
+    match.score = 1.0 / (strlen (match.key) + span);
+  else
+    match.score = 0;
 
-      if ((table_index + 1) < lookup->n_tables)
+  fuzzy_top_push (partition->matches, lookup->max_matches, &match);
+}
+
+static void
+fuzzy_partition_run (FuzzyPartition *partition)
+{
+  const FuzzyLookup *lookup = partition->lookup;
+  const guint64 *masks = (const guint64 *)(gpointer)lookup->fuzzy->id_to_mask->data;
+  guint64 needle_mask = lookup->needle->mask;
+  guint id = partition->begin;
+
+  if (partition->candidates != NULL)
+    {
+      guint i;
+
+      for (i = partition->begin; i < partition->end; i++)
         {
-          if (fuzzy_do_match(lookup, iter, table_index + 1, iter_score))
-            return TRUE;
-          continue;
+          id = partition->candidates [i];
+
+          if ((masks [id] & needle_mask) == needle_mask)
+            fuzzy_partition_score (partition, id);
         }
 
-      key = GINT_TO_POINTER (iter->id);
+      return;
+    }
 
-      if (!g_hash_table_contains (lookup->matches, key) ||
-          (iter_score < GPOINTER_TO_INT (g_hash_table_lookup (lookup->matches, key))))
-        g_hash_table_insert (lookup->matches, key, GINT_TO_POINTER (iter_score));
+  for (; id + FUZZY_PREFILTER_WIDTH <= partition->end; id += FUZZY_PREFILTER_WIDTH)
+    {
+      guint found = fuzzy_prefilter (&masks [id], needle_mask);
+
+      while (found != 0)
+        {
+          guint bit = g_bit_nth_lsf (found, -1);
 
-      return TRUE;
+          fuzzy_partition_score (partition, id + bit);
+          found &= ~(1U << bit);
+        }
     }
 
-  return FALSE;
+  for (; id < partition->end; id++)
+    {
+      if ((masks [id] & needle_mask) == needle_mask)
+        fuzzy_partition_score (partition, id);
+    }
 }
 
-static inline const gchar *
-fuzzy_get_string (Fuzzy *fuzzy,
-                  gint   id)
+static void
+fuzzy_partition_worker (gpointer data,
+                        gpointer user_data)
 {
-  gsize offset;
+  FuzzyPartition *partition = data;
+  FuzzyLookup *lookup = partition->lookup;
 
-  offset = g_array_index (fuzzy->id_to_text_offset, gsize, id);
+  fuzzy_partition_run (partition);
 
-  return (const gchar *)&fuzzy->heap->data [offset];
+  g_mutex_lock (&lookup->mutex);
+  if (--lookup->n_active == 0)
+    g_cond_signal (&lookup->cond);
+  g_mutex_unlock (&lookup->mutex);
+}
+
+static GThreadPool *
+fuzzy_get_thread_pool (void)
+{
+  static GThreadPool *thread_pool;
+
+  if (g_once_init_enter (&thread_pool))
+    {
+      GThreadPool *pool;
+
+      pool = g_thread_pool_new (fuzzy_partition_worker,
+                                NULL,
+                                MIN (g_get_num_processors (), FUZZY_MAX_PARTITIONS),
+                                FALSE,
+                                NULL);
+      g_once_init_leave (&thread_pool, pool);
+    }
+
+  return thread_pool;
+}
+
+/*
+ * Scores @candidates (or every key if %NULL) against the already
+ * casefolded @needle. If @survivors is set, the ids of every matching
+ * key are appended to it in ascending order.
+ */
+static GArray *
+fuzzy_do_match (Fuzzy       *fuzzy,
+                const gchar *needle,
+                gsize        max_matches,
+                const guint *candidates,
+                guint        n_candidates,
+                GArray      *survivors)
+{
+  FuzzyPartition partitions [FUZZY_MAX_PARTITIONS];
+  FuzzyLookup lookup = { 0 };
+  FuzzyNeedle folded = { 0 };
+  GArray *matches;
+  guint n_items;
+  guint n_partitions;
+  guint i;
+
+  g_assert (fuzzy != NULL);
+  g_assert (needle != NULL);
+  g_assert (*needle != '\0');
+
+  matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
+
+  fuzzy_needle_init (&folded, needle);
+
+  lookup.fuzzy = fuzzy;
+  lookup.needle = &folded;
+  lookup.max_matches = max_matches;
+
+  n_items = candidates ? n_candidates : fuzzy->id_to_mask->len;
+  n_partitions = CLAMP (n_items / FUZZY_MIN_PARTITION, 1, FUZZY_MAX_PARTITIONS);
+  n_partitions = MIN (n_partitions, g_get_num_processors ());
+
+  for (i = 0; i < n_partitions; i++)
+    {
+      partitions [i].lookup = &lookup;
+      partitions [i].candidates = candidates;
+      partitions [i].begin = (guint64)n_items * i / n_partitions;
+      partitions [i].end = (guint64)n_items * (i + 1) / n_partitions;
+
+      if (i == 0)
+        {
+          partitions [i].matches = matches;
+          partitions [i].survivors = survivors;
+        }
+      else
+        {
+          partitions [i].matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
+          partitions [i].survivors = survivors ? g_array_new (FALSE, FALSE, sizeof (guint)) : NULL;
+        }
+    }
+
+  if (n_partitions > 1)
+    {
+      GThreadPool *pool = fuzzy_get_thread_pool ();
+
+      g_mutex_init (&lookup.mutex);
+      g_cond_init (&lookup.cond);
+
+      lookup.n_active = n_partitions - 1;
+
+      for (i = 1; i < n_partitions; i++)
+        g_thread_pool_push (pool, &partitions [i], NULL);
+
+      /* Do our share of the work while the pool handles the rest */
+      fuzzy_partition_run (&partitions [0]);
+
+      g_mutex_lock (&lookup.mutex);
+      while (lookup.n_active > 0)
+        g_cond_wait (&lookup.cond, &lookup.mutex);
+      g_mutex_unlock (&lookup.mutex);
+
+      g_mutex_clear (&lookup.mutex);
+      g_cond_clear (&lookup.cond);
+
+      for (i = 1; i < n_partitions; i++)
+        {
+          GArray *ar = partitions [i].matches;
+          guint j;
+
+          for (j = 0; j < ar->len; j++)
+            fuzzy_top_push (matches, max_matches, &g_array_index (ar, FuzzyMatch, j));
+
+          g_array_unref (ar);
+
+          if (survivors != NULL)
+            {
+              g_array_append_vals (survivors,
+                                   partitions [i].survivors->data,
+                                   partitions [i].survivors->len);
+              g_array_unref (partitions [i].survivors);
+            }
+        }
+    }
+  else
+    {
+      fuzzy_partition_run (&partitions [0]);
+    }
+
+  if (max_matches != 0)
+    g_array_sort (matches, fuzzy_match_compare);
+
+  fuzzy_needle_clear (&folded);
+
+  return matches;
 }
 
 /**
@@ -381,9 +805,8 @@ fuzzy_get_string (Fuzzy *fuzzy,
  * @max_matches: (in): The max number of matches to return.
  *
  * Fuzzy searches within @fuzzy for strings that fuzzy match @needle.
- * Only up to @max_matches will be returned.
- *
- * TODO: max_matches is not yet respected.
+ * Only up to @max_matches will be returned, sorted by score. If
+ * @max_matches is zero, all matches are returned in no particular order.
  *
  * Returns: (transfer full) (element-type FuzzyMatch): A newly allocated
  *   #GArray containing #FuzzyMatch elements. This should be freed when
@@ -396,125 +819,162 @@ fuzzy_match (Fuzzy       *fuzzy,
              const gchar *needle,
              gsize        max_matches)
 {
-  FuzzyLookup lookup = { 0 };
-  FuzzyMatch match;
-  FuzzyItem *item;
-  GHashTableIter iter;
-  gpointer key;
-  gpointer value;
-  const gchar *tmp;
-  GArray *matches = NULL;
-  GArray *root;
-  gchar *downcase = NULL;
-  guint i;
+  g_autofree gchar *downcase = NULL;
 
   g_return_val_if_fail (fuzzy, NULL);
   g_return_val_if_fail (!fuzzy->in_bulk_insert, NULL);
   g_return_val_if_fail (needle, NULL);
 
-  matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
-
   if (!*needle)
-    goto cleanup;
+    return g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
 
   if (!fuzzy->case_sensitive)
-    {
-      downcase = g_utf8_casefold (needle, -1);
-      needle = downcase;
-    }
+    needle = downcase = g_utf8_casefold (needle, -1);
 
-  lookup.fuzzy = fuzzy;
-  lookup.n_tables = g_utf8_strlen (needle, -1);
-  lookup.state = g_new0 (gint, lookup.n_tables);
-  lookup.tables = g_new0 (GArray*, lookup.n_tables);
-  lookup.needle = needle;
-  lookup.max_matches = max_matches;
-  lookup.matches = g_hash_table_new (NULL, NULL);
+  return fuzzy_do_match (fuzzy, needle, max_matches, NULL, 0, NULL);
+}
 
-  for (i = 0, tmp = needle; *tmp; tmp = g_utf8_next_char (tmp))
-    {
-      gunichar ch;
-      GArray *table;
+/**
+ * fuzzy_refinement_new:
+ * @fuzzy: (in): A #Fuzzy.
+ *
+ * Creates a new #FuzzyRefinement for @fuzzy, used to run a series of
+ * queries where each is typically the previous query with another
+ * character typed, such as when searching as the user types.
+ *
+ * The refinement is not thread-safe and should only be used by one
+ * thread at a time.
+ *
+ * Returns: A newly allocated #FuzzyRefinement that should be freed with
+ *   fuzzy_refinement_free().
+ */
+FuzzyRefinement *
+fuzzy_refinement_new (Fuzzy *fuzzy)
+{
+  FuzzyRefinement *refinement;
 
-      ch = g_utf8_get_char (tmp);
-      table = g_hash_table_lookup (fuzzy->char_tables, GINT_TO_POINTER (ch));
+  g_return_val_if_fail (fuzzy != NULL, NULL);
 
-      if (table == NULL)
-        goto cleanup;
+  refinement = g_slice_new0 (FuzzyRefinement);
+  refinement->fuzzy = fuzzy_ref (fuzzy);
+  refinement->candidates = g_array_new (FALSE, FALSE, sizeof (guint));
 
-      lookup.tables [i++] = table;
+  return refinement;
+}
+
+void
+fuzzy_refinement_free (FuzzyRefinement *refinement)
+{
+  if (refinement != NULL)
+    {
+      g_clear_pointer (&refinement->fuzzy, fuzzy_unref);
+      g_clear_pointer (&refinement->needle, g_free);
+      g_clear_pointer (&refinement->candidates, g_array_unref);
+      g_slice_free (FuzzyRefinement, refinement);
     }
+}
 
-  g_assert (lookup.n_tables == i);
-  g_assert (lookup.tables [0] != NULL);
+/**
+ * fuzzy_refinement_get_fuzzy:
+ * @refinement: A #FuzzyRefinement.
+ *
+ * Returns: (transfer none): The #Fuzzy that @refinement searches.
+ */
+Fuzzy *
+fuzzy_refinement_get_fuzzy (FuzzyRefinement *refinement)
+{
+  g_return_val_if_fail (refinement != NULL, NULL);
 
-  root = lookup.tables [0];
+  return refinement->fuzzy;
+}
 
-  if (G_LIKELY (lookup.n_tables > 1))
-    {
-      for (i = 0; i < root->len; i++)
-        {
-          item = &g_array_index (root, FuzzyItem, i);
-          fuzzy_do_match (&lookup, item, 1, 0);
-        }
-    }
-  else
+static gboolean
+fuzzy_is_subsequence (const gchar *needle,
+                      const gchar *haystack)
+{
+  for (; *needle; needle = g_utf8_next_char (needle))
     {
-      guint last_id = G_MAXUINT;
+      gunichar ch = g_utf8_get_char (needle);
 
-      for (i = 0; i < root->len; i++)
+      for (; *haystack; haystack = g_utf8_next_char (haystack))
         {
-          item = &g_array_index (root, FuzzyItem, i);
-          match.id = GPOINTER_TO_INT (item->id);
-          if (match.id != last_id)
-            {
-              match.key = fuzzy_get_string (fuzzy, item->id);
-              match.value = g_ptr_array_index (fuzzy->id_to_value, item->id);
-              match.score = 0;
-              g_array_append_val (matches, match);
-              last_id = match.id;
-            }
+          if (g_utf8_get_char (haystack) == ch)
+            break;
         }
 
-      goto cleanup;
+      if (!*haystack)
+        return FALSE;
+
+      haystack = g_utf8_next_char (haystack);
     }
 
-  g_hash_table_iter_init (&iter, lookup.matches);
+  return TRUE;
+}
 
-  while (g_hash_table_iter_next (&iter, &key, &value))
-    {
-      /* Ignore keys that have a tombstone record. */
-      if (g_hash_table_contains (fuzzy->removed, key))
-        continue;
+/**
+ * fuzzy_refinement_match:
+ * @refinement: (in): A #FuzzyRefinement.
+ * @needle: (in): The needle to fuzzy search for.
+ * @max_matches: (in): The max number of matches to return.
+ *
+ * Like fuzzy_match(), but remembers which keys matched so that the next
+ * query only needs to look at those keys when the previous needle is
+ * contained within the new one (such as when a character was appended).
+ * Otherwise, such as after a backspace, every key is scanned again.
+ *
+ * Returns: (transfer full) (element-type FuzzyMatch): A newly allocated
+ *   #GArray containing #FuzzyMatch elements. See fuzzy_match().
+ */
+GArray *
+fuzzy_refinement_match (FuzzyRefinement *refinement,
+                        const gchar     *needle,
+                        gsize            max_matches)
+{
+  g_autofree gchar *downcase = NULL;
+  g_autoptr(GArray) candidates = NULL;
+  Fuzzy *fuzzy;
+  GArray *ret;
 
-      match.id = GPOINTER_TO_INT (key);
-      match.key = fuzzy_get_string (fuzzy, match.id);
-      match.score = 1.0 / (strlen (match.key) + GPOINTER_TO_INT (value));
-      match.value = g_ptr_array_index (fuzzy->id_to_value, match.id);
+  g_return_val_if_fail (refinement != NULL, NULL);
+  g_return_val_if_fail (!refinement->fuzzy->in_bulk_insert, NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
 
-      g_array_append_val (matches, match);
+  fuzzy = refinement->fuzzy;
+
+  if (!*needle)
+    {
+      g_clear_pointer (&refinement->needle, g_free);
+      return g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
     }
 
+  if (!fuzzy->case_sensitive)
+    needle = downcase = g_utf8_casefold (needle, -1);
+
   /*
-   * TODO: We could be more clever here when inserting into the array
-   *       only if it is a lower score than the end or < max items.
+   * Every key matching the new needle also matches the previous needle
+   * if the previous needle is a subsequence of it, so only the previous
+   * survivors need to be scored again.
    */
+  candidates = refinement->candidates;
+  refinement->candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  if (refinement->needle == NULL ||
+      refinement->generation != fuzzy->generation ||
+      !fuzzy_is_subsequence (refinement->needle, needle))
+    g_clear_pointer (&candidates, g_array_unref);
+
+  if (candidates != NULL)
+    ret = fuzzy_do_match (fuzzy, needle, max_matches,
+                          (const guint *)(gpointer)candidates->data, candidates->len,
+                          refinement->candidates);
+  else
+    ret = fuzzy_do_match (fuzzy, needle, max_matches, NULL, 0, refinement->candidates);
 
-  if (max_matches != 0)
-    {
-      g_array_sort (matches, fuzzy_match_compare);
-
-      if (max_matches && (matches->len > max_matches))
-        g_array_set_size (matches, max_matches);
-    }
-
-cleanup:
-  g_free (downcase);
-  g_free (lookup.state);
-  g_free (lookup.tables);
-  g_clear_pointer (&lookup.matches, g_hash_table_unref);
+  g_free (refinement->needle);
+  refinement->needle = g_strdup (needle);
+  refinement->generation = fuzzy->generation;
 
-  return matches;
+  return ret;
 }
 
 gboolean
@@ -533,31 +993,297 @@ fuzzy_contains (Fuzzy       *fuzzy,
   return ret;
 }
 
+/**
+ * fuzzy_remove:
+ * @fuzzy: (in): A #Fuzzy.
+ * @key: (in): The key to remove.
+ *
+ * Removes every entry in @fuzzy matching @key exactly.
+ */
 void
 fuzzy_remove (Fuzzy       *fuzzy,
               const gchar *key)
 {
-  GArray *ar;
+  const guint64 *masks;
+  gchar *downcase = NULL;
+  guint64 mask;
+  guint id;
 
   g_return_if_fail (fuzzy != NULL);
 
   if (!key || !*key)
     return;
 
-  ar = fuzzy_match (fuzzy, key, 1);
+  if (!fuzzy->case_sensitive)
+    downcase = g_utf8_casefold (key, -1);
 
-  if (ar != NULL && ar->len > 0)
+  mask = fuzzy_string_mask (downcase ? downcase : key);
+  masks = (const guint64 *)(gpointer)fuzzy->id_to_mask->data;
+
+  /* An exact match must have the very same character mask. */
+  for (id = 0; id < fuzzy->id_to_mask->len; id++)
     {
-      guint i;
+      if (masks [id] == mask && strcmp (fuzzy_get_string (fuzzy, id), key) == 0)
+        g_array_index (fuzzy->id_to_mask, guint64, id) = 0;
+    }
 
-      for (i = 0; i < ar->len; i++)
-        {
-          FuzzyMatch *match = &g_array_index (ar, FuzzyMatch, i);
+  fuzzy->generation++;
+
+  g_free (downcase);
+}
+
+/**
+ * fuzzy_remove_many:
+ * @fuzzy: (in): A #Fuzzy.
+ * @keys: (in) (array length=n_keys): The keys to remove.
+ * @n_keys: The number of elements in @keys.
+ *
+ * Removes every entry in @fuzzy matching any of @keys exactly. This
+ * walks the index once, rather than once per key as calling
+ * fuzzy_remove() repeatedly would.
+ */
+void
+fuzzy_remove_many (Fuzzy               *fuzzy,
+                   const gchar * const *keys,
+                   guint                n_keys)
+{
+  GHashTable *removed;
+  const guint64 *masks;
+  guint id;
+
+  g_return_if_fail (fuzzy != NULL);
+  g_return_if_fail (keys != NULL || n_keys == 0);
+
+  if (n_keys == 0)
+    return;
+
+  if (n_keys == 1)
+    {
+      fuzzy_remove (fuzzy, keys [0]);
+      return;
+    }
+
+  removed = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (guint i = 0; i < n_keys; i++)
+    {
+      if (keys [i] != NULL && *keys [i] != '\0')
+        g_hash_table_add (removed, (gchar *)keys [i]);
+    }
+
+  masks = (const guint64 *)(gpointer)fuzzy->id_to_mask->data;
+
+  for (id = 0; id < fuzzy->id_to_mask->len; id++)
+    {
+      if (masks [id] != 0 && g_hash_table_contains (removed, fuzzy_get_string (fuzzy, id)))
+        g_array_index (fuzzy->id_to_mask, guint64, id) = 0;
+    }
+
+  fuzzy->generation++;
+
+  g_hash_table_unref (removed);
+}
+
+/**
+ * fuzzy_to_variant:
+ * @fuzzy: (in): A #Fuzzy.
+ *
+ * Serializes the columns of @fuzzy into a #GVariant that can be written
+ * to disk and later mapped back in with fuzzy_new_from_variant(). Keys
+ * that have been removed are compacted away so the serialized index
+ * contains no tombstones.
+ *
+ * Values associated with keys are not serialized.
+ *
+ * Returns: (transfer floating): A new #GVariant.
+ */
+GVariant *
+fuzzy_to_variant (Fuzzy *fuzzy)
+{
+  GByteArray *heap;
+  GByteArray *folded_heap;
+  GVariant *ret;
+  GArray *offsets;
+  GArray *folded_offsets;
+  GArray *masks;
+  guint n_ids;
+  guint i;
+
+  g_return_val_if_fail (fuzzy != NULL, NULL);
+  g_return_val_if_fail (!fuzzy->in_bulk_insert, NULL);
+
+  n_ids = fuzzy->id_to_text_offset->len;
+  heap = g_byte_array_sized_new (fuzzy->heap->len);
+  folded_heap = g_byte_array_new ();
+  offsets = g_array_sized_new (FALSE, FALSE, sizeof (guint64), n_ids);
+  folded_offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
+  masks = g_array_sized_new (FALSE, FALSE, sizeof (guint64), n_ids);
+
+  for (i = 0; i < n_ids; i++)
+    {
+      guint64 mask = g_array_index (fuzzy->id_to_mask, guint64, i);
+      guint64 offset;
 
-          if (g_strcmp0 (match->key, key) == 0)
-            g_hash_table_insert (fuzzy->removed, GINT_TO_POINTER (match->id), NULL);
+      /* Skip tombstones */
+      if (mask == 0)
+        continue;
+
+      offset = fuzzy_heap_insert (heap, fuzzy_get_string (fuzzy, i));
+      g_array_append_val (offsets, offset);
+      g_array_append_val (masks, mask);
+
+      if (!fuzzy->case_sensitive)
+        {
+          offset = fuzzy_heap_insert (folded_heap, fuzzy_get_folded_string (fuzzy, i));
+          g_array_append_val (folded_offsets, offset);
         }
     }
 
-  g_clear_pointer (&ar, g_array_unref);
+  ret = g_variant_new ("(uub@ay@at@ay@at@at)",
+                       FUZZY_VARIANT_VERSION,
+                       G_BYTE_ORDER,
+                       (gboolean)fuzzy->case_sensitive,
+                       g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                  heap->data,
+                                                  heap->len,
+                                                  1),
+                       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                  offsets->data,
+                                                  offsets->len,
+                                                  sizeof (guint64)),
+                       g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                  folded_heap->data,
+                                                  folded_heap->len,
+                                                  1),
+                       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                  folded_offsets->data,
+                                                  folded_offsets->len,
+                                                  sizeof (guint64)),
+                       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                  masks->data,
+                                                  masks->len,
+                                                  sizeof (guint64)));
+
+  g_array_unref (masks);
+  g_array_unref (folded_offsets);
+  g_array_unref (offsets);
+  g_byte_array_unref (folded_heap);
+  g_byte_array_unref (heap);
+
+  return ret;
+}
+
+static gboolean
+fuzzy_check_heap (const guint8  *heap,
+                  gsize          heap_len,
+                  const guint64 *offsets,
+                  gsize          n_offsets)
+{
+  gsize i;
+
+  /*
+   * Make sure every string lives within the heap and is terminated
+   * before we trust any of the offsets.
+   */
+  if (heap_len > 0 && heap [heap_len - 1] != '\0')
+    return FALSE;
+
+  for (i = 0; i < n_offsets; i++)
+    {
+      if (offsets [i] >= heap_len)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * fuzzy_new_from_variant:
+ * @variant: (in): A #GVariant created with fuzzy_to_variant().
+ *
+ * Creates a new #Fuzzy from an index previously serialized with
+ * fuzzy_to_variant(). This is a straight copy of the serialized columns
+ * and is much cheaper than inserting every key again. @variant is
+ * typically backed by a #GMappedFile.
+ *
+ * All keys will have a %NULL value.
+ *
+ * Returns: (nullable): A newly allocated #Fuzzy or %NULL if @variant
+ *   is not a valid serialized index.
+ */
+Fuzzy *
+fuzzy_new_from_variant (GVariant *variant)
+{
+  GVariant *heap = NULL;
+  GVariant *offsets = NULL;
+  GVariant *folded_heap = NULL;
+  GVariant *folded_offsets = NULL;
+  GVariant *masks = NULL;
+  const guint64 *offsets_data;
+  const guint64 *folded_offsets_data;
+  const guint64 *masks_data;
+  const guint8 *heap_data;
+  const guint8 *folded_heap_data;
+  Fuzzy *fuzzy = NULL;
+  gboolean case_sensitive = FALSE;
+  guint32 version = 0;
+  guint32 byte_order = 0;
+  gsize n_offsets;
+  gsize n_folded_offsets;
+  gsize n_masks;
+  gsize heap_len;
+  gsize folded_heap_len;
+  gsize i;
+
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE (FUZZY_VARIANT_TYPE)))
+    return NULL;
+
+  g_variant_get (variant, "(uub@ay@at@ay@at@at)",
+                 &version, &byte_order, &case_sensitive,
+                 &heap, &offsets, &folded_heap, &folded_offsets, &masks);
+
+  if (version != FUZZY_VARIANT_VERSION || byte_order != G_BYTE_ORDER)
+    goto cleanup;
+
+  heap_data = g_variant_get_fixed_array (heap, &heap_len, 1);
+  offsets_data = g_variant_get_fixed_array (offsets, &n_offsets, sizeof (guint64));
+  folded_heap_data = g_variant_get_fixed_array (folded_heap, &folded_heap_len, 1);
+  folded_offsets_data = g_variant_get_fixed_array (folded_offsets, &n_folded_offsets, sizeof (guint64));
+  masks_data = g_variant_get_fixed_array (masks, &n_masks, sizeof (guint64));
+
+  if (n_masks != n_offsets ||
+      n_folded_offsets != (case_sensitive ? 0 : n_offsets) ||
+      !fuzzy_check_heap (heap_data, heap_len, offsets_data, n_offsets) ||
+      !fuzzy_check_heap (folded_heap_data, folded_heap_len, folded_offsets_data, n_folded_offsets))
+    goto cleanup;
+
+  fuzzy = fuzzy_new (case_sensitive);
+
+  g_byte_array_append (fuzzy->heap, heap_data, heap_len);
+  g_array_set_size (fuzzy->id_to_text_offset, n_offsets);
+  g_ptr_array_set_size (fuzzy->id_to_value, n_offsets);
+  g_array_append_vals (fuzzy->id_to_mask, masks_data, n_masks);
+
+  for (i = 0; i < n_offsets; i++)
+    g_array_index (fuzzy->id_to_text_offset, gsize, i) = offsets_data [i];
+
+  if (!case_sensitive)
+    {
+      g_byte_array_append (fuzzy->folded_heap, folded_heap_data, folded_heap_len);
+      g_array_set_size (fuzzy->id_to_folded_offset, n_folded_offsets);
+
+      for (i = 0; i < n_folded_offsets; i++)
+        g_array_index (fuzzy->id_to_folded_offset, gsize, i) = folded_offsets_data [i];
+    }
+
+cleanup:
+  g_clear_pointer (&heap, g_variant_unref);
+  g_clear_pointer (&offsets, g_variant_unref);
+  g_clear_pointer (&folded_heap, g_variant_unref);
+  g_clear_pointer (&folded_offsets, g_variant_unref);
+  g_clear_pointer (&masks, g_variant_unref);
+
+  return fuzzy;
 }
@@ -23,8 +23,9 @@
 
 G_BEGIN_DECLS
 
-typedef struct _Fuzzy      Fuzzy;
-typedef struct _FuzzyMatch FuzzyMatch;
+typedef struct _Fuzzy           Fuzzy;
+typedef struct _FuzzyMatch      FuzzyMatch;
+typedef struct _FuzzyRefinement FuzzyRefinement;
 
 struct _FuzzyMatch
 {
@@ -51,9 +52,23 @@ GArray    *fuzzy_match              (Fuzzy          *fuzzy,
                                      gsize           max_matches);
 void       fuzzy_remove             (Fuzzy          *fuzzy,
                                      const gchar    *key);
+void       fuzzy_remove_many        (Fuzzy          *fuzzy,
+                                     const gchar * const *keys,
+                                     guint           n_keys);
 Fuzzy     *fuzzy_ref                (Fuzzy          *fuzzy);
+Fuzzy     *fuzzy_new_from_variant   (GVariant       *variant);
+GVariant  *fuzzy_to_variant         (Fuzzy          *fuzzy);
 void       fuzzy_unref              (Fuzzy          *fuzzy);
 
+FuzzyRefinement *fuzzy_refinement_new       (Fuzzy           *fuzzy);
+Fuzzy           *fuzzy_refinement_get_fuzzy (FuzzyRefinement *refinement);
+GArray          *fuzzy_refinement_match     (FuzzyRefinement *refinement,
+                                             const gchar     *needle,
+                                             gsize            max_matches);
+void             fuzzy_refinement_free      (FuzzyRefinement *refinement);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FuzzyRefinement, fuzzy_refinement_free)
+
 G_END_DECLS
 
 #endif /* FUZZY_H */
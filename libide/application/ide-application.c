@@ -632,6 +632,65 @@ ide_application_get_worker_async (IdeApplication      *self,
                                        g_object_ref (task));
 }
 
+/**
+ * ide_application_get_worker_for_key_async:
+ * @self: A #IdeApplication
+ * @plugin_name: The name of the plugin.
+ * @n_workers: The number of worker processes to spread requests across.
+ * @key: (allow-none): A key used to route the request, such as a filename.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: A #GAsyncReadyCallback or %NULL.
+ * @user_data: user data for @callback.
+ *
+ * Like ide_application_get_worker_async(), but the worker is chosen from a
+ * pool of up to @n_workers processes. Requests for the same @key are always
+ * routed to the same process.
+ *
+ * Unlike ide_application_get_worker_async(), @callback is always executed.
+ * If the application is not the primary instance, the result will be an
+ * error of %G_IO_ERROR_NOT_SUPPORTED.
+ *
+ * @callback should call ide_application_get_worker_finish() with the result
+ * provided to retrieve the result.
+ */
+void
+ide_application_get_worker_for_key_async (IdeApplication      *self,
+                                          const gchar         *plugin_name,
+                                          guint                n_workers,
+                                          const gchar         *key,
+                                          GCancellable        *cancellable,
+                                          GAsyncReadyCallback  callback,
+                                          gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (IDE_IS_APPLICATION (self));
+  g_return_if_fail (plugin_name != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+
+  if (self->mode != IDE_APPLICATION_MODE_PRIMARY)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Workers are only available to the primary instance");
+      return;
+    }
+
+  if (self->worker_manager == NULL)
+    self->worker_manager = ide_worker_manager_new ();
+
+  ide_worker_manager_get_worker_for_key_async (self->worker_manager,
+                                               plugin_name,
+                                               n_workers,
+                                               key,
+                                               cancellable,
+                                               ide_application_get_worker_cb,
+                                               g_object_ref (task));
+}
+
 /**
  * ide_application_get_worker_finish:
  * @self: A #IdeApplication.
@@ -52,6 +52,14 @@ void                ide_application_get_worker_async     (IdeApplication       *
                                                           GCancellable         *cancellable,
                                                           GAsyncReadyCallback   callback,
                                                           gpointer              user_data);
+void                ide_application_get_worker_for_key_async
+                                                         (IdeApplication       *self,
+                                                          const gchar          *plugin_name,
+                                                          guint                 n_workers,
+                                                          const gchar          *key,
+                                                          GCancellable         *cancellable,
+                                                          GAsyncReadyCallback   callback,
+                                                          gpointer              user_data);
 GDBusProxy         *ide_application_get_worker_finish    (IdeApplication       *self,
                                                           GAsyncResult         *result,
                                                           GError              **error);
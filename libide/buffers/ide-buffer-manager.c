@@ -47,6 +47,7 @@
 
 #define AUTO_SAVE_TIMEOUT_DEFAULT    60
 #define MAX_FILE_SIZE_BYTES_DEFAULT  (1024UL * 1024UL * 10UL)
+#define MONITOR_POLL_TIMEOUT_SECS    5
 
 struct _IdeBufferManager
 {
@@ -54,6 +55,15 @@ struct _IdeBufferManager
 
   GPtrArray                *buffers;
   GHashTable               *timeouts;
+
+  /*
+   * Rather than a file monitor per buffer, we share one monitor for each
+   * directory containing open buffers. @monitors maps the directory to a
+   * DirectoryMonitor and @monitored maps each buffer to its directory.
+   */
+  GHashTable               *monitors;
+  GHashTable               *monitored;
+
   IdeBuffer                *focus_buffer;
   GtkSourceCompletionWords *word_completion;
   GSettings                *settings;
@@ -71,6 +81,15 @@ typedef struct
   guint             source_id;
 } AutoSave;
 
+typedef struct
+{
+  IdeBufferManager *self;
+  GFile            *directory;
+  GFileMonitor     *monitor;
+  guint             poll_source;
+  guint             hold_count;
+} DirectoryMonitor;
+
 typedef struct
 {
   IdeBuffer            *buffer;
@@ -185,6 +204,220 @@ unref_if_non_null (gpointer data)
     g_object_unref (data);
 }
 
+static void
+directory_monitor_free (gpointer data)
+{
+  DirectoryMonitor *monitor = data;
+
+  if (monitor != NULL)
+    {
+      if (monitor->monitor != NULL)
+        {
+          g_signal_handlers_disconnect_by_data (monitor->monitor, monitor);
+          g_file_monitor_cancel (monitor->monitor);
+          g_clear_object (&monitor->monitor);
+        }
+
+      if (monitor->poll_source != 0)
+        {
+          g_source_remove (monitor->poll_source);
+          monitor->poll_source = 0;
+        }
+
+      g_clear_object (&monitor->directory);
+      g_slice_free (DirectoryMonitor, monitor);
+    }
+}
+
+static void
+directory_monitor_changed (GFileMonitor      *file_monitor,
+                           GFile             *file,
+                           GFile             *other_file,
+                           GFileMonitorEvent  event,
+                           gpointer           user_data)
+{
+  DirectoryMonitor *monitor = user_data;
+  IdeBuffer *buffer;
+
+  g_assert (G_IS_FILE_MONITOR (file_monitor));
+  g_assert (G_IS_FILE (file));
+  g_assert (monitor != NULL);
+  g_assert (IDE_IS_BUFFER_MANAGER (monitor->self));
+
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_MOVED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      IDE_TRACE_MSG ("directory change event = %d", (int)event);
+
+      if (NULL != (buffer = ide_buffer_manager_find_buffer (monitor->self, file)))
+        _ide_buffer_queue_modify_check (buffer);
+
+      if (other_file != NULL &&
+          NULL != (buffer = ide_buffer_manager_find_buffer (monitor->self, other_file)))
+        _ide_buffer_queue_modify_check (buffer);
+
+      break;
+
+    case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+    case G_FILE_MONITOR_EVENT_UNMOUNTED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    default:
+      break;
+    }
+}
+
+static gboolean
+directory_monitor_poll (gpointer user_data)
+{
+  DirectoryMonitor *monitor = user_data;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  g_assert (monitor != NULL);
+  g_assert (IDE_IS_BUFFER_MANAGER (monitor->self));
+
+  g_hash_table_iter_init (&iter, monitor->self->monitored);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (g_file_equal (value, monitor->directory))
+        ide_buffer_check_for_volume_change (key);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+ide_buffer_manager_hold_directory (IdeBufferManager *self,
+                                   GFile            *directory)
+{
+  g_autoptr(GError) error = NULL;
+  DirectoryMonitor *monitor;
+
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (G_IS_FILE (directory));
+
+  if (NULL != (monitor = g_hash_table_lookup (self->monitors, directory)))
+    {
+      monitor->hold_count++;
+      return;
+    }
+
+  monitor = g_slice_new0 (DirectoryMonitor);
+  monitor->self = self;
+  monitor->directory = g_object_ref (directory);
+  monitor->hold_count = 1;
+  monitor->monitor = g_file_monitor_directory (directory, G_FILE_MONITOR_NONE, NULL, &error);
+
+  if (monitor->monitor != NULL)
+    {
+      g_signal_connect (monitor->monitor,
+                        "changed",
+                        G_CALLBACK (directory_monitor_changed),
+                        monitor);
+    }
+  else
+    {
+      /* Not all filesystems support monitoring, so fallback to polling */
+      g_debug ("Failed to monitor directory, polling instead: %s", error->message);
+      monitor->poll_source = g_timeout_add_seconds (MONITOR_POLL_TIMEOUT_SECS,
+                                                    directory_monitor_poll,
+                                                    monitor);
+    }
+
+  g_hash_table_insert (self->monitors, monitor->directory, monitor);
+}
+
+static void
+ide_buffer_manager_release_directory (IdeBufferManager *self,
+                                      GFile            *directory)
+{
+  DirectoryMonitor *monitor;
+
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (G_IS_FILE (directory));
+
+  if (NULL == (monitor = g_hash_table_lookup (self->monitors, directory)))
+    return;
+
+  if (--monitor->hold_count == 0)
+    g_hash_table_remove (self->monitors, directory);
+}
+
+static void
+ide_buffer_manager_unmonitor_buffer (IdeBufferManager *self,
+                                     IdeBuffer        *buffer)
+{
+  GFile *directory;
+
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (NULL != (directory = g_hash_table_lookup (self->monitored, buffer)))
+    {
+      ide_buffer_manager_release_directory (self, directory);
+      g_hash_table_remove (self->monitored, buffer);
+    }
+}
+
+/*
+ * Called when @buffer is registered, and by @buffer when its file moves,
+ * to watch the directory containing the file for changes.
+ */
+void
+_ide_buffer_manager_monitor_buffer (IdeBufferManager *self,
+                                    IdeBuffer        *buffer)
+{
+  g_autoptr(GFile) directory = NULL;
+  gboolean registered = FALSE;
+  GFile *previous;
+  IdeFile *file;
+  GFile *gfile;
+
+  g_return_if_fail (IDE_IS_BUFFER_MANAGER (self));
+  g_return_if_fail (IDE_IS_BUFFER (buffer));
+
+  /* Buffers are monitored once they are registered */
+  for (guint i = 0; i < self->buffers->len; i++)
+    {
+      if ((gpointer)buffer == g_ptr_array_index (self->buffers, i))
+        {
+          registered = TRUE;
+          break;
+        }
+    }
+
+  if (!registered)
+    return;
+
+  if (NULL != (file = ide_buffer_get_file (buffer)) &&
+      !ide_file_get_is_temporary (file) &&
+      NULL != (gfile = ide_file_get_file (file)))
+    directory = g_file_get_parent (gfile);
+
+  previous = g_hash_table_lookup (self->monitored, buffer);
+
+  if (previous == directory ||
+      (previous != NULL && directory != NULL && g_file_equal (previous, directory)))
+    return;
+
+  ide_buffer_manager_unmonitor_buffer (self, buffer);
+
+  if (directory != NULL)
+    {
+      ide_buffer_manager_hold_directory (self, directory);
+      g_hash_table_insert (self->monitored, buffer, g_steal_pointer (&directory));
+    }
+}
+
 /**
  * ide_buffer_manager_get_auto_save_timeout:
  *
@@ -388,6 +621,8 @@ ide_buffer_manager_add_buffer (IdeBufferManager *self,
   if (self->auto_save)
     register_auto_save (self, buffer);
 
+  _ide_buffer_manager_monitor_buffer (self, buffer);
+
   gtk_source_completion_words_register (self->word_completion, GTK_TEXT_BUFFER (buffer));
 
   g_signal_connect_object (buffer,
@@ -443,6 +678,8 @@ ide_buffer_manager_remove_buffer (IdeBufferManager *self,
 
   unregister_auto_save (self, buffer);
 
+  ide_buffer_manager_unmonitor_buffer (self, buffer);
+
   g_signal_handlers_disconnect_by_func (buffer,
                                         G_CALLBACK (ide_buffer_manager_buffer_changed),
                                         self);
@@ -1293,6 +1530,8 @@ ide_buffer_manager_finalize (GObject *object)
 
   g_clear_pointer (&self->buffers, g_ptr_array_unref);
   g_clear_pointer (&self->timeouts, g_hash_table_unref);
+  g_clear_pointer (&self->monitored, g_hash_table_unref);
+  g_clear_pointer (&self->monitors, g_hash_table_unref);
   g_clear_object (&self->settings);
 
   G_OBJECT_CLASS (ide_buffer_manager_parent_class)->finalize (object);
@@ -1549,6 +1788,11 @@ ide_buffer_manager_init (IdeBufferManager *self)
   self->buffers = g_ptr_array_new ();
   self->max_file_size = MAX_FILE_SIZE_BYTES_DEFAULT;
   self->timeouts = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->monitors = g_hash_table_new_full (g_file_hash,
+                                          (GEqualFunc)g_file_equal,
+                                          NULL,
+                                          directory_monitor_free);
+  self->monitored = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
   self->word_completion = g_object_new (IDE_TYPE_COMPLETION_WORDS, NULL);
   self->settings = g_settings_new ("org.gnome.builder.editor");
 }
@@ -0,0 +1,49 @@
+/* ide-buffer-snapshot-private.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUFFER_SNAPSHOT_PRIVATE_H
+#define IDE_BUFFER_SNAPSHOT_PRIVATE_H
+
+#include "buffers/ide-buffer-snapshot.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The rope is the mutable side of IdeBufferSnapshot. IdeBuffer keeps one in
+ * sync with its contents from the insert-text and delete-range handlers,
+ * using character offsets from before the change is applied.
+ */
+typedef struct _IdeBufferRope IdeBufferRope;
+
+IdeBufferRope     *ide_buffer_rope_new      (const gchar   *text,
+                                             gsize          length);
+void               ide_buffer_rope_free     (IdeBufferRope *self);
+void               ide_buffer_rope_insert   (IdeBufferRope *self,
+                                             gint           offset,
+                                             const gchar   *text,
+                                             gsize          length);
+void               ide_buffer_rope_delete   (IdeBufferRope *self,
+                                             gint           begin_offset,
+                                             gint           end_offset);
+IdeBufferSnapshot *ide_buffer_rope_snapshot (IdeBufferRope *self,
+                                             gsize          change_count,
+                                             gboolean       trailing_newline);
+
+G_END_DECLS
+
+#endif /* IDE_BUFFER_SNAPSHOT_PRIVATE_H */
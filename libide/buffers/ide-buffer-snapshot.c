@@ -0,0 +1,663 @@
+/* ide-buffer-snapshot.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-buffer-snapshot"
+
+#include <egg-counter.h>
+#include <string.h>
+
+#include "buffers/ide-buffer-snapshot.h"
+#include "buffers/ide-buffer-snapshot-private.h"
+
+/*
+ * The text is stored as an array of reference counted chunks. A snapshot
+ * takes a reference to every chunk, after which the rope must copy a chunk
+ * before modifying it. Since an edit touches at most a couple of chunks,
+ * taking a snapshot after each change only copies a few kilobytes no matter
+ * how large the buffer is.
+ */
+
+#define CHUNK_SIZE     4096
+#define MAX_CHUNK_SIZE (CHUNK_SIZE * 2)
+#define CHUNK_SLACK    256
+
+typedef struct
+{
+  volatile gint ref_count;
+  gint          n_chars;
+  gsize         len;
+  gsize         alloc;
+  gchar         data[];
+} Chunk;
+
+struct _IdeBufferRope
+{
+  GPtrArray *chunks;
+  /*
+   * The character offset at which each chunk begins, so that a chunk can
+   * be found with a binary search. Edits only invalidate the offsets from
+   * the chunk they touch onward, which are recomputed on the next lookup.
+   */
+  GArray    *offsets;
+  guint      n_valid_offsets;
+};
+
+struct _IdeBufferSnapshot
+{
+  volatile gint  ref_count;
+  gsize          change_count;
+  gsize          len;
+  guint          trailing_newline : 1;
+  guint          n_chunks;
+  Chunk         *chunks[];
+};
+
+G_DEFINE_BOXED_TYPE (IdeBufferSnapshot, ide_buffer_snapshot,
+                     ide_buffer_snapshot_ref, ide_buffer_snapshot_unref)
+
+EGG_DEFINE_COUNTER (instances, "IdeBufferSnapshot", "Instances", "Number of buffer snapshots")
+EGG_DEFINE_COUNTER (chunk_copies, "IdeBufferSnapshot", "Chunk Copies", "Number of chunks copied before writing")
+
+static Chunk *
+chunk_new (gsize alloc)
+{
+  Chunk *chunk;
+
+  chunk = g_malloc (sizeof *chunk + alloc);
+  chunk->ref_count = 1;
+  chunk->n_chars = 0;
+  chunk->len = 0;
+  chunk->alloc = alloc;
+
+  return chunk;
+}
+
+static Chunk *
+chunk_ref (Chunk *chunk)
+{
+  g_atomic_int_inc (&chunk->ref_count);
+  return chunk;
+}
+
+static void
+chunk_unref (gpointer data)
+{
+  Chunk *chunk = data;
+
+  if (g_atomic_int_dec_and_test (&chunk->ref_count))
+    g_free (chunk);
+}
+
+static Chunk *
+chunk_new_for_text (const gchar *text,
+                    gsize        len)
+{
+  Chunk *chunk;
+
+  chunk = chunk_new (MIN (len + CHUNK_SLACK, MAX_CHUNK_SIZE));
+  memcpy (chunk->data, text, len);
+  chunk->len = len;
+  chunk->n_chars = g_utf8_strlen (text, len);
+
+  return chunk;
+}
+
+static inline void
+ide_buffer_rope_invalidate (IdeBufferRope *self,
+                            guint          index)
+{
+  self->n_valid_offsets = MIN (self->n_valid_offsets, index);
+}
+
+static void
+ide_buffer_rope_update_offsets (IdeBufferRope *self)
+{
+  guint i = self->n_valid_offsets;
+
+  if (i == self->chunks->len)
+    return;
+
+  g_array_set_size (self->offsets, self->chunks->len);
+
+  for (; i < self->chunks->len; i++)
+    {
+      gint offset = 0;
+
+      if (i > 0)
+        {
+          const Chunk *prev = g_ptr_array_index (self->chunks, i - 1);
+
+          offset = g_array_index (self->offsets, gint, i - 1) + prev->n_chars;
+        }
+
+      g_array_index (self->offsets, gint, i) = offset;
+    }
+
+  self->n_valid_offsets = self->chunks->len;
+}
+
+/*
+ * Splits @text into chunks of about CHUNK_SIZE bytes, without breaking a
+ * UTF-8 sequence, and inserts them into the rope at @index.
+ */
+static void
+ide_buffer_rope_insert_chunks (IdeBufferRope *self,
+                               guint          index,
+                               const gchar   *text,
+                               gsize          len)
+{
+  ide_buffer_rope_invalidate (self, index);
+
+  while (len > 0)
+    {
+      gsize size = MIN (len, CHUNK_SIZE);
+
+      while (size < len && size > 0 && (text[size] & 0xC0) == 0x80)
+        size--;
+
+      if (size == 0)
+        size = MIN (len, CHUNK_SIZE);
+
+      g_ptr_array_insert (self->chunks, index++, chunk_new_for_text (text, size));
+
+      text += size;
+      len -= size;
+    }
+}
+
+/*
+ * Gets the chunk at @index, copying it first if a snapshot may be using it
+ * or it does not have room for @needed bytes.
+ */
+static Chunk *
+ide_buffer_rope_get_writable (IdeBufferRope *self,
+                              guint          index,
+                              gsize          needed)
+{
+  Chunk *chunk = g_ptr_array_index (self->chunks, index);
+  Chunk *copy;
+
+  if (g_atomic_int_get (&chunk->ref_count) == 1 && chunk->alloc >= needed)
+    return chunk;
+
+  EGG_COUNTER_INC (chunk_copies);
+
+  copy = chunk_new (MIN (MAX (needed, chunk->len) + CHUNK_SLACK, MAX_CHUNK_SIZE));
+  memcpy (copy->data, chunk->data, chunk->len);
+  copy->len = chunk->len;
+  copy->n_chars = chunk->n_chars;
+
+  g_ptr_array_index (self->chunks, index) = copy;
+  chunk_unref (chunk);
+
+  return copy;
+}
+
+/*
+ * Locates the chunk containing the character at @offset. If @offset falls
+ * between two chunks, @prefer_end selects the end of the first one rather
+ * than the start of the second.
+ */
+static gboolean
+ide_buffer_rope_locate (IdeBufferRope *self,
+                        gint           offset,
+                        gboolean       prefer_end,
+                        guint         *index,
+                        gint          *char_pos,
+                        gsize         *byte_pos)
+{
+  const Chunk *chunk;
+  guint lo = 0;
+  guint hi;
+  guint i;
+
+  if (self->chunks->len == 0)
+    return FALSE;
+
+  ide_buffer_rope_update_offsets (self);
+
+  /* Find the last chunk beginning at or before @offset */
+  hi = self->chunks->len;
+  while (hi - lo > 1)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (g_array_index (self->offsets, gint, mid) <= offset)
+        lo = mid;
+      else
+        hi = mid;
+    }
+
+  i = lo;
+  offset -= g_array_index (self->offsets, gint, i);
+
+  if (offset == 0 && prefer_end && i > 0)
+    offset = ((const Chunk *)g_ptr_array_index (self->chunks, --i))->n_chars;
+
+  chunk = g_ptr_array_index (self->chunks, i);
+
+  if (offset > chunk->n_chars ||
+      (offset == chunk->n_chars && !prefer_end && i + 1 < self->chunks->len))
+    return FALSE;
+
+  *index = i;
+  *char_pos = offset;
+  *byte_pos = g_utf8_offset_to_pointer (chunk->data, offset) - chunk->data;
+
+  return TRUE;
+}
+
+IdeBufferRope *
+ide_buffer_rope_new (const gchar *text,
+                     gsize        length)
+{
+  IdeBufferRope *self;
+
+  self = g_slice_new0 (IdeBufferRope);
+  self->chunks = g_ptr_array_new_with_free_func (chunk_unref);
+  self->offsets = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  if (text != NULL)
+    ide_buffer_rope_insert_chunks (self, 0, text, length);
+
+  return self;
+}
+
+void
+ide_buffer_rope_free (IdeBufferRope *self)
+{
+  if (self != NULL)
+    {
+      g_clear_pointer (&self->chunks, g_ptr_array_unref);
+      g_clear_pointer (&self->offsets, g_array_unref);
+      g_slice_free (IdeBufferRope, self);
+    }
+}
+
+void
+ide_buffer_rope_insert (IdeBufferRope *self,
+                        gint           offset,
+                        const gchar   *text,
+                        gsize          length)
+{
+  Chunk *chunk;
+  gsize byte_pos;
+  gint char_pos;
+  guint index;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (offset >= 0);
+  g_return_if_fail (text != NULL || length == 0);
+
+  if (length == 0)
+    return;
+
+  if (!ide_buffer_rope_locate (self, offset, TRUE, &index, &char_pos, &byte_pos))
+    {
+      if (self->chunks->len == 0 && offset == 0)
+        ide_buffer_rope_insert_chunks (self, 0, text, length);
+      else
+        g_warning ("Insertion at %d is past the end of the rope", offset);
+      return;
+    }
+
+  chunk = g_ptr_array_index (self->chunks, index);
+
+  /* Chunks after this one move, even if it is edited in place */
+  ide_buffer_rope_invalidate (self, index + 1);
+
+  if (chunk->len + length <= MAX_CHUNK_SIZE)
+    {
+      chunk = ide_buffer_rope_get_writable (self, index, chunk->len + length);
+      memmove (&chunk->data[byte_pos + length],
+               &chunk->data[byte_pos],
+               chunk->len - byte_pos);
+      memcpy (&chunk->data[byte_pos], text, length);
+      chunk->len += length;
+      chunk->n_chars += g_utf8_strlen (text, length);
+    }
+  else
+    {
+      g_autofree gchar *joined = NULL;
+      gsize joined_len = chunk->len + length;
+
+      joined = g_malloc (joined_len);
+      memcpy (joined, chunk->data, byte_pos);
+      memcpy (joined + byte_pos, text, length);
+      memcpy (joined + byte_pos + length, &chunk->data[byte_pos], chunk->len - byte_pos);
+
+      g_ptr_array_remove_index (self->chunks, index);
+      ide_buffer_rope_insert_chunks (self, index, joined, joined_len);
+    }
+}
+
+void
+ide_buffer_rope_delete (IdeBufferRope *self,
+                        gint           begin_offset,
+                        gint           end_offset)
+{
+  Chunk *first;
+  Chunk *last;
+  gsize begin_byte;
+  gsize end_byte;
+  gint begin_char;
+  gint end_char;
+  guint begin_index;
+  guint end_index;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (begin_offset >= 0);
+
+  if (begin_offset >= end_offset)
+    return;
+
+  if (!ide_buffer_rope_locate (self, begin_offset, FALSE, &begin_index, &begin_char, &begin_byte) ||
+      !ide_buffer_rope_locate (self, end_offset, TRUE, &end_index, &end_char, &end_byte))
+    {
+      g_warning ("Deletion of %d:%d is past the end of the rope", begin_offset, end_offset);
+      return;
+    }
+
+  ide_buffer_rope_invalidate (self, begin_index + 1);
+
+  if (begin_index == end_index)
+    {
+      first = ide_buffer_rope_get_writable (self, begin_index, 0);
+      memmove (&first->data[begin_byte], &first->data[end_byte], first->len - end_byte);
+      first->len -= end_byte - begin_byte;
+      first->n_chars -= end_char - begin_char;
+    }
+  else
+    {
+      first = ide_buffer_rope_get_writable (self, begin_index, 0);
+      first->len = begin_byte;
+      first->n_chars = begin_char;
+
+      last = ide_buffer_rope_get_writable (self, end_index, 0);
+      memmove (last->data, &last->data[end_byte], last->len - end_byte);
+      last->len -= end_byte;
+      last->n_chars -= end_char;
+
+      if (end_index > begin_index + 1)
+        g_ptr_array_remove_range (self->chunks, begin_index + 1, end_index - begin_index - 1);
+    }
+
+  /* Drop any chunks emptied by the deletion */
+  for (guint i = MIN (begin_index + 2, self->chunks->len); i > begin_index; i--)
+    {
+      Chunk *chunk = g_ptr_array_index (self->chunks, i - 1);
+
+      if (chunk->len == 0)
+        g_ptr_array_remove_index (self->chunks, i - 1);
+    }
+
+  /* Merge what is left around the deletion if it is small enough */
+  if (begin_index + 1 < self->chunks->len)
+    {
+      Chunk *next = g_ptr_array_index (self->chunks, begin_index + 1);
+
+      first = g_ptr_array_index (self->chunks, begin_index);
+
+      if (first->len + next->len <= CHUNK_SIZE)
+        {
+          first = ide_buffer_rope_get_writable (self, begin_index, first->len + next->len);
+          memcpy (&first->data[first->len], next->data, next->len);
+          first->len += next->len;
+          first->n_chars += next->n_chars;
+          g_ptr_array_remove_index (self->chunks, begin_index + 1);
+        }
+    }
+}
+
+IdeBufferSnapshot *
+ide_buffer_rope_snapshot (IdeBufferRope *self,
+                          gsize          change_count,
+                          gboolean       trailing_newline)
+{
+  IdeBufferSnapshot *ret;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  ret = g_malloc (sizeof *ret + sizeof (Chunk *) * self->chunks->len);
+  ret->ref_count = 1;
+  ret->change_count = change_count;
+  ret->trailing_newline = !!trailing_newline;
+  ret->n_chunks = self->chunks->len;
+  ret->len = ret->trailing_newline;
+
+  for (guint i = 0; i < self->chunks->len; i++)
+    {
+      ret->chunks[i] = chunk_ref (g_ptr_array_index (self->chunks, i));
+      ret->len += ret->chunks[i]->len;
+    }
+
+  EGG_COUNTER_INC (instances);
+
+  return ret;
+}
+
+IdeBufferSnapshot *
+ide_buffer_snapshot_ref (IdeBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+ide_buffer_snapshot_unref (IdeBufferSnapshot *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      for (guint i = 0; i < self->n_chunks; i++)
+        chunk_unref (self->chunks[i]);
+      g_free (self);
+
+      EGG_COUNTER_DEC (instances);
+    }
+}
+
+/**
+ * ide_buffer_snapshot_get_change_count:
+ * @self: An #IdeBufferSnapshot.
+ *
+ * Gets the value of #IdeBuffer:change-count at the time the snapshot was
+ * taken, which can be used to check if the snapshot is still current.
+ *
+ * Returns: The change count of the buffer.
+ */
+gsize
+ide_buffer_snapshot_get_change_count (IdeBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->change_count;
+}
+
+/**
+ * ide_buffer_snapshot_get_length:
+ * @self: An #IdeBufferSnapshot.
+ *
+ * Gets the length of the snapshot in bytes, including the implicit trailing
+ * newline of the buffer, if any.
+ *
+ * Returns: The length of the snapshot in bytes.
+ */
+gsize
+ide_buffer_snapshot_get_length (IdeBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->len;
+}
+
+/**
+ * ide_buffer_snapshot_get_n_chunks:
+ * @self: An #IdeBufferSnapshot.
+ *
+ * Gets the number of chunks that make up the snapshot. See
+ * ide_buffer_snapshot_get_chunk().
+ *
+ * Returns: The number of chunks.
+ */
+guint
+ide_buffer_snapshot_get_n_chunks (IdeBufferSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_chunks + self->trailing_newline;
+}
+
+/**
+ * ide_buffer_snapshot_get_chunk:
+ * @self: An #IdeBufferSnapshot.
+ * @chunk: The index of the chunk.
+ * @length: (out): A location for the length of the chunk in bytes.
+ *
+ * Gets the text of a chunk of the snapshot. Concatenating the chunks in
+ * order produces the same text as ide_buffer_get_content(). A chunk never
+ * ends in the middle of a UTF-8 sequence.
+ *
+ * The text is not nul-terminated, and remains valid for as long as @self.
+ * It is safe to call this from any thread.
+ *
+ * Returns: (transfer none) (array length=length) (element-type guint8): The
+ *   text of the chunk.
+ */
+const gchar *
+ide_buffer_snapshot_get_chunk (IdeBufferSnapshot *self,
+                               guint              chunk,
+                               gsize             *length)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (chunk < self->n_chunks + self->trailing_newline, NULL);
+  g_return_val_if_fail (length != NULL, NULL);
+
+  if (chunk == self->n_chunks)
+    {
+      *length = 1;
+      return "\n";
+    }
+
+  *length = self->chunks[chunk]->len;
+
+  return self->chunks[chunk]->data;
+}
+
+/**
+ * ide_buffer_snapshot_get_bytes:
+ * @self: An #IdeBufferSnapshot.
+ *
+ * Copies the contents of the snapshot into a contiguous #GBytes. This is
+ * safe to call from any thread, so consumers that require contiguous text
+ * should call this from their worker thread.
+ *
+ * As with ide_buffer_get_content(), the data is followed by a nul byte that
+ * is not included in the size of the #GBytes.
+ *
+ * Returns: (transfer full): A #GBytes.
+ */
+GBytes *
+ide_buffer_snapshot_get_bytes (IdeBufferSnapshot *self)
+{
+  gchar *data;
+  gchar *pos;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  pos = data = g_malloc (self->len + 1);
+
+  for (guint i = 0; i < self->n_chunks; i++)
+    {
+      memcpy (pos, self->chunks[i]->data, self->chunks[i]->len);
+      pos += self->chunks[i]->len;
+    }
+
+  if (self->trailing_newline)
+    *pos++ = '\n';
+
+  *pos = '\0';
+
+  return g_bytes_new_take (data, self->len);
+}
+
+/**
+ * ide_buffer_snapshot_get_slice:
+ * @self: An #IdeBufferSnapshot.
+ * @begin_offset: The character offset to begin at.
+ * @end_offset: The character offset to end at, or -1 for the end.
+ *
+ * Copies the text between two character offsets of the snapshot, which
+ * match those of the #GtkTextIter within the buffer at the time the
+ * snapshot was taken. This is safe to call from any thread.
+ *
+ * Returns: (transfer full): A newly allocated, nul-terminated string.
+ */
+gchar *
+ide_buffer_snapshot_get_slice (IdeBufferSnapshot *self,
+                               gint               begin_offset,
+                               gint               end_offset)
+{
+  GString *str;
+  gint offset = 0;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (begin_offset >= 0, NULL);
+
+  if (end_offset < 0)
+    end_offset = G_MAXINT;
+
+  str = g_string_new (NULL);
+
+  for (guint i = 0; i < self->n_chunks && offset < end_offset; i++)
+    {
+      const Chunk *chunk = self->chunks[i];
+      const gchar *begin;
+      const gchar *end;
+
+      /* Whole chunks before the slice can be skipped by their length */
+      if (offset + chunk->n_chars <= begin_offset)
+        {
+          offset += chunk->n_chars;
+          continue;
+        }
+
+      begin = chunk->data;
+      if (begin_offset > offset)
+        begin = g_utf8_offset_to_pointer (chunk->data, begin_offset - offset);
+
+      end = chunk->data + chunk->len;
+      if (end_offset < offset + chunk->n_chars)
+        end = g_utf8_offset_to_pointer (chunk->data, end_offset - offset);
+
+      g_string_append_len (str, begin, end - begin);
+
+      offset += chunk->n_chars;
+    }
+
+  if (self->trailing_newline && offset >= begin_offset && offset < end_offset)
+    g_string_append_c (str, '\n');
+
+  return g_string_free (str, FALSE);
+}
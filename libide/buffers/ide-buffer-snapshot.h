@@ -0,0 +1,48 @@
+/* ide-buffer-snapshot.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUFFER_SNAPSHOT_H
+#define IDE_BUFFER_SNAPSHOT_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BUFFER_SNAPSHOT (ide_buffer_snapshot_get_type())
+
+typedef struct _IdeBufferSnapshot IdeBufferSnapshot;
+
+GType              ide_buffer_snapshot_get_type         (void);
+IdeBufferSnapshot *ide_buffer_snapshot_ref              (IdeBufferSnapshot *self);
+void               ide_buffer_snapshot_unref            (IdeBufferSnapshot *self);
+gsize              ide_buffer_snapshot_get_change_count (IdeBufferSnapshot *self);
+gsize              ide_buffer_snapshot_get_length       (IdeBufferSnapshot *self);
+guint              ide_buffer_snapshot_get_n_chunks     (IdeBufferSnapshot *self);
+const gchar       *ide_buffer_snapshot_get_chunk        (IdeBufferSnapshot *self,
+                                                         guint              chunk,
+                                                         gsize             *length);
+GBytes            *ide_buffer_snapshot_get_bytes        (IdeBufferSnapshot *self);
+gchar             *ide_buffer_snapshot_get_slice        (IdeBufferSnapshot *self,
+                                                         gint               begin_offset,
+                                                         gint               end_offset);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (IdeBufferSnapshot, ide_buffer_snapshot_unref)
+
+G_END_DECLS
+
+#endif /* IDE_BUFFER_SNAPSHOT_H */
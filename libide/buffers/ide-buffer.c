@@ -28,6 +28,7 @@
 #include "ide-internal.h"
 
 #include "buffers/ide-buffer-change-monitor.h"
+#include "buffers/ide-buffer-snapshot-private.h"
 #include "buffers/ide-buffer.h"
 #include "buffers/ide-unsaved-files.h"
 #include "diagnostics/ide-diagnostic.h"
@@ -74,6 +75,8 @@ typedef struct
   EggSignalGroup         *diagnostics_manager_signals;
   IdeFile                *file;
   GBytes                 *content;
+  IdeBufferRope          *rope;
+  IdeBufferSnapshot      *snapshot;
   IdeBufferChangeMonitor *change_monitor;
   IdeHighlightEngine     *highlight_engine;
   IdeExtensionAdapter    *rename_provider_adapter;
@@ -83,7 +86,6 @@ typedef struct
 
   EggSignalGroup         *file_signals;
 
-  GFileMonitor           *file_monitor;
 
   gulong                  change_monitor_changed_handler;
 
@@ -684,6 +686,7 @@ ide_buffer_changed (GtkTextBuffer *buffer)
   priv->change_count++;
 
   g_clear_pointer (&priv->content, g_bytes_unref);
+  g_clear_pointer (&priv->snapshot, ide_buffer_snapshot_unref);
 }
 
 static void
@@ -691,6 +694,11 @@ ide_buffer_delete_range (GtkTextBuffer *buffer,
                          GtkTextIter   *start,
                          GtkTextIter   *end)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  gint begin_offset;
+  gint end_offset;
+
   IDE_ENTRY;
 
 #ifdef IDE_ENABLE_TRACE
@@ -709,6 +717,13 @@ ide_buffer_delete_range (GtkTextBuffer *buffer,
   }
 #endif
 
+  begin_offset = gtk_text_iter_get_offset (start);
+  end_offset = gtk_text_iter_get_offset (end);
+
+  /* Update the rope first, so it is current when ::changed is emitted */
+  if (priv->rope != NULL)
+    ide_buffer_rope_delete (priv->rope, begin_offset, end_offset);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->delete_range (buffer, start, end);
 
   ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
@@ -722,7 +737,10 @@ ide_buffer_insert_text (GtkTextBuffer *buffer,
                         const gchar   *text,
                         gint           len)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
   gboolean check_modeline = FALSE;
+  gint offset;
 
   g_assert (IDE_IS_BUFFER (buffer));
   g_assert (location);
@@ -738,6 +756,12 @@ ide_buffer_insert_text (GtkTextBuffer *buffer,
       ((text [0] == '\n') || ((len > 1) && (strchr (text, '\n') != NULL))))
     check_modeline = TRUE;
 
+  offset = gtk_text_iter_get_offset (location);
+
+  /* Update the rope first, so it is current when ::changed is emitted */
+  if (priv->rope != NULL)
+    ide_buffer_rope_insert (priv->rope, offset, text, len);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->insert_text (buffer, location, text, len);
 
   ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
@@ -774,8 +798,8 @@ do_check_modified (gpointer user_data)
   IDE_RETURN (G_SOURCE_REMOVE);
 }
 
-static void
-ide_buffer_queue_modify_check (IdeBuffer *self)
+void
+_ide_buffer_queue_modify_check (IdeBuffer *self)
 {
   IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
 
@@ -792,82 +816,22 @@ ide_buffer_queue_modify_check (IdeBuffer *self)
                                                         self);
 }
 
-static void
-ide_buffer__file_monitor_changed (IdeBuffer         *self,
-                                  GFile             *file,
-                                  GFile             *other_file,
-                                  GFileMonitorEvent  event,
-                                  GFileMonitor      *file_monitor)
-{
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_BUFFER (self));
-  g_assert (G_IS_FILE (file));
-  g_assert (G_IS_FILE_MONITOR (file_monitor));
-
-  switch (event)
-    {
-    case G_FILE_MONITOR_EVENT_CHANGED:
-    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
-    case G_FILE_MONITOR_EVENT_MOVED:
-    case G_FILE_MONITOR_EVENT_CREATED:
-    case G_FILE_MONITOR_EVENT_DELETED:
-    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
-    case G_FILE_MONITOR_EVENT_RENAMED:
-      IDE_TRACE_MSG ("buffer change event = %d", (int)event);
-      ide_buffer_queue_modify_check (self);
-      break;
-
-    case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
-    case G_FILE_MONITOR_EVENT_UNMOUNTED:
-    case G_FILE_MONITOR_EVENT_MOVED_IN:
-    case G_FILE_MONITOR_EVENT_MOVED_OUT:
-    default:
-      break;
-    }
-
-  IDE_EXIT;
-}
-
 static void
 ide_buffer__file_notify_file (IdeBuffer  *self,
                               GParamSpec *pspec,
                               IdeFile    *file)
 {
   IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
-  GFile *gfile;
 
   g_assert (IDE_IS_BUFFER (self));
   g_assert (IDE_IS_FILE (file));
 
-  gfile = ide_file_get_file (file);
-
-  if (priv->file_monitor)
-    {
-      g_file_monitor_cancel (priv->file_monitor);
-      g_clear_object (&priv->file_monitor);
-    }
-
-  if (gfile != NULL)
-    {
-      GError *error = NULL;
-
-      priv->file_monitor = g_file_monitor_file (gfile, G_FILE_MONITOR_NONE, NULL, &error);
-
-      if (priv->file_monitor != NULL)
-        {
-          g_signal_connect_object (priv->file_monitor,
-                                   "changed",
-                                   G_CALLBACK (ide_buffer__file_monitor_changed),
-                                   self,
-                                   G_CONNECT_SWAPPED);
-        }
-      else if (error != NULL)
-        {
-          g_debug ("Failed to create GFileMonitor: %s", error->message);
-          g_clear_error (&error);
-        }
-    }
+  /*
+   * The buffer manager watches the directory containing the file rather than
+   * each buffer creating its own monitor, so let it know where we moved.
+   */
+  if (priv->context != NULL)
+    _ide_buffer_manager_monitor_buffer (ide_context_get_buffer_manager (priv->context), self);
 }
 
 static void
@@ -1248,12 +1212,6 @@ ide_buffer_dispose (GObject *object)
       priv->check_modified_timeout = 0;
     }
 
-  if (priv->file_monitor)
-    {
-      g_file_monitor_cancel (priv->file_monitor);
-      g_clear_object (&priv->file_monitor);
-    }
-
   g_clear_object (&priv->file_signals);
 
   if (priv->highlight_engine != NULL)
@@ -1270,6 +1228,8 @@ ide_buffer_dispose (GObject *object)
   g_clear_pointer (&priv->diagnostics_line_cache, g_hash_table_unref);
   g_clear_pointer (&priv->diagnostics, ide_diagnostics_unref);
   g_clear_pointer (&priv->content, g_bytes_unref);
+  g_clear_pointer (&priv->snapshot, ide_buffer_snapshot_unref);
+  g_clear_pointer (&priv->rope, ide_buffer_rope_free);
   g_clear_pointer (&priv->title, g_free);
   g_clear_object (&priv->file);
   g_clear_object (&priv->highlight_engine);
@@ -1894,37 +1854,6 @@ ide_buffer_get_diagnostic_at_iter (IdeBuffer         *self,
   return NULL;
 }
 
-static gboolean
-ide_buffer_can_do_newline_hack (IdeBuffer *self,
-                                guint      len)
-{
-  guint next_pow2;
-
-  g_assert (IDE_IS_BUFFER (self));
-
-  /*
-   * If adding two bytes to our length (one for \n and one for \0) is still under the next
-   * power of two, then we can avoid making a copy of the buffer when saving the buffer
-   * to our drafts.
-   *
-   * HACK: This relies on the fact that GtkTextBuffer returns a GString allocated string
-   *       which grows the string in powers of two.
-   */
-
-  if ((len == 0) || (len & (len - 1)) == 0)
-    return FALSE;
-
-  next_pow2 = len;
-  next_pow2 |= next_pow2 >> 1;
-  next_pow2 |= next_pow2 >> 2;
-  next_pow2 |= next_pow2 >> 4;
-  next_pow2 |= next_pow2 >> 8;
-  next_pow2 |= next_pow2 >> 16;
-  next_pow2++;
-
-  return ((len + 2) < next_pow2);
-}
-
 /**
  * ide_buffer_get_content:
  * @self: A #IdeBuffer.
@@ -1948,46 +1877,19 @@ ide_buffer_get_content (IdeBuffer *self)
 
   if (!priv->content)
     {
+      g_autoptr(IdeBufferSnapshot) snapshot = NULL;
       IdeUnsavedFiles *unsaved_files;
-      gchar *text;
-      GtkTextIter begin;
-      GtkTextIter end;
       GFile *gfile = NULL;
-      gsize len;
-
-      gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (self), &begin, &end);
-      text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (self), &begin, &end, TRUE);
 
       /*
-       * If implicit newline is set, add a \n in place of the \0 and avoid duplicating the buffer.
-       * Make sure to track length beforehand, since we would overwrite afterwards. Since
-       * conversion to \r\n is dealth with during save operations, this should be fine for both.
-       * The unsaved files will restore to a buffer, for which \n is acceptable.
-       */
-      len = strlen (text);
-      if (gtk_source_buffer_get_implicit_trailing_newline (GTK_SOURCE_BUFFER (self)))
-        {
-          if (!ide_buffer_can_do_newline_hack (self, len))
-            {
-              gchar *copy;
-
-              copy = g_malloc (len + 2);
-              memcpy (copy, text, len);
-              g_free (text);
-              text = copy;
-            }
-
-          text [len] = '\n';
-          text [++len] = '\0';
-        }
-
-      /*
-       * We pass a buffer that is longer than the length we tell GBytes about.
-       * This way, compilers that don't want to see the trailing \0 can ignore
+       * The snapshot includes the implicit trailing newline, if any, and the
+       * bytes are followed by a \0 that is not included in their length. This
+       * way, compilers that don't want to see the trailing \0 can ignore
        * that data, but compilers that rely on valid C strings can also rely
        * on the buffer to be valid.
        */
-      priv->content = g_bytes_new_take (text, len);
+      snapshot = ide_buffer_get_snapshot (self);
+      priv->content = ide_buffer_snapshot_get_bytes (snapshot);
 
       if ((priv->context != NULL) &&
           (priv->file != NULL) &&
@@ -2001,6 +1903,48 @@ ide_buffer_get_content (IdeBuffer *self)
   return g_bytes_ref (priv->content);
 }
 
+/**
+ * ide_buffer_get_snapshot:
+ * @self: A #IdeBuffer.
+ *
+ * Gets an immutable snapshot of the contents of the buffer. Taking a
+ * snapshot does not copy the text of the buffer, and the snapshot may be
+ * used from any thread, making it suitable to pass to worker threads.
+ *
+ * The first snapshot of a buffer copies its contents once, after which
+ * the buffer keeps them up to date as it is edited.
+ *
+ * Returns: (transfer full): An #IdeBufferSnapshot.
+ */
+IdeBufferSnapshot *
+ide_buffer_get_snapshot (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), NULL);
+
+  if (priv->snapshot == NULL)
+    {
+      gboolean trailing_newline;
+
+      if (priv->rope == NULL)
+        {
+          g_autofree gchar *text = NULL;
+          GtkTextIter begin;
+          GtkTextIter end;
+
+          gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (self), &begin, &end);
+          text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (self), &begin, &end, TRUE);
+          priv->rope = ide_buffer_rope_new (text, strlen (text));
+        }
+
+      trailing_newline = gtk_source_buffer_get_implicit_trailing_newline (GTK_SOURCE_BUFFER (self));
+      priv->snapshot = ide_buffer_rope_snapshot (priv->rope, priv->change_count, trailing_newline);
+    }
+
+  return ide_buffer_snapshot_ref (priv->snapshot);
+}
+
 /**
  * ide_buffer_trim_trailing_whitespace:
  * @self: A #IdeBuffer.
@@ -2158,6 +2102,16 @@ _ide_buffer_get_loading (IdeBuffer *self)
   return priv->loading;
 }
 
+IdeHighlightEngine *
+_ide_buffer_get_highlight_engine (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), NULL);
+
+  return priv->highlight_engine;
+}
+
 void
 _ide_buffer_set_loading (IdeBuffer *self,
                          gboolean   loading)
@@ -23,6 +23,8 @@
 
 #include "ide-types.h"
 
+#include "buffers/ide-buffer-snapshot.h"
+
 G_BEGIN_DECLS
 
 #define IDE_TYPE_BUFFER (ide_buffer_get_type ())
@@ -71,6 +73,7 @@ IdeFile            *ide_buffer_get_file                      (IdeBuffer
 IdeBufferLineFlags  ide_buffer_get_line_flags                (IdeBuffer            *self,
                                                               guint                 line);
 gboolean            ide_buffer_get_read_only                 (IdeBuffer            *self);
+IdeBufferSnapshot  *ide_buffer_get_snapshot                  (IdeBuffer            *self);
 gboolean            ide_buffer_get_spell_checking            (IdeBuffer            *self);
 gboolean            ide_buffer_get_highlight_diagnostics     (IdeBuffer            *self);
 const gchar        *ide_buffer_get_style_scheme_name         (IdeBuffer            *self);
@@ -0,0 +1,65 @@
+/* ide-build-error-parser-private.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUILD_ERROR_PARSER_PRIVATE_H
+#define IDE_BUILD_ERROR_PARSER_PRIVATE_H
+
+#include <gio/gio.h>
+
+#include "diagnostics/ide-diagnostic.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BUILD_ERROR_PARSER (ide_build_error_parser_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeBuildErrorParser, ide_build_error_parser, IDE, BUILD_ERROR_PARSER, GObject)
+
+typedef struct
+{
+  /* Absolute, or relative to the top of the project */
+  gchar                 *filename;
+  gchar                 *message;
+  guint                  line;
+  guint                  column;
+  IdeDiagnosticSeverity  severity;
+} IdeBuildError;
+
+/*
+ * Called from the main thread with the errors extracted from the build
+ * output since the previous call.
+ */
+typedef void (*IdeBuildErrorParserCallback) (const IdeBuildError *errors,
+                                             guint                n_errors,
+                                             gpointer             user_data);
+
+IdeBuildErrorParser *ide_build_error_parser_new           (IdeBuildErrorParserCallback   callback,
+                                                           gpointer                      user_data);
+guint                ide_build_error_parser_add_format    (IdeBuildErrorParser          *self,
+                                                           const gchar                  *regex,
+                                                           GRegexCompileFlags            flags,
+                                                           gboolean                      builtin,
+                                                           GError                      **error);
+gboolean             ide_build_error_parser_remove_format (IdeBuildErrorParser          *self,
+                                                           guint                         format_id);
+void                 ide_build_error_parser_push          (IdeBuildErrorParser          *self,
+                                                           const gchar                  *message,
+                                                           gsize                         message_len);
+
+G_END_DECLS
+
+#endif /* IDE_BUILD_ERROR_PARSER_PRIVATE_H */
@@ -0,0 +1,718 @@
+/* ide-build-error-parser.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-build-error-parser"
+
+#include <string.h>
+
+#include "ide-debug.h"
+#include "ide-macros.h"
+
+#include "buildsystem/ide-build-error-parser-private.h"
+#include "buildsystem/ide-build-utils.h"
+
+/*
+ * IdeBuildErrorParser extracts errors from build output using the error
+ * formats registered with the IdeBuildPipeline.
+ *
+ * Lines are parsed on a dedicated thread so that noisy builds do not stall
+ * the main loop. The error formats are compiled into a single regex with
+ * one alternative per format when possible. Built-in formats, which are
+ * known to report a severity, are only matched against lines with a colon
+ * followed by a severity keyword. Other formats are matched against every
+ * line. Errors are delivered to the main thread in batches.
+ */
+
+#define DISPATCH_MAX      100
+#define COMBINABLE_FLAGS  (G_REGEX_CASELESS | G_REGEX_MULTILINE | G_REGEX_DOTALL | \
+                           G_REGEX_EXTENDED | G_REGEX_OPTIMIZE)
+
+typedef struct
+{
+  guint               id;
+  gchar              *pattern;
+  GRegexCompileFlags  flags;
+  guint               builtin : 1;
+} ErrorFormat;
+
+typedef struct
+{
+  /* A single regex matching any of the formats, if they could be combined */
+  GRegex    *combined;
+  /* Otherwise, each of the formats is tried in order */
+  GPtrArray *regexes;
+} MatcherSet;
+
+typedef struct
+{
+  volatile gint ref_count;
+  /* Built-in formats, only tried on lines that look like they have a severity */
+  MatcherSet    builtin;
+  /* Formats registered by plugins, tried on every line */
+  MatcherSet    custom;
+} Matcher;
+
+struct _IdeBuildErrorParser
+{
+  GObject                      parent_instance;
+
+  IdeBuildErrorParserCallback  callback;
+  gpointer                     user_data;
+
+  /* Only accessed from the main thread */
+  GArray                      *formats;
+  guint                        format_seqnum;
+
+  /* Protects matcher, which is replaced when the formats change */
+  GMutex                       mutex;
+  Matcher                     *matcher;
+
+  /* Lines of build output, which may be pushed from any thread */
+  GAsyncQueue                 *line_queue;
+  GThread                     *thread;
+
+  /* Only accessed from the parser thread */
+  gchar                       *current_dir;
+  gchar                       *top_dir;
+
+  /* Errors waiting to be delivered to the main thread */
+  GAsyncQueue                 *error_queue;
+  GSource                     *error_source;
+};
+
+G_DEFINE_TYPE (IdeBuildErrorParser, ide_build_error_parser, G_TYPE_OBJECT)
+
+/* Pushed to the line queue to stop the parser thread */
+static gchar stop_parsing[] = "";
+
+static void
+clear_error_format (gpointer data)
+{
+  ErrorFormat *errfmt = data;
+
+  errfmt->id = 0;
+  g_clear_pointer (&errfmt->pattern, g_free);
+}
+
+static void
+clear_build_error (gpointer data)
+{
+  IdeBuildError *error = data;
+
+  g_clear_pointer (&error->filename, g_free);
+  g_clear_pointer (&error->message, g_free);
+}
+
+static void
+build_error_free (gpointer data)
+{
+  clear_build_error (data);
+  g_slice_free (IdeBuildError, data);
+}
+
+static Matcher *
+matcher_ref (Matcher *matcher)
+{
+  g_assert (matcher != NULL);
+  g_assert (matcher->ref_count > 0);
+
+  g_atomic_int_inc (&matcher->ref_count);
+
+  return matcher;
+}
+
+static void
+matcher_unref (Matcher *matcher)
+{
+  g_assert (matcher != NULL);
+  g_assert (matcher->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&matcher->ref_count))
+    {
+      g_clear_pointer (&matcher->builtin.combined, g_regex_unref);
+      g_clear_pointer (&matcher->builtin.regexes, g_ptr_array_unref);
+      g_clear_pointer (&matcher->custom.combined, g_regex_unref);
+      g_clear_pointer (&matcher->custom.regexes, g_ptr_array_unref);
+      g_slice_free (Matcher, matcher);
+    }
+}
+
+/*
+ * Numbered backreferences would refer to the wrong group once the pattern
+ * is one alternative of many.
+ */
+static gboolean
+has_backreference (const gchar *pattern)
+{
+  for (const gchar *p = pattern; *p; p++)
+    {
+      if (*p != '\\')
+        continue;
+
+      p++;
+
+      if ((*p >= '1' && *p <= '9') || *p == 'g')
+        return TRUE;
+
+      if (*p == '\0')
+        break;
+    }
+
+  return FALSE;
+}
+
+static void
+matcher_set_init (MatcherSet *set,
+                  GArray     *formats,
+                  gboolean    builtin)
+{
+  GString *str;
+  gboolean combinable = TRUE;
+
+  g_assert (set != NULL);
+  g_assert (formats != NULL);
+
+  set->regexes = g_ptr_array_new_with_free_func ((GDestroyNotify)g_regex_unref);
+
+  str = g_string_new (NULL);
+
+  for (guint i = 0; i < formats->len; i++)
+    {
+      const ErrorFormat *errfmt = &g_array_index (formats, ErrorFormat, i);
+      GRegex *regex;
+
+      if (errfmt->builtin != !!builtin)
+        continue;
+
+      /* Formats were validated when they were added */
+      if ((regex = g_regex_new (errfmt->pattern, G_REGEX_OPTIMIZE | errfmt->flags, 0, NULL)))
+        g_ptr_array_add (set->regexes, regex);
+
+      if ((errfmt->flags & ~COMBINABLE_FLAGS) != 0 || has_backreference (errfmt->pattern))
+        combinable = FALSE;
+
+      if (str->len > 0)
+        g_string_append_c (str, '|');
+
+      /* Apply the compile flags of the format to its alternative only */
+      g_string_append (str, "(?");
+      if (errfmt->flags & G_REGEX_CASELESS)
+        g_string_append_c (str, 'i');
+      if (errfmt->flags & G_REGEX_MULTILINE)
+        g_string_append_c (str, 'm');
+      if (errfmt->flags & G_REGEX_DOTALL)
+        g_string_append_c (str, 's');
+      if (errfmt->flags & G_REGEX_EXTENDED)
+        g_string_append_c (str, 'x');
+      g_string_append_c (str, ':');
+      g_string_append (str, errfmt->pattern);
+      /* Terminate any trailing comment in extended patterns */
+      if (errfmt->flags & G_REGEX_EXTENDED)
+        g_string_append_c (str, '\n');
+      g_string_append_c (str, ')');
+    }
+
+  /* Each format uses the same group names, so allow duplicates */
+  if (combinable && set->regexes->len > 1)
+    set->combined = g_regex_new (str->str, G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES, 0, NULL);
+
+  g_string_free (str, TRUE);
+}
+
+static Matcher *
+matcher_new (GArray *formats)
+{
+  Matcher *matcher;
+
+  g_assert (formats != NULL);
+
+  matcher = g_slice_new0 (Matcher);
+  matcher->ref_count = 1;
+
+  matcher_set_init (&matcher->builtin, formats, TRUE);
+  matcher_set_init (&matcher->custom, formats, FALSE);
+
+  return matcher;
+}
+
+static void
+ide_build_error_parser_update_matcher (IdeBuildErrorParser *self)
+{
+  Matcher *matcher;
+  Matcher *old_matcher;
+
+  g_assert (IDE_IS_BUILD_ERROR_PARSER (self));
+
+  matcher = matcher_new (self->formats);
+
+  g_mutex_lock (&self->mutex);
+  old_matcher = self->matcher;
+  self->matcher = matcher;
+  g_mutex_unlock (&self->mutex);
+
+  if (old_matcher != NULL)
+    matcher_unref (old_matcher);
+}
+
+/*
+ * A cheap test to skip the built-in regexes for most lines of output. They
+ * report a severity for the errors panel, so look for a colon followed by
+ * one of the severities we know how to parse.
+ */
+static gboolean
+has_severity (const gchar *line)
+{
+  static const gchar *keywords[] = { "error", "warning", "note", "fatal", "deprecated", "ignored" };
+  const gchar *p;
+
+  if (NULL == (p = strchr (line, ':')))
+    return FALSE;
+
+  for (; *p; p++)
+    {
+      gchar ch = g_ascii_tolower (*p);
+
+      for (guint i = 0; i < G_N_ELEMENTS (keywords); i++)
+        {
+          if (ch == keywords [i][0] &&
+              g_ascii_strncasecmp (p, keywords [i], strlen (keywords [i])) == 0)
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static IdeDiagnosticSeverity
+parse_severity (const gchar *str)
+{
+  g_autofree gchar *lower = NULL;
+
+  if (str == NULL)
+    return IDE_DIAGNOSTIC_WARNING;
+
+  lower = g_utf8_strdown (str, -1);
+
+  if (strstr (lower, "fatal") != NULL)
+    return IDE_DIAGNOSTIC_FATAL;
+
+  if (strstr (lower, "error") != NULL)
+    return IDE_DIAGNOSTIC_ERROR;
+
+  if (strstr (lower, "warning") != NULL)
+    return IDE_DIAGNOSTIC_WARNING;
+
+  if (strstr (lower, "ignored") != NULL)
+    return IDE_DIAGNOSTIC_IGNORED;
+
+  if (strstr (lower, "deprecated") != NULL)
+    return IDE_DIAGNOSTIC_DEPRECATED;
+
+  if (strstr (lower, "note") != NULL)
+    return IDE_DIAGNOSTIC_NOTE;
+
+  return IDE_DIAGNOSTIC_WARNING;
+}
+
+static IdeBuildError *
+ide_build_error_parser_extract (IdeBuildErrorParser *self,
+                                GMatchInfo          *match_info)
+{
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *line = NULL;
+  g_autofree gchar *column = NULL;
+  g_autofree gchar *message = NULL;
+  g_autofree gchar *level = NULL;
+  IdeBuildError *error;
+  struct {
+    gint64 line;
+    gint64 column;
+  } parsed = { 0 };
+
+  g_assert (IDE_IS_BUILD_ERROR_PARSER (self));
+  g_assert (match_info != NULL);
+
+  message = g_match_info_fetch_named (match_info, "message");
+
+  /* XXX: This is a hack to ignore a common but unuseful error message.
+   *      This really belongs somewhere else, but it's easier to do the
+   *      check here for now. We need proper callback for ErrorRegex in
+   *      the future so they can ignore it.
+   */
+  if (message == NULL || strncmp (message, "#warning _FORTIFY_SOURCE requires compiling with optimization", 61) == 0)
+    return NULL;
+
+  filename = g_match_info_fetch_named (match_info, "filename");
+  line = g_match_info_fetch_named (match_info, "line");
+  column = g_match_info_fetch_named (match_info, "column");
+  level = g_match_info_fetch_named (match_info, "level");
+
+  if (ide_str_empty0 (filename))
+    return NULL;
+
+  if (!ide_str_empty0 (line))
+    {
+      parsed.line = g_ascii_strtoll (line, NULL, 10);
+      if (parsed.line < 1 || parsed.line > G_MAXINT32)
+        return NULL;
+      parsed.line--;
+    }
+
+  if (!ide_str_empty0 (column))
+    {
+      parsed.column = g_ascii_strtoll (column, NULL, 10);
+      if (parsed.column < 1 || parsed.column > G_MAXINT32)
+        return NULL;
+      parsed.column--;
+    }
+
+  if (!g_path_is_absolute (filename) && self->current_dir != NULL)
+    {
+      const gchar *basedir = self->current_dir;
+      gchar *path;
+
+      if (g_str_has_prefix (basedir, self->top_dir))
+        {
+          basedir += strlen (self->top_dir);
+          if (*basedir == '/')
+            basedir++;
+        }
+
+      path = g_build_filename (basedir, filename, NULL);
+      g_free (filename);
+      filename = path;
+    }
+
+  error = g_slice_new0 (IdeBuildError);
+  error->filename = g_steal_pointer (&filename);
+  error->message = g_steal_pointer (&message);
+  error->line = parsed.line;
+  error->column = parsed.column;
+  error->severity = parse_severity (level);
+
+  return error;
+}
+
+static IdeBuildError *
+ide_build_error_parser_match (IdeBuildErrorParser *self,
+                              const MatcherSet    *set,
+                              const gchar         *line)
+{
+  IdeBuildError *error = NULL;
+
+  g_assert (IDE_IS_BUILD_ERROR_PARSER (self));
+  g_assert (set != NULL);
+  g_assert (line != NULL);
+
+  if (set->combined != NULL)
+    {
+      g_autoptr(GMatchInfo) match_info = NULL;
+
+      if (g_regex_match (set->combined, line, 0, &match_info))
+        error = ide_build_error_parser_extract (self, match_info);
+    }
+  else
+    {
+      for (guint i = 0; error == NULL && i < set->regexes->len; i++)
+        {
+          GRegex *regex = g_ptr_array_index (set->regexes, i);
+          g_autoptr(GMatchInfo) match_info = NULL;
+
+          if (g_regex_match (regex, line, 0, &match_info))
+            error = ide_build_error_parser_extract (self, match_info);
+        }
+    }
+
+  return error;
+}
+
+static void
+ide_build_error_parser_parse_line (IdeBuildErrorParser *self,
+                                   const gchar         *line)
+{
+  g_autofree gchar *filtered_message = NULL;
+  IdeBuildError *error = NULL;
+  const gchar *enterdir;
+  Matcher *matcher;
+
+  g_assert (IDE_IS_BUILD_ERROR_PARSER (self));
+  g_assert (line != NULL);
+
+#define ENTERING_DIRECTORY_BEGIN "Entering directory '"
+#define ENTERING_DIRECTORY_END   "'\n"
+
+  filtered_message = ide_build_utils_color_codes_filtering (line);
+
+  /*
+   * This expects LANG=C, which is defined in the autotools Builder.
+   * Not the most ideal decoupling of logic, but we don't have a whole
+   * lot to work with here.
+   */
+  if (NULL != (enterdir = strstr (filtered_message, ENTERING_DIRECTORY_BEGIN)) &&
+      g_str_has_suffix (enterdir, ENTERING_DIRECTORY_END))
+    {
+      gssize len;
+
+      enterdir += IDE_LITERAL_LENGTH (ENTERING_DIRECTORY_BEGIN);
+      len = strlen (enterdir) - IDE_LITERAL_LENGTH (ENTERING_DIRECTORY_END);
+
+      if (len > 0)
+        {
+          g_free (self->current_dir);
+          self->current_dir = g_strndup (enterdir, len);
+          if (self->top_dir == NULL)
+            self->top_dir = g_strndup (enterdir, len);
+        }
+
+      return;
+    }
+
+#undef ENTERING_DIRECTORY_BEGIN
+#undef ENTERING_DIRECTORY_END
+
+  g_mutex_lock (&self->mutex);
+  matcher = self->matcher ? matcher_ref (self->matcher) : NULL;
+  g_mutex_unlock (&self->mutex);
+
+  if (matcher == NULL)
+    return;
+
+  if (matcher->builtin.regexes->len > 0 && has_severity (filtered_message))
+    error = ide_build_error_parser_match (self, &matcher->builtin, filtered_message);
+
+  /* We cannot know what plugins match, so they always see the line */
+  if (error == NULL && matcher->custom.regexes->len > 0)
+    error = ide_build_error_parser_match (self, &matcher->custom, filtered_message);
+
+  matcher_unref (matcher);
+
+  if (error != NULL)
+    {
+      /* Synchronize the ready time with the main thread, like IdeBuildLog */
+      g_async_queue_lock (self->error_queue);
+      g_async_queue_push_unlocked (self->error_queue, error);
+      g_source_set_ready_time (self->error_source, 0);
+      g_async_queue_unlock (self->error_queue);
+    }
+}
+
+static gpointer
+ide_build_error_parser_worker (gpointer data)
+{
+  IdeBuildErrorParser *self = data;
+  gchar *line;
+
+  g_assert (IDE_IS_BUILD_ERROR_PARSER (self));
+
+  while (stop_parsing != (line = g_async_queue_pop (self->line_queue)))
+    {
+      ide_build_error_parser_parse_line (self, line);
+      g_free (line);
+    }
+
+  return NULL;
+}
+
+static gboolean
+ide_build_error_parser_dispatch (gpointer user_data)
+{
+  IdeBuildErrorParser *self = user_data;
+  g_autoptr(GArray) errors = NULL;
+  IdeBuildError *error;
+
+  g_assert (IDE_IS_BUILD_ERROR_PARSER (self));
+
+  errors = g_array_new (FALSE, FALSE, sizeof (IdeBuildError));
+  g_array_set_clear_func (errors, clear_build_error);
+
+  g_async_queue_lock (self->error_queue);
+  for (guint i = 0; i < DISPATCH_MAX; i++)
+    {
+      if (NULL == (error = g_async_queue_try_pop_unlocked (self->error_queue)))
+        {
+          g_source_set_ready_time (self->error_source, -1);
+          break;
+        }
+      g_array_append_val (errors, *error);
+      g_slice_free (IdeBuildError, error);
+    }
+  g_async_queue_unlock (self->error_queue);
+
+  if (errors->len > 0 && self->callback != NULL)
+    self->callback ((const IdeBuildError *)(gpointer)errors->data, errors->len, self->user_data);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+ide_build_error_parser_finalize (GObject *object)
+{
+  IdeBuildErrorParser *self = (IdeBuildErrorParser *)object;
+
+  g_async_queue_push (self->line_queue, stop_parsing);
+  g_thread_join (self->thread);
+  self->thread = NULL;
+
+  if (self->error_source != NULL)
+    {
+      g_source_destroy (self->error_source);
+      g_clear_pointer (&self->error_source, g_source_unref);
+    }
+
+  g_clear_pointer (&self->line_queue, g_async_queue_unref);
+  g_clear_pointer (&self->error_queue, g_async_queue_unref);
+  g_clear_pointer (&self->matcher, matcher_unref);
+  g_clear_pointer (&self->formats, g_array_unref);
+  g_clear_pointer (&self->current_dir, g_free);
+  g_clear_pointer (&self->top_dir, g_free);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (ide_build_error_parser_parent_class)->finalize (object);
+}
+
+static void
+ide_build_error_parser_class_init (IdeBuildErrorParserClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_build_error_parser_finalize;
+}
+
+static void
+ide_build_error_parser_init (IdeBuildErrorParser *self)
+{
+  g_mutex_init (&self->mutex);
+
+  self->formats = g_array_new (FALSE, FALSE, sizeof (ErrorFormat));
+  g_array_set_clear_func (self->formats, clear_error_format);
+
+  self->line_queue = g_async_queue_new_full (g_free);
+  self->error_queue = g_async_queue_new_full (build_error_free);
+
+  self->error_source = g_timeout_source_new (G_MAXINT);
+  g_source_set_ready_time (self->error_source, -1);
+  g_source_set_name (self->error_source, "[ide] IdeBuildErrorParser");
+  g_source_set_callback (self->error_source, ide_build_error_parser_dispatch, self, NULL);
+  g_source_attach (self->error_source, g_main_context_default ());
+
+  self->thread = g_thread_new ("[ide] build-error-parser",
+                               ide_build_error_parser_worker,
+                               self);
+}
+
+/**
+ * ide_build_error_parser_new:
+ * @callback: a callback for errors found in the build output
+ * @user_data: user data for @callback
+ *
+ * Creates a new parser. @callback is called from the main thread with
+ * batches of errors until the parser is finalized.
+ *
+ * Returns: (transfer full): An #IdeBuildErrorParser
+ */
+IdeBuildErrorParser *
+ide_build_error_parser_new (IdeBuildErrorParserCallback callback,
+                            gpointer                    user_data)
+{
+  IdeBuildErrorParser *self;
+
+  self = g_object_new (IDE_TYPE_BUILD_ERROR_PARSER, NULL);
+  self->callback = callback;
+  self->user_data = user_data;
+
+  return self;
+}
+
+/**
+ * ide_build_error_parser_add_format:
+ * @builtin: if the format is one of the formats shipped with Builder
+ *
+ * Adds an error format. See ide_build_pipeline_add_error_format() for the
+ * named groups that are extracted.
+ *
+ * Built-in formats must capture a severity keyword following a colon, so
+ * that lines without one can be skipped before trying them.
+ *
+ * Returns: an identifier for the format, or 0 and @error is set.
+ */
+guint
+ide_build_error_parser_add_format (IdeBuildErrorParser  *self,
+                                   const gchar          *regex,
+                                   GRegexCompileFlags    flags,
+                                   gboolean              builtin,
+                                   GError              **error)
+{
+  g_autoptr(GRegex) compiled = NULL;
+  ErrorFormat errfmt = { 0 };
+
+  g_return_val_if_fail (IDE_IS_BUILD_ERROR_PARSER (self), 0);
+  g_return_val_if_fail (regex != NULL, 0);
+
+  if (!(compiled = g_regex_new (regex, G_REGEX_OPTIMIZE | flags, 0, error)))
+    return 0;
+
+  errfmt.id = ++self->format_seqnum;
+  errfmt.pattern = g_strdup (regex);
+  errfmt.flags = flags;
+  errfmt.builtin = !!builtin;
+
+  g_array_append_val (self->formats, errfmt);
+
+  ide_build_error_parser_update_matcher (self);
+
+  return errfmt.id;
+}
+
+gboolean
+ide_build_error_parser_remove_format (IdeBuildErrorParser *self,
+                                      guint                format_id)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_ERROR_PARSER (self), FALSE);
+  g_return_val_if_fail (format_id > 0, FALSE);
+
+  for (guint i = 0; i < self->formats->len; i++)
+    {
+      const ErrorFormat *errfmt = &g_array_index (self->formats, ErrorFormat, i);
+
+      if (errfmt->id == format_id)
+        {
+          g_array_remove_index (self->formats, i);
+          ide_build_error_parser_update_matcher (self);
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/**
+ * ide_build_error_parser_push:
+ *
+ * Queues a line of build output to be parsed. This may be called from
+ * any thread.
+ */
+void
+ide_build_error_parser_push (IdeBuildErrorParser *self,
+                             const gchar         *message,
+                             gsize                message_len)
+{
+  g_return_if_fail (IDE_IS_BUILD_ERROR_PARSER (self));
+  g_return_if_fail (message != NULL);
+
+  g_async_queue_push (self->line_queue, g_strndup (message, message_len));
+}
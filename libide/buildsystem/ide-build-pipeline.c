@@ -29,6 +29,7 @@
 #include "ide-macros.h"
 
 #include "application/ide-application.h"
+#include "buildsystem/ide-build-error-parser-private.h"
 #include "buildsystem/ide-build-log.h"
 #include "buildsystem/ide-build-log-private.h"
 #include "buildsystem/ide-build-pipeline.h"
@@ -37,7 +38,6 @@
 #include "buildsystem/ide-build-stage-launcher.h"
 #include "buildsystem/ide-build-stage-private.h"
 #include "buildsystem/ide-build-system.h"
-#include "buildsystem/ide-build-utils.h"
 #include "diagnostics/ide-diagnostic.h"
 #include "diagnostics/ide-source-location.h"
 #include "diagnostics/ide-source-range.h"
@@ -97,12 +97,6 @@ typedef struct
   IdeBuildStage *stage;
 } PipelineEntry;
 
-typedef struct
-{
-  guint   id;
-  GRegex *regex;
-} ErrorFormat;
-
 struct _IdeBuildPipeline
 {
   IdeObject         parent_instance;
@@ -143,15 +137,12 @@ struct _IdeBuildPipeline
   GArray *pipeline;
 
   /*
-   * This are used for ErrorFormat registration so that we have a
-   * single place to extract "GCC-style" warnings and errors. Other
+   * The error parser holds the registered error formats so that we have
+   * a single place to extract "GCC-style" warnings and errors. Other
    * languages can also register these so they show up in the build
-   * errors panel.
+   * errors panel. Build output is parsed on a thread of its own.
    */
-  GArray *errfmts;
-  gchar  *errfmt_current_dir;
-  gchar  *errfmt_top_dir;
-  guint   errfmt_seqnum;
+  IdeBuildErrorParser *error_parser;
 
   /*
    * No reference to the current stage. It is only available during
@@ -306,15 +297,6 @@ task_data_new (GTask    *task,
   return td;
 }
 
-static void
-clear_error_format (gpointer data)
-{
-  ErrorFormat *errfmt = data;
-
-  errfmt->id = 0;
-  g_clear_pointer (&errfmt->regex, g_regex_unref);
-}
-
 static inline const gchar *
 build_phase_nick (IdeBuildPhase phase)
 {
@@ -332,131 +314,57 @@ build_phase_nick (IdeBuildPhase phase)
   return "unknown";
 }
 
-static IdeDiagnosticSeverity
-parse_severity (const gchar *str)
-{
-  g_autofree gchar *lower = NULL;
-
-  if (str == NULL)
-    return IDE_DIAGNOSTIC_WARNING;
-
-  lower = g_utf8_strdown (str, -1);
-
-  if (strstr (lower, "fatal") != NULL)
-    return IDE_DIAGNOSTIC_FATAL;
-
-  if (strstr (lower, "error") != NULL)
-    return IDE_DIAGNOSTIC_ERROR;
-
-  if (strstr (lower, "warning") != NULL)
-    return IDE_DIAGNOSTIC_WARNING;
-
-  if (strstr (lower, "ignored") != NULL)
-    return IDE_DIAGNOSTIC_IGNORED;
-
-  if (strstr (lower, "deprecated") != NULL)
-    return IDE_DIAGNOSTIC_DEPRECATED;
-
-  if (strstr (lower, "note") != NULL)
-    return IDE_DIAGNOSTIC_NOTE;
-
-  return IDE_DIAGNOSTIC_WARNING;
-}
-
 static IdeDiagnostic *
-create_diagnostic (IdeBuildPipeline *self,
-                   GMatchInfo       *match_info)
+create_diagnostic (IdeBuildPipeline    *self,
+                   const IdeBuildError *error)
 {
   g_autofree gchar *filename = NULL;
-  g_autofree gchar *line = NULL;
-  g_autofree gchar *column = NULL;
-  g_autofree gchar *message = NULL;
-  g_autofree gchar *level = NULL;
   g_autoptr(IdeFile) file = NULL;
   g_autoptr(IdeSourceLocation) location = NULL;
   IdeContext *context;
-  struct {
-    gint64 line;
-    gint64 column;
-    IdeDiagnosticSeverity severity;
-  } parsed = { 0 };
 
   g_assert (IDE_IS_BUILD_PIPELINE (self));
-  g_assert (match_info != NULL);
-
-  message = g_match_info_fetch_named (match_info, "message");
-
-  /* XXX: This is a hack to ignore a common but unuseful error message.
-   *      This really belongs somewhere else, but it's easier to do the
-   *      check here for now. We need proper callback for ErrorRegex in
-   *      the future so they can ignore it.
-   */
-  if (message == NULL || strncmp (message, "#warning _FORTIFY_SOURCE requires compiling with optimization", 61) == 0)
-    return NULL;
-
-  filename = g_match_info_fetch_named (match_info, "filename");
-  line = g_match_info_fetch_named (match_info, "line");
-  column = g_match_info_fetch_named (match_info, "column");
-  level = g_match_info_fetch_named (match_info, "level");
-
-  if (line != NULL)
-    {
-      parsed.line = g_ascii_strtoll (line, NULL, 10);
-      if (parsed.line < 1 || parsed.line > G_MAXINT32)
-        return NULL;
-      parsed.line--;
-    }
-
-  if (column != NULL)
-    {
-      parsed.column = g_ascii_strtoll (column, NULL, 10);
-      if (parsed.column < 1 || parsed.column > G_MAXINT32)
-        return NULL;
-      parsed.column--;
-    }
-
-  parsed.severity = parse_severity (level);
-
-  if (!g_path_is_absolute (filename) && self->errfmt_current_dir != NULL)
-    {
-      const gchar *basedir = self->errfmt_current_dir;
-      gchar *path;
-
-      if (g_str_has_prefix (basedir, self->errfmt_top_dir))
-        {
-          basedir += strlen (self->errfmt_top_dir);
-          if (*basedir == '/')
-            basedir++;
-        }
-
-      path = g_build_filename (basedir, filename, NULL);
-      g_free (filename);
-      filename = path;
-    }
+  g_assert (error != NULL);
 
   context = ide_object_get_context (IDE_OBJECT (self));
 
-  if (!g_path_is_absolute (filename))
+  if (!g_path_is_absolute (error->filename))
     {
       g_autoptr(GFile) child = NULL;
       IdeVcs *vcs;
       GFile *workdir;
-      gchar *path;
 
       vcs = ide_context_get_vcs (context);
       workdir = ide_vcs_get_working_directory (vcs);
 
-      child = g_file_get_child (workdir, filename);
-      path = g_file_get_path (child);
-
-      g_free (filename);
-      filename = path;
+      child = g_file_get_child (workdir, error->filename);
+      filename = g_file_get_path (child);
     }
+  else
+    filename = g_strdup (error->filename);
 
   file = ide_file_new_for_path (context, filename);
-  location = ide_source_location_new (file, parsed.line, parsed.column, 0);
+  location = ide_source_location_new (file, error->line, error->column, 0);
 
-  return ide_diagnostic_new (parsed.severity, message, location);
+  return ide_diagnostic_new (error->severity, error->message, location);
+}
+
+static void
+ide_build_pipeline_errors_parsed (const IdeBuildError *errors,
+                                  guint                n_errors,
+                                  gpointer             user_data)
+{
+  IdeBuildPipeline *self = user_data;
+
+  g_assert (IDE_IS_BUILD_PIPELINE (self));
+  g_assert (errors != NULL);
+
+  for (guint i = 0; i < n_errors; i++)
+    {
+      g_autoptr(IdeDiagnostic) diagnostic = create_diagnostic (self, &errors [i]);
+
+      ide_build_pipeline_emit_diagnostic (self, diagnostic);
+    }
 }
 
 static void
@@ -466,67 +374,20 @@ ide_build_pipeline_log_observer (IdeBuildLogStream  stream,
                                  gpointer           user_data)
 {
   IdeBuildPipeline *self = user_data;
-  const gchar *enterdir;
-  g_autofree gchar *filtered_message = NULL;
 
   g_assert (stream == IDE_BUILD_LOG_STDOUT || stream == IDE_BUILD_LOG_STDERR);
   g_assert (IDE_IS_BUILD_PIPELINE (self));
   g_assert (message != NULL);
 
-#define ENTERING_DIRECTORY_BEGIN "Entering directory '"
-#define ENTERING_DIRECTORY_END   "'\n"
-
   if (message_len < 0)
     message_len = strlen (message);
 
   if (self->log != NULL)
     ide_build_log_observer (stream, message, message_len, self->log);
 
-  filtered_message = ide_build_utils_color_codes_filtering (message);
-
-  /*
-   * This expects LANG=C, which is defined in the autotools Builder.
-   * Not the most ideal decoupling of logic, but we don't have a whole
-   * lot to work with here.
-   */
-  if (NULL != (enterdir = strstr (filtered_message, ENTERING_DIRECTORY_BEGIN)) &&
-      g_str_has_suffix (enterdir, ENTERING_DIRECTORY_END))
-    {
-      gssize len;
-
-      enterdir += IDE_LITERAL_LENGTH (ENTERING_DIRECTORY_BEGIN);
-      len = strlen (enterdir) - IDE_LITERAL_LENGTH (ENTERING_DIRECTORY_END);
-
-      if (len > 0)
-        {
-          g_free (self->errfmt_current_dir);
-          self->errfmt_current_dir = g_strndup (enterdir, len);
-          if (self->errfmt_top_dir == NULL)
-            self->errfmt_top_dir = g_strndup (enterdir, len);
-        }
-
-      return;
-    }
-
-  for (guint i = 0; i < self->errfmts->len; i++)
-    {
-      const ErrorFormat *errfmt = &g_array_index (self->errfmts, ErrorFormat, i);
-      g_autoptr(GMatchInfo) match_info = NULL;
-
-      if (g_regex_match (errfmt->regex, filtered_message, 0, &match_info))
-        {
-          g_autoptr(IdeDiagnostic) diagnostic = create_diagnostic (self, match_info);
-
-          if (diagnostic != NULL)
-            {
-              ide_build_pipeline_emit_diagnostic (self, diagnostic);
-              return;
-            }
-        }
-    }
-
-#undef ENTERING_DIRECTORY_BEGIN
-#undef ENTERING_DIRECTORY_END
+  /* Error formats are matched on the parser thread */
+  if (self->error_parser != NULL)
+    ide_build_error_parser_push (self->error_parser, message, message_len);
 }
 
 static void
@@ -802,9 +663,7 @@ ide_build_pipeline_finalize (GObject *object)
   g_clear_pointer (&self->pipeline, g_array_unref);
   g_clear_pointer (&self->srcdir, g_free);
   g_clear_pointer (&self->builddir, g_free);
-  g_clear_pointer (&self->errfmts, g_array_unref);
-  g_clear_pointer (&self->errfmt_top_dir, g_free);
-  g_clear_pointer (&self->errfmt_current_dir, g_free);
+  g_clear_object (&self->error_parser);
 
   G_OBJECT_CLASS (ide_build_pipeline_parent_class)->finalize (object);
 
@@ -1048,8 +907,7 @@ ide_build_pipeline_init (IdeBuildPipeline *self)
   self->pipeline = g_array_new (FALSE, FALSE, sizeof (PipelineEntry));
   g_array_set_clear_func (self->pipeline, clear_pipeline_entry);
 
-  self->errfmts = g_array_new (FALSE, FALSE, sizeof (ErrorFormat));
-  g_array_set_clear_func (self->errfmts, clear_error_format);
+  self->error_parser = ide_build_error_parser_new (ide_build_pipeline_errors_parsed, self);
 
   self->log = ide_build_log_new ();
 }
@@ -1996,6 +1854,9 @@ ide_build_pipeline_emit_diagnostic (IdeBuildPipeline *self,
  *   "(?<level>[\\w\\s]+): "
  *   "(?<message>.*)"
  *
+ * Formats other than %IDE_BUILD_ERROR_FORMAT_GCC are matched against
+ * every line of output, so keep them anchored where possible.
+ *
  * To remove the regex, use the ide_build_pipeline_remove_error_format()
  * function with the resulting format id returned from this function.
  *
@@ -2009,24 +1870,25 @@ ide_build_pipeline_add_error_format (IdeBuildPipeline   *self,
                                      const gchar        *regex,
                                      GRegexCompileFlags  flags)
 {
-  ErrorFormat errfmt = { 0 };
   g_autoptr(GError) error = NULL;
+  gboolean builtin;
+  guint id;
 
   g_return_val_if_fail (IDE_IS_BUILD_PIPELINE (self), 0);
+  g_return_val_if_fail (regex != NULL, 0);
 
-  errfmt.regex = g_regex_new (regex, G_REGEX_OPTIMIZE | flags, 0, &error);
-
-  if (errfmt.regex == NULL)
-    {
-      g_warning ("%s", error->message);
-      return 0;
-    }
+  /*
+   * Only the formats we ship are known to require a severity keyword, so
+   * the error parser may skip lines without one before trying them.
+   */
+  builtin = g_str_equal (regex, IDE_BUILD_ERROR_FORMAT_GCC);
 
-  errfmt.id = ++self->errfmt_seqnum;
+  id = ide_build_error_parser_add_format (self->error_parser, regex, flags, builtin, &error);
 
-  g_array_append_val (self->errfmts, errfmt);
+  if (id == 0)
+    g_warning ("%s", error->message);
 
-  return errfmt.id;
+  return id;
 }
 
 /**
@@ -2046,18 +1908,7 @@ ide_build_pipeline_remove_error_format (IdeBuildPipeline *self,
   g_return_val_if_fail (IDE_IS_BUILD_PIPELINE (self), FALSE);
   g_return_val_if_fail (error_format_id > 0, FALSE);
 
-  for (guint i = 0; i < self->errfmts->len; i++)
-    {
-      const ErrorFormat *errfmt = &g_array_index (self->errfmts, ErrorFormat, i);
-
-      if (errfmt->id == error_format_id)
-        {
-          g_array_remove_index (self->errfmts, i);
-          return TRUE;
-        }
-    }
-
-  return FALSE;
+  return ide_build_error_parser_remove_format (self->error_parser, error_format_id);
 }
 
 gboolean
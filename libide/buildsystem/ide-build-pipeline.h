@@ -34,6 +34,18 @@ G_BEGIN_DECLS
 #define IDE_BUILD_PHASE_MASK        (0xFFFFFF)
 #define IDE_BUILD_PHASE_WHENCE_MASK (IDE_BUILD_PHASE_BEFORE | IDE_BUILD_PHASE_AFTER)
 
+/*
+ * The error format for GCC style diagnostics. Lines of build output are
+ * only matched against it when they contain a colon followed by a
+ * severity keyword.
+ */
+#define IDE_BUILD_ERROR_FORMAT_GCC      \
+  "(?<filename>[a-zA-Z0-9\\-\\.\\/]+):" \
+  "(?<line>\\d+):"                      \
+  "(?<column>\\d+): "                   \
+  "(?<level>[\\w\\s]+): "               \
+  "(?<message>.*)"
+
 typedef enum
 {
   IDE_BUILD_PHASE_NONE         = 0,
@@ -0,0 +1,987 @@
+/* ide-compile-commands.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-compile-commands"
+
+#include <string.h>
+
+#include "ide-debug.h"
+
+#include "buildsystem/ide-compile-commands.h"
+
+/**
+ * SECTION:ide-compile-commands
+ * @title: IdeCompileCommands
+ * @short_description: Compile commands database
+ *
+ * #IdeCompileCommands provides access to the compile_commands.json
+ * compilation database produced by build systems such as meson and cmake.
+ *
+ * The database is mapped into memory and scanned once, building an index
+ * from the path of each source file to a copy of its still encoded
+ * command. Commands are only decoded when they are looked up. Loading
+ * the same file again is cheap unless its modification time has changed.
+ *
+ * Since: 3.26
+ */
+
+typedef struct
+{
+  /* Interned in CommandsIndex.strings */
+  const gchar *directory;
+  /*
+   * Raw JSON copied into CommandsIndex.strings. The mapping is released
+   * after indexing, as build systems may rewrite the file in place.
+   */
+  const gchar *command;
+  gsize        command_len;
+  guint        is_arguments : 1;
+} CompileInfo;
+
+typedef struct
+{
+  volatile gint  ref_count;
+  GStringChunk  *strings;
+  GArray        *infos;
+  GHashTable    *info_by_path;
+  /* Microseconds, to notice rewrites within the same second */
+  guint64        mtime;
+  goffset        size;
+} CommandsIndex;
+
+typedef struct
+{
+  const gchar *pos;
+  const gchar *end;
+} Scanner;
+
+struct _IdeCompileCommands
+{
+  GObject        parent_instance;
+
+  /* Protects file and index, so lookups may happen from any thread */
+  GMutex         mutex;
+  GFile         *file;
+  CommandsIndex *index;
+};
+
+G_DEFINE_TYPE (IdeCompileCommands, ide_compile_commands, G_TYPE_OBJECT)
+
+static CommandsIndex *
+commands_index_ref (CommandsIndex *index)
+{
+  g_assert (index != NULL);
+  g_assert (index->ref_count > 0);
+
+  g_atomic_int_inc (&index->ref_count);
+
+  return index;
+}
+
+static void
+commands_index_unref (CommandsIndex *index)
+{
+  g_assert (index != NULL);
+  g_assert (index->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&index->ref_count))
+    {
+      g_clear_pointer (&index->info_by_path, g_hash_table_unref);
+      g_clear_pointer (&index->infos, g_array_unref);
+      g_clear_pointer (&index->strings, g_string_chunk_free);
+      g_slice_free (CommandsIndex, index);
+    }
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CommandsIndex, commands_index_unref)
+
+static inline void
+scanner_skip_space (Scanner *s)
+{
+  while (s->pos < s->end &&
+         (*s->pos == ' ' || *s->pos == '\n' || *s->pos == '\r' || *s->pos == '\t'))
+    s->pos++;
+}
+
+static inline gboolean
+scanner_expect (Scanner *s,
+                gchar    ch)
+{
+  scanner_skip_space (s);
+
+  if (s->pos < s->end && *s->pos == ch)
+    {
+      s->pos++;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Reads a string, setting @begin and @end to the raw (still escaped)
+ * contents between the quotes.
+ */
+static gboolean
+scanner_read_string (Scanner      *s,
+                     const gchar **begin,
+                     const gchar **end)
+{
+  if (!scanner_expect (s, '"'))
+    return FALSE;
+
+  *begin = s->pos;
+
+  while (s->pos < s->end)
+    {
+      if (*s->pos == '\\')
+        {
+          s->pos += 2;
+          continue;
+        }
+
+      if (*s->pos == '"')
+        {
+          *end = s->pos;
+          s->pos++;
+          return TRUE;
+        }
+
+      s->pos++;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+scanner_skip_value (Scanner *s,
+                    guint    depth)
+{
+  const gchar *begin;
+  const gchar *end;
+
+  scanner_skip_space (s);
+
+  if (s->pos >= s->end || depth > 32)
+    return FALSE;
+
+  switch (*s->pos)
+    {
+    case '"':
+      return scanner_read_string (s, &begin, &end);
+
+    case '[':
+      s->pos++;
+      if (scanner_expect (s, ']'))
+        return TRUE;
+      do
+        {
+          if (!scanner_skip_value (s, depth + 1))
+            return FALSE;
+        }
+      while (scanner_expect (s, ','));
+      return scanner_expect (s, ']');
+
+    case '{':
+      s->pos++;
+      if (scanner_expect (s, '}'))
+        return TRUE;
+      do
+        {
+          if (!scanner_read_string (s, &begin, &end) ||
+              !scanner_expect (s, ':') ||
+              !scanner_skip_value (s, depth + 1))
+            return FALSE;
+        }
+      while (scanner_expect (s, ','));
+      return scanner_expect (s, '}');
+
+    default:
+      /* Numbers, true, false, and null */
+      begin = s->pos;
+      while (s->pos < s->end &&
+             (g_ascii_isalnum (*s->pos) || *s->pos == '-' || *s->pos == '+' || *s->pos == '.'))
+        s->pos++;
+      return s->pos > begin;
+    }
+}
+
+static gboolean
+read_hex4 (const gchar *str,
+           gunichar    *ch)
+{
+  *ch = 0;
+
+  for (guint i = 0; i < 4; i++)
+    {
+      gint v = g_ascii_xdigit_value (str [i]);
+
+      if (v < 0)
+        return FALSE;
+
+      *ch = (*ch << 4) | v;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+decode_string (const gchar *begin,
+               const gchar *end)
+{
+  GString *str;
+
+  g_assert (begin <= end);
+
+  if (memchr (begin, '\\', end - begin) == NULL)
+    return g_strndup (begin, end - begin);
+
+  str = g_string_sized_new (end - begin);
+
+  for (const gchar *p = begin; p < end; p++)
+    {
+      gunichar ch;
+      gunichar low;
+
+      if (*p != '\\' || p + 1 >= end)
+        {
+          g_string_append_c (str, *p);
+          continue;
+        }
+
+      switch (*++p)
+        {
+        case 'b': g_string_append_c (str, '\b'); break;
+        case 'f': g_string_append_c (str, '\f'); break;
+        case 'n': g_string_append_c (str, '\n'); break;
+        case 'r': g_string_append_c (str, '\r'); break;
+        case 't': g_string_append_c (str, '\t'); break;
+
+        case 'u':
+          if (end - p < 5 || !read_hex4 (p + 1, &ch))
+            break;
+          p += 4;
+          /* Join UTF-16 surrogate pairs */
+          if (ch >= 0xD800 && ch < 0xDC00 &&
+              end - p >= 7 && p [1] == '\\' && p [2] == 'u' &&
+              read_hex4 (p + 3, &low) && low >= 0xDC00 && low < 0xE000)
+            {
+              ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+              p += 6;
+            }
+          g_string_append_unichar (str, ch);
+          break;
+
+        default:
+          g_string_append_c (str, *p);
+          break;
+        }
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static gchar *
+resolve_path (const gchar *directory,
+              const gchar *path)
+{
+  g_autofree gchar *joined = NULL;
+  g_autoptr(GFile) file = NULL;
+
+  if (g_path_is_absolute (path))
+    return g_strdup (path);
+
+  /* GFile will canonicalize the path, removing ./ and ../ */
+  joined = g_build_filename (directory, path, NULL);
+  file = g_file_new_for_path (joined);
+
+  return g_file_get_path (file);
+}
+
+static void
+commands_index_add (CommandsIndex *index,
+                    const gchar   *directory,
+                    const gchar   *directory_end,
+                    const gchar   *file,
+                    const gchar   *file_end,
+                    const gchar   *command,
+                    const gchar   *command_end,
+                    gboolean       is_arguments)
+{
+  g_autofree gchar *dir = NULL;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *path = NULL;
+  CompileInfo info;
+
+  g_assert (index != NULL);
+
+  dir = decode_string (directory, directory_end);
+  name = decode_string (file, file_end);
+  path = resolve_path (dir, name);
+
+  /* Sources built more than once use the first command, like the tools do */
+  if (path == NULL || g_hash_table_contains (index->info_by_path, path))
+    return;
+
+  info.directory = g_string_chunk_insert_const (index->strings, dir);
+  info.command = g_string_chunk_insert_len (index->strings, command, command_end - command);
+  info.command_len = command_end - command;
+  info.is_arguments = !!is_arguments;
+
+  g_array_append_val (index->infos, info);
+
+  g_hash_table_insert (index->info_by_path,
+                       g_string_chunk_insert (index->strings, path),
+                       GUINT_TO_POINTER (index->infos->len));
+}
+
+static gboolean
+commands_index_parse_entry (CommandsIndex *index,
+                            Scanner       *s)
+{
+  const gchar *directory = NULL;
+  const gchar *directory_end = NULL;
+  const gchar *file = NULL;
+  const gchar *file_end = NULL;
+  const gchar *command = NULL;
+  const gchar *command_end = NULL;
+  gboolean is_arguments = FALSE;
+
+  if (!scanner_expect (s, '{'))
+    return FALSE;
+
+  if (!scanner_expect (s, '}'))
+    {
+      do
+        {
+          const gchar *key;
+          const gchar *key_end;
+          gsize key_len;
+
+          if (!scanner_read_string (s, &key, &key_end) || !scanner_expect (s, ':'))
+            return FALSE;
+
+          key_len = key_end - key;
+
+#define KEY_IS(str) (key_len == strlen (str) && memcmp (key, str, key_len) == 0)
+
+          if (KEY_IS ("directory"))
+            {
+              if (!scanner_read_string (s, &directory, &directory_end))
+                return FALSE;
+            }
+          else if (KEY_IS ("file"))
+            {
+              if (!scanner_read_string (s, &file, &file_end))
+                return FALSE;
+            }
+          else if (KEY_IS ("command"))
+            {
+              if (!scanner_read_string (s, &command, &command_end))
+                return FALSE;
+              is_arguments = FALSE;
+            }
+          else if (KEY_IS ("arguments"))
+            {
+              scanner_skip_space (s);
+              command = s->pos;
+              if (!scanner_skip_value (s, 0))
+                return FALSE;
+              command_end = s->pos;
+              is_arguments = TRUE;
+            }
+          else if (!scanner_skip_value (s, 0))
+            return FALSE;
+
+#undef KEY_IS
+        }
+      while (scanner_expect (s, ','));
+
+      if (!scanner_expect (s, '}'))
+        return FALSE;
+    }
+
+  if (directory != NULL && file != NULL && command != NULL)
+    commands_index_add (index,
+                        directory, directory_end,
+                        file, file_end,
+                        command, command_end,
+                        is_arguments);
+
+  return TRUE;
+}
+
+static CommandsIndex *
+commands_index_new (GMappedFile  *mapped,
+                    GError      **error)
+{
+  g_autoptr(CommandsIndex) index = NULL;
+  Scanner s;
+  gboolean ret = TRUE;
+
+  IDE_ENTRY;
+
+  g_assert (mapped != NULL);
+
+  index = g_slice_new0 (CommandsIndex);
+  index->ref_count = 1;
+  index->strings = g_string_chunk_new (4096 * 4);
+  index->infos = g_array_new (FALSE, FALSE, sizeof (CompileInfo));
+  index->info_by_path = g_hash_table_new (g_str_hash, g_str_equal);
+
+  s.pos = g_mapped_file_get_contents (mapped);
+  s.end = s.pos + g_mapped_file_get_length (mapped);
+
+  if (s.pos == NULL || !scanner_expect (&s, '['))
+    ret = FALSE;
+  else if (!scanner_expect (&s, ']'))
+    {
+      do
+        {
+          ret = commands_index_parse_entry (index, &s);
+        }
+      while (ret && scanner_expect (&s, ','));
+
+      ret = ret && scanner_expect (&s, ']');
+    }
+
+  if (!ret)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Failed to parse compile commands near offset %"G_GSIZE_FORMAT,
+                   (gsize)(s.pos - g_mapped_file_get_contents (mapped)));
+      IDE_RETURN (NULL);
+    }
+
+  IDE_TRACE_MSG ("Indexed %u compile commands", index->infos->len);
+
+  IDE_RETURN (g_steal_pointer (&index));
+}
+
+static gchar **
+commands_index_decode (CommandsIndex      *index,
+                       const CompileInfo  *info,
+                       GError            **error)
+{
+  g_autoptr(GPtrArray) argv = NULL;
+  const gchar *begin;
+  const gchar *end;
+  Scanner s;
+
+  g_assert (index != NULL);
+  g_assert (info != NULL);
+
+  if (!info->is_arguments)
+    {
+      g_autofree gchar *command = NULL;
+      gchar **ret = NULL;
+
+      command = decode_string (info->command, info->command + info->command_len);
+
+      if (!g_shell_parse_argv (command, NULL, &ret, error))
+        return NULL;
+
+      return ret;
+    }
+
+  argv = g_ptr_array_new_with_free_func (g_free);
+
+  s.pos = info->command;
+  s.end = info->command + info->command_len;
+
+  if (scanner_expect (&s, '[') && !scanner_expect (&s, ']'))
+    {
+      do
+        {
+          if (!scanner_read_string (&s, &begin, &end))
+            break;
+          g_ptr_array_add (argv, decode_string (begin, end));
+        }
+      while (scanner_expect (&s, ','));
+    }
+
+  g_ptr_array_add (argv, NULL);
+
+  return (gchar **)g_ptr_array_free (g_steal_pointer (&argv), FALSE);
+}
+
+/*
+ * Keeps the arguments that are useful to language tooling such as clang,
+ * and makes include paths absolute since they are relative to the
+ * directory of the command rather than the source file.
+ */
+static gchar **
+filter_flags (const gchar * const *argv,
+              const gchar         *directory)
+{
+  static const gchar *path_flags[] = { "-isystem", "-idirafter", "-iquote", "-include", "-I" };
+  GPtrArray *ret;
+
+  g_assert (argv != NULL);
+  g_assert (directory != NULL);
+
+  ret = g_ptr_array_new ();
+
+  /* The first argument is the compiler */
+  for (guint i = argv [0] ? 1 : 0; argv [i] != NULL; i++)
+    {
+      const gchar *arg = argv [i];
+      const gchar *next = argv [i + 1];
+      gboolean handled = FALSE;
+
+      for (guint j = 0; j < G_N_ELEMENTS (path_flags); j++)
+        {
+          const gchar *value;
+
+          if (!g_str_has_prefix (arg, path_flags [j]))
+            continue;
+
+          handled = TRUE;
+          value = arg + strlen (path_flags [j]);
+
+          if (*value == '\0')
+            {
+              if (next == NULL)
+                break;
+              value = next;
+              i++;
+            }
+
+          if (g_str_equal (path_flags [j], "-I"))
+            {
+              g_autofree gchar *path = resolve_path (directory, value);
+
+              g_ptr_array_add (ret, g_strdup_printf ("-I%s", path));
+            }
+          else
+            {
+              g_ptr_array_add (ret, g_strdup (path_flags [j]));
+              g_ptr_array_add (ret, resolve_path (directory, value));
+            }
+
+          break;
+        }
+
+      if (handled)
+        continue;
+
+      if (g_str_has_prefix (arg, "-D") ||
+          g_str_has_prefix (arg, "-U") ||
+          g_str_has_prefix (arg, "-x"))
+        {
+          g_ptr_array_add (ret, g_strdup (arg));
+          if (arg [2] == '\0' && next != NULL)
+            g_ptr_array_add (ret, g_strdup (argv [++i]));
+        }
+      else if (g_str_has_prefix (arg, "-W"))
+        {
+          /* Skip -Wl, -Wa, and -Wp, which are passed to other tools */
+          if (arg [2] != '\0' && arg [3] != ',')
+            g_ptr_array_add (ret, g_strdup (arg));
+        }
+      else if (g_str_has_prefix (arg, "-f") ||
+               g_str_has_prefix (arg, "-m") ||
+               g_str_has_prefix (arg, "-std="))
+        {
+          g_ptr_array_add (ret, g_strdup (arg));
+        }
+    }
+
+  g_ptr_array_add (ret, NULL);
+
+  return (gchar **)g_ptr_array_free (ret, FALSE);
+}
+
+static void
+ide_compile_commands_finalize (GObject *object)
+{
+  IdeCompileCommands *self = (IdeCompileCommands *)object;
+
+  g_clear_object (&self->file);
+  g_clear_pointer (&self->index, commands_index_unref);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (ide_compile_commands_parent_class)->finalize (object);
+}
+
+static void
+ide_compile_commands_class_init (IdeCompileCommandsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_compile_commands_finalize;
+}
+
+static void
+ide_compile_commands_init (IdeCompileCommands *self)
+{
+  g_mutex_init (&self->mutex);
+}
+
+IdeCompileCommands *
+ide_compile_commands_new (void)
+{
+  return g_object_new (IDE_TYPE_COMPILE_COMMANDS, NULL);
+}
+
+/**
+ * ide_compile_commands_load:
+ * @self: An #IdeCompileCommands
+ * @file: A #GFile for a compile_commands.json
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Synchronously loads @file, replacing any previously loaded database.
+ *
+ * If @file was already loaded and has not been modified since, this does
+ * nothing more than query its modification time.
+ *
+ * This function may be called from a thread.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ *
+ * Since: 3.26
+ */
+gboolean
+ide_compile_commands_load (IdeCompileCommands  *self,
+                           GFile               *file,
+                           GCancellable        *cancellable,
+                           GError             **error)
+{
+  g_autoptr(GFileInfo) file_info = NULL;
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autofree gchar *path = NULL;
+  CommandsIndex *index;
+  CommandsIndex *old_index;
+  gboolean unchanged;
+  guint64 mtime;
+  goffset size;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  file_info = g_file_query_info (file,
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC","
+                                 G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 cancellable,
+                                 error);
+
+  if (file_info == NULL)
+    IDE_RETURN (FALSE);
+
+  mtime = (g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC) +
+          g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  size = g_file_info_get_size (file_info);
+
+  g_mutex_lock (&self->mutex);
+  unchanged = (self->file != NULL &&
+               self->index != NULL &&
+               g_file_equal (self->file, file) &&
+               self->index->mtime == mtime &&
+               self->index->size == size);
+  g_mutex_unlock (&self->mutex);
+
+  if (unchanged)
+    IDE_RETURN (TRUE);
+
+  if (NULL == (path = g_file_get_path (file)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "Only local compile commands are supported");
+      IDE_RETURN (FALSE);
+    }
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, error)))
+    IDE_RETURN (FALSE);
+
+  if (!(index = commands_index_new (mapped, error)))
+    IDE_RETURN (FALSE);
+
+  index->mtime = mtime;
+  index->size = size;
+
+  g_mutex_lock (&self->mutex);
+  g_set_object (&self->file, file);
+  old_index = self->index;
+  self->index = index;
+  g_mutex_unlock (&self->mutex);
+
+  if (old_index != NULL)
+    commands_index_unref (old_index);
+
+  IDE_RETURN (TRUE);
+}
+
+static void
+ide_compile_commands_load_worker (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  IdeCompileCommands *self = source_object;
+  GFile *file = task_data;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+  g_assert (G_IS_FILE (file));
+
+  if (!ide_compile_commands_load (self, file, cancellable, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * ide_compile_commands_load_async:
+ * @self: An #IdeCompileCommands
+ * @file: A #GFile for a compile_commands.json
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: (scope async): A callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Asynchronously loads @file from a thread. See ide_compile_commands_load()
+ * for details.
+ *
+ * Since: 3.26
+ */
+void
+ide_compile_commands_load_async (IdeCompileCommands  *self,
+                                 GFile               *file,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_COMPILE_COMMANDS (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_compile_commands_load_async);
+  g_task_set_task_data (task, g_object_ref (file), g_object_unref);
+  g_task_run_in_thread (task, ide_compile_commands_load_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_compile_commands_load_finish:
+ * @self: An #IdeCompileCommands
+ * @result: A #GAsyncResult provided to the callback
+ * @error: A location for a #GError or %NULL
+ *
+ * Completes an asynchronous request to ide_compile_commands_load_async().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ *
+ * Since: 3.26
+ */
+gboolean
+ide_compile_commands_load_finish (IdeCompileCommands  *self,
+                                  GAsyncResult        *result,
+                                  GError             **error)
+{
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * ide_compile_commands_lookup:
+ * @self: An #IdeCompileCommands
+ * @file: A #GFile for a source file
+ * @directory: (out) (optional) (transfer full): A location for the
+ *   directory the command is run from, or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Locates the command used to compile @file and extracts the flags that
+ * are useful to language tooling, such as include paths, defines, and
+ * warnings. Relative include paths are made absolute.
+ *
+ * This function may be called from a thread.
+ *
+ * Returns: (transfer full): A %NULL-terminated array of flags, or %NULL
+ *   and @error is set.
+ *
+ * Since: 3.26
+ */
+gchar **
+ide_compile_commands_lookup (IdeCompileCommands  *self,
+                             GFile               *file,
+                             GFile              **directory,
+                             GError             **error)
+{
+  g_autoptr(CommandsIndex) index = NULL;
+  g_autofree gchar *path = NULL;
+  g_auto(GStrv) argv = NULL;
+  const CompileInfo *info;
+  guint pos = 0;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  g_mutex_lock (&self->mutex);
+  if (self->index != NULL)
+    index = commands_index_ref (self->index);
+  g_mutex_unlock (&self->mutex);
+
+  if (index == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_INITIALIZED,
+                   "No compile commands have been loaded");
+      IDE_RETURN (NULL);
+    }
+
+  if (NULL != (path = g_file_get_path (file)))
+    pos = GPOINTER_TO_UINT (g_hash_table_lookup (index->info_by_path, path));
+
+  if (pos == 0)
+    {
+      g_autofree gchar *uri = g_file_get_uri (file);
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "No compile command found for %s",
+                   uri);
+      IDE_RETURN (NULL);
+    }
+
+  info = &g_array_index (index->infos, CompileInfo, pos - 1);
+
+  if (!(argv = commands_index_decode (index, info, error)))
+    IDE_RETURN (NULL);
+
+  if (directory != NULL)
+    *directory = g_file_new_for_path (info->directory);
+
+  IDE_RETURN (filter_flags ((const gchar * const *)argv, info->directory));
+}
+
+static void
+ide_compile_commands_lookup_worker (GTask        *task,
+                                    gpointer      source_object,
+                                    gpointer      task_data,
+                                    GCancellable *cancellable)
+{
+  IdeCompileCommands *self = source_object;
+  g_autoptr(GFile) commands_file = NULL;
+  GFile *file = task_data;
+  GError *error = NULL;
+  gchar **ret;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_COMPILE_COMMANDS (self));
+  g_assert (G_IS_FILE (file));
+
+  g_mutex_lock (&self->mutex);
+  if (self->file != NULL)
+    commands_file = g_object_ref (self->file);
+  g_mutex_unlock (&self->mutex);
+
+  /* Pick up changes to the database since it was last loaded */
+  if (commands_file != NULL &&
+      !ide_compile_commands_load (self, commands_file, cancellable, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  if (!(ret = ide_compile_commands_lookup (self, file, NULL, &error)))
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, ret, (GDestroyNotify)g_strfreev);
+}
+
+/**
+ * ide_compile_commands_lookup_async:
+ * @self: An #IdeCompileCommands
+ * @file: A #GFile for a source file
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: (scope async): A callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Asynchronously looks up the flags for @file. The previously loaded
+ * database is reloaded first if it has been modified.
+ *
+ * Since: 3.26
+ */
+void
+ide_compile_commands_lookup_async (IdeCompileCommands  *self,
+                                   GFile               *file,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_COMPILE_COMMANDS (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_compile_commands_lookup_async);
+  g_task_set_task_data (task, g_object_ref (file), g_object_unref);
+  g_task_run_in_thread (task, ide_compile_commands_lookup_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_compile_commands_lookup_finish:
+ * @self: An #IdeCompileCommands
+ * @result: A #GAsyncResult provided to the callback
+ * @error: A location for a #GError or %NULL
+ *
+ * Completes an asynchronous request to ide_compile_commands_lookup_async().
+ *
+ * Returns: (transfer full): A %NULL-terminated array of flags, or %NULL
+ *   and @error is set.
+ *
+ * Since: 3.26
+ */
+gchar **
+ide_compile_commands_lookup_finish (IdeCompileCommands  *self,
+                                    GAsyncResult        *result,
+                                    GError             **error)
+{
+  g_return_val_if_fail (IDE_IS_COMPILE_COMMANDS (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
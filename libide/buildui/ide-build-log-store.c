@@ -0,0 +1,735 @@
+/* ide-build-log-store.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-build-log-store"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ide-build-log-store.h"
+
+/*
+ * IdeBuildLogStore is an append-only store for the lines of a build log.
+ *
+ * Lines are appended to an open chunk, which is sealed once it contains
+ * LINES_PER_CHUNK lines. Only the most recent MAX_RESIDENT_CHUNKS sealed
+ * chunks are kept in memory, older chunks are spilled to an unlinked
+ * temporary file. When the view scrolls back into spilled output, those
+ * chunks are paged back in and kept in a small ring of MAX_PAGED_CHUNKS.
+ *
+ * Each line is stored as a record of a guint32 length, a stream byte and
+ * the text of the line followed by a trailing \0 so that it may be used
+ * directly from the chunk.
+ */
+
+#define LINES_PER_CHUNK     1024
+#define MAX_RESIDENT_CHUNKS 32
+#define MAX_PAGED_CHUNKS    4
+#define RECORD_HEADER_SIZE  (sizeof (guint32) + 1)
+
+typedef struct
+{
+  /* NULL while the chunk is spilled and not paged in */
+  GBytes  *bytes;
+  guint32 *offsets;
+
+  /* Position within the spill file, or -1 if not spilled */
+  goffset  spill_offset;
+  gsize    length;
+  guint    n_lines;
+} Chunk;
+
+struct _IdeBuildLogStore
+{
+  GObject     parent_instance;
+
+  /* Sealed chunks, the first n_spilled only exist in the spill file */
+  GPtrArray  *chunks;
+  guint       n_spilled;
+
+  /* Spilled chunks that were paged back in, most recently used first */
+  GQueue      paged;
+
+  /* The chunk currently being appended to */
+  GByteArray *open_data;
+  GArray     *open_offsets;
+
+  guint       n_lines;
+
+  gint        spill_fd;
+  goffset     spill_length;
+  guint       spill_failed : 1;
+};
+
+typedef struct
+{
+  guint    first_line;
+  guint    n_lines;
+  GBytes  *bytes;
+  goffset  spill_offset;
+  gsize    length;
+} SearchChunk;
+
+typedef struct
+{
+  gchar   *text;
+  guint    from_line;
+  gint     fd;
+  GArray  *chunks;
+} Search;
+
+enum {
+  CHANGED,
+  N_SIGNALS
+};
+
+G_DEFINE_TYPE (IdeBuildLogStore, ide_build_log_store, G_TYPE_OBJECT)
+
+static guint signals [N_SIGNALS];
+
+static void
+chunk_free (gpointer data)
+{
+  Chunk *chunk = data;
+
+  g_clear_pointer (&chunk->bytes, g_bytes_unref);
+  g_clear_pointer (&chunk->offsets, g_free);
+  g_slice_free (Chunk, chunk);
+}
+
+static void
+search_chunk_clear (gpointer data)
+{
+  SearchChunk *chunk = data;
+
+  g_clear_pointer (&chunk->bytes, g_bytes_unref);
+}
+
+static void
+search_free (gpointer data)
+{
+  Search *search = data;
+
+  g_clear_pointer (&search->text, g_free);
+  g_clear_pointer (&search->chunks, g_array_unref);
+  if (search->fd != -1)
+    close (search->fd);
+  g_slice_free (Search, search);
+}
+
+static GBytes *
+read_spilled (gint      fd,
+              goffset   offset,
+              gsize     length,
+              GError  **error)
+{
+  guint8 *buf;
+  gsize pos = 0;
+
+  g_assert (fd != -1);
+
+  buf = g_malloc (length);
+
+  while (pos < length)
+    {
+      gssize n_read = pread (fd, buf + pos, length - pos, offset + pos);
+
+      if (n_read < 0 && errno == EINTR)
+        continue;
+
+      if (n_read <= 0)
+        {
+          int errsv = errno;
+
+          g_free (buf);
+
+          if (n_read == 0)
+            g_set_error (error,
+                         G_IO_ERROR,
+                         G_IO_ERROR_PARTIAL_INPUT,
+                         "Unexpected end of build log");
+          else
+            g_set_error (error,
+                         G_IO_ERROR,
+                         g_io_error_from_errno (errsv),
+                         "%s", g_strerror (errsv));
+
+          return NULL;
+        }
+
+      pos += n_read;
+    }
+
+  return g_bytes_new_take (buf, length);
+}
+
+static gboolean
+write_spilled (gint           fd,
+               goffset        offset,
+               const guint8  *data,
+               gsize          length)
+{
+  gsize pos = 0;
+
+  g_assert (fd != -1);
+
+  while (pos < length)
+    {
+      gssize n_written = pwrite (fd, data + pos, length - pos, offset + pos);
+
+      if (n_written < 0 && errno == EINTR)
+        continue;
+
+      if (n_written <= 0)
+        return FALSE;
+
+      pos += n_written;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+chunk_index_lines (Chunk *chunk)
+{
+  const guint8 *data;
+  gsize length;
+  gsize pos = 0;
+
+  g_assert (chunk != NULL);
+  g_assert (chunk->bytes != NULL);
+  g_assert (chunk->offsets == NULL);
+
+  data = g_bytes_get_data (chunk->bytes, &length);
+  chunk->offsets = g_new (guint32, chunk->n_lines);
+
+  for (guint i = 0; i < chunk->n_lines; i++)
+    {
+      guint32 text_len;
+
+      if (pos + RECORD_HEADER_SIZE > length)
+        return FALSE;
+
+      chunk->offsets [i] = pos;
+      memcpy (&text_len, data + pos, sizeof text_len);
+      pos += RECORD_HEADER_SIZE + text_len + 1;
+    }
+
+  return pos == length;
+}
+
+static void
+ide_build_log_store_spill (IdeBuildLogStore *self)
+{
+  Chunk *chunk;
+
+  g_assert (IDE_IS_BUILD_LOG_STORE (self));
+  g_assert (self->n_spilled < self->chunks->len);
+
+  if (self->spill_failed)
+    return;
+
+  if (self->spill_fd == -1)
+    {
+      g_autoptr(GError) error = NULL;
+      g_autofree gchar *path = NULL;
+
+      self->spill_fd = g_file_open_tmp ("gnome-builder-build-log-XXXXXX", &path, &error);
+
+      if (self->spill_fd == -1)
+        {
+          g_warning ("Failed to create build log spill file: %s", error->message);
+          self->spill_failed = TRUE;
+          return;
+        }
+
+      /* Nothing else needs the path, so make sure the file never outlives us */
+      g_unlink (path);
+    }
+
+  chunk = g_ptr_array_index (self->chunks, self->n_spilled);
+
+  if (!write_spilled (self->spill_fd,
+                      self->spill_length,
+                      g_bytes_get_data (chunk->bytes, NULL),
+                      chunk->length))
+    {
+      g_warning ("Failed to write build log spill file: %s", g_strerror (errno));
+      self->spill_failed = TRUE;
+      return;
+    }
+
+  chunk->spill_offset = self->spill_length;
+  self->spill_length += chunk->length;
+  self->n_spilled++;
+
+  g_clear_pointer (&chunk->bytes, g_bytes_unref);
+  g_clear_pointer (&chunk->offsets, g_free);
+}
+
+static void
+ide_build_log_store_seal (IdeBuildLogStore *self)
+{
+  Chunk *chunk;
+
+  g_assert (IDE_IS_BUILD_LOG_STORE (self));
+  g_assert (self->open_offsets->len == LINES_PER_CHUNK);
+
+  chunk = g_slice_new0 (Chunk);
+  chunk->n_lines = self->open_offsets->len;
+  chunk->length = self->open_data->len;
+  chunk->spill_offset = -1;
+  chunk->offsets = (guint32 *)(gpointer)g_array_free (self->open_offsets, FALSE);
+  chunk->bytes = g_byte_array_free_to_bytes (self->open_data);
+
+  g_ptr_array_add (self->chunks, chunk);
+
+  self->open_data = g_byte_array_new ();
+  self->open_offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  while (!self->spill_failed && self->chunks->len - self->n_spilled > MAX_RESIDENT_CHUNKS)
+    ide_build_log_store_spill (self);
+}
+
+static gboolean
+ide_build_log_store_page_in (IdeBuildLogStore *self,
+                             Chunk            *chunk)
+{
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_BUILD_LOG_STORE (self));
+  g_assert (chunk != NULL);
+  g_assert (chunk->spill_offset != -1);
+
+  if (chunk->bytes != NULL)
+    {
+      /* Move to the head of the ring */
+      if (self->paged.head->data != chunk)
+        {
+          g_queue_remove (&self->paged, chunk);
+          g_queue_push_head (&self->paged, chunk);
+        }
+
+      return TRUE;
+    }
+
+  chunk->bytes = read_spilled (self->spill_fd, chunk->spill_offset, chunk->length, &error);
+
+  if (chunk->bytes == NULL)
+    {
+      g_warning ("Failed to read build log spill file: %s", error->message);
+      return FALSE;
+    }
+
+  if (!chunk_index_lines (chunk))
+    {
+      g_warning ("Corrupted build log spill file");
+      g_clear_pointer (&chunk->bytes, g_bytes_unref);
+      g_clear_pointer (&chunk->offsets, g_free);
+      return FALSE;
+    }
+
+  g_queue_push_head (&self->paged, chunk);
+
+  while (self->paged.length > MAX_PAGED_CHUNKS)
+    {
+      Chunk *evicted = g_queue_pop_tail (&self->paged);
+
+      g_clear_pointer (&evicted->bytes, g_bytes_unref);
+      g_clear_pointer (&evicted->offsets, g_free);
+    }
+
+  return TRUE;
+}
+
+static void
+ide_build_log_store_finalize (GObject *object)
+{
+  IdeBuildLogStore *self = (IdeBuildLogStore *)object;
+
+  g_queue_clear (&self->paged);
+  g_clear_pointer (&self->chunks, g_ptr_array_unref);
+  g_byte_array_unref (self->open_data);
+  g_array_unref (self->open_offsets);
+
+  if (self->spill_fd != -1)
+    {
+      close (self->spill_fd);
+      self->spill_fd = -1;
+    }
+
+  G_OBJECT_CLASS (ide_build_log_store_parent_class)->finalize (object);
+}
+
+static void
+ide_build_log_store_class_init (IdeBuildLogStoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_build_log_store_finalize;
+
+  /**
+   * IdeBuildLogStore::changed:
+   *
+   * The "changed" signal is emitted when lines have been appended to
+   * the store or the store has been cleared.
+   */
+  signals [CHANGED] =
+    g_signal_new ("changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+}
+
+static void
+ide_build_log_store_init (IdeBuildLogStore *self)
+{
+  self->chunks = g_ptr_array_new_with_free_func (chunk_free);
+  self->open_data = g_byte_array_new ();
+  self->open_offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  self->spill_fd = -1;
+  g_queue_init (&self->paged);
+}
+
+IdeBuildLogStore *
+ide_build_log_store_new (void)
+{
+  return g_object_new (IDE_TYPE_BUILD_LOG_STORE, NULL);
+}
+
+guint
+ide_build_log_store_get_n_lines (IdeBuildLogStore *self)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_LOG_STORE (self), 0);
+
+  return self->n_lines;
+}
+
+void
+ide_build_log_store_append (IdeBuildLogStore  *self,
+                            IdeBuildLogStream  stream,
+                            const gchar       *message,
+                            gsize              message_len)
+{
+  guint32 offset;
+  guint32 text_len;
+  guint8 stream_byte = stream;
+
+  g_return_if_fail (IDE_IS_BUILD_LOG_STORE (self));
+  g_return_if_fail (message != NULL);
+
+  if (self->n_lines == G_MAXUINT)
+    return;
+
+  text_len = MIN (message_len, G_MAXUINT32 - RECORD_HEADER_SIZE - 1);
+  offset = self->open_data->len;
+
+  g_byte_array_append (self->open_data, (const guint8 *)&text_len, sizeof text_len);
+  g_byte_array_append (self->open_data, &stream_byte, 1);
+  g_byte_array_append (self->open_data, (const guint8 *)message, text_len);
+  g_byte_array_append (self->open_data, (const guint8 *)"", 1);
+  g_array_append_val (self->open_offsets, offset);
+
+  self->n_lines++;
+
+  if (self->open_offsets->len == LINES_PER_CHUNK)
+    ide_build_log_store_seal (self);
+
+  g_signal_emit (self, signals [CHANGED], 0);
+}
+
+void
+ide_build_log_store_clear (IdeBuildLogStore *self)
+{
+  g_return_if_fail (IDE_IS_BUILD_LOG_STORE (self));
+
+  g_queue_clear (&self->paged);
+  g_ptr_array_set_size (self->chunks, 0);
+  g_byte_array_set_size (self->open_data, 0);
+  g_array_set_size (self->open_offsets, 0);
+
+  self->n_lines = 0;
+  self->n_spilled = 0;
+  self->spill_failed = FALSE;
+  self->spill_length = 0;
+
+  if (self->spill_fd != -1 && ftruncate (self->spill_fd, 0) != 0)
+    {
+      close (self->spill_fd);
+      self->spill_fd = -1;
+    }
+
+  g_signal_emit (self, signals [CHANGED], 0);
+}
+
+/**
+ * ide_build_log_store_get_line:
+ * @self: An #IdeBuildLogStore
+ * @line: the index of the line
+ * @stream: (out) (optional): a location for the stream of the line
+ *
+ * Gets the text of @line, which may require reading it back from the
+ * spill file.
+ *
+ * Returns: the text of the line, which is only valid until the next call
+ *   into @self.
+ */
+const gchar *
+ide_build_log_store_get_line (IdeBuildLogStore  *self,
+                              guint              line,
+                              IdeBuildLogStream *stream)
+{
+  const guint8 *data;
+  guint chunk_index;
+  guint32 offset;
+
+  g_return_val_if_fail (IDE_IS_BUILD_LOG_STORE (self), NULL);
+  g_return_val_if_fail (line < self->n_lines, NULL);
+
+  chunk_index = line / LINES_PER_CHUNK;
+  line %= LINES_PER_CHUNK;
+
+  if (chunk_index == self->chunks->len)
+    {
+      data = self->open_data->data;
+      offset = g_array_index (self->open_offsets, guint32, line);
+    }
+  else
+    {
+      Chunk *chunk = g_ptr_array_index (self->chunks, chunk_index);
+
+      if (chunk_index < self->n_spilled && !ide_build_log_store_page_in (self, chunk))
+        {
+          if (stream != NULL)
+            *stream = IDE_BUILD_LOG_STDOUT;
+          return "";
+        }
+
+      data = g_bytes_get_data (chunk->bytes, NULL);
+      offset = chunk->offsets [line];
+    }
+
+  if (stream != NULL)
+    *stream = data [offset + sizeof (guint32)];
+
+  return (const gchar *)data + offset + RECORD_HEADER_SIZE;
+}
+
+static gboolean
+contains_caseless (const gchar *haystack,
+                   gsize        haystack_len,
+                   const gchar *needle,
+                   gsize        needle_len)
+{
+  if (needle_len > haystack_len)
+    return FALSE;
+
+  for (gsize i = 0; i <= haystack_len - needle_len; i++)
+    {
+      if (g_ascii_strncasecmp (haystack + i, needle, needle_len) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+search_range (Search        *search,
+              guint          begin,
+              guint          end,
+              guint         *found,
+              GCancellable  *cancellable,
+              GError       **error)
+{
+  gsize text_len = strlen (search->text);
+
+  g_assert (search != NULL);
+  g_assert (found != NULL);
+
+  for (guint i = 0; i < search->chunks->len; i++)
+    {
+      const SearchChunk *chunk = &g_array_index (search->chunks, SearchChunk, i);
+      g_autoptr(GBytes) bytes = NULL;
+      const guint8 *data;
+      gsize length;
+      gsize pos = 0;
+
+      if (chunk->first_line + chunk->n_lines <= begin || chunk->first_line >= end)
+        continue;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+
+      if (chunk->bytes != NULL)
+        bytes = g_bytes_ref (chunk->bytes);
+      else if (!(bytes = read_spilled (search->fd, chunk->spill_offset, chunk->length, error)))
+        return FALSE;
+
+      data = g_bytes_get_data (bytes, &length);
+
+      for (guint j = 0; j < chunk->n_lines && pos + RECORD_HEADER_SIZE <= length; j++)
+        {
+          guint line = chunk->first_line + j;
+          guint32 line_len;
+
+          memcpy (&line_len, data + pos, sizeof line_len);
+
+          if (line >= begin && line < end &&
+              contains_caseless ((const gchar *)data + pos + RECORD_HEADER_SIZE,
+                                 MIN (line_len, length - pos - RECORD_HEADER_SIZE),
+                                 search->text,
+                                 text_len))
+            {
+              *found = line;
+              return TRUE;
+            }
+
+          pos += RECORD_HEADER_SIZE + line_len + 1;
+        }
+    }
+
+  return FALSE;
+}
+
+static void
+ide_build_log_store_search_worker (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+  Search *search = task_data;
+  GError *error = NULL;
+  guint found = 0;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_BUILD_LOG_STORE (source_object));
+  g_assert (search != NULL);
+
+  /* Search forward from @from_line, wrapping around to the beginning */
+  if (search_range (search, search->from_line, G_MAXUINT, &found, cancellable, &error) ||
+      (error == NULL && search_range (search, 0, search->from_line, &found, cancellable, &error)))
+    g_task_return_int (task, found);
+  else if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_new_error (task,
+                             G_IO_ERROR,
+                             G_IO_ERROR_NOT_FOUND,
+                             "No line matching \"%s\" was found",
+                             search->text);
+}
+
+/**
+ * ide_build_log_store_search_async:
+ * @self: An #IdeBuildLogStore
+ * @text: the text to search for
+ * @from_line: the first line to search
+ *
+ * Asynchronously searches for the next line containing @text, ignoring
+ * case. The search wraps around to the beginning of the log and
+ * includes the output that has been spilled to disk.
+ */
+void
+ide_build_log_store_search_async (IdeBuildLogStore    *self,
+                                  const gchar         *text,
+                                  guint                from_line,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  Search *search;
+  guint first_line = 0;
+
+  g_return_if_fail (IDE_IS_BUILD_LOG_STORE (self));
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_build_log_store_search_async);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+
+  search = g_slice_new0 (Search);
+  search->text = g_strdup (text);
+  search->from_line = from_line;
+  search->fd = self->spill_fd != -1 ? dup (self->spill_fd) : -1;
+  search->chunks = g_array_sized_new (FALSE, FALSE, sizeof (SearchChunk), self->chunks->len + 1);
+  g_array_set_clear_func (search->chunks, search_chunk_clear);
+
+  /*
+   * Sealed chunks are immutable and spilled chunks are never rewritten
+   * until the store is cleared, so the worker only needs a copy of the
+   * open chunk.
+   */
+  for (guint i = 0; i < self->chunks->len; i++)
+    {
+      const Chunk *chunk = g_ptr_array_index (self->chunks, i);
+      SearchChunk schunk = { 0 };
+
+      schunk.first_line = first_line;
+      schunk.n_lines = chunk->n_lines;
+      schunk.bytes = chunk->bytes ? g_bytes_ref (chunk->bytes) : NULL;
+      schunk.spill_offset = chunk->spill_offset;
+      schunk.length = chunk->length;
+
+      g_array_append_val (search->chunks, schunk);
+
+      first_line += chunk->n_lines;
+    }
+
+  if (self->open_offsets->len > 0)
+    {
+      SearchChunk schunk = { 0 };
+
+      schunk.first_line = first_line;
+      schunk.n_lines = self->open_offsets->len;
+      schunk.bytes = g_bytes_new (self->open_data->data, self->open_data->len);
+      schunk.spill_offset = -1;
+      schunk.length = self->open_data->len;
+
+      g_array_append_val (search->chunks, schunk);
+    }
+
+  g_task_set_task_data (task, search, search_free);
+  g_task_run_in_thread (task, ide_build_log_store_search_worker);
+}
+
+gboolean
+ide_build_log_store_search_finish (IdeBuildLogStore  *self,
+                                   GAsyncResult      *result,
+                                   guint             *line,
+                                   GError           **error)
+{
+  gssize ret;
+
+  g_return_val_if_fail (IDE_IS_BUILD_LOG_STORE (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  ret = g_task_propagate_int (G_TASK (result), error);
+
+  if (ret < 0)
+    return FALSE;
+
+  if (line != NULL)
+    *line = ret;
+
+  return TRUE;
+}
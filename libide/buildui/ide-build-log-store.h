@@ -0,0 +1,53 @@
+/* ide-build-log-store.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUILD_LOG_STORE_H
+#define IDE_BUILD_LOG_STORE_H
+
+#include <ide.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BUILD_LOG_STORE (ide_build_log_store_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeBuildLogStore, ide_build_log_store, IDE, BUILD_LOG_STORE, GObject)
+
+IdeBuildLogStore *ide_build_log_store_new           (void);
+guint             ide_build_log_store_get_n_lines   (IdeBuildLogStore     *self);
+void              ide_build_log_store_append        (IdeBuildLogStore     *self,
+                                                     IdeBuildLogStream     stream,
+                                                     const gchar          *message,
+                                                     gsize                 message_len);
+void              ide_build_log_store_clear         (IdeBuildLogStore     *self);
+const gchar      *ide_build_log_store_get_line      (IdeBuildLogStore     *self,
+                                                     guint                 line,
+                                                     IdeBuildLogStream    *stream);
+void              ide_build_log_store_search_async  (IdeBuildLogStore     *self,
+                                                     const gchar          *text,
+                                                     guint                 from_line,
+                                                     GCancellable         *cancellable,
+                                                     GAsyncReadyCallback   callback,
+                                                     gpointer              user_data);
+gboolean          ide_build_log_store_search_finish (IdeBuildLogStore     *self,
+                                                     GAsyncResult         *result,
+                                                     guint                *line,
+                                                     GError              **error);
+
+G_END_DECLS
+
+#endif /* IDE_BUILD_LOG_STORE_H */
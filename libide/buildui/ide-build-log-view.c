@@ -0,0 +1,1524 @@
+/* ide-build-log-view.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-build-log-view"
+
+#include <ide.h>
+#include <string.h>
+
+#include "egg-widget-action-group.h"
+
+#include "ide-build-log-view.h"
+
+/*
+ * IdeBuildLogView renders the lines of an IdeBuildLogStore. Every line has
+ * the same height, so only the lines within the visible area are fetched
+ * from the store and laid out, no matter how large the build log grows.
+ *
+ * Selections are kept as line numbers and byte offsets within the text of
+ * each line once its color codes are removed, so selecting everything
+ * does not require loading the whole log either. The text is only
+ * collected when it is copied.
+ */
+
+#define MARGIN 3
+
+typedef struct _ColorCodeState
+{
+  /* A value of -1 is used to specify a default foreground orr background */
+  gint16 foreground;
+  gint16 background;
+
+  guint  bold       : 1;
+  guint  dim        : 1;
+  guint  underlined : 1;
+  guint  reverse    : 1;
+  guint  hidden     : 1;
+} ColorCodeState;
+
+typedef struct
+{
+  guint line;
+  /* Byte offset within the formatted line, G_MAXUINT for the end */
+  guint offset;
+} LogPosition;
+
+struct _IdeBuildLogView
+{
+  GtkWidget         parent_instance;
+
+  IdeBuildLogStore *store;
+
+  GtkAdjustment    *hadjustment;
+  GtkAdjustment    *vadjustment;
+
+  PangoLayout      *layout;
+  GdkWindow        *event_window;
+  GtkWidget        *popup_menu;
+
+  LogPosition       selection_anchor;
+  LogPosition       selection_cursor;
+
+  gint              line_height;
+  gint              max_width;
+  gint              highlight_line;
+  guint             changed_handler;
+
+  guint             hscroll_policy : 1;
+  guint             vscroll_policy : 1;
+  guint             has_selection : 1;
+  guint             in_drag : 1;
+};
+
+enum {
+  PROP_0,
+  PROP_STORE,
+  N_PROPS,
+
+  PROP_HADJUSTMENT,
+  PROP_HSCROLL_POLICY,
+  PROP_VADJUSTMENT,
+  PROP_VSCROLL_POLICY,
+};
+
+enum {
+  COPY_CLIPBOARD,
+  SELECT_ALL,
+  N_SIGNALS
+};
+
+G_DEFINE_TYPE_WITH_CODE (IdeBuildLogView, ide_build_log_view, GTK_TYPE_WIDGET,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE, NULL))
+
+static GParamSpec *properties [N_PROPS];
+static guint signals [N_SIGNALS];
+
+/* TODO: Same hard-coded palette as terminal-view
+ * till we have code for custom palettes
+ */
+#define COLOR_PALETTE_NB_COLORS 16
+
+static const GdkRGBA solarized_palette[] =
+{
+  /*
+   * Solarized palette (1.0.0beta2):
+   * http://ethanschoonover.com/solarized
+   */
+  { 0.02745,  0.211764, 0.258823, 1 },
+  { 0.862745, 0.196078, 0.184313, 1 },
+  { 0.521568, 0.6,      0,        1 },
+  { 0.709803, 0.537254, 0,        1 },
+  { 0.149019, 0.545098, 0.823529, 1 },
+  { 0.82745,  0.211764, 0.509803, 1 },
+  { 0.164705, 0.631372, 0.596078, 1 },
+  { 0.933333, 0.909803, 0.835294, 1 },
+  { 0,        0.168627, 0.211764, 1 },
+  { 0.796078, 0.294117, 0.086274, 1 },
+  { 0.345098, 0.431372, 0.458823, 1 },
+  { 0.396078, 0.482352, 0.513725, 1 },
+  { 0.513725, 0.580392, 0.588235, 1 },
+  { 0.423529, 0.443137, 0.768627, 1 },
+  { 0.57647,  0.631372, 0.631372, 1 },
+  { 0.992156, 0.964705, 0.890196, 1 },
+};
+
+typedef enum
+{
+  COLOR_CODE_NONE,
+  COLOR_CODE_TAG,
+  COLOR_CODE_INVALID,
+  COLOR_CODE_SKIP,
+} ColorCodeType;
+
+static inline gboolean
+is_foreground_color_value (gint value)
+{
+  return ((value >= 30 && value <= 37) || (value >= 90 && value <= 97));
+}
+
+static inline gboolean
+is_background_color_value (gint value)
+{
+  return ((value >= 40 && value <= 47) || (value >= 100 && value <= 107));
+}
+
+static inline gboolean
+is_format_color_value (gint value)
+{
+  return (value == 1 || value == 2 || value == 4 || value == 5 || value == 7 || value == 8);
+}
+
+static inline gboolean
+is_reset_format_color_value (gint value)
+{
+  return (value == 21 || value == 22 || value == 24 || value == 25 || value == 27 || value == 28);
+}
+
+static inline gboolean
+is_reset_all_color_value (gint value)
+{
+  return (value == 0);
+}
+
+/* Return -1 if not valid.
+ * Cursor is updated in every cases.
+ */
+static gint
+str_to_int (const gchar **cursor_ptr)
+{
+  gint value = 0;
+
+  g_assert (cursor_ptr != NULL && *cursor_ptr != NULL);
+
+  if (**cursor_ptr == 'm')
+    return 0;
+
+  while (**cursor_ptr >= '0' && **cursor_ptr <= '9')
+    {
+      value *= 10;
+      value += **cursor_ptr - '0';
+
+      ++(*cursor_ptr);
+    }
+
+  if (is_foreground_color_value (value) ||
+      is_background_color_value (value) ||
+      is_format_color_value (value) ||
+      is_reset_format_color_value (value) ||
+      value == 0 || value == 39 || value == 49)
+    return value;
+  else
+    return -1;
+}
+
+static gint
+color_code_value_to_palette_index (gint value)
+{
+  if (value >= 30 && value <= 37)
+    return value - 30;
+
+  if (value >= 90 && value <= 97)
+    return value - 82;
+
+  if (value >= 40 && value <= 47)
+    return value - 40;
+
+  if (value >= 100 && value <= 107)
+    return value - 92;
+
+  return -1;
+}
+
+static void
+color_codes_state_reset (ColorCodeState *color_codes_state)
+{
+  g_assert (color_codes_state != NULL);
+
+  color_codes_state->foreground = -1;
+  color_codes_state->background = -1;
+
+  color_codes_state->bold = FALSE;
+  color_codes_state->dim = FALSE;
+  color_codes_state->reverse = FALSE;
+  color_codes_state->underlined = FALSE;
+  color_codes_state->hidden = FALSE;
+}
+
+static void
+color_codes_state_update (ColorCodeState *color_codes_state,
+                          gint            value)
+{
+  g_assert (color_codes_state != NULL);
+
+  if (value == 0)
+    color_codes_state_reset (color_codes_state);
+  else if (value == 39)
+    color_codes_state->foreground = -1;
+  else if (value == 49)
+    color_codes_state->background = -1;
+  else if (is_foreground_color_value (value))
+    color_codes_state->foreground = value;
+  else if (is_background_color_value (value))
+    color_codes_state->background = value;
+  else if (is_format_color_value (value))
+    {
+      if (value == 1)
+        color_codes_state->bold = TRUE;
+      else if (value == 4)
+        color_codes_state->underlined = TRUE;
+    }
+  else if (is_reset_format_color_value (value))
+    {
+      if (value == 21)
+        color_codes_state->bold = FALSE;
+      else if (value == 24)
+        color_codes_state->underlined = FALSE;
+    }
+}
+
+static void
+insert_attribute (PangoAttrList  *attrs,
+                  PangoAttribute *attr,
+                  guint           begin,
+                  guint           end)
+{
+  attr->start_index = begin;
+  attr->end_index = end;
+  pango_attr_list_insert (attrs, attr);
+}
+
+static void
+color_codes_state_apply (ColorCodeState *color_codes_state,
+                         PangoAttrList  *attrs,
+                         guint           begin,
+                         guint           end)
+{
+  const GdkRGBA *rgba;
+
+  g_assert (color_codes_state != NULL);
+  g_assert (attrs != NULL);
+
+  if (color_codes_state->foreground != -1)
+    {
+      rgba = &solarized_palette [color_code_value_to_palette_index (color_codes_state->foreground)];
+      insert_attribute (attrs,
+                        pango_attr_foreground_new (rgba->red * 0xFFFF,
+                                                   rgba->green * 0xFFFF,
+                                                   rgba->blue * 0xFFFF),
+                        begin, end);
+    }
+
+  if (color_codes_state->background != -1)
+    {
+      rgba = &solarized_palette [color_code_value_to_palette_index (color_codes_state->background)];
+      insert_attribute (attrs,
+                        pango_attr_background_new (rgba->red * 0xFFFF,
+                                                   rgba->green * 0xFFFF,
+                                                   rgba->blue * 0xFFFF),
+                        begin, end);
+    }
+
+  if (color_codes_state->bold == TRUE)
+    insert_attribute (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD), begin, end);
+
+  if (color_codes_state->underlined == TRUE)
+    insert_attribute (attrs, pango_attr_underline_new (PANGO_UNDERLINE_SINGLE), begin, end);
+}
+
+static ColorCodeType
+fetch_color_codes_tags (const gchar    **cursor,
+                        ColorCodeState  *color_codes_state)
+{
+  gint value;
+  ColorCodeType ret = COLOR_CODE_NONE;
+  ColorCodeState tmp_color_codes_state = *color_codes_state;
+
+  g_assert (cursor != NULL && *cursor != NULL);
+  g_assert (color_codes_state  != NULL);
+
+  while (**cursor != '\0')
+    {
+      value = str_to_int (cursor);
+      if (value != -1)
+        {
+          if (is_foreground_color_value (value) ||
+              is_background_color_value (value) ||
+              is_format_color_value (value) ||
+              is_reset_format_color_value (value) ||
+              is_reset_all_color_value (value))
+            {
+              color_codes_state_update (&tmp_color_codes_state, value);
+              ret = COLOR_CODE_TAG;
+            }
+        }
+      else if (ret == COLOR_CODE_NONE)
+        ret = COLOR_CODE_INVALID;
+
+      if (**cursor == 'm')
+      {
+        if (ret != COLOR_CODE_INVALID)
+          *color_codes_state = tmp_color_codes_state;
+
+        ++(*cursor);
+        return ret;
+      }
+
+      if (**cursor != ';')
+        break;
+
+      ++(*cursor);
+    }
+
+  return COLOR_CODE_INVALID;
+}
+
+/**
+ * find_color_code:
+ * @msg: text to search in
+ * @color_codes_state: (inout) : if a color code is found, the state is updated
+ * @start: (out) point to the first char of a found code
+ * @end: (out) point to the last char + 1 of a found code
+ *
+ * If no color code is found, start and end point to the string's end.
+ *
+ * Returns: a #ColorCodeType indicating the state of the search.
+ */
+
+static ColorCodeType
+find_color_code (const gchar     *msg,
+                 ColorCodeState  *color_codes_state,
+                 const gchar    **start,
+                 const gchar    **end)
+{
+  const gchar *cursor = msg;
+  ColorCodeType ret;
+
+  g_assert (!ide_str_empty0 (msg));
+  g_assert (color_codes_state != NULL);
+  g_assert (start != NULL);
+  g_assert (end != NULL);
+
+  while (*cursor != '\0')
+    {
+      if (*cursor == '\\' && *(cursor + 1) == 'e')
+        {
+          *start = cursor;
+          cursor += 2;
+        }
+      else if (*cursor == '\033')
+        {
+          *start = cursor;
+          ++cursor;
+        }
+      else
+        goto next;
+
+      if (*cursor == '[')
+        {
+          ++cursor;
+          if (*cursor == '\0')
+            goto end;
+
+          if (*cursor == 'K')
+            {
+              *end = cursor + 1;
+              return COLOR_CODE_SKIP;
+            }
+
+          ret = fetch_color_codes_tags (&cursor, color_codes_state);
+          *end = cursor;
+
+          return ret;
+        }
+
+      if (*cursor == '\0')
+        goto end;
+
+next:
+      /* TODO: skip a possible escaped char */
+      cursor = g_utf8_next_char (cursor);
+    }
+
+end:
+  *start = *end = cursor;
+  return COLOR_CODE_NONE;
+}
+
+/*
+ * Transform VT color codes into attributes. Each line starts out with the
+ * default state, so only lines that are visible need to be formatted.
+ * @attrs may be %NULL when only the text is needed.
+ */
+static void
+format_line (const gchar       *message,
+             IdeBuildLogStream  stream,
+             GString           *text,
+             PangoAttrList     *attrs)
+{
+  ColorCodeState color_codes_state;
+  ColorCodeState current_color_codes_state;
+  ColorCodeType tag_type;
+  ColorCodeType current_tag_type = COLOR_CODE_NONE;
+  const gchar *cursor = message;
+  const gchar *tag_start;
+  const gchar *tag_end;
+  gsize len;
+
+  g_assert (message != NULL);
+  g_assert (text != NULL);
+
+  color_codes_state_reset (&color_codes_state);
+  color_codes_state_reset (&current_color_codes_state);
+
+  /* Inserted first so that VT color codes have higher priority */
+  if (attrs != NULL && G_LIKELY (stream != IDE_BUILD_LOG_STDOUT))
+    insert_attribute (attrs, pango_attr_foreground_new (0xFFFF, 0, 0), 0, G_MAXUINT);
+
+  while (*cursor != '\0')
+    {
+      tag_type = find_color_code (cursor, &color_codes_state, &tag_start, &tag_end);
+      len = tag_start - cursor;
+      if (len > 0)
+        {
+          guint begin = text->len;
+
+          g_string_append_len (text, cursor, len);
+
+          if (attrs != NULL &&
+              (current_tag_type == COLOR_CODE_TAG || current_tag_type == COLOR_CODE_SKIP))
+            color_codes_state_apply (&current_color_codes_state, attrs, begin, text->len);
+        }
+
+      current_tag_type = tag_type;
+      current_color_codes_state = color_codes_state;
+
+      if (tag_type == COLOR_CODE_NONE)
+        break;
+
+      cursor = tag_end;
+    }
+}
+
+static gint
+ide_build_log_view_get_line_height (IdeBuildLogView *self)
+{
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (self->line_height == 0)
+    {
+      PangoContext *context = gtk_widget_get_pango_context (GTK_WIDGET (self));
+      PangoFontMetrics *metrics = pango_context_get_metrics (context, NULL, NULL);
+
+      self->line_height = MAX (1, PANGO_PIXELS (pango_font_metrics_get_ascent (metrics) +
+                                                pango_font_metrics_get_descent (metrics)));
+
+      pango_font_metrics_unref (metrics);
+    }
+
+  return self->line_height;
+}
+
+static void
+ide_build_log_view_update_adjustments (IdeBuildLogView *self)
+{
+  GtkAllocation alloc;
+  gboolean at_bottom;
+  gdouble upper;
+  gdouble value;
+  gint line_height;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (self->hadjustment == NULL || self->vadjustment == NULL)
+    return;
+
+  gtk_widget_get_allocation (GTK_WIDGET (self), &alloc);
+  line_height = ide_build_log_view_get_line_height (self);
+
+  /* Keep following the output if we were scrolled to the end */
+  at_bottom = (gtk_adjustment_get_value (self->vadjustment) +
+               gtk_adjustment_get_page_size (self->vadjustment) + 1 >=
+               gtk_adjustment_get_upper (self->vadjustment));
+
+  upper = (gdouble)ide_build_log_store_get_n_lines (self->store) * line_height + MARGIN * 2;
+
+  if (at_bottom)
+    value = MAX (0, upper - alloc.height);
+  else
+    value = CLAMP (gtk_adjustment_get_value (self->vadjustment), 0, MAX (0, upper - alloc.height));
+
+  gtk_adjustment_configure (self->vadjustment,
+                            value,
+                            0,
+                            upper,
+                            line_height,
+                            alloc.height * 0.9,
+                            alloc.height);
+
+  gtk_adjustment_configure (self->hadjustment,
+                            gtk_adjustment_get_value (self->hadjustment),
+                            0,
+                            MAX (self->max_width, alloc.width),
+                            line_height,
+                            alloc.width * 0.9,
+                            alloc.width);
+}
+
+static gboolean
+ide_build_log_view_changed_tick (GtkWidget     *widget,
+                                 GdkFrameClock *frame_clock,
+                                 gpointer       user_data)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  self->changed_handler = 0;
+
+  ide_build_log_view_update_adjustments (self);
+  gtk_widget_queue_draw (widget);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_build_log_view_store_changed (IdeBuildLogView  *self,
+                                  IdeBuildLogStore *store)
+{
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (IDE_IS_BUILD_LOG_STORE (store));
+
+  if (ide_build_log_store_get_n_lines (store) == 0)
+    {
+      self->max_width = 0;
+      self->highlight_line = -1;
+      self->has_selection = FALSE;
+      self->in_drag = FALSE;
+    }
+
+  /* Many lines may arrive per frame, so only update once per frame */
+  if (self->changed_handler == 0)
+    self->changed_handler =
+      gtk_widget_add_tick_callback (GTK_WIDGET (self),
+                                    ide_build_log_view_changed_tick,
+                                    NULL, NULL);
+}
+
+static void
+ide_build_log_view_set_adjustment (IdeBuildLogView  *self,
+                                   GtkAdjustment   **adjustment_ptr,
+                                   GtkAdjustment    *adjustment)
+{
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (adjustment_ptr != NULL);
+
+  if (adjustment != NULL && *adjustment_ptr == adjustment)
+    return;
+
+  if (adjustment == NULL)
+    adjustment = gtk_adjustment_new (0, 0, 0, 0, 0, 0);
+
+  if (*adjustment_ptr != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (*adjustment_ptr,
+                                            G_CALLBACK (gtk_widget_queue_draw),
+                                            self);
+      g_clear_object (adjustment_ptr);
+    }
+
+  *adjustment_ptr = g_object_ref_sink (adjustment);
+
+  g_signal_connect_object (adjustment,
+                           "value-changed",
+                           G_CALLBACK (gtk_widget_queue_draw),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  ide_build_log_view_update_adjustments (self);
+}
+
+static gint
+log_position_compare (const LogPosition *a,
+                      const LogPosition *b)
+{
+  if (a->line != b->line)
+    return a->line < b->line ? -1 : 1;
+
+  if (a->offset != b->offset)
+    return a->offset < b->offset ? -1 : 1;
+
+  return 0;
+}
+
+/*
+ * Gets the ordered bounds of the selection, returning %FALSE if nothing
+ * is selected.
+ */
+static gboolean
+ide_build_log_view_get_selection_bounds (IdeBuildLogView *self,
+                                         LogPosition     *begin,
+                                         LogPosition     *end)
+{
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+
+  if (!self->has_selection)
+    return FALSE;
+
+  if (log_position_compare (&self->selection_anchor, &self->selection_cursor) <= 0)
+    {
+      *begin = self->selection_anchor;
+      *end = self->selection_cursor;
+    }
+  else
+    {
+      *begin = self->selection_cursor;
+      *end = self->selection_anchor;
+    }
+
+  return log_position_compare (begin, end) != 0;
+}
+
+/*
+ * Lays out @line into the shared layout. The byte range from @sel_begin
+ * to @sel_end of the formatted line is drawn with @sel_fg, if set.
+ */
+static void
+ide_build_log_view_layout_line (IdeBuildLogView *self,
+                                guint            line,
+                                GString         *text,
+                                guint            sel_begin,
+                                guint            sel_end,
+                                const GdkRGBA   *sel_fg)
+{
+  PangoAttrList *attrs;
+  IdeBuildLogStream stream;
+  const gchar *message;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (text != NULL);
+
+  if (self->layout == NULL)
+    self->layout = gtk_widget_create_pango_layout (GTK_WIDGET (self), NULL);
+
+  attrs = pango_attr_list_new ();
+  message = ide_build_log_store_get_line (self->store, line, &stream);
+
+  g_string_truncate (text, 0);
+  format_line (message, stream, text, attrs);
+
+  sel_end = MIN (sel_end, text->len);
+
+  if (sel_fg != NULL && sel_begin < sel_end)
+    {
+      PangoAttribute *attr;
+
+      attr = pango_attr_foreground_new (sel_fg->red * 0xFFFF,
+                                        sel_fg->green * 0xFFFF,
+                                        sel_fg->blue * 0xFFFF);
+      attr->start_index = sel_begin;
+      attr->end_index = sel_end;
+      pango_attr_list_change (attrs, attr);
+    }
+
+  pango_layout_set_text (self->layout, text->str, text->len);
+  pango_layout_set_attributes (self->layout, attrs);
+  pango_attr_list_unref (attrs);
+}
+
+static void
+ide_build_log_view_draw_selection (IdeBuildLogView *self,
+                                   cairo_t         *cr,
+                                   gdouble          x,
+                                   gdouble          y,
+                                   guint            sel_begin,
+                                   guint            sel_end,
+                                   gboolean         to_edge)
+{
+  GtkStyleContext *style_context;
+  GtkAllocation alloc;
+  PangoLayoutLine *layout_line;
+  gint *ranges = NULL;
+  gint n_ranges = 0;
+  gint line_height;
+  gdouble last_x = x;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (cr != NULL);
+
+  gtk_widget_get_allocation (GTK_WIDGET (self), &alloc);
+  line_height = ide_build_log_view_get_line_height (self);
+  style_context = gtk_widget_get_style_context (GTK_WIDGET (self));
+
+  gtk_style_context_save (style_context);
+  gtk_style_context_set_state (style_context,
+                               gtk_widget_get_state_flags (GTK_WIDGET (self)) | GTK_STATE_FLAG_SELECTED);
+
+  if (sel_begin < sel_end &&
+      NULL != (layout_line = pango_layout_get_line_readonly (self->layout, 0)))
+    pango_layout_line_get_x_ranges (layout_line, sel_begin, sel_end, &ranges, &n_ranges);
+
+  for (gint i = 0; i < n_ranges; i++)
+    {
+      gdouble begin = x + PANGO_PIXELS (ranges [i * 2]);
+      gdouble end = x + PANGO_PIXELS (ranges [i * 2 + 1]);
+
+      gtk_render_background (style_context, cr, begin, y, end - begin, line_height);
+      last_x = MAX (last_x, end);
+    }
+
+  /* The newline is selected too, so extend to the edge like GtkTextView */
+  if (to_edge && last_x < alloc.width)
+    gtk_render_background (style_context, cr, last_x, y, alloc.width - last_x, line_height);
+
+  gtk_style_context_restore (style_context);
+
+  g_free (ranges);
+}
+
+static gboolean
+ide_build_log_view_draw (GtkWidget *widget,
+                         cairo_t   *cr)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+  GtkStyleContext *style_context;
+  GtkAllocation alloc;
+  LogPosition sel_begin;
+  LogPosition sel_end;
+  GdkRGBA fg;
+  GdkRGBA sel_fg;
+  GString *text;
+  gboolean has_selection;
+  gdouble xoffset;
+  gdouble yoffset;
+  guint n_lines;
+  guint first;
+  guint last;
+  gint line_height;
+  gint max_width;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (cr != NULL);
+
+  gtk_widget_get_allocation (widget, &alloc);
+  style_context = gtk_widget_get_style_context (widget);
+  gtk_render_background (style_context, cr, 0, 0, alloc.width, alloc.height);
+  gtk_style_context_get_color (style_context, gtk_widget_get_state_flags (widget), &fg);
+  gtk_style_context_get_color (style_context,
+                               gtk_widget_get_state_flags (widget) | GTK_STATE_FLAG_SELECTED,
+                               &sel_fg);
+
+  n_lines = ide_build_log_store_get_n_lines (self->store);
+  line_height = ide_build_log_view_get_line_height (self);
+  xoffset = gtk_adjustment_get_value (self->hadjustment);
+  yoffset = gtk_adjustment_get_value (self->vadjustment);
+
+  first = MAX (0, yoffset - MARGIN) / line_height;
+  last = MIN (n_lines, (yoffset + alloc.height) / line_height + 1);
+  max_width = self->max_width;
+
+  has_selection = ide_build_log_view_get_selection_bounds (self, &sel_begin, &sel_end);
+
+  text = g_string_new (NULL);
+
+  for (guint i = first; i < last; i++)
+    {
+      gdouble y = MARGIN + (gdouble)i * line_height - yoffset;
+      gboolean selected = has_selection && i >= sel_begin.line && i <= sel_end.line;
+      guint line_sel_begin = 0;
+      guint line_sel_end = 0;
+      gint width;
+
+      if (selected)
+        {
+          line_sel_begin = i == sel_begin.line ? sel_begin.offset : 0;
+          line_sel_end = i == sel_end.line ? sel_end.offset : G_MAXUINT;
+        }
+
+      ide_build_log_view_layout_line (self, i, text,
+                                      line_sel_begin, line_sel_end,
+                                      selected ? &sel_fg : NULL);
+
+      if ((gint)i == self->highlight_line)
+        {
+          GdkRGBA highlight = fg;
+
+          highlight.alpha *= 0.15;
+          gdk_cairo_set_source_rgba (cr, &highlight);
+          cairo_rectangle (cr, 0, y, alloc.width, line_height);
+          cairo_fill (cr);
+        }
+
+      if (selected)
+        ide_build_log_view_draw_selection (self, cr, MARGIN - xoffset, y,
+                                           line_sel_begin, MIN (line_sel_end, text->len),
+                                           i < sel_end.line);
+
+      gdk_cairo_set_source_rgba (cr, &fg);
+      cairo_move_to (cr, MARGIN - xoffset, y);
+      pango_cairo_show_layout (cr, self->layout);
+
+      pango_layout_get_pixel_size (self->layout, &width, NULL);
+      max_width = MAX (max_width, width + MARGIN * 2);
+    }
+
+  g_string_free (text, TRUE);
+
+  /* Widths are only known for lines that have been drawn */
+  if (max_width > self->max_width)
+    {
+      self->max_width = max_width;
+      gtk_adjustment_set_upper (self->hadjustment, MAX (max_width, alloc.width));
+    }
+
+  return GDK_EVENT_PROPAGATE;
+}
+
+/*
+ * Collects the text of the selection with the color codes removed. This
+ * pages in every selected line, so it is only done when the text is
+ * actually requested.
+ */
+static gchar *
+ide_build_log_view_get_selected_text (IdeBuildLogView *self)
+{
+  g_autoptr(GString) line_text = NULL;
+  LogPosition begin;
+  LogPosition end;
+  GString *str;
+  guint n_lines;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (!ide_build_log_view_get_selection_bounds (self, &begin, &end))
+    return NULL;
+
+  n_lines = ide_build_log_store_get_n_lines (self->store);
+
+  if (begin.line >= n_lines)
+    return NULL;
+
+  end.line = MIN (end.line, n_lines - 1);
+
+  str = g_string_new (NULL);
+  line_text = g_string_new (NULL);
+
+  for (guint i = begin.line; i <= end.line; i++)
+    {
+      IdeBuildLogStream stream;
+      const gchar *message;
+      guint line_begin;
+      guint line_end;
+
+      message = ide_build_log_store_get_line (self->store, i, &stream);
+
+      g_string_truncate (line_text, 0);
+      format_line (message, stream, line_text, NULL);
+
+      line_begin = MIN (i == begin.line ? begin.offset : 0, line_text->len);
+      line_end = MIN (i == end.line ? end.offset : G_MAXUINT, line_text->len);
+
+      if (line_begin < line_end)
+        g_string_append_len (str, line_text->str + line_begin, line_end - line_begin);
+
+      if (i < end.line)
+        g_string_append_c (str, '\n');
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+ide_build_log_view_update_primary (IdeBuildLogView *self)
+{
+  g_autofree gchar *text = NULL;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (NULL != (text = ide_build_log_view_get_selected_text (self)))
+    gtk_clipboard_set_text (gtk_widget_get_clipboard (GTK_WIDGET (self), GDK_SELECTION_PRIMARY),
+                            text, -1);
+}
+
+static void
+ide_build_log_view_copy_clipboard (IdeBuildLogView *self)
+{
+  g_autofree gchar *text = NULL;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (NULL != (text = ide_build_log_view_get_selected_text (self)))
+    gtk_clipboard_set_text (gtk_widget_get_clipboard (GTK_WIDGET (self), GDK_SELECTION_CLIPBOARD),
+                            text, -1);
+}
+
+static void
+ide_build_log_view_select_all (IdeBuildLogView *self,
+                               gboolean         select)
+{
+  guint n_lines;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  n_lines = ide_build_log_store_get_n_lines (self->store);
+
+  self->has_selection = select && n_lines > 0;
+  self->selection_anchor.line = 0;
+  self->selection_anchor.offset = 0;
+  self->selection_cursor.line = n_lines > 0 ? n_lines - 1 : 0;
+  self->selection_cursor.offset = G_MAXUINT;
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/*
+ * Translates widget coordinates into a position within the log, clamping
+ * to the first and last lines.
+ */
+static void
+ide_build_log_view_get_position_at (IdeBuildLogView *self,
+                                    gdouble          x,
+                                    gdouble          y,
+                                    LogPosition     *pos)
+{
+  g_autoptr(GString) text = NULL;
+  gdouble line_y;
+  guint n_lines;
+  gint line_height;
+  gint index = 0;
+  gint trailing = 0;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (pos != NULL);
+
+  pos->line = 0;
+  pos->offset = 0;
+
+  if (0 == (n_lines = ide_build_log_store_get_n_lines (self->store)))
+    return;
+
+  line_height = ide_build_log_view_get_line_height (self);
+  line_y = y + gtk_adjustment_get_value (self->vadjustment) - MARGIN;
+
+  if (line_y < 0)
+    return;
+
+  pos->line = MIN (line_y / line_height, n_lines - 1);
+
+  text = g_string_new (NULL);
+  ide_build_log_view_layout_line (self, pos->line, text, 0, 0, NULL);
+
+  x += gtk_adjustment_get_value (self->hadjustment) - MARGIN;
+
+  if (x <= 0)
+    return;
+
+  pango_layout_xy_to_index (self->layout, x * PANGO_SCALE, 0, &index, &trailing);
+
+  /* @trailing is the number of characters to move past @index */
+  pos->offset = g_utf8_offset_to_pointer (text->str + index, trailing) - text->str;
+}
+
+static gboolean
+ide_build_log_view_popup_menu (GtkWidget *widget)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+  g_autoptr(GdkEvent) event = NULL;
+  LogPosition begin;
+  LogPosition end;
+  GActionGroup *group;
+  GMenu *menu;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (self->popup_menu == NULL)
+    {
+      menu = ide_application_get_menu_by_id (IDE_APPLICATION_DEFAULT, "ide-build-log-view-popup-menu");
+      self->popup_menu = gtk_menu_new_from_model (G_MENU_MODEL (menu));
+      gtk_style_context_add_class (gtk_widget_get_style_context (self->popup_menu),
+                                   GTK_STYLE_CLASS_CONTEXT_MENU);
+      gtk_menu_attach_to_widget (GTK_MENU (self->popup_menu), widget, NULL);
+    }
+
+  group = gtk_widget_get_action_group (widget, "build-log-view");
+  egg_widget_action_group_set_action_enabled (EGG_WIDGET_ACTION_GROUP (group),
+                                              "copy-clipboard",
+                                              ide_build_log_view_get_selection_bounds (self, &begin, &end));
+
+  event = gtk_get_current_event ();
+  gtk_menu_popup_at_pointer (GTK_MENU (self->popup_menu), event);
+
+  return TRUE;
+}
+
+static gboolean
+ide_build_log_view_button_press_event (GtkWidget      *widget,
+                                       GdkEventButton *event)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+  LogPosition pos;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (event != NULL);
+
+  if (!gtk_widget_has_focus (widget))
+    gtk_widget_grab_focus (widget);
+
+  if (gdk_event_triggers_context_menu ((GdkEvent *)event))
+    return ide_build_log_view_popup_menu (widget);
+
+  if (event->button != GDK_BUTTON_PRIMARY)
+    return GDK_EVENT_PROPAGATE;
+
+  ide_build_log_view_get_position_at (self, event->x, event->y, &pos);
+
+  if (event->type == GDK_2BUTTON_PRESS || event->type == GDK_3BUTTON_PRESS)
+    {
+      /* Select the whole line */
+      self->selection_anchor.line = pos.line;
+      self->selection_anchor.offset = 0;
+      self->selection_cursor.line = pos.line;
+      self->selection_cursor.offset = G_MAXUINT;
+      self->has_selection = ide_build_log_store_get_n_lines (self->store) > 0;
+      ide_build_log_view_update_primary (self);
+    }
+  else if (event->type == GDK_BUTTON_PRESS)
+    {
+      if (!self->has_selection || !(event->state & GDK_SHIFT_MASK))
+        self->selection_anchor = pos;
+      self->selection_cursor = pos;
+      self->has_selection = TRUE;
+      self->in_drag = TRUE;
+    }
+
+  gtk_widget_queue_draw (widget);
+
+  return GDK_EVENT_STOP;
+}
+
+static gboolean
+ide_build_log_view_motion_notify_event (GtkWidget      *widget,
+                                        GdkEventMotion *event)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+  GtkAllocation alloc;
+  gdouble value;
+  gint line_height;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (event != NULL);
+
+  if (!self->in_drag)
+    return GDK_EVENT_PROPAGATE;
+
+  gtk_widget_get_allocation (widget, &alloc);
+  line_height = ide_build_log_view_get_line_height (self);
+  value = gtk_adjustment_get_value (self->vadjustment);
+
+  /* Scroll while dragging past the edges */
+  if (event->y < 0)
+    gtk_adjustment_set_value (self->vadjustment, value - line_height);
+  else if (event->y > alloc.height)
+    gtk_adjustment_set_value (self->vadjustment, value + line_height);
+
+  ide_build_log_view_get_position_at (self, event->x, event->y, &self->selection_cursor);
+
+  gtk_widget_queue_draw (widget);
+
+  return GDK_EVENT_STOP;
+}
+
+static gboolean
+ide_build_log_view_button_release_event (GtkWidget      *widget,
+                                         GdkEventButton *event)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+  g_assert (event != NULL);
+
+  if (!self->in_drag || event->button != GDK_BUTTON_PRIMARY)
+    return GDK_EVENT_PROPAGATE;
+
+  self->in_drag = FALSE;
+
+  ide_build_log_view_update_primary (self);
+
+  return GDK_EVENT_STOP;
+}
+
+static void
+ide_build_log_view_realize (GtkWidget *widget)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+  g_autoptr(GdkCursor) cursor = NULL;
+  GdkWindowAttr attributes = { 0 };
+  GtkAllocation alloc;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  GTK_WIDGET_CLASS (ide_build_log_view_parent_class)->realize (widget);
+
+  gtk_widget_get_allocation (widget, &alloc);
+
+  cursor = gdk_cursor_new_from_name (gtk_widget_get_display (widget), "text");
+
+  /* We draw on the parent window, but need our own for pointer events */
+  attributes.window_type = GDK_WINDOW_CHILD;
+  attributes.wclass = GDK_INPUT_ONLY;
+  attributes.x = alloc.x;
+  attributes.y = alloc.y;
+  attributes.width = alloc.width;
+  attributes.height = alloc.height;
+  attributes.cursor = cursor;
+  attributes.event_mask = (gtk_widget_get_events (widget) |
+                           GDK_BUTTON_PRESS_MASK |
+                           GDK_BUTTON_RELEASE_MASK |
+                           GDK_BUTTON1_MOTION_MASK);
+
+  self->event_window = gdk_window_new (gtk_widget_get_window (widget),
+                                       &attributes,
+                                       GDK_WA_X | GDK_WA_Y | (cursor ? GDK_WA_CURSOR : 0));
+  gtk_widget_register_window (widget, self->event_window);
+}
+
+static void
+ide_build_log_view_unrealize (GtkWidget *widget)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (self->event_window != NULL)
+    {
+      gtk_widget_unregister_window (widget, self->event_window);
+      gdk_window_destroy (self->event_window);
+      self->event_window = NULL;
+    }
+
+  GTK_WIDGET_CLASS (ide_build_log_view_parent_class)->unrealize (widget);
+}
+
+static void
+ide_build_log_view_map (GtkWidget *widget)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  GTK_WIDGET_CLASS (ide_build_log_view_parent_class)->map (widget);
+
+  if (self->event_window != NULL)
+    gdk_window_show (self->event_window);
+}
+
+static void
+ide_build_log_view_unmap (GtkWidget *widget)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  if (self->event_window != NULL)
+    gdk_window_hide (self->event_window);
+
+  GTK_WIDGET_CLASS (ide_build_log_view_parent_class)->unmap (widget);
+}
+
+static void
+ide_build_log_view_size_allocate (GtkWidget     *widget,
+                                  GtkAllocation *allocation)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  GTK_WIDGET_CLASS (ide_build_log_view_parent_class)->size_allocate (widget, allocation);
+
+  if (self->event_window != NULL)
+    gdk_window_move_resize (self->event_window,
+                            allocation->x,
+                            allocation->y,
+                            allocation->width,
+                            allocation->height);
+
+  ide_build_log_view_update_adjustments (self);
+}
+
+static void
+ide_build_log_view_style_updated (GtkWidget *widget)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)widget;
+
+  g_assert (IDE_IS_BUILD_LOG_VIEW (self));
+
+  GTK_WIDGET_CLASS (ide_build_log_view_parent_class)->style_updated (widget);
+
+  self->line_height = 0;
+  self->max_width = 0;
+  g_clear_object (&self->layout);
+
+  ide_build_log_view_update_adjustments (self);
+  gtk_widget_queue_draw (widget);
+}
+
+static void
+ide_build_log_view_dispose (GObject *object)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)object;
+
+  if (self->changed_handler != 0)
+    {
+      gtk_widget_remove_tick_callback (GTK_WIDGET (self), self->changed_handler);
+      self->changed_handler = 0;
+    }
+
+  if (self->popup_menu != NULL)
+    {
+      gtk_widget_destroy (self->popup_menu);
+      self->popup_menu = NULL;
+    }
+
+  g_clear_object (&self->layout);
+  g_clear_object (&self->hadjustment);
+  g_clear_object (&self->vadjustment);
+
+  G_OBJECT_CLASS (ide_build_log_view_parent_class)->dispose (object);
+}
+
+static void
+ide_build_log_view_finalize (GObject *object)
+{
+  IdeBuildLogView *self = (IdeBuildLogView *)object;
+
+  g_clear_object (&self->store);
+
+  G_OBJECT_CLASS (ide_build_log_view_parent_class)->finalize (object);
+}
+
+static void
+ide_build_log_view_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  IdeBuildLogView *self = IDE_BUILD_LOG_VIEW (object);
+
+  switch (prop_id)
+    {
+    case PROP_STORE:
+      g_value_set_object (value, self->store);
+      break;
+
+    case PROP_HADJUSTMENT:
+      g_value_set_object (value, self->hadjustment);
+      break;
+
+    case PROP_VADJUSTMENT:
+      g_value_set_object (value, self->vadjustment);
+      break;
+
+    case PROP_HSCROLL_POLICY:
+      g_value_set_enum (value, self->hscroll_policy);
+      break;
+
+    case PROP_VSCROLL_POLICY:
+      g_value_set_enum (value, self->vscroll_policy);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+ide_build_log_view_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  IdeBuildLogView *self = IDE_BUILD_LOG_VIEW (object);
+
+  switch (prop_id)
+    {
+    case PROP_STORE:
+      self->store = g_value_dup_object (value);
+      if (self->store == NULL)
+        self->store = ide_build_log_store_new ();
+      g_signal_connect_object (self->store,
+                               "changed",
+                               G_CALLBACK (ide_build_log_view_store_changed),
+                               self,
+                               G_CONNECT_SWAPPED);
+      break;
+
+    case PROP_HADJUSTMENT:
+      ide_build_log_view_set_adjustment (self, &self->hadjustment, g_value_get_object (value));
+      break;
+
+    case PROP_VADJUSTMENT:
+      ide_build_log_view_set_adjustment (self, &self->vadjustment, g_value_get_object (value));
+      break;
+
+    case PROP_HSCROLL_POLICY:
+      self->hscroll_policy = g_value_get_enum (value);
+      gtk_widget_queue_resize (GTK_WIDGET (self));
+      break;
+
+    case PROP_VSCROLL_POLICY:
+      self->vscroll_policy = g_value_get_enum (value);
+      gtk_widget_queue_resize (GTK_WIDGET (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+ide_build_log_view_class_init (IdeBuildLogViewClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+  GtkBindingSet *binding_set;
+
+  object_class->dispose = ide_build_log_view_dispose;
+  object_class->finalize = ide_build_log_view_finalize;
+  object_class->get_property = ide_build_log_view_get_property;
+  object_class->set_property = ide_build_log_view_set_property;
+
+  widget_class->draw = ide_build_log_view_draw;
+  widget_class->realize = ide_build_log_view_realize;
+  widget_class->unrealize = ide_build_log_view_unrealize;
+  widget_class->map = ide_build_log_view_map;
+  widget_class->unmap = ide_build_log_view_unmap;
+  widget_class->button_press_event = ide_build_log_view_button_press_event;
+  widget_class->button_release_event = ide_build_log_view_button_release_event;
+  widget_class->motion_notify_event = ide_build_log_view_motion_notify_event;
+  widget_class->popup_menu = ide_build_log_view_popup_menu;
+  widget_class->size_allocate = ide_build_log_view_size_allocate;
+  widget_class->style_updated = ide_build_log_view_style_updated;
+
+  gtk_widget_class_set_css_name (widget_class, "buildlogview");
+
+  properties [PROP_STORE] =
+    g_param_spec_object ("store",
+                         "Store",
+                         "The store containing the lines of the build log",
+                         IDE_TYPE_BUILD_LOG_STORE,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+
+  g_object_class_override_property (object_class, PROP_HADJUSTMENT, "hadjustment");
+  g_object_class_override_property (object_class, PROP_VADJUSTMENT, "vadjustment");
+  g_object_class_override_property (object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+  g_object_class_override_property (object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
+
+  signals [COPY_CLIPBOARD] =
+    g_signal_new_class_handler ("copy-clipboard",
+                                G_TYPE_FROM_CLASS (klass),
+                                G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                                G_CALLBACK (ide_build_log_view_copy_clipboard),
+                                NULL, NULL, NULL,
+                                G_TYPE_NONE, 0);
+
+  signals [SELECT_ALL] =
+    g_signal_new_class_handler ("select-all",
+                                G_TYPE_FROM_CLASS (klass),
+                                G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                                G_CALLBACK (ide_build_log_view_select_all),
+                                NULL, NULL, NULL,
+                                G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
+  binding_set = gtk_binding_set_by_class (klass);
+
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_c, GDK_CONTROL_MASK, "copy-clipboard", 0);
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_Insert, GDK_CONTROL_MASK, "copy-clipboard", 0);
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_a, GDK_CONTROL_MASK, "select-all", 1,
+                                G_TYPE_BOOLEAN, TRUE);
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_a, GDK_SHIFT_MASK | GDK_CONTROL_MASK, "select-all", 1,
+                                G_TYPE_BOOLEAN, FALSE);
+}
+
+static void
+ide_build_log_view_init (IdeBuildLogView *self)
+{
+  self->highlight_line = -1;
+
+  gtk_widget_set_has_window (GTK_WIDGET (self), FALSE);
+  gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
+  egg_widget_action_group_attach (self, "build-log-view");
+  gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (self)),
+                               GTK_STYLE_CLASS_VIEW);
+}
+
+GtkWidget *
+ide_build_log_view_new (IdeBuildLogStore *store)
+{
+  return g_object_new (IDE_TYPE_BUILD_LOG_VIEW,
+                       "store", store,
+                       NULL);
+}
+
+/**
+ * ide_build_log_view_get_store:
+ *
+ * Returns: (transfer none): An #IdeBuildLogStore
+ */
+IdeBuildLogStore *
+ide_build_log_view_get_store (IdeBuildLogView *self)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_LOG_VIEW (self), NULL);
+
+  return self->store;
+}
+
+guint
+ide_build_log_view_get_first_visible (IdeBuildLogView *self)
+{
+  gdouble value;
+
+  g_return_val_if_fail (IDE_IS_BUILD_LOG_VIEW (self), 0);
+
+  if (self->vadjustment == NULL)
+    return 0;
+
+  value = MAX (0, gtk_adjustment_get_value (self->vadjustment) - MARGIN);
+
+  return value / ide_build_log_view_get_line_height (self);
+}
+
+gint
+ide_build_log_view_get_highlight_line (IdeBuildLogView *self)
+{
+  g_return_val_if_fail (IDE_IS_BUILD_LOG_VIEW (self), -1);
+
+  return self->highlight_line;
+}
+
+/**
+ * ide_build_log_view_set_highlight_line:
+ * @self: An #IdeBuildLogView
+ * @line: the line to highlight, or -1
+ *
+ * Highlights @line, such as for a search result, and scrolls to it if it
+ * is not currently visible.
+ */
+void
+ide_build_log_view_set_highlight_line (IdeBuildLogView *self,
+                                       gint             line)
+{
+  g_return_if_fail (IDE_IS_BUILD_LOG_VIEW (self));
+
+  self->highlight_line = MAX (-1, line);
+
+  if (line >= 0 && self->vadjustment != NULL)
+    {
+      gint line_height = ide_build_log_view_get_line_height (self);
+      gdouble y = MARGIN + (gdouble)line * line_height;
+      gdouble value = gtk_adjustment_get_value (self->vadjustment);
+      gdouble page_size = gtk_adjustment_get_page_size (self->vadjustment);
+
+      if (y < value || y + line_height > value + page_size)
+        gtk_adjustment_set_value (self->vadjustment, y - (page_size - line_height) / 2);
+    }
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
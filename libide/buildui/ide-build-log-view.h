@@ -0,0 +1,41 @@
+/* ide-build-log-view.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUILD_LOG_VIEW_H
+#define IDE_BUILD_LOG_VIEW_H
+
+#include <gtk/gtk.h>
+
+#include "ide-build-log-store.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_BUILD_LOG_VIEW (ide_build_log_view_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeBuildLogView, ide_build_log_view, IDE, BUILD_LOG_VIEW, GtkWidget)
+
+GtkWidget        *ide_build_log_view_new                (IdeBuildLogStore *store);
+IdeBuildLogStore *ide_build_log_view_get_store          (IdeBuildLogView  *self);
+guint             ide_build_log_view_get_first_visible  (IdeBuildLogView  *self);
+gint              ide_build_log_view_get_highlight_line (IdeBuildLogView  *self);
+void              ide_build_log_view_set_highlight_line (IdeBuildLogView  *self,
+                                                         gint              line);
+
+G_END_DECLS
+
+#endif /* IDE_BUILD_LOG_VIEW_H */
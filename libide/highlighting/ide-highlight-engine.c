@@ -31,6 +31,7 @@
 
 #define HIGHLIGHT_QUANTA_USEC 5000
 #define PRIVATE_TAG_PREFIX    "gb-private-tag"
+#define MAX_RANGE_LINES       500
 
 struct _IdeHighlightEngine
 {
@@ -43,19 +44,39 @@ struct _IdeHighlightEngine
 
   IdeExtensionAdapter *extension;
 
-  GtkTextMark         *invalid_begin;
-  GtkTextMark         *invalid_end;
+  /* The regions of the buffer that still need to be highlighted */
+  GtkSourceRegion     *invalid_region;
+
+  /*
+   * Weak references to the views showing the buffer, so that we can
+   * highlight what the user is looking at before the rest.
+   */
+  GSList              *views;
 
   GSList              *private_tags;
   GSList              *public_tags;
 
+  /* Used to discard spans computed by the highlighter in a thread */
+  GCancellable        *spans_cancellable;
+
   gint64               quanta_expiration;
 
   guint                work_timeout;
 
   guint                enabled : 1;
+  guint                spans_active : 1;
+  /* Set when compute_spans failed, to use update for this highlighter */
+  guint                spans_failed : 1;
 };
 
+typedef struct
+{
+  IdeHighlighter    *highlighter;
+  IdeBufferSnapshot *snapshot;
+  gint               begin_offset;
+  gint               end_offset;
+} SpansRequest;
+
 G_DEFINE_TYPE (IdeHighlightEngine, ide_highlight_engine, IDE_TYPE_OBJECT)
 
 enum {
@@ -294,29 +315,326 @@ ide_highlight_engine_apply_style (const GtkTextIter *begin,
   return IDE_HIGHLIGHT_CONTINUE;
 }
 
+static void
+ide_highlight_engine_remove_private_tags (IdeHighlightEngine *self,
+                                          const GtkTextIter  *begin,
+                                          const GtkTextIter  *end)
+{
+  GtkTextBuffer *buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  for (GSList *iter = self->private_tags; iter; iter = iter->next)
+    gtk_text_buffer_remove_tag (buffer, GTK_TEXT_TAG (iter->data), begin, end);
+}
+
 static gboolean
-ide_highlight_engine_tick (IdeHighlightEngine *self)
+get_visible_range (GtkTextView *view,
+                   GtkTextIter *begin,
+                   GtkTextIter *end)
 {
+  GdkRectangle rect;
+
+  g_assert (GTK_IS_TEXT_VIEW (view));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+
+  if (!gtk_widget_get_mapped (GTK_WIDGET (view)))
+    return FALSE;
+
+  gtk_text_view_get_visible_rect (view, &rect);
+  gtk_text_view_get_line_at_y (view, begin, rect.y, NULL);
+  gtk_text_view_get_line_at_y (view, end, rect.y + rect.height, NULL);
+  gtk_text_iter_forward_line (end);
+
+  return TRUE;
+}
+
+/*
+ * Finds the next range to highlight. The visible area of the views is
+ * highlighted first, then we work outward from the visible area so that
+ * scrolling a little finds highlighted text.
+ */
+static gboolean
+ide_highlight_engine_get_next_range (IdeHighlightEngine *self,
+                                     GtkTextIter        *begin,
+                                     GtkTextIter        *end)
+{
+  GtkSourceRegionIter region_iter;
+  GtkTextIter visible_begin;
+  GtkTextIter visible_end;
+  gboolean has_visible = FALSE;
+  gint best_distance = G_MAXINT;
+  gint line;
+
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+
+  if (self->invalid_region == NULL || gtk_source_region_is_empty (self->invalid_region))
+    return FALSE;
+
+  for (GSList *iter = self->views; iter; iter = iter->next)
+    {
+      g_autoptr(GtkSourceRegion) visible = NULL;
+      GtkTextIter view_begin;
+      GtkTextIter view_end;
+
+      if (!get_visible_range (iter->data, &view_begin, &view_end))
+        continue;
+
+      if (!has_visible)
+        {
+          visible_begin = view_begin;
+          visible_end = view_end;
+          has_visible = TRUE;
+        }
+
+      visible = gtk_source_region_intersect_subregion (self->invalid_region, &view_begin, &view_end);
+
+      if (visible != NULL && !gtk_source_region_is_empty (visible))
+        {
+          gtk_source_region_get_start_region_iter (visible, &region_iter);
+          gtk_source_region_iter_get_subregion (&region_iter, begin, end);
+          return TRUE;
+        }
+    }
+
+  gtk_source_region_get_start_region_iter (self->invalid_region, &region_iter);
+
+  if (!has_visible)
+    {
+      /* Nothing is visible, so just work from the top */
+      gtk_source_region_iter_get_subregion (&region_iter, begin, end);
+      IDE_GOTO (clamp_end);
+    }
+
+  while (!gtk_source_region_iter_is_end (&region_iter))
+    {
+      GtkTextIter sub_begin;
+      GtkTextIter sub_end;
+      gint distance;
+
+      gtk_source_region_iter_get_subregion (&region_iter, &sub_begin, &sub_end);
+      gtk_source_region_iter_next (&region_iter);
+
+      if (gtk_text_iter_compare (&sub_end, &visible_begin) <= 0)
+        distance = gtk_text_iter_get_line (&visible_begin) - gtk_text_iter_get_line (&sub_end);
+      else
+        distance = gtk_text_iter_get_line (&sub_begin) - gtk_text_iter_get_line (&visible_end);
+
+      if (distance < best_distance)
+        {
+          best_distance = distance;
+          *begin = sub_begin;
+          *end = sub_end;
+        }
+    }
+
+  /* Work upward from the end of ranges above the visible area */
+  if (gtk_text_iter_compare (end, &visible_begin) <= 0)
+    {
+      GtkTextIter sub_begin = *begin;
+
+      line = gtk_text_iter_get_line (end) - MAX_RANGE_LINES;
+
+      if (line > gtk_text_iter_get_line (&sub_begin))
+        gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (self->buffer), begin, line);
+
+      return TRUE;
+    }
+
+clamp_end:
+  line = gtk_text_iter_get_line (begin) + MAX_RANGE_LINES;
+
+  if (line < gtk_text_iter_get_line (end))
+    gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (self->buffer), end, line);
+
+  return TRUE;
+}
+
+static void
+spans_request_free (gpointer data)
+{
+  SpansRequest *request = data;
+
+  g_clear_object (&request->highlighter);
+  g_clear_pointer (&request->snapshot, ide_buffer_snapshot_unref);
+  g_slice_free (SpansRequest, request);
+}
+
+static void ide_highlight_engine_queue_work (IdeHighlightEngine *self);
+
+static void
+ide_highlight_engine_compute_spans_worker (GTask        *task,
+                                           gpointer      source_object,
+                                           gpointer      task_data,
+                                           GCancellable *cancellable)
+{
+  SpansRequest *request = task_data;
+  g_autofree gchar *text = NULL;
+  GError *error = NULL;
+  GArray *spans;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (source_object));
+  g_assert (request != NULL);
+
+  text = ide_buffer_snapshot_get_slice (request->snapshot, request->begin_offset, request->end_offset);
+  spans = ide_highlighter_compute_spans (request->highlighter, text, cancellable, &error);
+
+  if (spans == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, spans, (GDestroyNotify)g_array_unref);
+}
+
+static void
+ide_highlight_engine_compute_spans_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      user_data)
+{
+  IdeHighlightEngine *self = (IdeHighlightEngine *)object;
+  g_autoptr(GArray) spans = NULL;
+  g_autoptr(GError) error = NULL;
   GtkTextBuffer *buffer;
+  SpansRequest *request;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_assert (G_IS_TASK (result));
+
+  request = g_task_get_task_data (G_TASK (result));
+  spans = g_task_propagate_pointer (G_TASK (result), &error);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  self->spans_active = FALSE;
+
+  if (self->buffer == NULL || request->highlighter != self->highlighter)
+    return;
+
+  if (spans == NULL)
+    {
+      /* Keep highlighting, but on the main thread from now on */
+      g_debug ("%s failed to compute spans, falling back to update: %s",
+               G_OBJECT_TYPE_NAME (request->highlighter),
+               error ? error->message : "unknown error");
+      self->spans_failed = TRUE;
+      ide_highlight_engine_queue_work (self);
+      return;
+    }
+
+  /* The spans are stale if the buffer changed while they were computed */
+  if (ide_buffer_snapshot_get_change_count (request->snapshot) !=
+      ide_buffer_get_change_count (self->buffer))
+    {
+      ide_highlight_engine_queue_work (self);
+      return;
+    }
+
+  buffer = GTK_TEXT_BUFFER (self->buffer);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &begin, request->begin_offset);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, request->end_offset);
+
+  ide_highlight_engine_remove_private_tags (self, &begin, &end);
+
+  for (guint i = 0; i < spans->len; i++)
+    {
+      const IdeHighlightSpan *span = &g_array_index (spans, IdeHighlightSpan, i);
+      GtkTextIter span_begin;
+      GtkTextIter span_end;
+      GtkTextTag *tag;
+
+      if (span->begin >= span->end ||
+          request->begin_offset + span->end > (guint)request->end_offset)
+        continue;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &span_begin, request->begin_offset + span->begin);
+
+      /* The worker cannot see syntax classes, so filter like scan_words() would */
+      if (gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (buffer), &span_begin, "string") ||
+          gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (buffer), &span_begin, "path") ||
+          gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (buffer), &span_begin, "comment"))
+        continue;
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &span_end, request->begin_offset + span->end);
+
+      tag = get_tag_from_style (self, span->style_name, TRUE);
+      gtk_text_buffer_apply_tag (buffer, tag, &span_begin, &span_end);
+    }
+
+  gtk_source_region_subtract_subregion (self->invalid_region, &begin, &end);
+
+  ide_highlight_engine_queue_work (self);
+}
+
+static void
+ide_highlight_engine_compute_spans (IdeHighlightEngine *self,
+                                    const GtkTextIter  *begin,
+                                    const GtkTextIter  *end)
+{
+  g_autoptr(GTask) task = NULL;
+  SpansRequest *request;
+
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_assert (!self->spans_active);
+
+  /* The text is copied out of the snapshot by the worker */
+  request = g_slice_new0 (SpansRequest);
+  request->highlighter = g_object_ref (self->highlighter);
+  request->snapshot = ide_buffer_get_snapshot (self->buffer);
+  request->begin_offset = gtk_text_iter_get_offset (begin);
+  request->end_offset = gtk_text_iter_get_offset (end);
+
+  if (self->spans_cancellable == NULL)
+    self->spans_cancellable = g_cancellable_new ();
+
+  self->spans_active = TRUE;
+
+  task = g_task_new (self, self->spans_cancellable, ide_highlight_engine_compute_spans_cb, NULL);
+  g_task_set_source_tag (task, ide_highlight_engine_compute_spans);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_set_task_data (task, request, spans_request_free);
+  g_task_run_in_thread (task, ide_highlight_engine_compute_spans_worker);
+}
+
+static void
+ide_highlight_engine_cancel_spans (IdeHighlightEngine *self)
+{
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+
+  if (self->spans_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->spans_cancellable);
+      g_clear_object (&self->spans_cancellable);
+    }
+
+  self->spans_active = FALSE;
+}
+
+static gboolean
+ide_highlight_engine_tick (IdeHighlightEngine *self)
+{
   GtkTextIter iter;
   GtkTextIter invalid_begin;
   GtkTextIter invalid_end;
-  GSList *tags_iter;
 
   IDE_PROBE;
 
   g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
   g_assert (self->buffer != NULL);
   g_assert (self->highlighter != NULL);
-  g_assert (self->invalid_begin != NULL);
-  g_assert (self->invalid_end != NULL);
+  g_assert (self->invalid_region != NULL);
 
-  self->quanta_expiration = g_get_monotonic_time () + HIGHLIGHT_QUANTA_USEC;
+  if (self->spans_active)
+    return FALSE;
 
-  buffer = GTK_TEXT_BUFFER (self->buffer);
+  self->quanta_expiration = g_get_monotonic_time () + HIGHLIGHT_QUANTA_USEC;
 
-  gtk_text_buffer_get_iter_at_mark (buffer, &invalid_begin, self->invalid_begin);
-  gtk_text_buffer_get_iter_at_mark (buffer, &invalid_end, self->invalid_end);
+  if (!ide_highlight_engine_get_next_range (self, &invalid_begin, &invalid_end))
+    return FALSE;
 
   IDE_TRACE_MSG ("Highlight Range [%u:%u,%u:%u] (%s)",
                  gtk_text_iter_get_line (&invalid_begin),
@@ -325,38 +643,28 @@ ide_highlight_engine_tick (IdeHighlightEngine *self)
                  gtk_text_iter_get_line_offset (&invalid_end),
                  G_OBJECT_TYPE_NAME (self->highlighter));
 
-  if (gtk_text_iter_compare (&invalid_begin, &invalid_end) >= 0)
-    IDE_GOTO (up_to_date);
+  /* Highlighters that can work from a copy of the text do so in a thread */
+  if (IDE_HIGHLIGHTER_GET_IFACE (self->highlighter)->compute_spans != NULL && !self->spans_failed)
+    {
+      ide_highlight_engine_compute_spans (self, &invalid_begin, &invalid_end);
+      return FALSE;
+    }
 
   /*Clear all our tags*/
-  for (tags_iter = self->private_tags; tags_iter; tags_iter = tags_iter->next)
-    gtk_text_buffer_remove_tag (buffer,
-                                GTK_TEXT_TAG (tags_iter->data),
-                                &invalid_begin,
-                                &invalid_end);
+  ide_highlight_engine_remove_private_tags (self, &invalid_begin, &invalid_end);
 
   iter = invalid_begin;
 
   ide_highlighter_update (self->highlighter, ide_highlight_engine_apply_style,
                           &invalid_begin, &invalid_end, &iter);
 
-  if (gtk_text_iter_compare (&iter, &invalid_end) >= 0)
-    IDE_GOTO (up_to_date);
-
   /* Stop processing until further instruction if no movement was made */
-  if (gtk_text_iter_equal (&iter, &invalid_begin))
+  if (gtk_text_iter_compare (&iter, &invalid_begin) <= 0)
     return FALSE;
 
-  gtk_text_buffer_move_mark (buffer, self->invalid_begin, &iter);
-
-  return TRUE;
+  gtk_source_region_subtract_subregion (self->invalid_region, &invalid_begin, &iter);
 
-up_to_date:
-  gtk_text_buffer_get_start_iter (buffer, &iter);
-  gtk_text_buffer_move_mark (buffer, self->invalid_begin, &iter);
-  gtk_text_buffer_move_mark (buffer, self->invalid_end, &iter);
-
-  return FALSE;
+  return !gtk_source_region_is_empty (self->invalid_region);
 }
 
 static gboolean
@@ -385,12 +693,33 @@ ide_highlight_engine_queue_work (IdeHighlightEngine *self)
   if ((self->highlighter == NULL) || (self->buffer == NULL) || (self->work_timeout != 0))
     return;
 
-  self->work_timeout =  gdk_threads_add_idle_full (G_PRIORITY_LOW,
+  self->work_timeout = gdk_threads_add_idle_full (G_PRIORITY_LOW,
                                                    ide_highlight_engine_work_timeout_handler,
                                                    self,
                                                    NULL);
 }
 
+static void
+ide_highlight_engine_add_invalid (IdeHighlightEngine *self,
+                                  const GtkTextIter  *begin,
+                                  const GtkTextIter  *end)
+{
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+
+  if (self->invalid_region == NULL)
+    return;
+
+  gtk_source_region_add_subregion (self->invalid_region, begin, end);
+
+  /* Anything being computed in a thread may now be stale */
+  if (self->spans_active)
+    ide_highlight_engine_cancel_spans (self);
+
+  ide_highlight_engine_queue_work (self);
+}
+
 static gboolean
 invalidate_and_highlight (IdeHighlightEngine *self,
                           GtkTextIter        *begin,
@@ -406,28 +735,7 @@ invalidate_and_highlight (IdeHighlightEngine *self,
 
   if (get_invalidation_area (begin, end))
     {
-      GtkTextIter begin_tmp;
-      GtkTextIter end_tmp;
-      GtkTextBuffer *text_buffer = GTK_TEXT_BUFFER (self->buffer);
-
-      gtk_text_buffer_get_iter_at_mark (text_buffer, &begin_tmp, self->invalid_begin);
-      gtk_text_buffer_get_iter_at_mark (text_buffer, &end_tmp, self->invalid_end);
-
-      if (gtk_text_iter_equal (&begin_tmp, &end_tmp))
-        {
-          gtk_text_buffer_move_mark (text_buffer, self->invalid_begin, begin);
-          gtk_text_buffer_move_mark (text_buffer, self->invalid_end, end);
-        }
-      else
-        {
-          if (gtk_text_iter_compare (begin, &begin_tmp) < 0)
-            gtk_text_buffer_move_mark (text_buffer, self->invalid_begin, begin);
-          if (gtk_text_iter_compare (end, &end_tmp) > 0)
-            gtk_text_buffer_move_mark (text_buffer, self->invalid_end, end);
-        }
-
-      ide_highlight_engine_queue_work (self);
-
+      ide_highlight_engine_add_invalid (self, begin, end);
       return TRUE;
     }
 
@@ -452,6 +760,8 @@ ide_highlight_engine_reload (IdeHighlightEngine *self)
       self->work_timeout = 0;
     }
 
+  ide_highlight_engine_cancel_spans (self);
+
   if (self->buffer == NULL)
     IDE_EXIT;
 
@@ -462,8 +772,9 @@ ide_highlight_engine_reload (IdeHighlightEngine *self)
   /*
    * Invalidate the whole buffer.
    */
-  gtk_text_buffer_move_mark (buffer, self->invalid_begin, &begin);
-  gtk_text_buffer_move_mark (buffer, self->invalid_end, &end);
+  g_clear_object (&self->invalid_region);
+  self->invalid_region = gtk_source_region_new (buffer);
+  gtk_source_region_add_subregion (self->invalid_region, &begin, &end);
 
   /*
    * Remove our highlight tags from the buffer.
@@ -493,6 +804,8 @@ ide_highlight_engine_set_highlighter (IdeHighlightEngine *self,
 
   if (g_set_object (&self->highlighter, highlighter))
     {
+      self->spans_failed = FALSE;
+
       if (highlighter != NULL)
         {
           IDE_HIGHLIGHTER_GET_IFACE (highlighter)->set_engine (highlighter, self);
@@ -630,10 +943,6 @@ ide_highlight_engine__bind_buffer_cb (IdeHighlightEngine *self,
                                       IdeBuffer          *buffer,
                                       EggSignalGroup     *group)
 {
-  GtkTextBuffer *text_buffer = (GtkTextBuffer *)buffer;
-  GtkTextIter begin;
-  GtkTextIter end;
-
   IDE_ENTRY;
 
   g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
@@ -644,11 +953,7 @@ ide_highlight_engine__bind_buffer_cb (IdeHighlightEngine *self,
 
   g_object_set_qdata (G_OBJECT (buffer), engineQuark, self);
 
-  gtk_text_buffer_get_bounds (text_buffer, &begin, &end);
-
-  self->invalid_begin = gtk_text_buffer_create_mark (text_buffer, NULL, &begin, TRUE);
-  self->invalid_end = gtk_text_buffer_create_mark (text_buffer, NULL, &end, FALSE);
-
+  /* Creates the invalid region covering the whole buffer */
   ide_highlight_engine_reload (self);
 
   IDE_EXIT;
@@ -677,15 +982,13 @@ ide_highlight_engine__unbind_buffer_cb (IdeHighlightEngine  *self,
       self->work_timeout = 0;
     }
 
+  ide_highlight_engine_cancel_spans (self);
+
   g_object_set_qdata (G_OBJECT (text_buffer), engineQuark, NULL);
 
   tag_table = gtk_text_buffer_get_tag_table (text_buffer);
 
-  gtk_text_buffer_delete_mark (text_buffer, self->invalid_begin);
-  gtk_text_buffer_delete_mark (text_buffer, self->invalid_end);
-
-  self->invalid_begin = NULL;
-  self->invalid_end = NULL;
+  g_clear_object (&self->invalid_region);
 
   gtk_text_buffer_get_bounds (text_buffer, &begin, &end);
 
@@ -791,6 +1094,9 @@ ide_highlight_engine_finalize (GObject *object)
 {
   IdeHighlightEngine *self = (IdeHighlightEngine *)object;
 
+  while (self->views != NULL)
+    _ide_highlight_engine_remove_view (self, self->views->data);
+
   g_clear_object (&self->extension);
   g_clear_object (&self->highlighter);
   g_clear_object (&self->settings);
@@ -982,9 +1288,7 @@ ide_highlight_engine_rebuild (IdeHighlightEngine *self)
       GtkTextIter end;
 
       gtk_text_buffer_get_bounds (buffer, &begin, &end);
-      gtk_text_buffer_move_mark (buffer, self->invalid_begin, &begin);
-      gtk_text_buffer_move_mark (buffer, self->invalid_end, &end);
-      ide_highlight_engine_queue_work (self);
+      ide_highlight_engine_add_invalid (self, &begin, &end);
     }
 
   IDE_EXIT;
@@ -1011,10 +1315,6 @@ ide_highlight_engine_invalidate (IdeHighlightEngine *self,
                                  const GtkTextIter  *begin,
                                  const GtkTextIter  *end)
 {
-  GtkTextBuffer *buffer;
-  GtkTextIter mark_begin;
-  GtkTextIter mark_end;
-
   IDE_ENTRY;
 
   g_return_if_fail (IDE_IS_HIGHLIGHT_ENGINE (self));
@@ -1023,25 +1323,7 @@ ide_highlight_engine_invalidate (IdeHighlightEngine *self,
   g_return_if_fail (gtk_text_iter_get_buffer (begin) == GTK_TEXT_BUFFER (self->buffer));
   g_return_if_fail (gtk_text_iter_get_buffer (end) == GTK_TEXT_BUFFER (self->buffer));
 
-  buffer = GTK_TEXT_BUFFER (self->buffer);
-
-  gtk_text_buffer_get_iter_at_mark (buffer, &mark_begin, self->invalid_begin);
-  gtk_text_buffer_get_iter_at_mark (buffer, &mark_end, self->invalid_end);
-
-  if (gtk_text_iter_equal (&mark_begin, &mark_end))
-    {
-      gtk_text_buffer_move_mark (buffer, self->invalid_begin, begin);
-      gtk_text_buffer_move_mark (buffer, self->invalid_end, end);
-    }
-  else
-    {
-      if (gtk_text_iter_compare (begin, &mark_begin) < 0)
-        gtk_text_buffer_move_mark (buffer, self->invalid_begin, begin);
-      if (gtk_text_iter_compare (end, &mark_end) > 0)
-        gtk_text_buffer_move_mark (buffer, self->invalid_end, end);
-    }
-
-  ide_highlight_engine_queue_work (self);
+  ide_highlight_engine_add_invalid (self, begin, end);
 
   IDE_EXIT;
 }
@@ -1061,3 +1343,42 @@ ide_highlight_engine_get_style (IdeHighlightEngine *self,
 {
   return get_tag_from_style (self, style_name, FALSE);
 }
+
+static void
+ide_highlight_engine_view_finalized (gpointer  data,
+                                     GObject  *where_the_object_was)
+{
+  IdeHighlightEngine *self = data;
+
+  g_assert (IDE_IS_HIGHLIGHT_ENGINE (self));
+
+  self->views = g_slist_remove (self->views, where_the_object_was);
+}
+
+void
+_ide_highlight_engine_add_view (IdeHighlightEngine *self,
+                                GtkTextView        *view)
+{
+  g_return_if_fail (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_return_if_fail (GTK_IS_TEXT_VIEW (view));
+
+  if (g_slist_find (self->views, view) != NULL)
+    return;
+
+  self->views = g_slist_prepend (self->views, view);
+  g_object_weak_ref (G_OBJECT (view), ide_highlight_engine_view_finalized, self);
+}
+
+void
+_ide_highlight_engine_remove_view (IdeHighlightEngine *self,
+                                   GtkTextView        *view)
+{
+  g_return_if_fail (IDE_IS_HIGHLIGHT_ENGINE (self));
+  g_return_if_fail (GTK_IS_TEXT_VIEW (view));
+
+  if (g_slist_find (self->views, view) == NULL)
+    return;
+
+  self->views = g_slist_remove (self->views, view);
+  g_object_weak_unref (G_OBJECT (view), ide_highlight_engine_view_finalized, self);
+}
@@ -92,3 +92,291 @@ ide_highlighter_load (IdeHighlighter *self)
   if (IDE_HIGHLIGHTER_GET_IFACE (self)->load)
     IDE_HIGHLIGHTER_GET_IFACE (self)->load (self);
 }
+
+/**
+ * ide_highlighter_compute_spans:
+ * @self: A #IdeHighlighter.
+ * @text: The text to highlight.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @error: A location for a #GError or %NULL.
+ *
+ * Computes the styled spans for @text. This is called from a thread by the
+ * highlight engine when the highlighter implements the vfunc, so it must not
+ * access the #IdeBuffer.
+ *
+ * Returns: (transfer full) (element-type Ide.HighlightSpan): A #GArray of
+ *   #IdeHighlightSpan or %NULL and @error is set.
+ */
+GArray *
+ide_highlighter_compute_spans (IdeHighlighter  *self,
+                               const gchar     *text,
+                               GCancellable    *cancellable,
+                               GError         **error)
+{
+  g_return_val_if_fail (IDE_IS_HIGHLIGHTER (self), NULL);
+  g_return_val_if_fail (text != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  if (IDE_HIGHLIGHTER_GET_IFACE (self)->compute_spans == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "%s does not support computing spans",
+                   G_OBJECT_TYPE_NAME (self));
+      return NULL;
+    }
+
+  return IDE_HIGHLIGHTER_GET_IFACE (self)->compute_spans (self, text, cancellable, error);
+}
+
+static const gchar *skip_classes[] = { "string", "path", "comment" };
+
+/*
+ * Tracks whether the scanner is within one of @skip_classes. Rather than
+ * querying the buffer for every word, we only query again once we have
+ * passed the next toggle of the context class.
+ */
+typedef struct
+{
+  gint     next_toggle;
+  gboolean inside;
+} ContextClassState;
+
+static gboolean
+in_skipped_context (GtkSourceBuffer   *buffer,
+                    ContextClassState *states,
+                    const GtkTextIter *iter)
+{
+  gint offset = gtk_text_iter_get_offset (iter);
+  gboolean ret = FALSE;
+
+  for (guint i = 0; i < G_N_ELEMENTS (skip_classes); i++)
+    {
+      if (offset >= states[i].next_toggle)
+        {
+          GtkTextIter toggle = *iter;
+
+          states[i].inside = gtk_source_buffer_iter_has_context_class (buffer, iter, skip_classes[i]);
+
+          if (gtk_source_buffer_iter_forward_to_context_class_toggle (buffer, &toggle, skip_classes[i]))
+            states[i].next_toggle = gtk_text_iter_get_offset (&toggle);
+          else
+            states[i].next_toggle = G_MAXINT;
+        }
+
+      ret |= states[i].inside;
+    }
+
+  return ret;
+}
+
+static inline gboolean
+is_word_char (const gchar  *str,
+              const gchar **next)
+{
+  gunichar ch;
+
+  if ((guchar)*str < 0x80)
+    {
+      *next = str + 1;
+      return *str == '_' || g_ascii_isalnum (*str);
+    }
+
+  ch = g_utf8_get_char (str);
+  *next = g_utf8_next_char (str);
+
+  return g_unichar_isalnum (ch);
+}
+
+/**
+ * ide_highlighter_scan_words:
+ * @self: An #IdeHighlighter.
+ * @callback: (scope call): A callback to apply a given style.
+ * @range_begin: The beginning of the range to update.
+ * @range_end: The end of the range to update.
+ * @location: (out): How far the scan got in the update.
+ * @lookup: (scope call): A function to get the style for a word.
+ * @user_data: Closure data for @lookup.
+ *
+ * This is a helper for highlighters that style words found in an index,
+ * suitable for calling from IdeHighlighter::update.
+ *
+ * The range is copied once and scanned in place, so words are not copied
+ * before calling @lookup. Words within strings, paths, and comments are
+ * skipped.
+ */
+void
+ide_highlighter_scan_words (IdeHighlighter         *self,
+                            IdeHighlightCallback    callback,
+                            const GtkTextIter      *range_begin,
+                            const GtkTextIter      *range_end,
+                            GtkTextIter            *location,
+                            IdeHighlightWordLookup  lookup,
+                            gpointer                user_data)
+{
+  ContextClassState states[G_N_ELEMENTS (skip_classes)] = {{ 0 }};
+  GtkSourceBuffer *buffer;
+  g_autofree gchar *text = NULL;
+  GtkTextIter iter;
+  const gchar *str;
+  gint iter_offset = 0;
+  gint offset = 0;
+
+  g_return_if_fail (IDE_IS_HIGHLIGHTER (self));
+  g_return_if_fail (callback != NULL);
+  g_return_if_fail (range_begin != NULL);
+  g_return_if_fail (range_end != NULL);
+  g_return_if_fail (location != NULL);
+  g_return_if_fail (lookup != NULL);
+
+  *location = *range_begin;
+
+  buffer = GTK_SOURCE_BUFFER (gtk_text_iter_get_buffer (range_begin));
+
+  /* Slices keep a placeholder for child anchors, so offsets still match */
+  text = gtk_text_iter_get_slice (range_begin, range_end);
+  iter = *range_begin;
+  str = text;
+
+  while (*str != '\0')
+    {
+      const gchar *next;
+      const gchar *word;
+      const gchar *style_name;
+      GtkTextIter begin;
+      GtkTextIter end;
+      gint word_offset;
+      gchar saved;
+
+      if (!is_word_char (str, &next))
+        {
+          str = next;
+          offset++;
+          continue;
+        }
+
+      word = str;
+      word_offset = offset;
+
+      do
+        {
+          str = next;
+          offset++;
+        }
+      while (*str != '\0' && is_word_char (str, &next));
+
+      gtk_text_iter_forward_chars (&iter, word_offset - iter_offset);
+      iter_offset = word_offset;
+      begin = iter;
+
+      if (in_skipped_context (buffer, states, &begin))
+        continue;
+
+      /* Terminate the word in place rather than copying it */
+      saved = *str;
+      *(gchar *)str = '\0';
+      style_name = lookup (self, word, user_data);
+      *(gchar *)str = saved;
+
+      if (style_name == NULL)
+        continue;
+
+      end = begin;
+      gtk_text_iter_forward_chars (&end, offset - word_offset);
+
+      if (callback (&begin, &end, style_name) == IDE_HIGHLIGHT_STOP)
+        {
+          *location = end;
+          return;
+        }
+    }
+
+  *location = *range_end;
+}
+
+/**
+ * ide_highlighter_scan_text_words:
+ * @self: An #IdeHighlighter.
+ * @text: The text to scan.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @lookup: (scope call): A function to get the style for a word.
+ * @user_data: Closure data for @lookup.
+ * @error: A location for a #GError or %NULL.
+ *
+ * This is the counterpart of ide_highlighter_scan_words() for highlighters
+ * implementing IdeHighlighter::compute_spans, and may be called from a
+ * thread. @lookup is called from the same thread.
+ *
+ * Since there is no buffer to check, words within strings, paths, and
+ * comments are returned as well and left to the #IdeHighlightEngine.
+ *
+ * Returns: (transfer full) (element-type Ide.HighlightSpan): A #GArray of
+ *   #IdeHighlightSpan or %NULL if @cancellable was cancelled.
+ */
+GArray *
+ide_highlighter_scan_text_words (IdeHighlighter          *self,
+                                 const gchar             *text,
+                                 GCancellable            *cancellable,
+                                 IdeHighlightWordLookup   lookup,
+                                 gpointer                 user_data,
+                                 GError                 **error)
+{
+  g_autoptr(GArray) spans = NULL;
+  g_autofree gchar *copy = NULL;
+  gchar *str;
+  guint offset = 0;
+  guint n_words = 0;
+
+  g_return_val_if_fail (IDE_IS_HIGHLIGHTER (self), NULL);
+  g_return_val_if_fail (text != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (lookup != NULL, NULL);
+
+  spans = g_array_new (FALSE, FALSE, sizeof (IdeHighlightSpan));
+
+  /* Copied so that words can be terminated in place */
+  str = copy = g_strdup (text);
+
+  while (*str != '\0')
+    {
+      IdeHighlightSpan span;
+      const gchar *next;
+      gchar *word;
+      gchar saved;
+
+      if (!is_word_char (str, &next))
+        {
+          str = (gchar *)next;
+          offset++;
+          continue;
+        }
+
+      if ((++n_words % 1000) == 0 &&
+          g_cancellable_set_error_if_cancelled (cancellable, error))
+        return NULL;
+
+      word = str;
+      span.begin = offset;
+
+      do
+        {
+          str = (gchar *)next;
+          offset++;
+        }
+      while (*str != '\0' && is_word_char (str, &next));
+
+      saved = *str;
+      *str = '\0';
+      span.style_name = lookup (self, word, user_data);
+      *str = saved;
+
+      if (span.style_name == NULL)
+        continue;
+
+      span.end = offset;
+      g_array_append_val (spans, span);
+    }
+
+  return g_steal_pointer (&spans);
+}
@@ -39,10 +39,38 @@ typedef enum
   IDE_HIGHLIGHT_CONTINUE,
 } IdeHighlightResult;
 
+/**
+ * IdeHighlightSpan:
+ * @begin: the character offset where the span begins, relative to the text
+ * @end: the character offset where the span ends, relative to the text
+ * @style_name: an interned string containing the style to apply
+ *
+ * A span of text to be styled, as computed by
+ * ide_highlighter_compute_spans().
+ */
+typedef struct
+{
+  guint        begin;
+  guint        end;
+  const gchar *style_name;
+} IdeHighlightSpan;
+
 typedef IdeHighlightResult (*IdeHighlightCallback) (const GtkTextIter *begin,
                                                     const GtkTextIter *end,
                                                     const gchar       *style_name);
 
+/**
+ * IdeHighlightWordLookup:
+ * @self: An #IdeHighlighter.
+ * @word: A nul-terminated word. It is only valid for the duration of the call.
+ * @user_data: Closure data.
+ *
+ * Returns: (nullable): The style name to apply to @word, or %NULL.
+ */
+typedef const gchar *(*IdeHighlightWordLookup) (IdeHighlighter *self,
+                                                const gchar    *word,
+                                                gpointer        user_data);
+
 struct _IdeHighlighterInterface
 {
   GTypeInterface parent_interface;
@@ -70,14 +98,50 @@ struct _IdeHighlighterInterface
                       IdeHighlightEngine   *engine);
 
   void (*load)       (IdeHighlighter       *self);
+
+  /**
+   * IdeHighlighter::compute_spans:
+   *
+   * If implemented, the #IdeHighlightEngine will call this from a thread
+   * with a copy of the text to be highlighted instead of calling
+   * IdeHighlighter::update on the main thread. Implementations must not
+   * touch the buffer and should check @cancellable periodically.
+   *
+   * Spans beginning within strings, paths, or comments are not applied.
+   * If this fails, the engine uses IdeHighlighter::update instead.
+   *
+   * Returns: (transfer full): a #GArray of #IdeHighlightSpan or %NULL
+   *   and @error is set.
+   */
+  GArray *(*compute_spans) (IdeHighlighter  *self,
+                            const gchar     *text,
+                            GCancellable    *cancellable,
+                            GError         **error);
 };
 
-void ide_highlighter_load   (IdeHighlighter       *self);
-void ide_highlighter_update (IdeHighlighter       *self,
-                             IdeHighlightCallback  callback,
-                             const GtkTextIter    *range_begin,
-                             const GtkTextIter    *range_end,
-                             GtkTextIter          *location);
+void    ide_highlighter_load            (IdeHighlighter          *self);
+void    ide_highlighter_update          (IdeHighlighter          *self,
+                                         IdeHighlightCallback     callback,
+                                         const GtkTextIter       *range_begin,
+                                         const GtkTextIter       *range_end,
+                                         GtkTextIter             *location);
+GArray *ide_highlighter_compute_spans   (IdeHighlighter          *self,
+                                         const gchar             *text,
+                                         GCancellable            *cancellable,
+                                         GError                 **error);
+void    ide_highlighter_scan_words      (IdeHighlighter          *self,
+                                         IdeHighlightCallback     callback,
+                                         const GtkTextIter       *range_begin,
+                                         const GtkTextIter       *range_end,
+                                         GtkTextIter             *location,
+                                         IdeHighlightWordLookup   lookup,
+                                         gpointer                 user_data);
+GArray *ide_highlighter_scan_text_words (IdeHighlighter          *self,
+                                         const gchar             *text,
+                                         GCancellable            *cancellable,
+                                         IdeHighlightWordLookup   lookup,
+                                         gpointer                 user_data,
+                                         GError                 **error);
 
 G_END_DECLS
 
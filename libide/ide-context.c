@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "ide-context"
 
+#include <egg-counter.h>
 #include <glib/gi18n.h>
 #include <libpeas/peas.h>
 
@@ -58,6 +59,23 @@
 
 #define RESTORE_FILES_MAX_FILES 20
 
+EGG_DEFINE_COUNTER (InitEarlyDiscovery, "IdeContext", "Early Discovery", "Microseconds spent in early build system discovery")
+EGG_DEFINE_COUNTER (InitBuildSystem, "IdeContext", "Build System", "Microseconds spent loading the build system")
+EGG_DEFINE_COUNTER (InitVcs, "IdeContext", "VCS", "Microseconds spent loading the VCS")
+EGG_DEFINE_COUNTER (InitServices, "IdeContext", "Services", "Microseconds spent starting services")
+EGG_DEFINE_COUNTER (InitProjectName, "IdeContext", "Project Name", "Microseconds spent loading the project name")
+EGG_DEFINE_COUNTER (InitBackForwardList, "IdeContext", "Back Forward List", "Microseconds spent loading the back-forward list")
+EGG_DEFINE_COUNTER (InitSnippets, "IdeContext", "Snippets", "Microseconds spent loading snippets")
+EGG_DEFINE_COUNTER (InitUnsavedFiles, "IdeContext", "Unsaved Files", "Microseconds spent restoring unsaved files")
+EGG_DEFINE_COUNTER (InitAddRecent, "IdeContext", "Add Recent", "Microseconds spent registering the recent project")
+EGG_DEFINE_COUNTER (InitSearchEngine, "IdeContext", "Search Engine", "Microseconds spent creating the search engine")
+EGG_DEFINE_COUNTER (InitRuntimes, "IdeContext", "Runtimes", "Microseconds spent loading runtimes")
+EGG_DEFINE_COUNTER (InitConfigurationManager, "IdeContext", "Configuration Manager", "Microseconds spent loading configurations")
+EGG_DEFINE_COUNTER (InitBuildManager, "IdeContext", "Build Manager", "Microseconds spent initializing the build manager")
+EGG_DEFINE_COUNTER (InitDiagnosticsManager, "IdeContext", "Diagnostics Manager", "Microseconds spent initializing the diagnostics manager")
+EGG_DEFINE_COUNTER (InitLoaded, "IdeContext", "Loaded", "Microseconds spent in handlers of the loaded signal")
+EGG_DEFINE_COUNTER (InitTotal, "IdeContext", "Total", "Microseconds spent initializing contexts")
+
 struct _IdeContext
 {
   GObject                   parent_instance;
@@ -1630,6 +1648,241 @@ ide_context_init_early_discovery (gpointer             source_object,
   g_task_run_in_thread (task, ide_context_init_early_discovery_worker);
 }
 
+typedef enum
+{
+  INIT_EARLY_DISCOVERY,
+  INIT_BUILD_SYSTEM,
+  INIT_VCS,
+  INIT_SERVICES,
+  INIT_PROJECT_NAME,
+  INIT_BACK_FORWARD_LIST,
+  INIT_SNIPPETS,
+  INIT_UNSAVED_FILES,
+  INIT_ADD_RECENT,
+  INIT_SEARCH_ENGINE,
+  INIT_RUNTIMES,
+  INIT_CONFIGURATION_MANAGER,
+  INIT_BUILD_MANAGER,
+  INIT_DIAGNOSTICS_MANAGER,
+  INIT_LOADED,
+  N_INIT_PHASES
+} InitPhaseId;
+
+#define AFTER(phase)    (1U << (phase))
+#define ALL_INIT_PHASES ((1U << N_INIT_PHASES) - 1)
+
+typedef struct
+{
+  const gchar  *name;
+  IdeAsyncStep  step;
+  EggCounter   *counter;
+  /* Mask of the phases that must complete before this phase may start */
+  guint         requires;
+} InitPhase;
+
+/*
+ * Context initialization is a dependency graph rather than a sequence, so
+ * that phases which do not depend on each other can overlap. Most phases
+ * complete asynchronously (from threads or I/O), so this shortens the time
+ * it takes to open a project considerably.
+ *
+ * The build system may change the project file, which everything that
+ * looks at the project tree needs to wait for. Anything named after the
+ * project needs to wait for the project name.
+ */
+static const InitPhase init_phases [N_INIT_PHASES] = {
+  [INIT_EARLY_DISCOVERY] = {
+    "early-discovery", ide_context_init_early_discovery, &InitEarlyDiscovery_ctr,
+    0 },
+  [INIT_BUILD_SYSTEM] = {
+    "build-system", ide_context_init_build_system, &InitBuildSystem_ctr,
+    AFTER (INIT_EARLY_DISCOVERY) },
+  [INIT_VCS] = {
+    "vcs", ide_context_init_vcs, &InitVcs_ctr,
+    AFTER (INIT_BUILD_SYSTEM) },
+  [INIT_SERVICES] = {
+    "services", ide_context_init_services, &InitServices_ctr,
+    AFTER (INIT_BUILD_SYSTEM) | AFTER (INIT_VCS) },
+  [INIT_PROJECT_NAME] = {
+    "project-name", ide_context_init_project_name, &InitProjectName_ctr,
+    AFTER (INIT_BUILD_SYSTEM) },
+  [INIT_BACK_FORWARD_LIST] = {
+    "back-forward-list", ide_context_init_back_forward_list, &InitBackForwardList_ctr,
+    AFTER (INIT_PROJECT_NAME) },
+  [INIT_SNIPPETS] = {
+    "snippets", ide_context_init_snippets, &InitSnippets_ctr,
+    0 },
+  [INIT_UNSAVED_FILES] = {
+    "unsaved-files", ide_context_init_unsaved_files, &InitUnsavedFiles_ctr,
+    AFTER (INIT_PROJECT_NAME) },
+  [INIT_ADD_RECENT] = {
+    "add-recent", ide_context_init_add_recent, &InitAddRecent_ctr,
+    AFTER (INIT_PROJECT_NAME) },
+  [INIT_SEARCH_ENGINE] = {
+    "search-engine", ide_context_init_search_engine, &InitSearchEngine_ctr,
+    AFTER (INIT_SERVICES) },
+  [INIT_RUNTIMES] = {
+    "runtimes", ide_context_init_runtimes, &InitRuntimes_ctr,
+    AFTER (INIT_BUILD_SYSTEM) | AFTER (INIT_VCS) },
+  [INIT_CONFIGURATION_MANAGER] = {
+    "configuration-manager", ide_context_init_configuration_manager, &InitConfigurationManager_ctr,
+    AFTER (INIT_VCS) | AFTER (INIT_RUNTIMES) },
+  [INIT_BUILD_MANAGER] = {
+    "build-manager", ide_context_init_build_manager, &InitBuildManager_ctr,
+    AFTER (INIT_SERVICES) | AFTER (INIT_CONFIGURATION_MANAGER) },
+  [INIT_DIAGNOSTICS_MANAGER] = {
+    "diagnostics-manager", ide_context_init_diagnostics_manager, &InitDiagnosticsManager_ctr,
+    AFTER (INIT_SERVICES) | AFTER (INIT_UNSAVED_FILES) | AFTER (INIT_BUILD_MANAGER) },
+  [INIT_LOADED] = {
+    "loaded", ide_context_init_loaded, &InitLoaded_ctr,
+    ALL_INIT_PHASES & ~AFTER (INIT_LOADED) },
+};
+
+typedef struct
+{
+  guint   started;
+  guint   completed;
+  guint   n_active;
+  gint64  begin_time;
+  gint64  phase_begin_time [N_INIT_PHASES];
+  gint64  phase_elapsed [N_INIT_PHASES];
+  GError *error;
+  guint   failed : 1;
+} InitState;
+
+typedef struct
+{
+  GTask       *task;
+  InitPhaseId  phase;
+} InitPhaseClosure;
+
+static void
+init_state_free (gpointer data)
+{
+  InitState *state = data;
+
+  g_clear_error (&state->error);
+  g_slice_free (InitState, state);
+}
+
+static void
+ide_context_init_log_timings (IdeContext *self,
+                              InitState  *state)
+{
+  g_autoptr(GString) str = NULL;
+  gint64 total;
+
+  g_assert (IDE_IS_CONTEXT (self));
+  g_assert (state != NULL);
+
+  total = g_get_monotonic_time () - state->begin_time;
+  egg_counter_add (&InitTotal_ctr, total);
+
+  str = g_string_new (NULL);
+  g_string_append_printf (str, "Context initialized in %.3lf msec:", total / 1000.0);
+
+  for (guint i = 0; i < N_INIT_PHASES; i++)
+    g_string_append_printf (str, " %s=%.3lf",
+                            init_phases [i].name,
+                            state->phase_elapsed [i] / 1000.0);
+
+  g_debug ("%s", str->str);
+}
+
+static void ide_context_init_schedule (GTask *task);
+
+static void
+ide_context_init_phase_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  InitPhaseClosure *closure = user_data;
+  g_autoptr(GTask) task = closure->task;
+  InitPhaseId phase = closure->phase;
+  GError *error = NULL;
+  InitState *state;
+
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  g_slice_free (InitPhaseClosure, closure);
+
+  state = g_task_get_task_data (task);
+
+  state->n_active--;
+  state->completed |= AFTER (phase);
+  state->phase_elapsed [phase] = g_get_monotonic_time () - state->phase_begin_time [phase];
+  egg_counter_add (init_phases [phase].counter, state->phase_elapsed [phase]);
+
+  /* Stop starting new phases after the first failure */
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_debug ("Context phase \"%s\" failed: %s", init_phases [phase].name, error->message);
+
+      if (!state->failed)
+        state->error = error;
+      else
+        g_error_free (error);
+
+      state->failed = TRUE;
+    }
+
+  ide_context_init_schedule (task);
+}
+
+static void
+ide_context_init_schedule (GTask *task)
+{
+  IdeContext *self;
+  InitState *state;
+
+  g_assert (G_IS_TASK (task));
+
+  self = g_task_get_source_object (task);
+  state = g_task_get_task_data (task);
+
+  if (state->failed)
+    {
+      /* Wait for phases in flight so they don't outlive the task */
+      if (state->n_active == 0 && state->error != NULL)
+        g_task_return_error (task, g_steal_pointer (&state->error));
+      return;
+    }
+
+  if (state->completed == ALL_INIT_PHASES)
+    {
+      ide_context_init_log_timings (self, state);
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  for (guint i = 0; i < N_INIT_PHASES; i++)
+    {
+      const InitPhase *phase = &init_phases [i];
+      InitPhaseClosure *closure;
+
+      /* Earlier phases may have completed synchronously, check again */
+      if (state->failed || (state->started & AFTER (i)) != 0)
+        continue;
+
+      if ((phase->requires & state->completed) != phase->requires)
+        continue;
+
+      state->started |= AFTER (i);
+      state->n_active++;
+      state->phase_begin_time [i] = g_get_monotonic_time ();
+
+      closure = g_slice_new0 (InitPhaseClosure);
+      closure->task = g_object_ref (task);
+      closure->phase = i;
+
+      phase->step (self,
+                   g_task_get_cancellable (task),
+                   ide_context_init_phase_cb,
+                   closure);
+    }
+}
+
 static void
 ide_context_init_async (GAsyncInitable      *initable,
                         int                  io_priority,
@@ -1638,30 +1891,21 @@ ide_context_init_async (GAsyncInitable      *initable,
                         gpointer             user_data)
 {
   IdeContext *context = (IdeContext *)initable;
+  g_autoptr(GTask) task = NULL;
+  InitState *state;
 
   g_return_if_fail (G_IS_ASYNC_INITABLE (context));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  ide_async_helper_run (context,
-                        cancellable,
-                        callback,
-                        user_data,
-                        ide_context_init_early_discovery,
-                        ide_context_init_build_system,
-                        ide_context_init_vcs,
-                        ide_context_init_services,
-                        ide_context_init_project_name,
-                        ide_context_init_back_forward_list,
-                        ide_context_init_snippets,
-                        ide_context_init_unsaved_files,
-                        ide_context_init_add_recent,
-                        ide_context_init_search_engine,
-                        ide_context_init_runtimes,
-                        ide_context_init_configuration_manager,
-                        ide_context_init_build_manager,
-                        ide_context_init_diagnostics_manager,
-                        ide_context_init_loaded,
-                        NULL);
+  state = g_slice_new0 (InitState);
+  state->begin_time = g_get_monotonic_time ();
+
+  task = g_task_new (context, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_context_init_async);
+  g_task_set_priority (task, io_priority);
+  g_task_set_task_data (task, state, init_state_free);
+
+  ide_context_init_schedule (task);
 }
 
 static gboolean
@@ -38,12 +38,16 @@ void                _ide_battery_monitor_shutdown           (void);
 void                _ide_buffer_set_changed_on_volume       (IdeBuffer             *self,
                                                              gboolean               changed_on_volume);
 gboolean            _ide_buffer_get_loading                 (IdeBuffer             *self);
+IdeHighlightEngine *_ide_buffer_get_highlight_engine        (IdeBuffer             *self);
 void                _ide_buffer_set_loading                 (IdeBuffer             *self,
                                                              gboolean               loading);
 void                _ide_buffer_set_mtime                   (IdeBuffer             *self,
                                                              const GTimeVal        *mtime);
 void                _ide_buffer_set_read_only               (IdeBuffer             *buffer,
                                                              gboolean               read_only);
+void                _ide_buffer_queue_modify_check          (IdeBuffer             *self);
+void                _ide_buffer_manager_monitor_buffer      (IdeBufferManager      *self,
+                                                             IdeBuffer             *buffer);
 void                _ide_buffer_manager_reclaim             (IdeBufferManager      *self,
                                                              IdeBuffer             *buffer);
 void                _ide_build_system_set_project_file      (IdeBuildSystem        *self,
@@ -88,6 +92,10 @@ IdeUnsavedFile     *_ide_unsaved_file_new                   (GFile
                                                              gint64                 sequence);
 void                _ide_highlighter_set_highlighter_engine (IdeHighlighter        *highlighter,
                                                              IdeHighlightEngine    *highlight_engine);
+void                _ide_highlight_engine_add_view          (IdeHighlightEngine    *self,
+                                                             GtkTextView           *view);
+void                _ide_highlight_engine_remove_view       (IdeHighlightEngine    *self,
+                                                             GtkTextView           *view);
 const gchar        *_ide_source_view_get_mode_name          (IdeSourceView         *self);
 
 G_END_DECLS
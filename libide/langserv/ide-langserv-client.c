@@ -44,8 +44,28 @@ typedef struct
   GIOStream      *io_stream;
   GHashTable     *diagnostics_by_file;
   GPtrArray      *languages;
+  GHashTable     *pending_changes;
+  guint           flush_changes_source;
 } IdeLangservClientPrivate;
 
+/*
+ * Content changes are accumulated per-buffer and sent as a single
+ * textDocument/didChange notification, rather than one notification per
+ * insert-text or delete-range signal.
+ */
+typedef struct
+{
+  IdeBuffer *buffer;
+  GPtrArray *changes;
+  guint      full_sync : 1;
+} PendingChanges;
+
+/* How long we coalesce changes before notifying the peer */
+#define FLUSH_CHANGES_DELAY_MSEC 50
+
+/* After this many changes, sending the whole document is cheaper */
+#define MAX_PENDING_CHANGES 64
+
 G_DEFINE_TYPE_WITH_PRIVATE (IdeLangservClient, ide_langserv_client, IDE_TYPE_OBJECT)
 
 enum {
@@ -77,6 +97,203 @@ enum {
 static GParamSpec *properties [N_PROPS];
 static guint signals [N_SIGNALS];
 
+static void
+pending_changes_free (gpointer data)
+{
+  PendingChanges *pending = data;
+
+  g_clear_object (&pending->buffer);
+  g_clear_pointer (&pending->changes, g_ptr_array_unref);
+  g_slice_free (PendingChanges, pending);
+}
+
+static GVariant *
+pending_changes_build_params (PendingChanges *pending)
+{
+  g_autoptr(GVariant) text_document = NULL;
+  g_autofree gchar *uri = NULL;
+  GVariantBuilder builder;
+  GVariantBuilder changes;
+  gint64 version;
+
+  g_assert (pending != NULL);
+  g_assert (IDE_IS_BUFFER (pending->buffer));
+
+  uri = ide_buffer_get_uri (pending->buffer);
+  version = (gint64)ide_buffer_get_change_count (pending->buffer);
+
+  text_document = JSONRPC_MESSAGE_NEW (
+    "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
+    "version", JSONRPC_MESSAGE_PUT_INT64 (version)
+  );
+
+  g_variant_builder_init (&changes, G_VARIANT_TYPE ("av"));
+
+  if (pending->full_sync)
+    {
+      g_autoptr(GBytes) content = ide_buffer_get_content (pending->buffer);
+      /* The content is always followed by a \0, so avoid another copy */
+      const gchar *text = g_bytes_get_data (content, NULL);
+      GVariant *change;
+
+      change = JSONRPC_MESSAGE_NEW (
+        "text", JSONRPC_MESSAGE_PUT_STRING (text)
+      );
+
+      g_variant_builder_add (&changes, "v", change);
+    }
+  else
+    {
+      for (guint i = 0; i < pending->changes->len; i++)
+        g_variant_builder_add (&changes, "v", g_ptr_array_index (pending->changes, i));
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "textDocument", text_document);
+  g_variant_builder_add (&builder, "{sv}", "contentChanges", g_variant_builder_end (&changes));
+
+  return g_variant_builder_end (&builder);
+}
+
+static void
+ide_langserv_client_flush_pending (IdeLangservClient *self,
+                                   PendingChanges    *pending)
+{
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
+  GVariant *params;
+
+  g_assert (IDE_IS_LANGSERV_CLIENT (self));
+  g_assert (pending != NULL);
+
+  if (priv->rpc_client == NULL)
+    return;
+
+  if (!pending->full_sync && pending->changes->len == 0)
+    return;
+
+  params = pending_changes_build_params (pending);
+
+  jsonrpc_client_send_notification_async (priv->rpc_client,
+                                          "textDocument/didChange",
+                                          params,
+                                          NULL, NULL, NULL);
+}
+
+/*
+ * Sends any queued content changes to the peer. This must be done before
+ * anything that relies on the peer having an up to date view of the
+ * documents, such as requests for completion or hover.
+ */
+static void
+ide_langserv_client_flush_changes (IdeLangservClient *self,
+                                   IdeBuffer         *buffer)
+{
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
+  g_autoptr(GPtrArray) flush = NULL;
+  GHashTableIter iter;
+  PendingChanges *pending;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_LANGSERV_CLIENT (self));
+  g_assert (!buffer || IDE_IS_BUFFER (buffer));
+
+  flush = g_ptr_array_new_with_free_func (pending_changes_free);
+
+  /* Steal everything first so that we are safe against reentrancy */
+  if (buffer != NULL)
+    {
+      if ((pending = g_hash_table_lookup (priv->pending_changes, buffer)))
+        {
+          g_hash_table_steal (priv->pending_changes, buffer);
+          g_ptr_array_add (flush, pending);
+        }
+    }
+  else
+    {
+      g_hash_table_iter_init (&iter, priv->pending_changes);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&pending))
+        {
+          g_hash_table_iter_steal (&iter);
+          g_ptr_array_add (flush, pending);
+        }
+    }
+
+  if (g_hash_table_size (priv->pending_changes) == 0 && priv->flush_changes_source != 0)
+    {
+      g_source_remove (priv->flush_changes_source);
+      priv->flush_changes_source = 0;
+    }
+
+  for (guint i = 0; i < flush->len; i++)
+    ide_langserv_client_flush_pending (self, g_ptr_array_index (flush, i));
+
+  IDE_EXIT;
+}
+
+static gboolean
+ide_langserv_client_flush_changes_cb (gpointer user_data)
+{
+  IdeLangservClient *self = user_data;
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
+
+  g_assert (IDE_IS_LANGSERV_CLIENT (self));
+
+  priv->flush_changes_source = 0;
+
+  ide_langserv_client_flush_changes (self, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_langserv_client_queue_change (IdeLangservClient *self,
+                                  IdeBuffer         *buffer,
+                                  GVariant          *change)
+{
+  IdeLangservClientPrivate *priv = ide_langserv_client_get_instance_private (self);
+  PendingChanges *pending;
+
+  g_assert (IDE_IS_LANGSERV_CLIENT (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (change != NULL);
+
+  g_variant_ref_sink (change);
+
+  if (!(pending = g_hash_table_lookup (priv->pending_changes, buffer)))
+    {
+      pending = g_slice_new0 (PendingChanges);
+      pending->buffer = g_object_ref (buffer);
+      pending->changes = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+      g_hash_table_insert (priv->pending_changes, buffer, pending);
+    }
+
+  /*
+   * Once we are going to send the whole document there is no need to
+   * track the individual edits any longer.
+   */
+  if (!pending->full_sync)
+    {
+      g_ptr_array_add (pending->changes, g_variant_ref (change));
+
+      if (pending->changes->len > MAX_PENDING_CHANGES)
+        {
+          pending->full_sync = TRUE;
+          g_ptr_array_set_size (pending->changes, 0);
+        }
+    }
+
+  g_variant_unref (change);
+
+  if (priv->flush_changes_source == 0)
+    priv->flush_changes_source =
+      g_timeout_add_full (G_PRIORITY_LOW,
+                          FLUSH_CHANGES_DELAY_MSEC,
+                          ide_langserv_client_flush_changes_cb,
+                          self,
+                          NULL);
+}
+
 static gboolean
 ide_langserv_client_supports_buffer (IdeLangservClient *self,
                                      IdeBuffer         *buffer)
@@ -134,6 +351,8 @@ ide_langserv_client_buffer_saved (IdeLangservClient *self,
   if (!ide_langserv_client_supports_buffer (self, buffer))
     IDE_EXIT;
 
+  ide_langserv_client_flush_changes (self, buffer);
+
   uri = ide_buffer_get_uri (buffer);
 
   params = JSONRPC_MESSAGE_NEW (
@@ -149,11 +368,6 @@ ide_langserv_client_buffer_saved (IdeLangservClient *self,
   IDE_EXIT;
 }
 
-/*
- * TODO: This should all be delayed and buffered so we coalesce multiple
- *       events into a single dispatch.
- */
-
 static void
 ide_langserv_client_buffer_insert_text (IdeLangservClient *self,
                                         GtkTextIter       *location,
@@ -161,12 +375,10 @@ ide_langserv_client_buffer_insert_text (IdeLangservClient *self,
                                         gint               len,
                                         IdeBuffer         *buffer)
 {
-  g_autoptr(GVariant) params = NULL;
-  g_autofree gchar *uri = NULL;
   g_autofree gchar *copy = NULL;
+  GVariant *change;
   gint line;
   gint column;
-  gint version;
 
   IDE_ENTRY;
 
@@ -176,37 +388,25 @@ ide_langserv_client_buffer_insert_text (IdeLangservClient *self,
 
   copy = g_strndup (new_text, len);
 
-  uri = ide_buffer_get_uri (buffer);
-  version = (gint)ide_buffer_get_change_count (buffer);
-
   line = gtk_text_iter_get_line (location);
   column = gtk_text_iter_get_line_offset (location);
 
-  params = JSONRPC_MESSAGE_NEW (
-    "textDocument", "{",
-      "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
-      "version", JSONRPC_MESSAGE_PUT_INT64 (version),
-    "}",
-    "contentChanges", "[",
-      "{",
-        "range", "{",
-          "start", "{",
-            "line", JSONRPC_MESSAGE_PUT_INT64 (line),
-            "character", JSONRPC_MESSAGE_PUT_INT64 (column),
-          "}",
-          "end", "{",
-            "line", JSONRPC_MESSAGE_PUT_INT64 (line),
-            "character", JSONRPC_MESSAGE_PUT_INT64 (column),
-          "}",
-        "}",
-        "rangeLength", JSONRPC_MESSAGE_PUT_INT64 (0),
-        "text", JSONRPC_MESSAGE_PUT_STRING (copy),
+  change = JSONRPC_MESSAGE_NEW (
+    "range", "{",
+      "start", "{",
+        "line", JSONRPC_MESSAGE_PUT_INT64 (line),
+        "character", JSONRPC_MESSAGE_PUT_INT64 (column),
       "}",
-    "]");
+      "end", "{",
+        "line", JSONRPC_MESSAGE_PUT_INT64 (line),
+        "character", JSONRPC_MESSAGE_PUT_INT64 (column),
+      "}",
+    "}",
+    "rangeLength", JSONRPC_MESSAGE_PUT_INT64 (0),
+    "text", JSONRPC_MESSAGE_PUT_STRING (copy)
+  );
 
-  ide_langserv_client_send_notification_async (self, "textDocument/didChange",
-                                               g_steal_pointer (&params),
-                                               NULL, NULL, NULL);
+  ide_langserv_client_queue_change (self, buffer, change);
 
   IDE_EXIT;
 }
@@ -217,14 +417,11 @@ ide_langserv_client_buffer_delete_range (IdeLangservClient *self,
                                          GtkTextIter       *end_iter,
                                          IdeBuffer         *buffer)
 {
-
-  g_autoptr(GVariant) params = NULL;
-  g_autofree gchar *uri = NULL;
+  GVariant *change;
   struct {
     gint line;
     gint column;
   } begin, end;
-  gint version;
   gint length;
 
   IDE_ENTRY;
@@ -234,9 +431,6 @@ ide_langserv_client_buffer_delete_range (IdeLangservClient *self,
   g_assert (end_iter != NULL);
   g_assert (IDE_IS_BUFFER (buffer));
 
-  uri = ide_buffer_get_uri (buffer);
-  version = (gint)ide_buffer_get_change_count (buffer);
-
   begin.line = gtk_text_iter_get_line (begin_iter);
   begin.column = gtk_text_iter_get_line_offset (begin_iter);
 
@@ -245,31 +439,22 @@ ide_langserv_client_buffer_delete_range (IdeLangservClient *self,
 
   length = gtk_text_iter_get_offset (end_iter) - gtk_text_iter_get_offset (begin_iter);
 
-  params = JSONRPC_MESSAGE_NEW (
-    "textDocument", "{",
-      "uri", JSONRPC_MESSAGE_PUT_STRING (uri),
-      "version", JSONRPC_MESSAGE_PUT_INT64 (version),
-    "}",
-    "contentChanges", "[",
-      "{",
-        "range", "{",
-          "start", "{",
-            "line", JSONRPC_MESSAGE_PUT_INT64 (begin.line),
-            "character", JSONRPC_MESSAGE_PUT_INT64 (begin.column),
-          "}",
-          "end", "{",
-            "line", JSONRPC_MESSAGE_PUT_INT64 (end.line),
-            "character", JSONRPC_MESSAGE_PUT_INT64 (end.column),
-          "}",
-        "}",
-        "rangeLength", JSONRPC_MESSAGE_PUT_INT64 (length),
-        "text", "",
+  change = JSONRPC_MESSAGE_NEW (
+    "range", "{",
+      "start", "{",
+        "line", JSONRPC_MESSAGE_PUT_INT64 (begin.line),
+        "character", JSONRPC_MESSAGE_PUT_INT64 (begin.column),
       "}",
-    "]");
+      "end", "{",
+        "line", JSONRPC_MESSAGE_PUT_INT64 (end.line),
+        "character", JSONRPC_MESSAGE_PUT_INT64 (end.column),
+      "}",
+    "}",
+    "rangeLength", JSONRPC_MESSAGE_PUT_INT64 (length),
+    "text", ""
+  );
 
-  ide_langserv_client_send_notification_async (self, "textDocument/didChange",
-                                               g_steal_pointer (&params),
-                                               NULL, NULL, NULL);
+  ide_langserv_client_queue_change (self, buffer, change);
 
   IDE_EXIT;
 }
@@ -336,6 +521,8 @@ ide_langserv_client_buffer_unloaded (IdeLangservClient *self,
   if (!ide_langserv_client_supports_buffer (self, buffer))
     IDE_EXIT;
 
+  ide_langserv_client_flush_changes (self, buffer);
+
   uri = ide_buffer_get_uri (buffer);
 
   params = JSONRPC_MESSAGE_NEW (
@@ -652,7 +839,14 @@ ide_langserv_client_finalize (GObject *object)
 
   g_clear_pointer (&priv->diagnostics_by_file, g_hash_table_unref);
   g_clear_pointer (&priv->languages, g_ptr_array_unref);
+  g_clear_pointer (&priv->pending_changes, g_hash_table_unref);
   g_clear_object (&priv->rpc_client);
+
+  if (priv->flush_changes_source != 0)
+    {
+      g_source_remove (priv->flush_changes_source);
+      priv->flush_changes_source = 0;
+    }
   g_clear_object (&priv->buffer_manager_signals);
   g_clear_object (&priv->project_signals);
 
@@ -782,6 +976,8 @@ ide_langserv_client_init (IdeLangservClient *self)
 
   priv->languages = g_ptr_array_new_with_free_func (g_free);
 
+  priv->pending_changes = g_hash_table_new_full (NULL, NULL, NULL, pending_changes_free);
+
   priv->diagnostics_by_file = g_hash_table_new_full ((GHashFunc)g_file_hash,
                                                      (GEqualFunc)g_file_equal,
                                                      g_object_unref,
@@ -992,6 +1188,8 @@ ide_langserv_client_stop (IdeLangservClient *self)
 
   g_return_if_fail (IDE_IS_LANGSERV_CLIENT (self));
 
+  ide_langserv_client_flush_changes (self, NULL);
+
   if (priv->rpc_client != NULL)
     {
       jsonrpc_client_call_async (priv->rpc_client,
@@ -1074,6 +1272,9 @@ ide_langserv_client_call_async (IdeLangservClient   *self,
       IDE_EXIT;
     }
 
+  /* Requests such as completion depend on the peer having our changes */
+  ide_langserv_client_flush_changes (self, NULL);
+
   jsonrpc_client_call_async (priv->rpc_client,
                              method,
                              params,
@@ -1162,6 +1363,8 @@ ide_langserv_client_send_notification_async (IdeLangservClient   *self,
       IDE_EXIT;
     }
 
+  ide_langserv_client_flush_changes (self, NULL);
+
   jsonrpc_client_send_notification_async (priv->rpc_client,
                                           method,
                                           params,
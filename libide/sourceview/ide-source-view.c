@@ -1618,6 +1618,7 @@ ide_source_view_bind_buffer (IdeSourceView  *self,
 {
   IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
   GtkSourceSearchSettings *search_settings;
+  IdeHighlightEngine *engine;
   GtkTextMark *insert;
   GtkTextIter iter;
   IdeContext *context;
@@ -1634,6 +1635,9 @@ ide_source_view_bind_buffer (IdeSourceView  *self,
 
   ide_buffer_hold (buffer);
 
+  if (NULL != (engine = _ide_buffer_get_highlight_engine (buffer)))
+    _ide_highlight_engine_add_view (engine, GTK_TEXT_VIEW (self));
+
   if (_ide_buffer_get_loading (buffer))
     {
       GtkSourceCompletion *completion;
@@ -1722,6 +1726,7 @@ ide_source_view_unbind_buffer (IdeSourceView  *self,
                                EggSignalGroup *group)
 {
   IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+  IdeHighlightEngine *engine;
 
   IDE_ENTRY;
 
@@ -1754,6 +1759,9 @@ ide_source_view_unbind_buffer (IdeSourceView  *self,
   g_clear_object (&priv->definition_highlight_start_mark);
   g_clear_object (&priv->definition_highlight_end_mark);
 
+  if (NULL != (engine = _ide_buffer_get_highlight_engine (priv->buffer)))
+    _ide_highlight_engine_remove_view (engine, GTK_TEXT_VIEW (self));
+
   ide_buffer_release (priv->buffer);
 
   IDE_EXIT;
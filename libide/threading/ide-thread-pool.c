@@ -188,12 +188,14 @@ _ide_thread_pool_init (gboolean is_worker)
 {
   gint compiler = COMPILER_MAX_THREADS;
   gint indexer = INDEXER_MAX_THREADS;
+  gint crawler = g_get_num_processors ();
   gboolean exclusive = FALSE;
 
   if (is_worker)
     {
       compiler = 1;
       indexer = 1;
+      crawler = 1;
       exclusive = TRUE;
     }
 
@@ -217,4 +219,15 @@ _ide_thread_pool_init (gboolean is_worker)
                                                               indexer,
                                                               exclusive,
                                                               NULL);
+
+  /*
+   * Create our pool for helpers of IdeDirectoryCrawler. Crawls are started
+   * from the indexer pool, so these must not share its threads. Every crawl
+   * shares this pool instead of spawning threads of its own.
+   */
+  thread_pools [IDE_THREAD_POOL_CRAWLER] = g_thread_pool_new (ide_thread_pool_worker,
+                                                              NULL,
+                                                              crawler,
+                                                              exclusive,
+                                                              NULL);
 }
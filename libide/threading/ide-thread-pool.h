@@ -29,6 +29,7 @@ typedef enum
 {
   IDE_THREAD_POOL_COMPILER,
   IDE_THREAD_POOL_INDEXER,
+  IDE_THREAD_POOL_CRAWLER,
   IDE_THREAD_POOL_LAST
 } IdeThreadPoolKind;
 
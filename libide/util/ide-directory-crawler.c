@@ -0,0 +1,821 @@
+/* ide-directory-crawler.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-directory-crawler"
+
+#include <egg-counter.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ide-debug.h"
+
+#include "threading/ide-thread-pool.h"
+#include "util/ide-directory-crawler.h"
+#include "vcs/ide-vcs.h"
+
+/**
+ * SECTION:ide-directory-crawler
+ * @title: IdeDirectoryCrawler
+ * @short_description: Parallel directory tree crawler
+ *
+ * #IdeDirectoryCrawler walks a directory tree using a number of worker
+ * threads. Directories that have been discovered but not yet enumerated
+ * are kept in a shared queue from which every worker pulls, so a single
+ * deep subtree does not leave the other threads idle.
+ *
+ * The calling thread always takes part in the crawl, and additional
+ * helpers are taken from the shared %IDE_THREAD_POOL_CRAWLER pool. If the
+ * pool is busy with other crawls, the caller simply does more of the work
+ * itself.
+ *
+ * Symlinks to directories are followed by default. Each symlinked
+ * directory is only entered once per crawl, and never when it contains
+ * the symlink, so that cycles terminate.
+ *
+ * The results for each directory are delivered to every subscriber, so
+ * that a single crawl of the tree can feed multiple consumers (such as
+ * the file search index and the ctags builder).
+ *
+ * If a #IdeVcs is set, files and directories ignored by the version
+ * control system are filtered out before delivery and ignored
+ * directories are not descended into.
+ */
+
+#define DEFAULT_ATTRIBUTES \
+  G_FILE_ATTRIBUTE_STANDARD_NAME"," \
+  G_FILE_ATTRIBUTE_STANDARD_TYPE
+
+struct _IdeDirectoryCrawler
+{
+  GObject  parent_instance;
+
+  GFile   *root;
+  IdeVcs  *vcs;
+  gchar   *attributes;
+  GArray  *subscribers;
+  guint    max_threads;
+  guint    follow_symlinks : 1;
+};
+
+typedef struct
+{
+  IdeDirectoryCrawlerFunc func;
+  gpointer                user_data;
+  GDestroyNotify          notify;
+} Subscriber;
+
+typedef struct
+{
+  GFile     *directory;
+  GFileInfo *info;
+  gchar     *relative_path;
+  /* Canonical path of @directory, or %NULL if it is not local */
+  gchar     *real_path;
+} Job;
+
+/*
+ * Helpers from the thread pool may only get to run after the crawl has
+ * completed, so the state is reference counted rather than living on the
+ * stack of the calling thread.
+ */
+typedef struct
+{
+  volatile gint        ref_count;
+
+  IdeDirectoryCrawler *self;
+  GCancellable        *cancellable;
+
+  /* Protects pending, n_active and visited */
+  GMutex               mutex;
+  GCond                cond;
+  GQueue               pending;
+  guint                n_active;
+
+  /* Real paths of every directory entered, however it was reached */
+  GHashTable          *visited;
+
+  /* Serializes delivery to subscribers */
+  GMutex               deliver_mutex;
+} Crawl;
+
+G_DEFINE_TYPE (IdeDirectoryCrawler, ide_directory_crawler, G_TYPE_OBJECT)
+
+EGG_DEFINE_COUNTER (crawled_dirs, "IdeDirectoryCrawler", "Directories", "Number of directories crawled")
+
+static void
+clear_subscriber (gpointer data)
+{
+  Subscriber *sub = data;
+
+  if (sub->notify != NULL)
+    sub->notify (sub->user_data);
+}
+
+static void
+job_free (gpointer data)
+{
+  Job *job = data;
+
+  g_clear_object (&job->directory);
+  g_clear_object (&job->info);
+  g_clear_pointer (&job->relative_path, g_free);
+  g_clear_pointer (&job->real_path, g_free);
+  g_slice_free (Job, job);
+}
+
+static Job *
+job_new (GFile       *directory,
+         GFileInfo   *info,
+         const gchar *relative_path,
+         const gchar *real_path)
+{
+  Job *job;
+
+  job = g_slice_new0 (Job);
+  job->directory = g_object_ref (directory);
+  job->info = g_object_ref (info);
+  job->relative_path = g_strdup (relative_path);
+  job->real_path = g_strdup (real_path);
+
+  return job;
+}
+
+static Crawl *
+crawl_new (IdeDirectoryCrawler *self,
+           GCancellable        *cancellable)
+{
+  Crawl *crawl;
+
+  crawl = g_slice_new0 (Crawl);
+  crawl->ref_count = 1;
+  crawl->self = g_object_ref (self);
+  crawl->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+  crawl->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_mutex_init (&crawl->mutex);
+  g_mutex_init (&crawl->deliver_mutex);
+  g_cond_init (&crawl->cond);
+  g_queue_init (&crawl->pending);
+
+  return crawl;
+}
+
+static Crawl *
+crawl_ref (Crawl *crawl)
+{
+  g_assert (crawl != NULL);
+  g_assert (crawl->ref_count > 0);
+
+  g_atomic_int_inc (&crawl->ref_count);
+
+  return crawl;
+}
+
+static void
+crawl_unref (Crawl *crawl)
+{
+  g_assert (crawl != NULL);
+  g_assert (crawl->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&crawl->ref_count))
+    {
+      g_assert (crawl->pending.length == 0);
+      g_assert (crawl->n_active == 0);
+
+      g_clear_object (&crawl->self);
+      g_clear_object (&crawl->cancellable);
+      g_clear_pointer (&crawl->visited, g_hash_table_unref);
+      g_mutex_clear (&crawl->mutex);
+      g_mutex_clear (&crawl->deliver_mutex);
+      g_cond_clear (&crawl->cond);
+      g_slice_free (Crawl, crawl);
+    }
+}
+
+static void
+ide_directory_crawler_finalize (GObject *object)
+{
+  IdeDirectoryCrawler *self = (IdeDirectoryCrawler *)object;
+
+  g_clear_object (&self->root);
+  g_clear_object (&self->vcs);
+  g_clear_pointer (&self->attributes, g_free);
+  g_clear_pointer (&self->subscribers, g_array_unref);
+
+  G_OBJECT_CLASS (ide_directory_crawler_parent_class)->finalize (object);
+}
+
+static void
+ide_directory_crawler_class_init (IdeDirectoryCrawlerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_directory_crawler_finalize;
+}
+
+static void
+ide_directory_crawler_init (IdeDirectoryCrawler *self)
+{
+  self->attributes = g_strdup (DEFAULT_ATTRIBUTES);
+  self->max_threads = g_get_num_processors ();
+  self->follow_symlinks = TRUE;
+  self->subscribers = g_array_new (FALSE, FALSE, sizeof (Subscriber));
+  g_array_set_clear_func (self->subscribers, clear_subscriber);
+}
+
+/**
+ * ide_directory_crawler_new:
+ * @root: the directory to crawl
+ *
+ * Returns: (transfer full): A new #IdeDirectoryCrawler.
+ */
+IdeDirectoryCrawler *
+ide_directory_crawler_new (GFile *root)
+{
+  IdeDirectoryCrawler *self;
+
+  g_return_val_if_fail (G_IS_FILE (root), NULL);
+
+  self = g_object_new (IDE_TYPE_DIRECTORY_CRAWLER, NULL);
+  self->root = g_object_ref (root);
+
+  return self;
+}
+
+/**
+ * ide_directory_crawler_set_vcs:
+ * @self: An #IdeDirectoryCrawler
+ * @vcs: (nullable): An #IdeVcs or %NULL
+ *
+ * Sets the #IdeVcs used to filter ignored files. If %NULL, no files
+ * are filtered.
+ */
+void
+ide_directory_crawler_set_vcs (IdeDirectoryCrawler *self,
+                               IdeVcs              *vcs)
+{
+  g_return_if_fail (IDE_IS_DIRECTORY_CRAWLER (self));
+  g_return_if_fail (!vcs || IDE_IS_VCS (vcs));
+
+  g_set_object (&self->vcs, vcs);
+}
+
+/**
+ * ide_directory_crawler_set_attributes:
+ * @self: An #IdeDirectoryCrawler
+ * @attributes: (nullable): additional file attributes to query
+ *
+ * Sets additional attributes to query for each file. The name and type
+ * of files are always queried. Requesting only those two allows the
+ * local backend to avoid a stat() per file.
+ */
+void
+ide_directory_crawler_set_attributes (IdeDirectoryCrawler *self,
+                                      const gchar         *attributes)
+{
+  g_return_if_fail (IDE_IS_DIRECTORY_CRAWLER (self));
+
+  g_free (self->attributes);
+
+  if (attributes == NULL || *attributes == '\0')
+    self->attributes = g_strdup (DEFAULT_ATTRIBUTES);
+  else
+    self->attributes = g_strdup_printf (DEFAULT_ATTRIBUTES",%s", attributes);
+}
+
+/**
+ * ide_directory_crawler_set_max_threads:
+ * @self: An #IdeDirectoryCrawler
+ * @max_threads: the maximum number of threads, or 0 for the default
+ *
+ * Sets the number of threads used to enumerate directories, including
+ * the calling thread. The default is the number of processors. Threads
+ * beyond the first are taken from a thread pool shared by all crawlers,
+ * so fewer may be used when it is busy.
+ */
+void
+ide_directory_crawler_set_max_threads (IdeDirectoryCrawler *self,
+                                       guint                max_threads)
+{
+  g_return_if_fail (IDE_IS_DIRECTORY_CRAWLER (self));
+
+  if (max_threads == 0)
+    max_threads = g_get_num_processors ();
+
+  self->max_threads = max_threads;
+}
+
+/**
+ * ide_directory_crawler_set_follow_symlinks:
+ * @self: An #IdeDirectoryCrawler
+ * @follow_symlinks: if symlinks should be followed
+ *
+ * Sets if symlinks should be followed, which is the default. Followed
+ * symlinks are delivered to subscribers with the type of their target
+ * and #GFileInfo:is-symlink set. Symlinks that are not followed, either
+ * because of this setting or because they would create a cycle or lead
+ * to a directory that was already crawled, are delivered as
+ * %G_FILE_TYPE_SYMBOLIC_LINK and not crawled. Likewise, a directory that
+ * was already crawled through a symlink is delivered but not crawled
+ * again.
+ */
+void
+ide_directory_crawler_set_follow_symlinks (IdeDirectoryCrawler *self,
+                                           gboolean             follow_symlinks)
+{
+  g_return_if_fail (IDE_IS_DIRECTORY_CRAWLER (self));
+
+  self->follow_symlinks = !!follow_symlinks;
+}
+
+/**
+ * ide_directory_crawler_subscribe:
+ * @self: An #IdeDirectoryCrawler
+ * @func: (scope notified) (closure user_data): the callback for results
+ * @user_data: closure data for @func
+ * @notify: closure notify for @user_data
+ *
+ * Adds a subscriber that will be notified of the contents of each
+ * directory as it is crawled. See #IdeDirectoryCrawlerFunc for the
+ * threading guarantees.
+ */
+void
+ide_directory_crawler_subscribe (IdeDirectoryCrawler     *self,
+                                 IdeDirectoryCrawlerFunc  func,
+                                 gpointer                 user_data,
+                                 GDestroyNotify           notify)
+{
+  Subscriber sub = { 0 };
+
+  g_return_if_fail (IDE_IS_DIRECTORY_CRAWLER (self));
+  g_return_if_fail (func != NULL);
+
+  sub.func = func;
+  sub.user_data = user_data;
+  sub.notify = notify;
+
+  g_array_append_val (self->subscribers, sub);
+}
+
+static void
+ide_directory_crawler_remove_ignored (IdeDirectoryCrawler *self,
+                                      GFile               *directory,
+                                      GPtrArray           *children)
+{
+  g_autofree gboolean *ignored = NULL;
+  guint i;
+
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (self));
+  g_assert (G_IS_FILE (directory));
+  g_assert (children != NULL);
+
+  if (self->vcs == NULL || children->len == 0)
+    return;
+
+  ignored = g_new0 (gboolean, children->len);
+
+  if (!ide_vcs_is_ignored_batch (self->vcs, directory, children, ignored, NULL))
+    return;
+
+  for (i = children->len; i > 0; i--)
+    {
+      if (ignored [i - 1])
+        g_ptr_array_remove_index (children, i - 1);
+    }
+}
+
+/*
+ * Checks if the symlinked directory @link within the directory whose real
+ * path is @directory_real may be entered, which is the case if its target
+ * was not visited yet and does not contain that directory. On success,
+ * @link_real_path is set to the real path of the target.
+ */
+static gboolean
+ide_directory_crawler_enter_link (Crawl        *crawl,
+                                  const gchar  *directory_real,
+                                  GFile        *link,
+                                  gchar       **link_real_path)
+{
+  g_autofree gchar *link_path = NULL;
+  gchar *link_real;
+  gsize len;
+  gboolean contains_directory;
+  gboolean ret = FALSE;
+
+  g_assert (crawl != NULL);
+  g_assert (G_IS_FILE (link));
+  g_assert (link_real_path != NULL);
+
+  if (directory_real == NULL || NULL == (link_path = g_file_get_path (link)))
+    return FALSE;
+
+  if (NULL == (link_real = realpath (link_path, NULL)))
+    return FALSE;
+
+  len = strlen (link_real);
+  contains_directory = strncmp (directory_real, link_real, len) == 0 &&
+                       (directory_real [len] == '\0' ||
+                        directory_real [len] == G_DIR_SEPARATOR ||
+                        (len > 0 && link_real [len - 1] == G_DIR_SEPARATOR));
+
+  if (!contains_directory)
+    {
+      g_mutex_lock (&crawl->mutex);
+      if (!g_hash_table_contains (crawl->visited, link_real))
+        {
+          g_hash_table_add (crawl->visited, g_strdup (link_real));
+          *link_real_path = g_strdup (link_real);
+          ret = TRUE;
+        }
+      g_mutex_unlock (&crawl->mutex);
+    }
+
+  free (link_real);
+
+  return ret;
+}
+
+/*
+ * The enumeration does not follow symlinks, so that the type of most files
+ * can come from the directory entry without a stat(). Resolve the symlinks
+ * here instead, leaving those that are dangling or would loop untouched.
+ */
+static void
+ide_directory_crawler_resolve_symlinks (Crawl      *crawl,
+                                        Job        *job,
+                                        GPtrArray  *children,
+                                        GHashTable *link_real_paths)
+{
+  IdeDirectoryCrawler *self = crawl->self;
+
+  g_assert (crawl != NULL);
+  g_assert (job != NULL);
+  g_assert (children != NULL);
+  g_assert (link_real_paths != NULL);
+
+  for (guint i = 0; i < children->len; i++)
+    {
+      GFileInfo *info = g_ptr_array_index (children, i);
+      g_autoptr(GFileInfo) target_info = NULL;
+      g_autoptr(GFile) child = NULL;
+      gchar *link_real_path = NULL;
+      const gchar *name;
+
+      if (g_file_info_get_file_type (info) != G_FILE_TYPE_SYMBOLIC_LINK)
+        continue;
+
+      name = g_file_info_get_name (info);
+      child = g_file_get_child (job->directory, name);
+      target_info = g_file_query_info (child,
+                                       self->attributes,
+                                       G_FILE_QUERY_INFO_NONE,
+                                       crawl->cancellable,
+                                       NULL);
+
+      if (target_info == NULL)
+        continue;
+
+      if (g_file_info_get_file_type (target_info) == G_FILE_TYPE_DIRECTORY)
+        {
+          if (!ide_directory_crawler_enter_link (crawl, job->real_path, child, &link_real_path))
+            continue;
+          g_hash_table_insert (link_real_paths, g_strdup (name), link_real_path);
+        }
+
+      g_file_info_set_name (target_info, name);
+      g_file_info_set_is_symlink (target_info, TRUE);
+
+      g_ptr_array_index (children, i) = g_steal_pointer (&target_info);
+      g_object_unref (info);
+    }
+}
+
+static gchar *
+join_relative_path (const gchar *relative_path,
+                    const gchar *name)
+{
+  if (*relative_path == '\0')
+    return g_strdup (name);
+  return g_build_filename (relative_path, name, NULL);
+}
+
+static GPtrArray *
+ide_directory_crawler_process (Crawl  *crawl,
+                               Job    *job)
+{
+  IdeDirectoryCrawler *self = crawl->self;
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  g_autoptr(GHashTable) link_real_paths = NULL;
+  g_autoptr(GError) error = NULL;
+  GPtrArray *subdirs = NULL;
+  gpointer infoptr;
+  guint i;
+
+  g_assert (crawl != NULL);
+  g_assert (job != NULL);
+
+  EGG_COUNTER_INC (crawled_dirs);
+
+  /*
+   * The local GFileEnumerator reads directory entries in large batches
+   * (getdents), and when only name and type are requested it can use
+   * d_type instead of stat()ing every entry. Symlinks are resolved
+   * separately, see ide_directory_crawler_resolve_symlinks().
+   */
+  enumerator = g_file_enumerate_children (job->directory,
+                                          self->attributes,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          crawl->cancellable,
+                                          &error);
+
+  if (enumerator == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("%s", error->message);
+      return NULL;
+    }
+
+  children = g_ptr_array_new_with_free_func (g_object_unref);
+
+  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, crawl->cancellable, NULL)))
+    g_ptr_array_add (children, infoptr);
+
+  if (g_cancellable_is_cancelled (crawl->cancellable))
+    return NULL;
+
+  ide_directory_crawler_remove_ignored (self, job->directory, children);
+
+  /* Real paths of the symlinked directories that may be entered, by name */
+  link_real_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  if (self->follow_symlinks)
+    ide_directory_crawler_resolve_symlinks (crawl, job, children, link_real_paths);
+
+  g_mutex_lock (&crawl->deliver_mutex);
+  for (i = 0; i < self->subscribers->len; i++)
+    {
+      const Subscriber *sub = &g_array_index (self->subscribers, Subscriber, i);
+
+      sub->func (self,
+                 job->directory,
+                 job->relative_path,
+                 job->info,
+                 children,
+                 sub->user_data);
+    }
+  g_mutex_unlock (&crawl->deliver_mutex);
+
+  /* Subscribers may have pruned directories they do not want crawled */
+  for (i = 0; i < children->len; i++)
+    {
+      GFileInfo *info = g_ptr_array_index (children, i);
+      g_autoptr(GFile) child = NULL;
+      g_autofree gchar *relative_path = NULL;
+      g_autofree gchar *real_path = NULL;
+      const gchar *name;
+
+      if (g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+        continue;
+
+      name = g_file_info_get_name (info);
+
+      if (g_file_info_get_is_symlink (info))
+        {
+          /* Already recorded as visited when resolved */
+          real_path = g_strdup (g_hash_table_lookup (link_real_paths, name));
+        }
+      else if (job->real_path != NULL)
+        {
+          /*
+           * Not a symlink, so the real path follows from ours without
+           * resolving it again. It may still have been entered through
+           * a symlink elsewhere.
+           */
+          real_path = g_build_filename (job->real_path, name, NULL);
+
+          g_mutex_lock (&crawl->mutex);
+          if (g_hash_table_contains (crawl->visited, real_path))
+            g_clear_pointer (&real_path, g_free);
+          else
+            g_hash_table_add (crawl->visited, g_strdup (real_path));
+          g_mutex_unlock (&crawl->mutex);
+
+          if (real_path == NULL)
+            continue;
+        }
+
+      if (subdirs == NULL)
+        subdirs = g_ptr_array_new ();
+
+      child = g_file_get_child (job->directory, name);
+      relative_path = join_relative_path (job->relative_path, name);
+
+      g_ptr_array_add (subdirs, job_new (child, info, relative_path, real_path));
+    }
+
+  return subdirs;
+}
+
+static void
+ide_directory_crawler_run (Crawl *crawl)
+{
+  g_assert (crawl != NULL);
+
+  g_mutex_lock (&crawl->mutex);
+
+  for (;;)
+    {
+      GPtrArray *subdirs;
+      Job *job;
+
+      if (g_cancellable_is_cancelled (crawl->cancellable))
+        {
+          while (NULL != (job = g_queue_pop_head (&crawl->pending)))
+            job_free (job);
+        }
+
+      while (crawl->pending.length == 0 && crawl->n_active > 0)
+        g_cond_wait (&crawl->cond, &crawl->mutex);
+
+      /* Nothing left to do and nobody can produce more work */
+      if (crawl->pending.length == 0)
+        break;
+
+      /*
+       * Pop from the head so that we crawl depth-first, which keeps the
+       * queue small and improves locality of the directory inodes.
+       */
+      job = g_queue_pop_head (&crawl->pending);
+      crawl->n_active++;
+
+      g_mutex_unlock (&crawl->mutex);
+      subdirs = ide_directory_crawler_process (crawl, job);
+      job_free (job);
+      g_mutex_lock (&crawl->mutex);
+
+      if (subdirs != NULL)
+        {
+          guint i;
+
+          if (!g_cancellable_is_cancelled (crawl->cancellable))
+            {
+              for (i = subdirs->len; i > 0; i--)
+                g_queue_push_head (&crawl->pending, g_ptr_array_index (subdirs, i - 1));
+            }
+          else
+            {
+              for (i = 0; i < subdirs->len; i++)
+                job_free (g_ptr_array_index (subdirs, i));
+            }
+
+          g_ptr_array_unref (subdirs);
+        }
+
+      crawl->n_active--;
+
+      g_cond_broadcast (&crawl->cond);
+    }
+
+  g_cond_broadcast (&crawl->cond);
+  g_mutex_unlock (&crawl->mutex);
+}
+
+static void
+ide_directory_crawler_helper (gpointer data)
+{
+  Crawl *crawl = data;
+
+  g_assert (crawl != NULL);
+
+  /* Returns right away if the crawl completed before we got to run */
+  ide_directory_crawler_run (crawl);
+  crawl_unref (crawl);
+}
+
+/**
+ * ide_directory_crawler_crawl:
+ * @self: An #IdeDirectoryCrawler
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Synchronously crawls the directory tree, blocking until every directory
+ * has been delivered. The calling thread participates in the crawl.
+ *
+ * This should not be called from the main thread, see
+ * ide_directory_crawler_crawl_async().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_directory_crawler_crawl (IdeDirectoryCrawler  *self,
+                             GCancellable         *cancellable,
+                             GError              **error)
+{
+  g_autoptr(GFileInfo) root_info = NULL;
+  g_autofree gchar *root_path = NULL;
+  gchar *root_real = NULL;
+  Crawl *crawl;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_DIRECTORY_CRAWLER (self), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  root_info = g_file_query_info (self->root,
+                                 self->attributes,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 cancellable,
+                                 error);
+
+  if (root_info == NULL)
+    IDE_RETURN (FALSE);
+
+  crawl = crawl_new (self, cancellable);
+
+  /* Symlinks back to the root must not crawl it again */
+  if (NULL != (root_path = g_file_get_path (self->root)) &&
+      NULL != (root_real = realpath (root_path, NULL)))
+    g_hash_table_add (crawl->visited, g_strdup (root_real));
+
+  g_queue_push_head (&crawl->pending, job_new (self->root, root_info, "", root_real));
+
+  free (root_real);
+
+  for (guint i = 1; i < self->max_threads; i++)
+    ide_thread_pool_push (IDE_THREAD_POOL_CRAWLER,
+                          ide_directory_crawler_helper,
+                          crawl_ref (crawl));
+
+  /*
+   * Once this returns nothing is pending or being processed, so helpers
+   * still running or queued will not deliver anything else.
+   */
+  ide_directory_crawler_run (crawl);
+
+  crawl_unref (crawl);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    IDE_RETURN (FALSE);
+
+  IDE_RETURN (TRUE);
+}
+
+static void
+ide_directory_crawler_crawl_worker (GTask        *task,
+                                    gpointer      source_object,
+                                    gpointer      task_data,
+                                    GCancellable *cancellable)
+{
+  IdeDirectoryCrawler *self = source_object;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (self));
+
+  if (!ide_directory_crawler_crawl (self, cancellable, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+void
+ide_directory_crawler_crawl_async (IdeDirectoryCrawler *self,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (IDE_IS_DIRECTORY_CRAWLER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_directory_crawler_crawl_async);
+  g_task_run_in_thread (task, ide_directory_crawler_crawl_worker);
+}
+
+gboolean
+ide_directory_crawler_crawl_finish (IdeDirectoryCrawler  *self,
+                                    GAsyncResult         *result,
+                                    GError              **error)
+{
+  g_return_val_if_fail (IDE_IS_DIRECTORY_CRAWLER (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
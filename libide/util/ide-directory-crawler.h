@@ -0,0 +1,82 @@
+/* ide-directory-crawler.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_DIRECTORY_CRAWLER_H
+#define IDE_DIRECTORY_CRAWLER_H
+
+#include <gio/gio.h>
+
+#include "ide-types.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_DIRECTORY_CRAWLER (ide_directory_crawler_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeDirectoryCrawler, ide_directory_crawler, IDE, DIRECTORY_CRAWLER, GObject)
+
+/**
+ * IdeDirectoryCrawlerFunc:
+ * @self: An #IdeDirectoryCrawler
+ * @directory: the directory that was enumerated
+ * @relative_path: the path of @directory relative to the crawl root,
+ *   or "" for the root itself
+ * @directory_info: a #GFileInfo for @directory
+ * @children: (element-type GFileInfo): the children of @directory
+ * @user_data: closure data for the callback
+ *
+ * Subscribers are called from the crawler worker threads, but never
+ * concurrently with one another, so they do not need to provide their
+ * own locking for state that is only touched from the callback.
+ *
+ * Subscribers may remove directories from @children to prevent the
+ * crawler from descending into them.
+ */
+typedef void (*IdeDirectoryCrawlerFunc) (IdeDirectoryCrawler *self,
+                                         GFile               *directory,
+                                         const gchar         *relative_path,
+                                         GFileInfo           *directory_info,
+                                         GPtrArray           *children,
+                                         gpointer             user_data);
+
+IdeDirectoryCrawler *ide_directory_crawler_new                 (GFile                   *root);
+void                 ide_directory_crawler_set_vcs             (IdeDirectoryCrawler     *self,
+                                                                IdeVcs                  *vcs);
+void                 ide_directory_crawler_set_attributes      (IdeDirectoryCrawler     *self,
+                                                                const gchar             *attributes);
+void                 ide_directory_crawler_set_max_threads     (IdeDirectoryCrawler     *self,
+                                                                guint                    max_threads);
+void                 ide_directory_crawler_set_follow_symlinks (IdeDirectoryCrawler     *self,
+                                                                gboolean                 follow_symlinks);
+void                 ide_directory_crawler_subscribe           (IdeDirectoryCrawler     *self,
+                                                                IdeDirectoryCrawlerFunc  func,
+                                                                gpointer                 user_data,
+                                                                GDestroyNotify           notify);
+gboolean             ide_directory_crawler_crawl               (IdeDirectoryCrawler     *self,
+                                                                GCancellable            *cancellable,
+                                                                GError                 **error);
+void                 ide_directory_crawler_crawl_async         (IdeDirectoryCrawler     *self,
+                                                                GCancellable            *cancellable,
+                                                                GAsyncReadyCallback      callback,
+                                                                gpointer                 user_data);
+gboolean             ide_directory_crawler_crawl_finish        (IdeDirectoryCrawler     *self,
+                                                                GAsyncResult            *result,
+                                                                GError                 **error);
+
+G_END_DECLS
+
+#endif /* IDE_DIRECTORY_CRAWLER_H */
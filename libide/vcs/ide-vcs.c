@@ -82,16 +82,11 @@ ide_vcs_default_init (IdeVcsInterface *iface)
                   NULL, NULL, NULL, G_TYPE_NONE, 0);
 }
 
-gboolean
-ide_vcs_is_ignored (IdeVcs  *self,
-                    GFile   *file,
-                    GError **error)
+static gboolean
+ide_vcs_is_ignored_name (const gchar *name)
 {
-  g_return_val_if_fail (IDE_IS_VCS (self), FALSE);
-
   if G_LIKELY (ignored != NULL)
     {
-      g_autofree gchar *name = g_file_get_basename (file);
       guint len = strlen (name);
       g_autofree gchar *reversed = g_utf8_strreverse (name, len);
 
@@ -104,12 +99,126 @@ ide_vcs_is_ignored (IdeVcs  *self,
         }
     }
 
+  return FALSE;
+}
+
+gboolean
+ide_vcs_is_ignored (IdeVcs  *self,
+                    GFile   *file,
+                    GError **error)
+{
+  g_return_val_if_fail (IDE_IS_VCS (self), FALSE);
+
+  if G_LIKELY (ignored != NULL)
+    {
+      g_autofree gchar *name = g_file_get_basename (file);
+
+      if (ide_vcs_is_ignored_name (name))
+        return TRUE;
+    }
+
   if (IDE_VCS_GET_IFACE (self)->is_ignored)
     return IDE_VCS_GET_IFACE (self)->is_ignored (self, file, error);
 
   return FALSE;
 }
 
+/**
+ * ide_vcs_is_ignored_batch:
+ * @self: An #IdeVcs
+ * @directory: the directory containing @file_infos
+ * @file_infos: (element-type GFileInfo): the children of @directory, with
+ *   at least the standard::name and standard::type attributes
+ * @ignored: (array) (out caller-allocates): a location to store the result
+ *   for each element of @file_infos
+ * @error: A location for a #GError, or %NULL
+ *
+ * Checks which children of @directory are ignored by the version control
+ * system. Implementations can compile the ignore rules for @directory once
+ * and evaluate the whole listing against them, which is much cheaper than
+ * calling ide_vcs_is_ignored() for every file.
+ *
+ * @directory itself is assumed to not be ignored.
+ *
+ * This function may be called from any thread.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_vcs_is_ignored_batch (IdeVcs     *self,
+                          GFile      *directory,
+                          GPtrArray  *file_infos,
+                          gboolean   *ignored,
+                          GError    **error)
+{
+  static GMutex fallback_mutex;
+
+  g_return_val_if_fail (IDE_IS_VCS (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (directory), FALSE);
+  g_return_val_if_fail (file_infos != NULL, FALSE);
+  g_return_val_if_fail (ignored != NULL, FALSE);
+
+  if (IDE_VCS_GET_IFACE (self)->is_ignored_batch)
+    {
+      if (!IDE_VCS_GET_IFACE (self)->is_ignored_batch (self, directory, file_infos, ignored, error))
+        return FALSE;
+
+      for (guint i = 0; i < file_infos->len; i++)
+        {
+          GFileInfo *info = g_ptr_array_index (file_infos, i);
+
+          if (!ignored [i])
+            ignored [i] = ide_vcs_is_ignored_name (g_file_info_get_name (info));
+        }
+
+      return TRUE;
+    }
+
+  /*
+   * Implementations of is_ignored() are not required to be thread-safe,
+   * so serialize the fallback path.
+   */
+  g_mutex_lock (&fallback_mutex);
+  for (guint i = 0; i < file_infos->len; i++)
+    {
+      GFileInfo *info = g_ptr_array_index (file_infos, i);
+      g_autoptr(GFile) child = g_file_get_child (directory, g_file_info_get_name (info));
+
+      ignored [i] = ide_vcs_is_ignored (self, child, NULL);
+    }
+  g_mutex_unlock (&fallback_mutex);
+
+  return TRUE;
+}
+
+/**
+ * ide_vcs_get_ignore_stamp:
+ * @self: An #IdeVcs
+ * @directory: a directory within the working tree
+ *
+ * Gets a value that changes whenever the rules deciding which children of
+ * @directory are ignored may have changed, such as when a .gitignore file
+ * was edited. This allows callers to cache filtered directory listings.
+ *
+ * Implementations that do not track their ignore rules return 0.
+ *
+ * This function may be called from any thread.
+ *
+ * Returns: the ignore stamp for @directory
+ */
+guint64
+ide_vcs_get_ignore_stamp (IdeVcs *self,
+                          GFile  *directory)
+{
+  g_return_val_if_fail (IDE_IS_VCS (self), 0);
+  g_return_val_if_fail (G_IS_FILE (directory), 0);
+
+  if (IDE_VCS_GET_IFACE (self)->get_ignore_stamp)
+    return IDE_VCS_GET_IFACE (self)->get_ignore_stamp (self, directory);
+
+  return 0;
+}
+
 gint
 ide_vcs_get_priority (IdeVcs *self)
 {
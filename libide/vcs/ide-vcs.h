@@ -44,6 +44,13 @@ struct _IdeVcsInterface
   void                    (*changed)                   (IdeVcs     *self);
   IdeVcsConfig           *(*get_config)                (IdeVcs     *self);
   gchar                  *(*get_branch_name)           (IdeVcs     *self);
+  gboolean                (*is_ignored_batch)          (IdeVcs     *self,
+                                                        GFile      *directory,
+                                                        GPtrArray  *file_infos,
+                                                        gboolean   *ignored,
+                                                        GError    **error);
+  guint64                 (*get_ignore_stamp)          (IdeVcs     *self,
+                                                        GFile      *directory);
 };
 
 void                    ide_vcs_register_ignored          (const gchar          *pattern);
@@ -60,6 +67,13 @@ IdeVcs                 *ide_vcs_new_finish                (GAsyncResult
 gboolean                ide_vcs_is_ignored                (IdeVcs               *self,
                                                            GFile                *file,
                                                            GError              **error);
+gboolean                ide_vcs_is_ignored_batch          (IdeVcs               *self,
+                                                           GFile                *directory,
+                                                           GPtrArray            *file_infos,
+                                                           gboolean             *ignored,
+                                                           GError              **error);
+guint64                 ide_vcs_get_ignore_stamp          (IdeVcs               *self,
+                                                           GFile                *directory);
 gint                    ide_vcs_get_priority              (IdeVcs               *self);
 void                    ide_vcs_emit_changed              (IdeVcs               *self);
 IdeVcsConfig           *ide_vcs_get_config                (IdeVcs               *self);
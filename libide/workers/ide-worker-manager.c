@@ -191,8 +191,10 @@ ide_worker_manager_init (IdeWorkerManager *self)
 
 static IdeWorkerProcess *
 ide_worker_manager_get_worker_process (IdeWorkerManager *self,
-                                       const gchar      *plugin_name)
+                                       const gchar      *plugin_name,
+                                       guint             slot)
 {
+  g_autofree gchar *name = NULL;
   IdeWorkerProcess *worker_process;
 
   g_assert (IDE_IS_WORKER_MANAGER (self));
@@ -201,7 +203,8 @@ ide_worker_manager_get_worker_process (IdeWorkerManager *self,
   if (!self->plugin_name_to_worker || !self->dbus_server)
     return NULL;
 
-  worker_process = g_hash_table_lookup (self->plugin_name_to_worker, plugin_name);
+  name = g_strdup_printf ("%s:%u", plugin_name, slot);
+  worker_process = g_hash_table_lookup (self->plugin_name_to_worker, name);
 
   if (worker_process == NULL)
     {
@@ -220,7 +223,7 @@ ide_worker_manager_get_worker_process (IdeWorkerManager *self,
         path = "gnome-builder-worker";
 
       worker_process = ide_worker_process_new (path, plugin_name, address);
-      g_hash_table_insert (self->plugin_name_to_worker, g_strdup (plugin_name), worker_process);
+      g_hash_table_insert (self->plugin_name_to_worker, g_steal_pointer (&name), worker_process);
       ide_worker_process_run (worker_process);
     }
 
@@ -267,7 +270,63 @@ ide_worker_manager_get_worker_async (IdeWorkerManager    *self,
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   task = g_task_new (self, cancellable, callback, user_data);
-  worker_process = ide_worker_manager_get_worker_process (self, plugin_name);
+  worker_process = ide_worker_manager_get_worker_process (self, plugin_name, 0);
+  ide_worker_process_get_proxy_async (worker_process,
+                                      cancellable,
+                                      ide_worker_manager_get_worker_cb,
+                                      task);
+}
+
+/**
+ * ide_worker_manager_get_worker_for_key_async:
+ * @self: An #IdeWorkerManager
+ * @plugin_name: the name of the plugin providing the worker
+ * @n_workers: the number of worker processes in the pool
+ * @key: (nullable): a key used to route the request
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * This is like ide_worker_manager_get_worker_async() except that up to
+ * @n_workers processes are spawned for @plugin_name. Requests with the
+ * same @key are always routed to the same process, which allows workers
+ * to keep per-key state (such as a parsed file) warm between requests.
+ *
+ * Call ide_worker_manager_get_worker_finish() to get the result.
+ */
+void
+ide_worker_manager_get_worker_for_key_async (IdeWorkerManager    *self,
+                                             const gchar         *plugin_name,
+                                             guint                n_workers,
+                                             const gchar         *key,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data)
+{
+  IdeWorkerProcess *worker_process;
+  GTask *task;
+  guint slot = 0;
+
+  g_return_if_fail (IDE_IS_WORKER_MANAGER (self));
+  g_return_if_fail (plugin_name != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  if (key != NULL && n_workers > 1)
+    slot = g_str_hash (key) % n_workers;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  worker_process = ide_worker_manager_get_worker_process (self, plugin_name, slot);
+
+  if (worker_process == NULL)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CLOSED,
+                               "The worker manager has been shut down");
+      g_object_unref (task);
+      return;
+    }
+
   ide_worker_process_get_proxy_async (worker_process,
                                       cancellable,
                                       ide_worker_manager_get_worker_cb,
@@ -27,16 +27,23 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (IdeWorkerManager, ide_worker_manager, IDE, WORKER_MANAGER, GObject)
 
-IdeWorkerManager *ide_worker_manager_new               (void);
-void              ide_worker_manager_shutdown          (IdeWorkerManager     *self);
-void              ide_worker_manager_get_worker_async  (IdeWorkerManager     *self,
-                                                        const gchar          *plugin_name,
-                                                        GCancellable         *cancellable,
-                                                        GAsyncReadyCallback   callback,
-                                                        gpointer              user_data);
-GDBusProxy       *ide_worker_manager_get_worker_finish (IdeWorkerManager     *self,
-                                                        GAsyncResult         *result,
-                                                        GError              **error);
+IdeWorkerManager *ide_worker_manager_new                      (void);
+void              ide_worker_manager_shutdown                 (IdeWorkerManager     *self);
+void              ide_worker_manager_get_worker_async         (IdeWorkerManager     *self,
+                                                               const gchar          *plugin_name,
+                                                               GCancellable         *cancellable,
+                                                               GAsyncReadyCallback   callback,
+                                                               gpointer              user_data);
+void              ide_worker_manager_get_worker_for_key_async (IdeWorkerManager     *self,
+                                                               const gchar          *plugin_name,
+                                                               guint                 n_workers,
+                                                               const gchar          *key,
+                                                               GCancellable         *cancellable,
+                                                               GAsyncReadyCallback   callback,
+                                                               gpointer              user_data);
+GDBusProxy       *ide_worker_manager_get_worker_finish        (IdeWorkerManager     *self,
+                                                               GAsyncResult         *result,
+                                                               GError              **error);
 
 G_END_DECLS
 
@@ -103,6 +103,13 @@ ide_worker_process_wait_check_cb (GObject      *object,
 
   g_clear_object (&self->subprocess);
 
+  /*
+   * The connection died along with the process. Drop it so that proxy
+   * requests are queued until the respawned worker connects rather than
+   * being handed a proxy to a closed connection.
+   */
+  g_clear_object (&self->connection);
+
   if (!self->quit)
     ide_worker_process_respawn (self);
 
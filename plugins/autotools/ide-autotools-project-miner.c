@@ -193,25 +193,45 @@ directory_is_ignored (GFile *directory)
   return FALSE;
 }
 
-static void
-ide_autotools_project_miner_mine_directory (IdeAutotoolsProjectMiner *self,
-                                            GFile                    *directory,
-                                            guint                     depth,
-                                            GCancellable             *cancellable)
+typedef struct
 {
-  g_autoptr(GFileEnumerator) file_enum = NULL;
-  g_autoptr(GPtrArray) directories = NULL;
-  gpointer file_info_ptr;
+  IdeAutotoolsProjectMiner *self;
+  GCancellable             *cancellable;
+} MineState;
 
-  g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
-  g_assert (G_IS_FILE (directory));
-  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+static guint
+get_depth (const gchar *relative_path)
+{
+  guint depth = 0;
 
-  if (depth == MAX_MINE_DEPTH)
-    return;
+  if (*relative_path == '\0')
+    return 0;
 
-  if (directory_is_ignored (directory))
-    return;
+  for (const gchar *iter = relative_path; *iter; iter++)
+    {
+      if (*iter == G_DIR_SEPARATOR)
+        depth++;
+    }
+
+  return depth + 1;
+}
+
+static void
+ide_autotools_project_miner_crawl_cb (IdeDirectoryCrawler *crawler,
+                                      GFile               *directory,
+                                      const gchar         *relative_path,
+                                      GFileInfo           *directory_info,
+                                      GPtrArray           *children,
+                                      gpointer             user_data)
+{
+  MineState *state = user_data;
+  gboolean descend;
+
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (crawler));
+  g_assert (G_IS_FILE (directory));
+  g_assert (relative_path != NULL);
+  g_assert (children != NULL);
+  g_assert (state != NULL);
 
 #ifdef IDE_ENABLE_TRACE
   {
@@ -222,71 +242,69 @@ ide_autotools_project_miner_mine_directory (IdeAutotoolsProjectMiner *self,
   }
 #endif
 
-  file_enum = g_file_enumerate_children (directory,
-                                         G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                         G_FILE_ATTRIBUTE_STANDARD_TYPE","
-                                         G_FILE_ATTRIBUTE_TIME_MODIFIED,
-                                         G_FILE_QUERY_INFO_NONE,
-                                         cancellable,
-                                         NULL);
-
-  if (file_enum == NULL)
-    return;
+  descend = get_depth (relative_path) + 1 < MAX_MINE_DEPTH;
 
-  while ((file_info_ptr = g_file_enumerator_next_file (file_enum, cancellable, NULL)))
+  for (guint i = 0; i < children->len; i++)
     {
-      g_autoptr(GFileInfo) file_info = file_info_ptr;
-      const gchar *filename;
-      GFileType file_type;
-      GFile *child;
+      GFileInfo *file_info = g_ptr_array_index (children, i);
+      const gchar *filename = g_file_info_get_name (file_info);
 
-      file_type = g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_STANDARD_TYPE);
-      filename = g_file_info_get_attribute_byte_string (file_info, G_FILE_ATTRIBUTE_STANDARD_NAME);
-
-      if (filename && filename [0] == '.')
+      if (filename [0] == '.')
         continue;
 
-      switch (file_type)
+      if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_REGULAR &&
+          ((0 == g_strcmp0 (filename, "configure.ac")) ||
+           (0 == g_strcmp0 (filename, "configure.in"))))
         {
-        case G_FILE_TYPE_DIRECTORY:
-          if (directories == NULL)
-            directories = g_ptr_array_new_with_free_func (g_object_unref);
-          child = g_file_get_child (directory, filename);
-          g_ptr_array_add (directories, child);
-          break;
-
-        case G_FILE_TYPE_REGULAR:
-          if ((0 == g_strcmp0 (filename, "configure.ac")) ||
-              (0 == g_strcmp0 (filename, "configure.in")))
-            {
-              ide_autotools_project_miner_discovered (self, cancellable, directory, file_info);
-              g_clear_object (&file_info);
-              return;
-            }
-          break;
-
-        case G_FILE_TYPE_UNKNOWN:
-        case G_FILE_TYPE_SYMBOLIC_LINK:
-        case G_FILE_TYPE_SPECIAL:
-        case G_FILE_TYPE_SHORTCUT:
-        case G_FILE_TYPE_MOUNTABLE:
-        default:
+          ide_autotools_project_miner_discovered (state->self, state->cancellable, directory, file_info);
+          descend = FALSE;
           break;
         }
     }
 
-  if (directories != NULL)
+  /* Prune what we do not want crawled, everything once a project is found */
+  for (guint i = children->len; i > 0; i--)
     {
-      gsize i;
+      GFileInfo *file_info = g_ptr_array_index (children, i - 1);
+      const gchar *filename = g_file_info_get_name (file_info);
+      g_autoptr(GFile) child = NULL;
+
+      if (g_file_info_get_file_type (file_info) != G_FILE_TYPE_DIRECTORY)
+        continue;
 
-      for (i = 0; i < directories->len; i++)
+      if (descend && filename [0] != '.')
         {
-          GFile *child = g_ptr_array_index (directories, i);
-          ide_autotools_project_miner_mine_directory (self, child, depth + 1, cancellable);
+          child = g_file_get_child (directory, filename);
+
+          if (!directory_is_ignored (child))
+            continue;
         }
+
+      g_ptr_array_remove_index (children, i - 1);
     }
 }
 
+static void
+ide_autotools_project_miner_mine_directory (IdeAutotoolsProjectMiner *self,
+                                            GFile                    *directory,
+                                            GCancellable             *cancellable)
+{
+  g_autoptr(IdeDirectoryCrawler) crawler = NULL;
+  MineState state = { self, cancellable };
+
+  g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
+  g_assert (G_IS_FILE (directory));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  if (directory_is_ignored (directory))
+    return;
+
+  crawler = ide_directory_crawler_new (directory);
+  ide_directory_crawler_set_attributes (crawler, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  ide_directory_crawler_subscribe (crawler, ide_autotools_project_miner_crawl_cb, &state, NULL);
+  ide_directory_crawler_crawl (crawler, cancellable, NULL);
+}
+
 static void
 ide_autotools_project_miner_worker (GTask        *task,
                                     gpointer      source_object,
@@ -303,7 +321,7 @@ ide_autotools_project_miner_worker (GTask        *task,
   g_assert (G_IS_FILE (directory));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  ide_autotools_project_miner_mine_directory (self, directory, 0, cancellable);
+  ide_autotools_project_miner_mine_directory (self, directory, cancellable);
 
   g_task_return_boolean (task, TRUE);
 
@@ -43,12 +43,46 @@
 #define FAKE_VALAC   "__LIBIDE_FAKE_VALAC__"
 #define PRINT_VARS   "include Makefile\nprint-%: ; @echo $* = $($*)\n"
 
+/*
+ * The targets index maps the basename of each prerequisite found in the
+ * make database to the targets that depend on it. It is saved next to the
+ * makecache, and is only valid for a makecache of the same size and
+ * modification time, in microseconds.
+ */
+#define TARGETS_INDEX_VERSION 3
+#define TARGETS_INDEX_TYPE    "(utt(a{sa(mss)}a{s(asas)}))"
+
+/*
+ * Flags discovered by running make once per subdirectory are saved next to
+ * the makecache too, keyed by subdirectory and then by source path.
+ */
+#define BATCH_FLAGS_VERSION 2
+#define BATCH_FLAGS_TYPE    "(utta{sa{sas}})"
+
+/*
+ * How long to wait for another thread running make within the same
+ * subdirectory before falling back to running make for the file alone.
+ */
+#define BATCH_WAIT_TIMEOUT_USEC (30 * G_USEC_PER_SEC)
+
 struct _IdeMakecache
 {
   IdeObject     parent_instance;
 
   GFile        *parent;
   GMappedFile  *mapped;
+  gchar        *cache_path;
+  guint64       cache_size;
+  guint64       cache_mtime;
+  GVariant     *targets_index;
+  GVariant     *subdirs_index;
+  GHashTable   *targets_by_name;
+  GMutex        batch_mutex;
+  GCond         batch_cond;
+  GHashTable   *batch_flags;
+  GHashTable   *batch_pending;
+  /* Orders writes of the .flags file, taken before batch_mutex */
+  GMutex        batch_save_mutex;
   EggTaskCache *file_targets_cache;
   EggTaskCache *file_flags_cache;
   GPtrArray    *build_targets;
@@ -66,10 +100,22 @@ typedef struct
 
 typedef struct
 {
-  GMappedFile *mapped;
-  gchar       *path;
+  GHashTable *targets_by_name;
+  gchar      *path;
 } FileTargetsLookup;
 
+typedef struct
+{
+  GHashTable *targets;
+  GHashTable *sources;
+} SubdirIndex;
+
+typedef struct
+{
+  IdeMakecache *self;
+  GHashTable   *flags;
+} BatchInsert;
+
 G_DEFINE_TYPE (IdeMakecache, ide_makecache, IDE_TYPE_OBJECT)
 
 EGG_DEFINE_COUNTER (instances, "IdeMakecache", "Instances", "The number of IdeMakecache")
@@ -92,10 +138,30 @@ file_targets_lookup_free (gpointer data)
   FileTargetsLookup *lookup = data;
 
   g_clear_pointer (&lookup->path, g_free);
-  g_clear_pointer (&lookup->mapped, g_mapped_file_unref);
+  g_clear_pointer (&lookup->targets_by_name, g_hash_table_unref);
   g_slice_free (FileTargetsLookup, lookup);
 }
 
+static void
+subdir_index_free (gpointer data)
+{
+  SubdirIndex *index = data;
+
+  g_clear_pointer (&index->targets, g_hash_table_unref);
+  g_clear_pointer (&index->sources, g_hash_table_unref);
+  g_slice_free (SubdirIndex, index);
+}
+
+static void
+batch_insert_free (gpointer data)
+{
+  BatchInsert *insert = data;
+
+  g_clear_object (&insert->self);
+  g_clear_pointer (&insert->flags, g_hash_table_unref);
+  g_slice_free (BatchInsert, insert);
+}
+
 static gboolean
 file_is_clangable (GFile *file)
 {
@@ -141,70 +207,127 @@ is_target_interesting (const gchar *target)
            g_str_has_suffix (target, ".o")));
 }
 
+static gboolean
+is_source_file (const gchar *name,
+                gsize        len)
+{
+  static const gchar *suffixes[] = {
+    ".c", ".cc", ".cpp", ".cxx", ".c++", ".C", ".m", ".mm", ".vala", ".gs",
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (suffixes); i++)
+    {
+      gsize suffix_len = strlen (suffixes[i]);
+
+      if (len > suffix_len && memcmp (name + len - suffix_len, suffixes[i], suffix_len) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+add_source_for_subdir (GHashTable  *by_subdir,
+                       const gchar *subdir,
+                       const gchar *target,
+                       const gchar *source,
+                       gsize        source_len)
+{
+  SubdirIndex *index;
+
+  if (!(index = g_hash_table_lookup (by_subdir, subdir ?: "")))
+    {
+      index = g_slice_new0 (SubdirIndex);
+      index->targets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      index->sources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      g_hash_table_insert (by_subdir, g_strdup (subdir ?: ""), index);
+    }
+
+  if (!g_hash_table_contains (index->targets, target))
+    g_hash_table_add (index->targets, g_strdup (target));
+
+  g_hash_table_add (index->sources, g_strndup (source, source_len));
+}
+
+static void
+add_target_for_name (GHashTable  *by_name,
+                     const gchar *name,
+                     gsize        name_len,
+                     const gchar *subdir,
+                     const gchar *target)
+{
+  g_autofree gchar *key = g_strndup (name, name_len);
+  GPtrArray *targets;
+  IdeMakecacheTarget *item;
+
+  if (!(targets = g_hash_table_lookup (by_name, key)))
+    {
+      targets = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_makecache_target_unref);
+      g_hash_table_insert (by_name, g_steal_pointer (&key), targets);
+    }
+
+  item = ide_makecache_target_new (subdir, target);
+
+  for (guint i = 0; i < targets->len; i++)
+    {
+      if (ide_makecache_target_equal (item, g_ptr_array_index (targets, i)))
+        {
+          ide_makecache_target_unref (item);
+          return;
+        }
+    }
+
+  g_ptr_array_add (targets, item);
+}
+
 /**
- * ide_makecache_get_file_targets_searched:
+ * ide_makecache_build_targets_index:
  *
- * Returns: (transfer container): A #GPtrArray of #IdeMakecacheTarget.
+ * Scans the make database once, collecting the targets each prerequisite
+ * is found in, keyed by the basename of the prerequisite. This matches a
+ * line of the form "target: ... name ..." the same way we used to find
+ * targets for a single file.
+ *
+ * While we are here, we also collect the interesting targets and their
+ * source prerequisites for each subdirectory so that flags for a whole
+ * subdirectory can be extracted with a single dry run of make.
+ *
+ * Returns: (transfer full): A #GVariant of type "(a{sa(mss)}a{s(asas)})".
  */
-static GPtrArray *
-ide_makecache_get_file_targets_searched (GMappedFile *mapped,
-                                         const gchar *path)
+static GVariant *
+ide_makecache_build_targets_index (GMappedFile *mapped)
 {
-  g_autofree gchar *escaped = NULL;
-  g_autofree gchar *name = NULL;
-  g_autofree gchar *regexstr = NULL;
+  g_autoptr(GHashTable) by_name = NULL;
+  g_autoptr(GHashTable) by_subdir = NULL;
   g_autofree gchar *subdir = NULL;
-  g_autoptr(GHashTable) found = NULL;
-  g_autoptr(GPtrArray) targets = NULL;
-  g_autoptr(GRegex) regex = NULL;
+  GVariantBuilder builder;
+  GHashTableIter iter;
   const gchar *content;
   const gchar *line;
   IdeLineReader rl;
+  gpointer key, value;
   gsize len;
   gsize line_len;
 
   IDE_ENTRY;
 
-  g_assert (path);
-
-  /*
-   * TODO:
-   *
-   * We can end up with the same filename in multiple subdirectories. We should be careful about
-   * that later when we extract flags to choose the best match first.
-   */
-  name = g_path_get_basename (path);
-  escaped = g_regex_escape_string (name, -1);
-  regexstr = g_strdup_printf ("^([^:\n ]+):.*\\b(%s)\\b", escaped);
-
-  regex = g_regex_new (regexstr, 0, 0, NULL);
-  if (!regex)
-    IDE_RETURN (NULL);
+  g_assert (mapped != NULL);
 
   content = g_mapped_file_get_contents (mapped);
   len = g_mapped_file_get_length (mapped);
 
-  targets = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_makecache_target_unref);
-  found = g_hash_table_new (ide_makecache_target_hash, ide_makecache_target_equal);
-
-#ifdef IDE_ENABLE_TRACE
-  {
-    gchar *fmtsize;
-
-    fmtsize = g_format_size (len);
-    IDE_TRACE_MSG ("Beginning regex lookup across %s of UTF-8 text", fmtsize);
-    g_free (fmtsize);
-  }
-#endif
-
-  if (len > G_MAXSSIZE)
-    IDE_RETURN (NULL);
+  by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                   (GDestroyNotify)g_ptr_array_unref);
+  by_subdir = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, subdir_index_free);
 
   ide_line_reader_init (&rl, (gchar *)content, len);
 
   while ((line = ide_line_reader_next (&rl, &line_len)))
     {
-      g_autoptr(GMatchInfo) match_info = NULL;
+      g_autofree gchar *target = NULL;
+      const gchar *colon;
+      const gchar *end = line + line_len;
+      const gchar *iter_pos;
 
       /*
        * Keep track of "subdir = <dir>" changes so we know what directory
@@ -217,33 +340,362 @@ ide_makecache_get_file_targets_searched (GMappedFile *mapped,
           continue;
         }
 
-      if (g_regex_match_full (regex, line, line_len, 0, 0, &match_info, NULL))
+      /* Rules start with the target, up to the first colon */
+      if (line_len == 0 ||
+          NULL == (colon = memchr (line, ':', line_len)) ||
+          colon == line ||
+          memchr (line, ' ', colon - line) != NULL)
+        continue;
+
+      target = g_strndup (line, colon - line);
+
+      if (!is_target_interesting (target))
+        continue;
+
+      /* Index the basename of every prerequisite */
+      for (iter_pos = colon + 1; iter_pos < end; )
         {
-          while (g_match_info_matches (match_info))
+          const gchar *word;
+          const gchar *name;
+
+          while (iter_pos < end && g_ascii_isspace (*iter_pos))
+            iter_pos++;
+
+          for (word = name = iter_pos; iter_pos < end && !g_ascii_isspace (*iter_pos); iter_pos++)
             {
-              g_autofree gchar *targetstr = NULL;
+              if (*iter_pos == G_DIR_SEPARATOR)
+                name = iter_pos + 1;
+            }
 
-              targetstr = g_match_info_fetch (match_info, 1);
+          if (iter_pos > name && *word != ':')
+            {
+              add_target_for_name (by_name, name, iter_pos - name, subdir, target);
 
-              if (is_target_interesting (targetstr))
-                {
-                  g_autoptr(IdeMakecacheTarget) target = NULL;
+              if (is_source_file (word, iter_pos - word))
+                add_source_for_subdir (by_subdir, subdir, target, word, iter_pos - word);
+            }
+        }
+    }
 
-                  target = ide_makecache_target_new (subdir, targetstr);
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("(a{sa(mss)}a{s(asas)})"));
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sa(mss)}"));
 
-                  if (!g_hash_table_contains (found, target))
-                    {
-                      g_hash_table_insert (found, target, NULL);
-                      g_ptr_array_add (targets, g_steal_pointer (&target));
-                    }
-                }
+  g_hash_table_iter_init (&iter, by_name);
 
-              g_match_info_next (match_info, NULL);
-            }
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GPtrArray *targets = value;
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sa(mss)}"));
+      g_variant_builder_add (&builder, "s", key);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(mss)"));
+
+      for (guint i = 0; i < targets->len; i++)
+        {
+          IdeMakecacheTarget *target = g_ptr_array_index (targets, i);
+
+          g_variant_builder_add (&builder,
+                                 "(mss)",
+                                 ide_makecache_target_get_subdir (target),
+                                 ide_makecache_target_get_target (target));
         }
+
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+
+  g_variant_builder_close (&builder);
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{s(asas)}"));
+
+  g_hash_table_iter_init (&iter, by_subdir);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      SubdirIndex *index = value;
+      g_autofree const gchar **targets = NULL;
+      g_autofree const gchar **sources = NULL;
+
+      targets = (const gchar **)g_hash_table_get_keys_as_array (index->targets, NULL);
+      sources = (const gchar **)g_hash_table_get_keys_as_array (index->sources, NULL);
+
+      g_variant_builder_add (&builder, "{s(^as^as)}", key, targets, sources);
     }
 
-  IDE_TRACE_MSG ("Regex scan complete");
+  g_variant_builder_close (&builder);
+
+  IDE_TRACE_MSG ("Indexed %u prerequisites in %u subdirectories",
+                 g_hash_table_size (by_name),
+                 g_hash_table_size (by_subdir));
+
+  IDE_RETURN (g_variant_ref_sink (g_variant_builder_end (&builder)));
+}
+
+static GVariant *
+ide_makecache_load_targets_index (const gchar *index_path,
+                                  guint64      cache_size,
+                                  guint64      cache_mtime)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  guint32 version = 0;
+  guint64 size = 0;
+  guint64 mtime = 0;
+  GVariant *index = NULL;
+
+  g_assert (index_path != NULL);
+
+  if (!(mapped = g_mapped_file_new (index_path, FALSE, NULL)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (TARGETS_INDEX_TYPE), bytes, FALSE);
+  g_variant_ref_sink (variant);
+
+  g_variant_get (variant, "(utt@(a{sa(mss)}a{s(asas)}))", &version, &size, &mtime, &index);
+
+  if (version != TARGETS_INDEX_VERSION || size != cache_size || mtime != cache_mtime)
+    g_clear_pointer (&index, g_variant_unref);
+
+  return index;
+}
+
+static void
+ide_makecache_save_targets_index (const gchar *index_path,
+                                  guint64      cache_size,
+                                  guint64      cache_mtime,
+                                  GVariant    *index)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (index_path != NULL);
+  g_assert (index != NULL);
+
+  variant = g_variant_new ("(utt@(a{sa(mss)}a{s(asas)}))",
+                           TARGETS_INDEX_VERSION,
+                           cache_size,
+                           cache_mtime,
+                           index);
+  g_variant_ref_sink (variant);
+
+  if (!g_file_set_contents (index_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_warning ("Failed to save makecache targets index: %s", error->message);
+}
+
+/*
+ * Loads the targets index from beside the makecache, or builds and saves
+ * it when it is missing or stale. Called once from the validate worker.
+ */
+static void
+ide_makecache_ensure_targets_index (IdeMakecache *self)
+{
+  g_autoptr(GVariant) by_name = NULL;
+  g_autofree gchar *index_path = NULL;
+  GVariantIter iter;
+  GVariant *targets;
+  const gchar *name;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (self->cache_path != NULL);
+  g_assert (self->targets_index == NULL);
+
+  index_path = g_strdup_printf ("%s.targets", self->cache_path);
+
+  if (!(self->targets_index = ide_makecache_load_targets_index (index_path, self->cache_size, self->cache_mtime)))
+    {
+      self->targets_index = ide_makecache_build_targets_index (self->mapped);
+      ide_makecache_save_targets_index (index_path, self->cache_size, self->cache_mtime, self->targets_index);
+    }
+
+  g_variant_get (self->targets_index, "(@a{sa(mss)}@a{s(asas)})", &by_name, &self->subdirs_index);
+
+  /* Keys and values point into the index, which we keep alive */
+  self->targets_by_name = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                 (GDestroyNotify)g_variant_unref);
+
+  g_variant_iter_init (&iter, by_name);
+  while (g_variant_iter_next (&iter, "{&s@a(mss)}", &name, &targets))
+    g_hash_table_insert (self->targets_by_name, (gchar *)name, targets);
+
+  IDE_EXIT;
+}
+
+/*
+ * Loads the flags discovered by previous batch runs of make, as long as they
+ * were discovered from a makecache of the same size and modification time.
+ * Called once from the validate worker.
+ */
+static void
+ide_makecache_load_batch_flags (IdeMakecache *self)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GVariant) subdirs = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autofree gchar *flags_path = NULL;
+  GVariantIter iter;
+  GVariantIter *paths;
+  const gchar *subdir;
+  guint32 version = 0;
+  guint64 size = 0;
+  guint64 mtime = 0;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (self->cache_path != NULL);
+
+  flags_path = g_strdup_printf ("%s.flags", self->cache_path);
+
+  if (!(mapped = g_mapped_file_new (flags_path, FALSE, NULL)))
+    IDE_EXIT;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (BATCH_FLAGS_TYPE), bytes, FALSE);
+  g_variant_ref_sink (variant);
+
+  g_variant_get (variant, "(utt@a{sa{sas}})", &version, &size, &mtime, &subdirs);
+
+  if (version != BATCH_FLAGS_VERSION || size != self->cache_size || mtime != self->cache_mtime)
+    IDE_EXIT;
+
+  g_variant_iter_init (&iter, subdirs);
+
+  while (g_variant_iter_next (&iter, "{&sa{sas}}", &subdir, &paths))
+    {
+      GHashTable *flags;
+      gchar *path;
+      gchar **argv;
+
+      flags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_strfreev);
+
+      while (g_variant_iter_next (paths, "{s^as}", &path, &argv))
+        g_hash_table_insert (flags, path, argv);
+
+      g_hash_table_insert (self->batch_flags, g_strdup (subdir), flags);
+
+      g_variant_iter_free (paths);
+    }
+
+  IDE_TRACE_MSG ("Loaded batched flags for %u subdirectories",
+                 g_hash_table_size (self->batch_flags));
+
+  IDE_EXIT;
+}
+
+/*
+ * Saves the flags for all subdirectories we have run make within. This must
+ * be called without batch_mutex held, which is only taken to copy the table
+ * so that lookups are not blocked while we serialize and write it.
+ */
+static void
+ide_makecache_save_batch_flags (IdeMakecache *self)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GHashTable) batch_flags = NULL;
+  g_autofree gchar *flags_path = NULL;
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  g_mutex_lock (&self->batch_save_mutex);
+
+  /* The tables of flags are never modified once inserted, so sharing them is enough */
+  batch_flags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)g_hash_table_unref);
+
+  g_mutex_lock (&self->batch_mutex);
+  g_hash_table_iter_init (&iter, self->batch_flags);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (batch_flags, g_strdup (key), g_hash_table_ref (value));
+  g_mutex_unlock (&self->batch_mutex);
+
+  flags_path = g_strdup_printf ("%s.flags", self->cache_path);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (BATCH_FLAGS_TYPE));
+  g_variant_builder_add (&builder, "u", BATCH_FLAGS_VERSION);
+  g_variant_builder_add (&builder, "t", self->cache_size);
+  g_variant_builder_add (&builder, "t", self->cache_mtime);
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sa{sas}}"));
+
+  g_hash_table_iter_init (&iter, batch_flags);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GHashTableIter piter;
+      gpointer path, argv;
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("{sa{sas}}"));
+      g_variant_builder_add (&builder, "s", key);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sas}"));
+
+      g_hash_table_iter_init (&piter, value);
+      while (g_hash_table_iter_next (&piter, &path, &argv))
+        g_variant_builder_add (&builder, "{s^as}", path, argv);
+
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+
+  g_variant_builder_close (&builder);
+
+  variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  if (!g_file_set_contents (flags_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_warning ("Failed to save makecache flags: %s", error->message);
+
+  g_mutex_unlock (&self->batch_save_mutex);
+}
+
+/**
+ * ide_makecache_get_file_targets_indexed:
+ *
+ * Returns: (transfer container): A #GPtrArray of #IdeMakecacheTarget.
+ */
+static GPtrArray *
+ide_makecache_get_file_targets_indexed (GHashTable  *targets_by_name,
+                                        const gchar *path)
+{
+  g_autofree gchar *name = NULL;
+  g_autoptr(GPtrArray) targets = NULL;
+  const gchar *subdir;
+  const gchar *target;
+  GVariantIter iter;
+  GVariant *entries;
+
+  IDE_ENTRY;
+
+  g_assert (targets_by_name != NULL);
+  g_assert (path);
+
+  /*
+   * TODO:
+   *
+   * We can end up with the same filename in multiple subdirectories. We should be careful about
+   * that later when we extract flags to choose the best match first.
+   */
+  name = g_path_get_basename (path);
+
+  if (!(entries = g_hash_table_lookup (targets_by_name, name)))
+    IDE_RETURN (NULL);
+
+  targets = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_makecache_target_unref);
+
+  g_variant_iter_init (&iter, entries);
+  while (g_variant_iter_next (&iter, "(m&s&s)", &subdir, &target))
+    g_ptr_array_add (targets, ide_makecache_target_new (subdir, target));
 
   if (targets->len > 0)
     {
@@ -257,7 +709,6 @@ ide_makecache_get_file_targets_searched (GMappedFile *mapped,
         for (i = 0; i < targets->len; i++)
           {
             const gchar *target_subdir;
-            const gchar *target;
             IdeMakecacheTarget *cur;
 
             cur = g_ptr_array_index (targets, i);
@@ -277,9 +728,7 @@ ide_makecache_get_file_targets_searched (GMappedFile *mapped,
       }
 #endif
 
-      g_ptr_array_ref (targets);
-
-      IDE_RETURN (targets);
+      IDE_RETURN (g_steal_pointer (&targets));
     }
 
   IDE_RETURN (NULL);
@@ -605,6 +1054,413 @@ ide_makecache_parse_line (IdeMakecache *self,
   IDE_RETURN (NULL);
 }
 
+/*
+ * Runs make as a dry run within @subdir using the fake compilers, and
+ * returns the lines of output with escaped newlines joined.
+ */
+static gchar **
+ide_makecache_dry_run (IdeMakecache        *self,
+                       const gchar         *subdir,
+                       const gchar * const *args,
+                       GCancellable        *cancellable,
+                       GError             **error)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autoptr(GPtrArray) argv = NULL;
+  g_autofree gchar *stdoutstr = NULL;
+  g_autofree gchar *cwd = NULL;
+  gchar **lines;
+  gchar *tmp;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (args != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  cwd = g_file_get_path (self->parent);
+
+  argv = g_ptr_array_new ();
+  g_ptr_array_add (argv, (gchar *)self->make_name);
+  g_ptr_array_add (argv, "-C");
+  g_ptr_array_add (argv, (gchar *)(subdir ?: "."));
+  g_ptr_array_add (argv, "-s");
+  g_ptr_array_add (argv, "-i");
+  g_ptr_array_add (argv, "-n");
+  for (guint i = 0; args [i]; i++)
+    g_ptr_array_add (argv, (gchar *)args [i]);
+  g_ptr_array_add (argv, "V=1");
+  g_ptr_array_add (argv, "CC="FAKE_CC);
+  g_ptr_array_add (argv, "CXX="FAKE_CXX);
+  g_ptr_array_add (argv, "VALAC="FAKE_VALAC);
+  g_ptr_array_add (argv, NULL);
+
+#ifdef IDE_ENABLE_TRACE
+  {
+    gchar *cmdline;
+
+    cmdline = g_strjoinv (" ", (gchar **)argv->pdata);
+    IDE_TRACE_MSG ("subdir=%s %s", subdir ?: ".", cmdline);
+    g_free (cmdline);
+  }
+#endif
+
+  if (!(launcher = ide_runtime_create_launcher (self->runtime, error)))
+    IDE_RETURN (NULL);
+
+  ide_subprocess_launcher_set_flags (launcher, (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                                G_SUBPROCESS_FLAGS_STDERR_SILENCE));
+  ide_subprocess_launcher_set_cwd (launcher, cwd);
+  ide_subprocess_launcher_push_args (launcher, (const gchar * const *)argv->pdata);
+
+  if (!(subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, error)))
+    IDE_RETURN (NULL);
+
+  /* Don't let ourselves be cancelled from this operation */
+  if (!ide_subprocess_communicate_utf8 (subprocess, NULL, NULL, &stdoutstr, NULL, error))
+    IDE_RETURN (NULL);
+
+  /*
+   * Replace escaped newlines with " " to simplify command parsing
+   */
+  tmp = stdoutstr;
+  while (NULL != (tmp = strstr (tmp, "\\\n")))
+    {
+      tmp[0] = ' ';
+      tmp[1] = ' ';
+    }
+
+  lines = g_strsplit (stdoutstr, "\n", 0);
+
+  for (guint i = 0; lines [i]; i++)
+    {
+      gchar *line = lines [i];
+      gsize linelen = strlen (line);
+
+      if (linelen > 0 && line [linelen - 1] == '\\')
+        line [linelen - 1] = '\0';
+    }
+
+  IDE_RETURN (lines);
+}
+
+/*
+ * Locates the source files compiled by a fake compiler invocation, such as
+ * those found in the output of ide_makecache_dry_run(). Automake wraps the
+ * source in something like `test -f 'foo.c' || echo '$(srcdir)/'`foo.c so
+ * we take the last source found for C and C++, where the srcdir variant is
+ * the last argument. Vala compiles all of its sources in one invocation.
+ *
+ * Returns: (transfer full) (nullable): A #GPtrArray of absolute paths.
+ */
+static GPtrArray *
+ide_makecache_parse_line_sources (IdeMakecache *self,
+                                  const gchar  *line,
+                                  const gchar  *subdir)
+{
+  g_autoptr(GPtrArray) ret = NULL;
+  g_autofree gchar *parent = NULL;
+  g_autofree gchar *last = NULL;
+  g_auto(GStrv) argv = NULL;
+  gboolean is_vala = FALSE;
+  const gchar *pos;
+  gint argc = 0;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (line != NULL);
+  g_assert (subdir != NULL);
+
+  if ((pos = strstr (line, FAKE_CXX)))
+    {
+      pos += strlen (FAKE_CXX);
+    }
+  else if ((pos = strstr (line, FAKE_CC)))
+    {
+      pos += strlen (FAKE_CC);
+    }
+  else if ((pos = strstr (line, FAKE_VALAC)))
+    {
+      pos += strlen (FAKE_VALAC);
+      is_vala = TRUE;
+    }
+  else
+    return NULL;
+
+  if (!g_shell_parse_argv (pos, &argc, &argv, NULL))
+    return NULL;
+
+  parent = g_file_get_path (self->parent);
+  ret = g_ptr_array_new_with_free_func (g_free);
+
+  for (gint i = 0; i < argc; i++)
+    {
+      g_autofree gchar *word = NULL;
+      g_autofree gchar *path = NULL;
+      g_autoptr(GFile) file = NULL;
+      g_autoptr(GFile) translated = NULL;
+      gchar *out;
+
+      if (argv [i][0] == '-' || !is_source_file (argv [i], strlen (argv [i])))
+        continue;
+
+      /* Drop the backticks from the automake srcdir dance */
+      word = g_strdup (argv [i]);
+      for (const gchar *in = out = word; *in; in++)
+        {
+          if (*in != '`')
+            *out++ = *in;
+        }
+      *out = '\0';
+
+      if (g_path_is_absolute (word))
+        file = g_file_new_for_path (word);
+      else
+        {
+          path = g_build_filename (parent, subdir, word, NULL);
+          file = g_file_new_for_path (path);
+        }
+
+      translated = ide_runtime_translate_file (self->runtime, file);
+
+      if (is_vala)
+        g_ptr_array_add (ret, g_file_get_path (translated));
+      else
+        {
+          g_free (last);
+          last = g_file_get_path (translated);
+        }
+    }
+
+  if (last != NULL)
+    g_ptr_array_add (ret, g_steal_pointer (&last));
+
+  if (ret->len == 0)
+    return NULL;
+
+  return g_steal_pointer (&ret);
+}
+
+/*
+ * Runs make once for all of the interesting targets in @subdir, marking all
+ * of their sources as modified, and collects the flags for every source
+ * that was compiled.
+ *
+ * Returns: (transfer full): A #GHashTable of source path to flags.
+ */
+static GHashTable *
+ide_makecache_run_batch (IdeMakecache  *self,
+                         const gchar   *subdir,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  g_autoptr(GHashTable) ret = NULL;
+  g_autoptr(GPtrArray) args = NULL;
+  g_autofree const gchar **targets = NULL;
+  g_autofree const gchar **sources = NULL;
+  g_auto(GStrv) lines = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (subdir != NULL);
+
+  ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_strfreev);
+
+  if (self->subdirs_index == NULL ||
+      !g_variant_lookup (self->subdirs_index, subdir, "(^a&s^a&s)", &targets, &sources))
+    IDE_RETURN (g_steal_pointer (&ret));
+
+  args = g_ptr_array_new ();
+
+  for (guint i = 0; sources [i]; i++)
+    {
+      g_ptr_array_add (args, "-W");
+      g_ptr_array_add (args, (gchar *)sources [i]);
+    }
+
+  for (guint i = 0; targets [i]; i++)
+    g_ptr_array_add (args, (gchar *)targets [i]);
+
+  g_ptr_array_add (args, NULL);
+
+  if (!(lines = ide_makecache_dry_run (self,
+                                       *subdir ? subdir : NULL,
+                                       (const gchar * const *)args->pdata,
+                                       cancellable,
+                                       error)))
+    IDE_RETURN (NULL);
+
+  for (guint i = 0; lines [i]; i++)
+    {
+      g_autoptr(GPtrArray) paths = NULL;
+      g_auto(GStrv) flags = NULL;
+      const gchar *line = lines [i];
+
+      if (line [0] == '\0')
+        continue;
+
+      if (!(paths = ide_makecache_parse_line_sources (self, line, *subdir ? subdir : ".")))
+        continue;
+
+      if (!(flags = ide_makecache_parse_line (self, line, g_ptr_array_index (paths, 0), *subdir ? subdir : ".")))
+        continue;
+
+      /* Like the single file lookup, the first invocation wins */
+      for (guint j = 0; j < paths->len; j++)
+        {
+          const gchar *path = g_ptr_array_index (paths, j);
+
+          if (!g_hash_table_contains (ret, path))
+            g_hash_table_insert (ret, g_strdup (path), g_strdupv (flags));
+        }
+    }
+
+  IDE_TRACE_MSG ("Extracted flags for %u files in subdir \"%s\"",
+                 g_hash_table_size (ret), subdir);
+
+  IDE_RETURN (g_steal_pointer (&ret));
+}
+
+static gboolean
+ide_makecache_insert_batch_flags (gpointer data)
+{
+  BatchInsert *insert = data;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_assert (insert != NULL);
+  g_assert (IDE_IS_MAKECACHE (insert->self));
+
+  g_hash_table_iter_init (&iter, insert->flags);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_autoptr(GFile) file = g_file_new_for_path (key);
+
+      egg_task_cache_insert (insert->self->file_flags_cache, file, value);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_makecache_batch_cancelled (GCancellable *cancellable,
+                               IdeMakecache *self)
+{
+  g_assert (G_IS_CANCELLABLE (cancellable));
+  g_assert (IDE_IS_MAKECACHE (self));
+
+  /* Wake up waiters so they notice the cancellation */
+  g_mutex_lock (&self->batch_mutex);
+  g_cond_broadcast (&self->batch_cond);
+  g_mutex_unlock (&self->batch_mutex);
+}
+
+/*
+ * Gets the flags for @path from the batch run of make within @subdir,
+ * running make if no other thread has done so yet. Every file compiled by
+ * that run is added to the flags cache as well, so that opening the rest of
+ * the files in @subdir does not need to spawn make again.
+ *
+ * While another thread runs make within @subdir we wait for it, unless
+ * @cancellable is cancelled or that takes too long, in which case %NULL is
+ * returned and the caller falls back to running make for @path alone.
+ *
+ * Returns: (transfer full) (nullable): The flags for @path or %NULL.
+ */
+static gchar **
+ide_makecache_get_batched_flags (IdeMakecache *self,
+                                 const gchar  *subdir,
+                                 const gchar  *path,
+                                 GCancellable *cancellable)
+{
+  g_autoptr(GHashTable) flags = NULL;
+  g_autoptr(GError) error = NULL;
+  const gchar *key = subdir ?: "";
+  gchar **ret = NULL;
+  gboolean waited_out = FALSE;
+  gulong cancelled_handler = 0;
+  gint64 deadline;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_MAKECACHE (self));
+  g_assert (path != NULL);
+
+  /* Must not hold batch_mutex, as this may call the handler right away */
+  if (cancellable != NULL)
+    cancelled_handler = g_cancellable_connect (cancellable,
+                                               G_CALLBACK (ide_makecache_batch_cancelled),
+                                               self, NULL);
+
+  deadline = g_get_monotonic_time () + BATCH_WAIT_TIMEOUT_USEC;
+
+  g_mutex_lock (&self->batch_mutex);
+
+  while (g_hash_table_contains (self->batch_pending, key))
+    {
+      if (g_cancellable_is_cancelled (cancellable) ||
+          !g_cond_wait_until (&self->batch_cond, &self->batch_mutex, deadline))
+        {
+          waited_out = g_hash_table_contains (self->batch_pending, key);
+          break;
+        }
+    }
+
+  if (!waited_out && (flags = g_hash_table_lookup (self->batch_flags, key)))
+    g_hash_table_ref (flags);
+  else if (!waited_out)
+    g_hash_table_add (self->batch_pending, g_strdup (key));
+
+  g_mutex_unlock (&self->batch_mutex);
+
+  /* Never called with batch_mutex held, since it waits for a running handler */
+  g_cancellable_disconnect (cancellable, cancelled_handler);
+
+  if (waited_out)
+    IDE_RETURN (NULL);
+
+  if (flags != NULL)
+    IDE_RETURN (g_strdupv (g_hash_table_lookup (flags, path)));
+
+  flags = ide_makecache_run_batch (self, key, cancellable, &error);
+
+  if (flags == NULL)
+    g_debug ("Failed to extract flags for subdir \"%s\": %s", key, error->message);
+
+  /* A cancelled run should be retried by the next lookup */
+  if (flags != NULL && g_cancellable_is_cancelled (cancellable))
+    g_clear_pointer (&flags, g_hash_table_unref);
+
+  g_mutex_lock (&self->batch_mutex);
+  if (flags != NULL)
+    g_hash_table_insert (self->batch_flags, g_strdup (key), g_hash_table_ref (flags));
+  g_hash_table_remove (self->batch_pending, key);
+  g_cond_broadcast (&self->batch_cond);
+  g_mutex_unlock (&self->batch_mutex);
+
+  if (flags != NULL)
+    {
+      BatchInsert *insert;
+
+      ide_makecache_save_batch_flags (self);
+
+      insert = g_slice_new0 (BatchInsert);
+      insert->self = g_object_ref (self);
+      insert->flags = g_hash_table_ref (flags);
+
+      g_idle_add_full (G_PRIORITY_LOW,
+                       ide_makecache_insert_batch_flags,
+                       insert,
+                       batch_insert_free);
+
+      ret = g_strdupv (g_hash_table_lookup (flags, path));
+    }
+
+  IDE_RETURN (ret);
+}
+
 static void
 ide_makecache_get_file_flags_worker (GTask        *task,
                                      gpointer      source_object,
@@ -612,6 +1468,7 @@ ide_makecache_get_file_flags_worker (GTask        *task,
                                      GCancellable *cancellable)
 {
   FileFlagsLookup *lookup = task_data;
+  g_autofree gchar *path = NULL;
   gsize i;
   gsize j;
 
@@ -626,21 +1483,18 @@ ide_makecache_get_file_flags_worker (GTask        *task,
   g_assert (IDE_IS_MAKECACHE (lookup->self));
   g_assert (lookup->targets != NULL);
 
+  path = g_file_get_path (lookup->file);
+
   for (j = 0; j < lookup->targets->len; j++)
     {
       IdeMakecacheTarget *target;
-      g_autoptr(IdeSubprocessLauncher) launcher = NULL;
-      g_autoptr(IdeSubprocess) subprocess = NULL;
-      g_autoptr(GPtrArray) argv = NULL;
-      g_autofree gchar *stdoutstr = NULL;
-      g_autofree gchar *cwd = NULL;
+      const gchar *args[4] = { "-W", NULL, NULL, NULL };
       const gchar *subdir;
       const gchar *targetstr;
       const gchar *relpath;
       GError *error = NULL;
       gchar **lines;
       gchar **ret = NULL;
-      gchar *tmp;
 
       if (g_cancellable_is_cancelled (cancellable))
         break;
@@ -650,7 +1504,17 @@ ide_makecache_get_file_flags_worker (GTask        *task,
       subdir = ide_makecache_target_get_subdir (target);
       targetstr = ide_makecache_target_get_target (target);
 
-      cwd = g_file_get_path (lookup->self->parent);
+      /*
+       * Most of the time, the flags were extracted along with the rest of
+       * the sources in the subdirectory. Headers and anything else that is
+       * not compiled directly fall back to running make for this file.
+       */
+      if (path != NULL &&
+          (ret = ide_makecache_get_batched_flags (lookup->self, subdir, path, cancellable)))
+        {
+          g_task_return_pointer (task, ret, (GDestroyNotify)g_strfreev);
+          IDE_EXIT;
+        }
 
       if ((subdir != NULL) && g_str_has_prefix (lookup->relative_path, subdir))
         relpath = lookup->relative_path + strlen (subdir);
@@ -660,88 +1524,23 @@ ide_makecache_get_file_flags_worker (GTask        *task,
       while (*relpath == G_DIR_SEPARATOR)
         relpath++;
 
-      argv = g_ptr_array_new ();
-      g_ptr_array_add (argv, (gchar *)lookup->self->make_name);
-      g_ptr_array_add (argv, "-C");
-      g_ptr_array_add (argv, (gchar *)(subdir ?: "."));
-      g_ptr_array_add (argv, "-s");
-      g_ptr_array_add (argv, "-i");
-      g_ptr_array_add (argv, "-n");
-      g_ptr_array_add (argv, "-W");
-      g_ptr_array_add (argv, (gchar *)relpath);
-      g_ptr_array_add (argv, (gchar *)targetstr);
-      g_ptr_array_add (argv, "V=1");
-      g_ptr_array_add (argv, "CC="FAKE_CC);
-      g_ptr_array_add (argv, "CXX="FAKE_CXX);
-      g_ptr_array_add (argv, "VALAC="FAKE_VALAC);
-      g_ptr_array_add (argv, NULL);
+      args [1] = relpath;
+      args [2] = targetstr;
 
-#ifdef IDE_ENABLE_TRACE
-      {
-        gchar *cmdline;
-
-        cmdline = g_strjoinv (" ", (gchar **)argv->pdata);
-        IDE_TRACE_MSG ("subdir=%s %s", subdir ?: ".", cmdline);
-        g_free (cmdline);
-      }
-#endif
-
-      launcher = ide_runtime_create_launcher (lookup->self->runtime, &error);
-
-      if (launcher == NULL)
-        {
-          g_assert (error != NULL);
-          g_task_return_error (task, error);
-          IDE_EXIT;
-        }
-
-      ide_subprocess_launcher_set_flags (launcher, (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
-                                                    G_SUBPROCESS_FLAGS_STDERR_SILENCE));
-      ide_subprocess_launcher_set_cwd (launcher, cwd);
-      ide_subprocess_launcher_push_args (launcher, (const gchar * const *)argv->pdata);
-
-      subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, &error);
-
-      if (subprocess == NULL)
+      if (!(lines = ide_makecache_dry_run (lookup->self, subdir, args, cancellable, &error)))
         {
           g_assert (error != NULL);
           g_task_return_error (task, error);
           IDE_EXIT;
         }
 
-      /* Don't let ourselves be cancelled from this operation */
-      if (!ide_subprocess_communicate_utf8 (subprocess, NULL, NULL, &stdoutstr, NULL, &error))
-        {
-          g_assert (error != NULL);
-          g_task_return_error (task, error);
-          IDE_EXIT;
-        }
-
-      /*
-       * Replace escaped newlines with " " to simplify command parsing
-       */
-      tmp = stdoutstr;
-      while (NULL != (tmp = strstr (tmp, "\\\n")))
-        {
-          tmp[0] = ' ';
-          tmp[1] = ' ';
-        }
-
-      lines = g_strsplit (stdoutstr, "\n", 0);
-
       for (i = 0; lines [i]; i++)
         {
-          gchar *line = lines [i];
-          gsize linelen;
+          const gchar *line = lines [i];
 
           if (line [0] == '\0')
             continue;
 
-          linelen = strlen (line);
-
-          if (line [linelen - 1] == '\\')
-            line [linelen - 1] = '\0';
-
           if ((ret = ide_makecache_parse_line (lookup->self, line, relpath, subdir ?: ".")))
             break;
         }
@@ -809,7 +1608,7 @@ ide_makecache_get_file_targets_worker (GTask        *task,
   g_assert (EGG_IS_TASK_CACHE (source_object));
   g_assert (G_IS_TASK (task));
   g_assert (lookup != NULL);
-  g_assert (lookup->mapped != NULL);
+  g_assert (lookup->targets_by_name != NULL);
   g_assert (lookup->path != NULL);
 
   path = lookup->path;
@@ -821,7 +1620,7 @@ ide_makecache_get_file_targets_worker (GTask        *task,
   base = g_path_get_basename (path);
 
   /* we use an empty GPtrArray to get negative cache hits. a bit heavy handed? sure. */
-  if (!(ret = ide_makecache_get_file_targets_searched (lookup->mapped, path)))
+  if (!(ret = ide_makecache_get_file_targets_indexed (lookup->targets_by_name, path)))
     ret = g_ptr_array_new ();
 
   /* If we had a vala file, we might need to translate the target */
@@ -893,7 +1692,7 @@ ide_makecache_get_file_targets_dispatch (EggTaskCache  *cache,
   g_assert (G_IS_TASK (task));
 
   lookup = g_slice_new0 (FileTargetsLookup);
-  lookup->mapped = g_mapped_file_ref (self->mapped);
+  lookup->targets_by_name = g_hash_table_ref (self->targets_by_name);
 
   if (!(lookup->path = ide_makecache_get_relative_path (self, file)) &&
       !(lookup->path = g_file_get_path (file)) &&
@@ -1023,7 +1822,17 @@ ide_makecache_finalize (GObject *object)
   g_clear_object (&self->runtime);
   g_clear_object (&self->parent);
 
+  g_clear_pointer (&self->batch_flags, g_hash_table_unref);
+  g_clear_pointer (&self->batch_pending, g_hash_table_unref);
+  g_mutex_clear (&self->batch_mutex);
+  g_mutex_clear (&self->batch_save_mutex);
+  g_cond_clear (&self->batch_cond);
+
+  g_clear_pointer (&self->targets_by_name, g_hash_table_unref);
+  g_clear_pointer (&self->subdirs_index, g_variant_unref);
+  g_clear_pointer (&self->targets_index, g_variant_unref);
   g_clear_pointer (&self->mapped, g_mapped_file_unref);
+  g_clear_pointer (&self->cache_path, g_free);
   g_clear_pointer (&self->build_targets, g_ptr_array_unref);
 
   G_OBJECT_CLASS (ide_makecache_parent_class)->finalize (object);
@@ -1046,6 +1855,13 @@ ide_makecache_init (IdeMakecache *self)
 
   self->make_name = "make";
 
+  g_mutex_init (&self->batch_mutex);
+  g_mutex_init (&self->batch_save_mutex);
+  g_cond_init (&self->batch_cond);
+  self->batch_flags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)g_hash_table_unref);
+  self->batch_pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
   self->file_targets_cache = egg_task_cache_new ((GHashFunc)g_file_hash,
                                                  (GEqualFunc)g_file_equal,
                                                  g_object_ref,
@@ -1080,6 +1896,8 @@ ide_makecache_validate_worker (GTask        *task,
                                GCancellable *cancellable)
 {
   IdeMakecache *self = task_data;
+  g_autoptr(GFileInfo) info = NULL;
+  g_autoptr(GFile) file = NULL;
   g_autoptr(GError) error = NULL;
 
   IDE_ENTRY;
@@ -1088,9 +1906,33 @@ ide_makecache_validate_worker (GTask        *task,
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   if (!ide_makecache_validate_mapped_file (self->mapped, &error))
-    g_task_return_error (task, g_steal_pointer (&error));
-  else
-    g_task_return_pointer (task, g_object_ref (self), g_object_unref);
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  /* make can regenerate the makecache more than once within a second */
+  file = g_file_new_for_path (self->cache_path);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            cancellable,
+                            NULL);
+
+  if (info != NULL)
+    {
+      self->cache_size = g_file_info_get_size (info);
+      self->cache_mtime =
+        g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+        g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    }
+
+  ide_makecache_ensure_targets_index (self);
+  ide_makecache_load_batch_flags (self);
+
+  g_task_return_pointer (task, g_object_ref (self), g_object_unref);
 
   IDE_EXIT;
 }
@@ -1166,6 +2008,7 @@ ide_makecache_new_for_cache_file_async (IdeRuntime          *runtime,
 
   self->parent = g_steal_pointer (&parent);
   self->mapped = g_steal_pointer (&mapped);
+  self->cache_path = g_steal_pointer (&cache_path);
   self->runtime = g_object_ref (runtime);
 
   if (ide_runtime_contains_program_in_path (runtime, "gmake", NULL))
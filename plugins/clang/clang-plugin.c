@@ -30,6 +30,8 @@
 #include "ide-clang-symbol-resolver.h"
 #include "ide-clang-symbol-tree.h"
 #include "ide-clang-translation-unit.h"
+#include "ide-clang-worker.h"
+#include "ide-clang-xref-service.h"
 
 void
 peas_register_types (PeasObjectModule *module)
@@ -43,6 +45,9 @@ peas_register_types (PeasObjectModule *module)
   peas_object_module_register_extension_type (module,
                                               IDE_TYPE_SERVICE,
                                               IDE_TYPE_CLANG_SERVICE);
+  peas_object_module_register_extension_type (module,
+                                              IDE_TYPE_SERVICE,
+                                              IDE_TYPE_CLANG_XREF_SERVICE);
   peas_object_module_register_extension_type (module,
                                               IDE_TYPE_DIAGNOSTIC_PROVIDER,
                                               IDE_TYPE_CLANG_DIAGNOSTIC_PROVIDER);
@@ -52,4 +57,7 @@ peas_register_types (PeasObjectModule *module)
   peas_object_module_register_extension_type (module,
                                               IDE_TYPE_PREFERENCES_ADDIN,
                                               IDE_TYPE_CLANG_PREFERENCES_ADDIN);
+  peas_object_module_register_extension_type (module,
+                                              IDE_TYPE_WORKER,
+                                              IDE_TYPE_CLANG_WORKER);
 }
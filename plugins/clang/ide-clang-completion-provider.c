@@ -24,6 +24,7 @@
 #include "ide-clang-completion-item.h"
 #include "ide-clang-completion-item-private.h"
 #include "ide-clang-completion-provider.h"
+#include "ide-clang-private.h"
 #include "ide-clang-service.h"
 #include "ide-clang-translation-unit.h"
 
@@ -67,6 +68,7 @@ typedef struct
   GCancellable *cancellable;
   gchar *line;
   gchar *query;
+  guint waited_for_source : 1;
 } IdeClangCompletionState;
 
 static void ide_clang_completion_provider_iface_init (GtkSourceCompletionProviderIface *iface);
@@ -470,6 +472,22 @@ ide_clang_completion_provider_get_translation_unit_cb (GObject      *object,
       IDE_EXIT;
     }
 
+  /*
+   * Units loaded from a saved AST cannot complete code. The service is
+   * already parsing the file from source, so wait for that instead.
+   */
+  if (_ide_clang_translation_unit_get_from_ast (unit) && !state->waited_for_source)
+    {
+      state->waited_for_source = TRUE;
+      ide_clang_service_get_translation_unit_async (service,
+                                                    state->file,
+                                                    0,
+                                                    NULL,
+                                                    ide_clang_completion_provider_get_translation_unit_cb,
+                                                    state);
+      IDE_EXIT;
+    }
+
   gtk_source_completion_context_get_iter (state->context, &iter);
 
   ide_clang_translation_unit_code_complete_async (unit,
@@ -595,6 +613,9 @@ ide_clang_completion_provider_populate (GtkSourceCompletionProvider *provider,
 
       tu = ide_clang_service_get_cached_translation_unit (service, file);
 
+      if (tu != NULL && _ide_clang_translation_unit_get_from_ast (tu))
+        g_clear_object (&tu);
+
       if (tu == NULL)
         {
           ide_clang_service_get_translation_unit_async (service, file, 0, NULL, NULL, NULL);
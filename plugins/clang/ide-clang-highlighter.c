@@ -34,34 +34,6 @@ static void highlighter_iface_init (IdeHighlighterInterface *iface);
 G_DEFINE_TYPE_EXTENDED (IdeClangHighlighter, ide_clang_highlighter, IDE_TYPE_OBJECT, 0,
                         G_IMPLEMENT_INTERFACE (IDE_TYPE_HIGHLIGHTER, highlighter_iface_init))
 
-static inline gboolean
-accepts_char (gunichar ch)
-{
-  return (ch == '_' || g_unichar_isalnum (ch));
-}
-
-static gboolean
-select_next_word (GtkTextIter *begin,
-                  GtkTextIter *end)
-{
-  g_assert (begin);
-  g_assert (end);
-
-  *end = *begin;
-
-  while (!accepts_char (gtk_text_iter_get_char (begin)))
-    if (!gtk_text_iter_forward_char (begin))
-      return FALSE;
-
-  *end = *begin;
-
-  while (accepts_char (gtk_text_iter_get_char (end)))
-    if (!gtk_text_iter_forward_char (end))
-      return !gtk_text_iter_equal (begin, end);
-
-  return TRUE;
-}
-
 static void
 get_unit_cb (GObject      *object,
              GAsyncResult *result,
@@ -83,6 +55,16 @@ get_unit_cb (GObject      *object,
     ide_highlight_engine_rebuild (self->engine);
 }
 
+static const gchar *
+get_tag (IdeHighlighter *highlighter,
+         const gchar    *word,
+         gpointer        user_data)
+{
+  IdeHighlightIndex *index = user_data;
+
+  return ide_highlight_index_lookup (index, word);
+}
+
 static void
 ide_clang_highlighter_real_update (IdeHighlighter       *highlighter,
                                    IdeHighlightCallback  callback,
@@ -93,14 +75,11 @@ ide_clang_highlighter_real_update (IdeHighlighter       *highlighter,
   g_autoptr(IdeClangTranslationUnit) unit = NULL;
   IdeClangHighlighter *self = (IdeClangHighlighter *)highlighter;
   GtkTextBuffer *text_buffer;
-  GtkSourceBuffer *source_buffer;
   IdeHighlightIndex *index;
   IdeContext *context;
   IdeClangService *service = NULL;
   IdeBuffer *buffer;
   IdeFile *file;
-  GtkTextIter begin;
-  GtkTextIter end;
 
   g_assert (IDE_IS_CLANG_HIGHLIGHTER (highlighter));
   g_assert (callback != NULL);
@@ -110,7 +89,6 @@ ide_clang_highlighter_real_update (IdeHighlighter       *highlighter,
 
   if (!(text_buffer = gtk_text_iter_get_buffer (range_begin)) ||
       !IDE_IS_BUFFER (text_buffer) ||
-      !(source_buffer = GTK_SOURCE_BUFFER (text_buffer)) ||
       !(buffer = IDE_BUFFER (text_buffer)) ||
       !(file = ide_buffer_get_file (buffer)) ||
       !(context = ide_object_get_context (IDE_OBJECT (highlighter))) ||
@@ -136,44 +114,8 @@ ide_clang_highlighter_real_update (IdeHighlighter       *highlighter,
   if (!(index = ide_clang_translation_unit_get_index (unit)))
     return;
 
-  begin = end = *location = *range_begin;
-
-  while (gtk_text_iter_compare (&begin, range_end) < 0)
-    {
-      if (!select_next_word (&begin, &end))
-        goto completed;
-
-      if (gtk_text_iter_compare (&begin, range_end) >= 0)
-        goto completed;
-
-      g_assert (!gtk_text_iter_equal (&begin, &end));
-
-      if (!gtk_source_buffer_iter_has_context_class (source_buffer, &begin, "string") &&
-          !gtk_source_buffer_iter_has_context_class (source_buffer, &begin, "path") &&
-          !gtk_source_buffer_iter_has_context_class (source_buffer, &begin, "comment"))
-        {
-          const gchar *tag;
-          gchar *word;
-
-          word = gtk_text_iter_get_slice (&begin, &end);
-          tag = ide_highlight_index_lookup (index, word);
-          g_free (word);
-
-          if (tag != NULL)
-            {
-              if (callback (&begin, &end, tag) == IDE_HIGHLIGHT_STOP)
-                {
-                  *location = end;
-                  return;
-                }
-            }
-        }
-
-      begin = end;
-    }
-
-completed:
-  *location = *range_end;
+  ide_highlighter_scan_words (highlighter, callback, range_begin, range_end, location,
+                              get_tag, index);
 }
 
 static void
@@ -28,18 +28,34 @@
 
 G_BEGIN_DECLS
 
-IdeClangTranslationUnit *_ide_clang_translation_unit_new     (IdeContext         *context,
-                                                              CXTranslationUnit   tu,
-                                                              GFile              *file,
-                                                              IdeHighlightIndex  *index,
-                                                              gint64              serial);
-void                     _ide_clang_dispose_string           (CXString           *str);
-IdeSymbolNode           *_ide_clang_symbol_node_new          (IdeContext         *context,
-                                                              CXCursor            cursor);
-CXCursor                 _ide_clang_symbol_node_get_cursor   (IdeClangSymbolNode *self);
-GArray                  *_ide_clang_symbol_node_get_children (IdeClangSymbolNode *self);
-void                     _ide_clang_symbol_node_set_children (IdeClangSymbolNode *self,
-                                                              GArray             *children);
+IdeClangTranslationUnit *_ide_clang_translation_unit_new          (IdeContext               *context,
+                                                                   IdeRefPtr                *tu,
+                                                                   GFile                    *file,
+                                                                   IdeHighlightIndex        *index,
+                                                                   gint64                    serial);
+void                     _ide_clang_translation_unit_set_from_ast (IdeClangTranslationUnit  *self,
+                                                                   gboolean                  from_ast);
+gboolean                 _ide_clang_translation_unit_get_from_ast (IdeClangTranslationUnit  *self);
+CXTranslationUnit        _ide_clang_unit_lock                     (IdeRefPtr                *native);
+void                     _ide_clang_unit_unlock                   (IdeRefPtr                *native);
+gboolean                 _ide_clang_unit_is_outdated              (IdeRefPtr                *native);
+void                     _ide_clang_dispose_string                (CXString                 *str);
+const gchar             *_ide_clang_discover_llvm_flags           (void);
+gint64                   _ide_clang_get_mtime_usec                (const gchar              *path);
+GVariant                *_ide_clang_xref_index_file               (CXIndex                   index,
+                                                                   const gchar              *source_filename,
+                                                                   const gchar              *workpath,
+                                                                   const gchar              *cache_path,
+                                                                   const gchar * const      *argv,
+                                                                   GCancellable             *cancellable,
+                                                                   GError                  **error);
+IdeClangSymbolNode      *_ide_clang_symbol_node_new               (IdeContext               *context,
+                                                                   IdeRefPtr                *native,
+                                                                   CXCursor                  cursor);
+CXCursor                 _ide_clang_symbol_node_get_cursor        (IdeClangSymbolNode       *self);
+GArray                  *_ide_clang_symbol_node_get_children      (IdeClangSymbolNode       *self);
+void                     _ide_clang_symbol_node_set_children      (IdeClangSymbolNode       *self,
+                                                                   GArray                   *children);
 
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (CXString, _ide_clang_dispose_string)
 
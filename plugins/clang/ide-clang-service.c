@@ -20,6 +20,7 @@
 
 #include <clang-c/Index.h>
 #include <egg-counter.h>
+#include <glib/gstdio.h>
 #include <egg-task-cache.h>
 #include <glib/gi18n.h>
 #include <ide.h>
@@ -30,6 +31,20 @@
 
 #define DEFAULT_EVICTION_MSEC (60 * 1000)
 
+/*
+ * Translation units are saved to the cache directory so that opening a
+ * file in a new session does not require parsing it again. Next to each
+ * AST is a manifest of the files that went into it along with their
+ * modification times, which is used to check whether the AST is stale.
+ */
+#define AST_MANIFEST_VERSION "2"
+
+/*
+ * Saved ASTs are often several megabytes, so the oldest are removed once
+ * the ASTs of a project take more space than this.
+ */
+#define AST_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
 struct _IdeClangService
 {
   IdeObject     parent_instance;
@@ -37,8 +52,50 @@ struct _IdeClangService
   CXIndex       index;
   GCancellable *cancellable;
   EggTaskCache *units_cache;
+
+  /*
+   * The translation unit of each file, keyed by source filename. Parsing
+   * a file again reparses its translation unit in place rather than
+   * creating a new one, which lets clang reuse the precompiled preamble.
+   */
+  GMutex        units_mutex;
+  GHashTable   *units;
+
+  /*
+   * Files whose translation unit was loaded from a saved AST and are now
+   * being parsed from source, mapped to the tasks waiting for the result.
+   * AST units cannot be reparsed and lack what code completion needs.
+   */
+  GHashTable   *reparsing;
 };
 
+/*
+ * The translation unit of a file, shared by every IdeClangTranslationUnit
+ * created for it. Since it is reparsed in place, @mutex must be held while
+ * using @tu, and anything derived from it such as cursors is only valid
+ * for as long as @generation is unchanged.
+ */
+typedef struct
+{
+  volatile gint      ref_count;
+  GRecMutex          mutex;
+  CXTranslationUnit  tu;
+  gchar             *flags;
+  guint              generation;
+  gint64             last_used;
+  guint              from_ast : 1;
+} IdeClangUnit;
+
+/*
+ * The IdeRefPtr given to IdeClangTranslationUnit, which remembers the
+ * generation of the unit it was created for.
+ */
+typedef struct
+{
+  IdeClangUnit *unit;
+  guint         generation;
+} UnitHandle;
+
 typedef struct
 {
   IdeFile    *file;
@@ -46,8 +103,11 @@ typedef struct
   gchar      *source_filename;
   gchar     **command_line_args;
   GPtrArray  *unsaved_files;
+  gchar      *cache_dir;
   gint64      sequence;
   guint       options;
+  guint       skip_ast : 1;
+  guint       from_ast : 1;
 } ParseRequest;
 
 typedef struct
@@ -66,6 +126,194 @@ EGG_DEFINE_COUNTER (ParseAttempts,
                     "Clang",
                     "Total Parse Attempts",
                     "Total number of attempts to create a translation unit.")
+EGG_DEFINE_COUNTER (ReparseAttempts,
+                    "Clang",
+                    "Total Reparse Attempts",
+                    "Total number of attempts to reparse an existing translation unit.")
+
+static IdeClangUnit *
+ide_clang_unit_ref (IdeClangUnit *unit)
+{
+  g_assert (unit != NULL);
+  g_assert (unit->ref_count > 0);
+
+  g_atomic_int_inc (&unit->ref_count);
+
+  return unit;
+}
+
+static void
+ide_clang_unit_unref (IdeClangUnit *unit)
+{
+  g_assert (unit != NULL);
+  g_assert (unit->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&unit->ref_count))
+    {
+      g_clear_pointer (&unit->tu, clang_disposeTranslationUnit);
+      g_clear_pointer (&unit->flags, g_free);
+      g_rec_mutex_clear (&unit->mutex);
+      g_slice_free (IdeClangUnit, unit);
+    }
+}
+
+static void
+unit_handle_free (gpointer data)
+{
+  UnitHandle *handle = data;
+
+  ide_clang_unit_unref (handle->unit);
+  g_slice_free (UnitHandle, handle);
+}
+
+/*
+ * Must be called with the lock of @unit held.
+ */
+static IdeRefPtr *
+ide_clang_unit_create_handle (IdeClangUnit *unit)
+{
+  UnitHandle *handle;
+
+  g_assert (unit != NULL);
+
+  handle = g_slice_new0 (UnitHandle);
+  handle->unit = ide_clang_unit_ref (unit);
+  handle->generation = unit->generation;
+
+  return ide_ref_ptr_new (handle, unit_handle_free);
+}
+
+/*
+ * Replaces the translation unit of @unit. Must be called with the lock
+ * of @unit held.
+ */
+static void
+ide_clang_unit_set_tu (IdeClangUnit      *unit,
+                       CXTranslationUnit  tu,
+                       const gchar       *flags,
+                       gboolean           from_ast)
+{
+  g_assert (unit != NULL);
+
+  if (unit->tu != tu)
+    {
+      g_clear_pointer (&unit->tu, clang_disposeTranslationUnit);
+      unit->tu = tu;
+    }
+
+  if (unit->flags != flags)
+    {
+      g_free (unit->flags);
+      unit->flags = g_strdup (flags);
+    }
+
+  unit->from_ast = !!from_ast;
+  unit->generation++;
+}
+
+/**
+ * _ide_clang_unit_lock:
+ * @native: the native translation unit of an #IdeClangTranslationUnit
+ *
+ * Locks the translation unit shared by every #IdeClangTranslationUnit of
+ * the same file, so that it cannot be reparsed while in use. The lock is
+ * recursive, and must be paired with _ide_clang_unit_unlock() even when
+ * %NULL is returned.
+ *
+ * The translation unit may have been reparsed since @native was created,
+ * see _ide_clang_unit_is_outdated().
+ *
+ * Returns: (nullable): The translation unit, or %NULL if the service has
+ *   released it.
+ */
+CXTranslationUnit
+_ide_clang_unit_lock (IdeRefPtr *native)
+{
+  UnitHandle *handle;
+
+  g_return_val_if_fail (native != NULL, NULL);
+
+  handle = ide_ref_ptr_get (native);
+  g_rec_mutex_lock (&handle->unit->mutex);
+
+  return handle->unit->tu;
+}
+
+/**
+ * _ide_clang_unit_is_outdated:
+ * @native: the native translation unit of an #IdeClangTranslationUnit
+ *
+ * Checks whether the translation unit was reparsed or released since
+ * @native was created, in which case cursors taken from it before are
+ * no longer valid. The lock must be held.
+ */
+gboolean
+_ide_clang_unit_is_outdated (IdeRefPtr *native)
+{
+  UnitHandle *handle;
+
+  g_return_val_if_fail (native != NULL, TRUE);
+
+  handle = ide_ref_ptr_get (native);
+
+  return handle->generation != handle->unit->generation || handle->unit->tu == NULL;
+}
+
+void
+_ide_clang_unit_unlock (IdeRefPtr *native)
+{
+  UnitHandle *handle;
+
+  g_return_if_fail (native != NULL);
+
+  handle = ide_ref_ptr_get (native);
+  g_rec_mutex_unlock (&handle->unit->mutex);
+}
+
+/*
+ * Gets the unit for @source_filename, creating it if necessary. Units that
+ * are no longer referenced by any translation unit are dropped once they
+ * have not been used for a while.
+ */
+static IdeClangUnit *
+ide_clang_service_get_unit (IdeClangService *self,
+                            const gchar     *source_filename)
+{
+  IdeClangUnit *unit;
+  GHashTableIter iter;
+  gpointer value;
+  gint64 now = g_get_monotonic_time ();
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+  g_assert (source_filename != NULL);
+
+  g_mutex_lock (&self->units_mutex);
+
+  g_hash_table_iter_init (&iter, self->units);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      IdeClangUnit *other = value;
+
+      if (g_atomic_int_get (&other->ref_count) == 1 &&
+          now - other->last_used > DEFAULT_EVICTION_MSEC * 1000L)
+        g_hash_table_iter_remove (&iter);
+    }
+
+  if (!(unit = g_hash_table_lookup (self->units, source_filename)))
+    {
+      unit = g_slice_new0 (IdeClangUnit);
+      unit->ref_count = 1;
+      g_rec_mutex_init (&unit->mutex);
+      g_hash_table_insert (self->units, g_strdup (source_filename), unit);
+    }
+
+  unit->last_used = now;
+  ide_clang_unit_ref (unit);
+
+  g_mutex_unlock (&self->units_mutex);
+
+  return unit;
+}
 
 static void
 parse_request_free (gpointer data)
@@ -73,6 +321,7 @@ parse_request_free (gpointer data)
   ParseRequest *request = data;
 
   g_free (request->source_filename);
+  g_free (request->cache_dir);
   g_strfreev (request->command_line_args);
   g_ptr_array_unref (request->unsaved_files);
   g_clear_object (&request->file);
@@ -190,8 +439,8 @@ clear_unsaved_file (gpointer data)
   g_free ((gchar *)uf->Filename);
 }
 
-static const gchar *
-discover_llvm_flags (void)
+const gchar *
+_ide_clang_discover_llvm_flags (void)
 {
   static const gchar *llvm_flags;
   g_autoptr(GSubprocess) subprocess = NULL;
@@ -244,6 +493,298 @@ discover_llvm_flags (void)
   IDE_RETURN (llvm_flags);
 }
 
+static gchar *
+ide_clang_service_get_ast_path (const gchar *cache_dir,
+                                const gchar *source_filename,
+                                const gchar *flags)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autofree gchar *name = NULL;
+
+  g_assert (cache_dir != NULL);
+  g_assert (source_filename != NULL);
+  g_assert (flags != NULL);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (const guchar *)source_filename, -1);
+  g_checksum_update (checksum, (const guchar *)"\n", 1);
+  g_checksum_update (checksum, (const guchar *)flags, -1);
+
+  name = g_strdup_printf ("%s.ast", g_checksum_get_string (checksum));
+
+  return g_build_filename (cache_dir, name, NULL);
+}
+
+/*
+ * Returns the modification time of @path in microseconds, or -1 if the
+ * file cannot be queried. This is used instead of clang_getFileTime(),
+ * which only has a resolution of seconds.
+ */
+gint64
+_ide_clang_get_mtime_usec (const gchar *path)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+
+  g_assert (path != NULL);
+
+  file = g_file_new_for_path (path);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+
+  if (info == NULL)
+    return -1;
+
+  return (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC) +
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static gboolean
+unsaved_files_contains (GArray      *unsaved_files,
+                        const gchar *path)
+{
+  for (guint i = 0; i < unsaved_files->len; i++)
+    {
+      const struct CXUnsavedFile *uf = &g_array_index (unsaved_files, struct CXUnsavedFile, i);
+
+      if (g_strcmp0 (uf->Filename, path) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Loads the translation unit saved by a previous session, if none of the
+ * files it was built from have changed since and none of them are being
+ * edited.
+ */
+static CXTranslationUnit
+ide_clang_service_load_ast (CXIndex      index,
+                            const gchar *ast_path,
+                            GArray      *unsaved_files)
+{
+  g_autofree gchar *manifest_path = NULL;
+  g_autofree gchar *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  CXTranslationUnit tu = NULL;
+
+  g_assert (ast_path != NULL);
+  g_assert (unsaved_files != NULL);
+
+  manifest_path = g_strdup_printf ("%s.manifest", ast_path);
+
+  if (!g_file_get_contents (manifest_path, &contents, NULL, NULL))
+    return NULL;
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  if (lines [0] == NULL || !g_str_equal (lines [0], AST_MANIFEST_VERSION))
+    return NULL;
+
+  for (guint i = 1; lines [i] != NULL; i++)
+    {
+      const gchar *path;
+      gchar *endptr = NULL;
+      gint64 mtime;
+
+      if (lines [i][0] == '\0')
+        continue;
+
+      mtime = g_ascii_strtoll (lines [i], &endptr, 10);
+
+      if (endptr == NULL || *endptr != '\t')
+        return NULL;
+
+      path = endptr + 1;
+
+      if (_ide_clang_get_mtime_usec (path) != mtime ||
+          unsaved_files_contains (unsaved_files, path))
+        return NULL;
+    }
+
+  if (clang_createTranslationUnit2 (index, ast_path, &tu) != CXError_Success)
+    return NULL;
+
+  return tu;
+}
+
+static void
+collect_inclusions (CXFile             included_file,
+                    CXSourceLocation  *inclusion_stack,
+                    unsigned           include_len,
+                    CXClientData       user_data)
+{
+  GHashTable *files = user_data;
+  CXString name;
+  const gchar *path;
+
+  name = clang_getFileName (included_file);
+  path = clang_getCString (name);
+
+  if (path != NULL && !g_hash_table_contains (files, path))
+    g_hash_table_add (files, g_strdup (path));
+
+  clang_disposeString (name);
+}
+
+static void
+ide_clang_service_remove_ast (const gchar *ast_path)
+{
+  g_autofree gchar *manifest_path = NULL;
+
+  g_assert (ast_path != NULL);
+
+  /* Remove the manifest first, so that a partial removal is never used */
+  manifest_path = g_strdup_printf ("%s.manifest", ast_path);
+  g_unlink (manifest_path);
+  g_unlink (ast_path);
+}
+
+static gint
+compare_file_info_by_mtime (gconstpointer a,
+                            gconstpointer b)
+{
+  GFileInfo *info_a = *(GFileInfo * const *)a;
+  GFileInfo *info_b = *(GFileInfo * const *)b;
+  guint64 mtime_a = g_file_info_get_attribute_uint64 (info_a, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  guint64 mtime_b = g_file_info_get_attribute_uint64 (info_b, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  return (mtime_a > mtime_b) - (mtime_a < mtime_b);
+}
+
+/*
+ * Removes the oldest ASTs in @cache_dir until they take no more than
+ * AST_CACHE_MAX_SIZE. Stale ASTs are only replaced when their file is
+ * parsed with the same flags again, so without this the directory
+ * would keep growing.
+ */
+static void
+ide_clang_service_prune_ast_cache (const gchar *cache_dir)
+{
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) infos = NULL;
+  gpointer infoptr;
+  guint64 total = 0;
+
+  g_assert (cache_dir != NULL);
+
+  directory = g_file_new_for_path (cache_dir);
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          NULL,
+                                          NULL);
+
+  if (enumerator == NULL)
+    return;
+
+  infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      GFileInfo *info = infoptr;
+
+      if (!g_str_has_suffix (g_file_info_get_name (info), ".ast"))
+        {
+          g_object_unref (info);
+          continue;
+        }
+
+      total += g_file_info_get_size (info);
+      g_ptr_array_add (infos, info);
+    }
+
+  if (total <= AST_CACHE_MAX_SIZE)
+    return;
+
+  g_ptr_array_sort (infos, compare_file_info_by_mtime);
+
+  for (guint i = 0; i < infos->len && total > AST_CACHE_MAX_SIZE; i++)
+    {
+      GFileInfo *info = g_ptr_array_index (infos, i);
+      g_autofree gchar *path = NULL;
+
+      path = g_build_filename (cache_dir, g_file_info_get_name (info), NULL);
+      ide_clang_service_remove_ast (path);
+      total -= g_file_info_get_size (info);
+    }
+}
+
+/*
+ * Saves @tu along with the manifest of the files it was built from. We
+ * only do this when the translation unit matches what is on disk, as
+ * otherwise it would not be valid in the next session anyway.
+ */
+static void
+ide_clang_service_save_ast (CXTranslationUnit  tu,
+                            const gchar       *ast_path,
+                            GArray            *unsaved_files)
+{
+  g_autoptr(GHashTable) files = NULL;
+  g_autoptr(GString) manifest = NULL;
+  g_autofree gchar *manifest_path = NULL;
+  g_autofree gchar *tmp_path = NULL;
+  g_autofree gchar *dir = NULL;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_assert (tu != NULL);
+  g_assert (ast_path != NULL);
+  g_assert (unsaved_files != NULL);
+
+  files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  clang_getInclusions (tu, collect_inclusions, files);
+
+  manifest = g_string_new (AST_MANIFEST_VERSION"\n");
+
+  /*
+   * clang_getFileTime() only has a resolution of seconds, which misses
+   * edits made within the same second the unit was parsed.
+   */
+  g_hash_table_iter_init (&iter, files);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      gint64 mtime;
+
+      if (unsaved_files_contains (unsaved_files, key) ||
+          (mtime = _ide_clang_get_mtime_usec (key)) < 0)
+        return;
+
+      g_string_append_printf (manifest, "%"G_GINT64_FORMAT"\t%s\n",
+                              mtime, (const gchar *)key);
+    }
+
+  dir = g_path_get_dirname (ast_path);
+
+  if (g_mkdir_with_parents (dir, 0750) != 0)
+    return;
+
+  /* Invalidate the previous AST before replacing it */
+  ide_clang_service_remove_ast (ast_path);
+  manifest_path = g_strdup_printf ("%s.manifest", ast_path);
+
+  tmp_path = g_strdup_printf ("%s.tmp", ast_path);
+
+  if (clang_saveTranslationUnit (tu, tmp_path, clang_defaultSaveOptions (tu)) != CXSaveError_None ||
+      g_rename (tmp_path, ast_path) != 0)
+    {
+      g_unlink (tmp_path);
+      return;
+    }
+
+  g_file_set_contents (manifest_path, manifest->str, manifest->len, NULL);
+
+  ide_clang_service_prune_ast_cache (dir);
+}
+
 static void
 ide_clang_service_parse_worker (GTask        *task,
                                 gpointer      source_object,
@@ -253,9 +794,15 @@ ide_clang_service_parse_worker (GTask        *task,
   g_autoptr(IdeClangTranslationUnit) ret = NULL;
   g_autoptr(IdeHighlightIndex) index = NULL;
   g_autoptr(IdeFile) file_copy = NULL;
+  g_autoptr(IdeRefPtr) native = NULL;
+  g_autofree gchar *flags = NULL;
+  g_autofree gchar *ast_path = NULL;
+  g_autofree gchar *old_ast_path = NULL;
+  gboolean from_ast = FALSE;
   IdeClangService *self = source_object;
   CXTranslationUnit tu = NULL;
   ParseRequest *request = task_data;
+  IdeClangUnit *unit;
   IdeContext *context;
   g_autoptr(GPtrArray) built_argv = NULL;
   GFile *gfile;
@@ -297,21 +844,100 @@ ide_clang_service_parse_worker (GTask        *task,
    * included. Add a guard NULL just for extra safety.
    */
   built_argv = g_ptr_array_new ();
-  if (NULL != (llvm_flags = discover_llvm_flags ()))
+  if (NULL != (llvm_flags = _ide_clang_discover_llvm_flags ()))
     g_ptr_array_add (built_argv, (gchar *)llvm_flags);
   for (i = 0; request->command_line_args[i] != NULL; i++)
     g_ptr_array_add (built_argv, request->command_line_args[i]);
   g_ptr_array_add (built_argv, NULL);
 
-  EGG_COUNTER_INC (ParseAttempts);
-  code = clang_parseTranslationUnit2 (request->index,
-                                      request->source_filename,
-                                      (const gchar * const *)built_argv->pdata,
-                                      built_argv->len - 1,
-                                      (struct CXUnsavedFile *)(gpointer)ar->data,
-                                      ar->len,
-                                      request->options,
-                                      &tu);
+  flags = g_strjoinv ("\n", (gchar **)built_argv->pdata);
+  unit = ide_clang_service_get_unit (self, request->source_filename);
+
+  if (request->cache_dir != NULL)
+    ast_path = ide_clang_service_get_ast_path (request->cache_dir, request->source_filename, flags);
+
+  g_rec_mutex_lock (&unit->mutex);
+
+  /*
+   * If the translation unit of this file was built with the same flags, we
+   * can just reparse it in place with the new unsaved files. Since we use
+   * the editing options, that reuses the precompiled preamble instead of
+   * parsing all of the headers again.
+   */
+  if (unit->tu != NULL && !unit->from_ast && g_strcmp0 (unit->flags, flags) == 0)
+    {
+      EGG_COUNTER_INC (ReparseAttempts);
+      code = clang_reparseTranslationUnit (unit->tu,
+                                           ar->len,
+                                           (struct CXUnsavedFile *)(gpointer)ar->data,
+                                           clang_defaultReparseOptions (unit->tu));
+
+      /* The translation unit may not be used after a failed reparse */
+      if (code == CXError_Success)
+        {
+          tu = unit->tu;
+          ide_clang_unit_set_tu (unit, tu, flags, FALSE);
+        }
+      else
+        ide_clang_unit_set_tu (unit, NULL, NULL, FALSE);
+    }
+
+  if (tu == NULL)
+    {
+      /* Others can keep using the current translation unit meanwhile */
+      g_rec_mutex_unlock (&unit->mutex);
+
+      /*
+       * Otherwise, we might still have the translation unit from a previous
+       * session, which is much faster to load than parsing the file. The
+       * service parses the file from source right after that, so this only
+       * happens once per file.
+       */
+      if (ast_path != NULL && !request->skip_ast)
+        {
+          if (NULL != (tu = ide_clang_service_load_ast (request->index, ast_path, ar)))
+            {
+              code = CXError_Success;
+              from_ast = TRUE;
+            }
+        }
+
+      if (tu == NULL)
+        {
+          EGG_COUNTER_INC (ParseAttempts);
+          code = clang_parseTranslationUnit2 (request->index,
+                                              request->source_filename,
+                                              (const gchar * const *)built_argv->pdata,
+                                              built_argv->len - 1,
+                                              (struct CXUnsavedFile *)(gpointer)ar->data,
+                                              ar->len,
+                                              request->options,
+                                              &tu);
+
+          /*
+           * Only save the AST when the file is first loaded. Later parses
+           * reparse in place and are not saved, since the saved AST only
+           * needs to match the files on disk for the next session. When
+           * following an AST load (skip_ast), the saved AST is current.
+           */
+          if (code == CXError_Success && ast_path != NULL && !request->skip_ast)
+            ide_clang_service_save_ast (tu, ast_path, ar);
+        }
+
+      g_rec_mutex_lock (&unit->mutex);
+
+      if (tu != NULL)
+        {
+          /* The AST saved for the previous flags will not be used again */
+          if (unit->flags != NULL && request->cache_dir != NULL &&
+              g_strcmp0 (unit->flags, flags) != 0)
+            old_ast_path = ide_clang_service_get_ast_path (request->cache_dir,
+                                                           request->source_filename,
+                                                           unit->flags);
+
+          ide_clang_unit_set_tu (unit, tu, flags, from_ast);
+        }
+    }
 
   switch (code)
     {
@@ -344,6 +970,7 @@ ide_clang_service_parse_worker (GTask        *task,
 
   if (!tu)
     {
+      g_rec_mutex_unlock (&unit->mutex);
       g_task_return_new_error (task,
                                G_IO_ERROR,
                                G_IO_ERROR_FAILED,
@@ -354,11 +981,26 @@ ide_clang_service_parse_worker (GTask        *task,
 
   context = ide_object_get_context (source_object);
   gfile = ide_file_get_file (request->file);
-  ret = _ide_clang_translation_unit_new (context, tu, gfile, index, request->sequence);
+  native = ide_clang_unit_create_handle (unit);
+  ret = _ide_clang_translation_unit_new (context, native, gfile, index, request->sequence);
+  _ide_clang_translation_unit_set_from_ast (ret, from_ast);
+  request->from_ast = from_ast;
+
+  /*
+   * Collect the diagnostics while the translation unit is still current,
+   * since another parse of the file could start before anyone asks.
+   */
+  ide_clang_translation_unit_get_diagnostics (ret);
+
+  g_rec_mutex_unlock (&unit->mutex);
 
   g_task_return_pointer (task, g_object_ref (ret), g_object_unref);
 
 cleanup:
+  if (old_ast_path != NULL)
+    ide_clang_service_remove_ast (old_ast_path);
+
+  ide_clang_unit_unref (unit);
   g_array_unref (ar);
 }
 
@@ -428,58 +1070,64 @@ ide_clang_service__get_build_flags_cb (GObject      *object,
                              ide_clang_service_parse_worker);
 }
 
+static void ide_clang_service_reparse_from_source (IdeClangService *self,
+                                                   IdeFile         *file);
+
 static void
 ide_clang_service_unit_completed_cb (GObject      *object,
                                      GAsyncResult *result,
                                      gpointer      user_data)
 {
+  IdeClangService *self = (IdeClangService *)object;
   g_autoptr(GTask) task = user_data;
+  ParseRequest *request;
   gpointer ret;
   GError *error = NULL;
 
-  g_assert (IDE_IS_CLANG_SERVICE (object));
+  g_assert (IDE_IS_CLANG_SERVICE (self));
   g_assert (G_IS_TASK (result));
   g_assert (G_IS_TASK (task));
 
+  request = g_task_get_task_data (G_TASK (result));
+
   if (!(ret = g_task_propagate_pointer (G_TASK (result), &error)))
-    g_task_return_error (task, error);
-  else
-    g_task_return_pointer (task, ret, g_object_unref);
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Start parsing from source before anyone can see the AST unit */
+  if (request->from_ast)
+    ide_clang_service_reparse_from_source (self, request->file);
+
+  g_task_return_pointer (task, ret, g_object_unref);
 }
 
-static void
-ide_clang_service_get_translation_unit_worker (EggTaskCache  *cache,
-                                               gconstpointer  key,
-                                               GTask         *task,
-                                               gpointer       user_data)
+static ParseRequest *
+ide_clang_service_create_request (IdeClangService *self,
+                                  IdeFile         *file,
+                                  GError         **error)
 {
-  g_autoptr(GTask) real_task = NULL;
   g_autofree gchar *path = NULL;
-  IdeClangService *self = user_data;
   IdeUnsavedFiles *unsaved_files;
-  IdeBuildSystem *build_system;
   ParseRequest *request;
   IdeContext *context;
-  IdeFile *file = (IdeFile *)key;
   GFile *gfile;
 
   g_assert (IDE_IS_CLANG_SERVICE (self));
-  g_assert (IDE_IS_FILE ((IdeFile *)key));
   g_assert (IDE_IS_FILE (file));
-  g_assert (G_IS_TASK (task));
 
   context = ide_object_get_context (IDE_OBJECT (self));
   unsaved_files = ide_context_get_unsaved_files (context);
-  build_system = ide_context_get_build_system (context);
   gfile = ide_file_get_file (file);
 
   if (!gfile || !(path = g_file_get_path (gfile)))
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_NOT_SUPPORTED,
-                               _("File must be saved locally to parse."));
-      return;
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   _("File must be saved locally to parse."));
+      return NULL;
     }
 
   request = g_slice_new0 (ParseRequest);
@@ -492,6 +1140,11 @@ ide_clang_service_get_translation_unit_worker (EggTaskCache  *cache,
   request->command_line_args = NULL;
   request->unsaved_files = ide_unsaved_files_to_array (unsaved_files);
   request->sequence = ide_unsaved_files_get_sequence (unsaved_files);
+  request->cache_dir = g_build_filename (g_get_user_cache_dir (),
+                                         ide_get_program_name (),
+                                         "clang",
+                                         ide_project_get_id (ide_context_get_project (context)),
+                                         NULL);
   /*
    * NOTE:
    *
@@ -503,6 +1156,123 @@ ide_clang_service_get_translation_unit_worker (EggTaskCache  *cache,
   request->options = (clang_defaultEditingTranslationUnitOptions () |
                       CXTranslationUnit_DetailedPreprocessingRecord);
 
+  return request;
+}
+
+static void
+ide_clang_service_reparse_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  IdeClangService *self = (IdeClangService *)object;
+  g_autoptr(IdeClangTranslationUnit) unit = NULL;
+  g_autoptr(IdeFile) file = user_data;
+  g_autoptr(GPtrArray) waiters = NULL;
+  g_autoptr(GError) error = NULL;
+  gpointer key = NULL;
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (IDE_IS_FILE (file));
+
+  unit = g_task_propagate_pointer (G_TASK (result), &error);
+
+  if (self->reparsing != NULL &&
+      g_hash_table_lookup_extended (self->reparsing, file, &key, (gpointer *)&waiters))
+    {
+      g_hash_table_steal (self->reparsing, file);
+      g_object_unref (key);
+    }
+
+  if (unit != NULL && self->units_cache != NULL)
+    egg_task_cache_insert (self->units_cache, file, unit);
+
+  for (guint i = 0; waiters != NULL && i < waiters->len; i++)
+    {
+      GTask *waiter = g_ptr_array_index (waiters, i);
+
+      if (unit != NULL)
+        g_task_return_pointer (waiter, g_object_ref (unit), g_object_unref);
+      else
+        g_task_return_error (waiter, g_error_copy (error));
+    }
+}
+
+/*
+ * A translation unit loaded from a saved AST has no parsed source behind
+ * it, so clang cannot complete code with it nor reparse it. It is good
+ * enough to highlight and show diagnostics right away, but we replace it
+ * with a real parse of the file as soon as possible.
+ */
+static void
+ide_clang_service_reparse_from_source (IdeClangService *self,
+                                       IdeFile         *file)
+{
+  g_autoptr(GTask) task = NULL;
+  IdeBuildSystem *build_system;
+  ParseRequest *request;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+  g_assert (IDE_IS_FILE (file));
+
+  if (self->reparsing == NULL || g_hash_table_contains (self->reparsing, file))
+    IDE_EXIT;
+
+  if (!(request = ide_clang_service_create_request (self, file, NULL)))
+    IDE_EXIT;
+
+  request->skip_ast = TRUE;
+
+  g_hash_table_insert (self->reparsing,
+                       g_object_ref (file),
+                       g_ptr_array_new_with_free_func (g_object_unref));
+
+  task = g_task_new (self, self->cancellable, ide_clang_service_reparse_cb, g_object_ref (file));
+  g_task_set_task_data (task, request, parse_request_free);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+
+  ide_build_system_get_build_flags_async (build_system,
+                                          request->file,
+                                          self->cancellable,
+                                          ide_clang_service__get_build_flags_cb,
+                                          g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_service_get_translation_unit_worker (EggTaskCache  *cache,
+                                               gconstpointer  key,
+                                               GTask         *task,
+                                               gpointer       user_data)
+{
+  g_autoptr(GTask) real_task = NULL;
+  IdeClangService *self = user_data;
+  IdeBuildSystem *build_system;
+  ParseRequest *request;
+  IdeContext *context;
+  IdeFile *file = (IdeFile *)key;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+  g_assert (IDE_IS_FILE ((IdeFile *)key));
+  g_assert (IDE_IS_FILE (file));
+  g_assert (G_IS_TASK (task));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+
+  if (!(request = ide_clang_service_create_request (self, file, &error)))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
   real_task = g_task_new (self,
                           g_task_get_cancellable (task),
                           ide_clang_service_unit_completed_cb,
@@ -548,7 +1318,8 @@ ide_clang_service_get_translation_unit_cb (GObject      *object,
  * existing translation unit will be used.
  *
  * If the translation unit is out of date, then the source file(s) will be
- * parsed via clang_parseTranslationUnit() asynchronously.
+ * parsed asynchronously. When possible, a previous translation unit for the
+ * file is reused with clang_reparseTranslationUnit().
  */
 void
 ide_clang_service_get_translation_unit_async (IdeClangService     *self,
@@ -560,6 +1331,7 @@ ide_clang_service_get_translation_unit_async (IdeClangService     *self,
 {
   IdeClangTranslationUnit *cached;
   g_autoptr(GTask) task = NULL;
+  GPtrArray *waiters;
 
   g_return_if_fail (IDE_IS_CLANG_SERVICE (self));
   g_return_if_fail (IDE_IS_FILE (file));
@@ -589,6 +1361,17 @@ ide_clang_service_get_translation_unit_async (IdeClangService     *self,
       min_serial = ide_unsaved_files_get_sequence (unsaved_files);
     }
 
+  /*
+   * If the cached unit was loaded from a saved AST, wait for the file to
+   * be parsed from source instead of handing out a unit that cannot be
+   * used for code completion.
+   */
+  if ((waiters = g_hash_table_lookup (self->reparsing, file)))
+    {
+      g_ptr_array_add (waiters, g_steal_pointer (&task));
+      return;
+    }
+
   /*
    * If we have a cached unit, and it is new enough, then re-use it.
    */
@@ -665,17 +1448,47 @@ ide_clang_service_stop (IdeService *service)
 
   g_cancellable_cancel (self->cancellable);
   g_clear_object (&self->units_cache);
+
+  g_mutex_lock (&self->units_mutex);
+  if (self->units != NULL)
+    g_hash_table_remove_all (self->units);
+  g_mutex_unlock (&self->units_mutex);
 }
 
 static void
 ide_clang_service_dispose (GObject *object)
 {
   IdeClangService *self = (IdeClangService *)object;
+  g_autoptr(GHashTable) units = NULL;
+  GHashTableIter iter;
+  gpointer value;
 
   IDE_ENTRY;
 
   g_clear_object (&self->units_cache);
   g_clear_object (&self->cancellable);
+
+  /*
+   * Translation units must be released before the index they belong to,
+   * even those of units that are still referenced elsewhere.
+   */
+  g_mutex_lock (&self->units_mutex);
+  units = g_steal_pointer (&self->units);
+  g_mutex_unlock (&self->units_mutex);
+
+  if (units != NULL)
+    {
+      g_hash_table_iter_init (&iter, units);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          IdeClangUnit *unit = value;
+
+          g_rec_mutex_lock (&unit->mutex);
+          ide_clang_unit_set_tu (unit, NULL, NULL, FALSE);
+          g_rec_mutex_unlock (&unit->mutex);
+        }
+    }
+
   g_clear_pointer (&self->index, clang_disposeIndex);
 
   G_OBJECT_CLASS (ide_clang_service_parent_class)->dispose (object);
@@ -686,8 +1499,13 @@ ide_clang_service_dispose (GObject *object)
 static void
 ide_clang_service_finalize (GObject *object)
 {
+  IdeClangService *self = (IdeClangService *)object;
+
   IDE_ENTRY;
 
+  g_mutex_clear (&self->units_mutex);
+  g_clear_pointer (&self->reparsing, g_hash_table_unref);
+
   G_OBJECT_CLASS (ide_clang_service_parent_class)->finalize (object);
 
   IDE_EXIT;
@@ -712,6 +1530,13 @@ service_iface_init (IdeServiceInterface *iface)
 static void
 ide_clang_service_init (IdeClangService *self)
 {
+  g_mutex_init (&self->units_mutex);
+  self->units = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)ide_clang_unit_unref);
+  self->reparsing = g_hash_table_new_full ((GHashFunc)ide_file_hash,
+                                           (GEqualFunc)ide_file_equal,
+                                           g_object_unref,
+                                           (GDestroyNotify)g_ptr_array_unref);
 }
 
 /**
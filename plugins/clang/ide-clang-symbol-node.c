@@ -22,14 +22,17 @@
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 
+#include "ide-clang-private.h"
 #include "ide-clang-symbol-node.h"
 
 struct _IdeClangSymbolNode
 {
   IdeSymbolNode parent_instance;
 
-  CXCursor  cursor;
-  GArray   *children;
+  /* The translation unit @cursor belongs to */
+  IdeRefPtr *native;
+  CXCursor   cursor;
+  GArray    *children;
 };
 
 G_DEFINE_TYPE (IdeClangSymbolNode, ide_clang_symbol_node, IDE_TYPE_SYMBOL_NODE)
@@ -130,6 +133,7 @@ get_symbol_kind (CXCursor        cursor,
 
 IdeClangSymbolNode *
 _ide_clang_symbol_node_new (IdeContext *context,
+                            IdeRefPtr  *native,
                             CXCursor    cursor)
 {
   IdeClangSymbolNode *self;
@@ -149,6 +153,7 @@ _ide_clang_symbol_node_new (IdeContext *context,
                        "name", ide_str_empty0 (name) ? _("anonymous") : name,
                        NULL);
 
+  self->native = ide_ref_ptr_ref (native);
   self->cursor = cursor;
 
   clang_disposeString (cxname);
@@ -188,6 +193,18 @@ ide_clang_symbol_node_get_location_async (IdeSymbolNode       *symbol_node,
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, ide_clang_symbol_node_get_location_async);
 
+  /* The cursor is gone once the translation unit was reparsed */
+  if (_ide_clang_unit_lock (self->native) == NULL ||
+      _ide_clang_unit_is_outdated (self->native))
+    {
+      _ide_clang_unit_unlock (self->native);
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_FAILED,
+                               "The symbol is outdated");
+      return;
+    }
+
   cxloc = clang_getCursorLocation (self->cursor);
   clang_getFileLocation (cxloc, &file, &line, &line_offset, NULL);
   cxfilename = clang_getFileName (file);
@@ -210,6 +227,8 @@ ide_clang_symbol_node_get_location_async (IdeSymbolNode       *symbol_node,
   g_clear_object (&gfile);
   clang_disposeString (cxfilename);
 
+  _ide_clang_unit_unlock (self->native);
+
   g_task_return_pointer (task, ret, (GDestroyNotify)ide_source_location_unref);
 }
 
@@ -224,11 +243,25 @@ ide_clang_symbol_node_get_location_finish (IdeSymbolNode  *symbol_node,
   return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+static void
+ide_clang_symbol_node_finalize (GObject *object)
+{
+  IdeClangSymbolNode *self = (IdeClangSymbolNode *)object;
+
+  g_clear_pointer (&self->children, g_array_unref);
+  g_clear_pointer (&self->native, ide_ref_ptr_unref);
+
+  G_OBJECT_CLASS (ide_clang_symbol_node_parent_class)->finalize (object);
+}
+
 static void
 ide_clang_symbol_node_class_init (IdeClangSymbolNodeClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   IdeSymbolNodeClass *node_class = IDE_SYMBOL_NODE_CLASS (klass);
 
+  object_class->finalize = ide_clang_symbol_node_finalize;
+
   node_class->get_location_async = ide_clang_symbol_node_get_location_async;
   node_class->get_location_finish = ide_clang_symbol_node_get_location_finish;
 }
@@ -161,15 +161,18 @@ ide_clang_symbol_tree_get_n_children (IdeSymbolTree *symbol_tree,
   if (children != NULL)
     return children->len;
 
-  if (parent == NULL)
+  /* Cursors cannot be used once the translation unit was reparsed */
+  if (NULL == (tu = _ide_clang_unit_lock (self->native)) ||
+      _ide_clang_unit_is_outdated (self->native))
     {
-      tu = ide_ref_ptr_get (self->native);
-      cursor = clang_getTranslationUnitCursor (tu);
+      _ide_clang_unit_unlock (self->native);
+      return 0;
     }
+
+  if (parent == NULL)
+    cursor = clang_getTranslationUnitCursor (tu);
   else
-    {
-      cursor = _ide_clang_symbol_node_get_cursor (IDE_CLANG_SYMBOL_NODE (parent));
-    }
+    cursor = _ide_clang_symbol_node_get_cursor (IDE_CLANG_SYMBOL_NODE (parent));
 
   children = g_array_new (FALSE, FALSE, sizeof (CXCursor));
 
@@ -180,6 +183,8 @@ ide_clang_symbol_tree_get_n_children (IdeSymbolTree *symbol_tree,
                        count_recognizable_children,
                        &state);
 
+  _ide_clang_unit_unlock (self->native);
+
   if (parent == NULL)
     self->children = g_array_ref (children);
   else
@@ -215,10 +220,17 @@ ide_clang_symbol_tree_get_nth_child (IdeSymbolTree *symbol_tree,
 
   if (nth < children->len)
     {
+      IdeSymbolNode *ret = NULL;
       CXCursor cursor;
 
       cursor = g_array_index (children, CXCursor, nth);
-      return _ide_clang_symbol_node_new (context, cursor);
+
+      if (_ide_clang_unit_lock (self->native) != NULL &&
+          !_ide_clang_unit_is_outdated (self->native))
+        ret = IDE_SYMBOL_NODE (_ide_clang_symbol_node_new (context, self->native, cursor));
+      _ide_clang_unit_unlock (self->native);
+
+      return ret;
     }
 
   g_warning ("nth child %u is out of bounds", nth);
@@ -28,6 +28,7 @@
 #include "ide-clang-private.h"
 #include "ide-clang-symbol-tree.h"
 #include "ide-clang-translation-unit.h"
+#include "ide-clang-xref-service.h"
 #include "ide-internal.h"
 
 struct _IdeClangTranslationUnit
@@ -39,6 +40,7 @@ struct _IdeClangTranslationUnit
   GFile             *file;
   IdeHighlightIndex *index;
   GHashTable        *diagnostics;
+  guint              from_ast : 1;
 };
 
 typedef struct
@@ -130,7 +132,7 @@ ide_clang_translation_unit_set_file (IdeClangTranslationUnit *self,
 
 IdeClangTranslationUnit *
 _ide_clang_translation_unit_new (IdeContext        *context,
-                                 CXTranslationUnit  tu,
+                                 IdeRefPtr         *tu,
                                  GFile             *file,
                                  IdeHighlightIndex *index,
                                  gint64             serial)
@@ -138,7 +140,7 @@ _ide_clang_translation_unit_new (IdeContext        *context,
   IdeClangTranslationUnit *ret;
 
   g_return_val_if_fail (IDE_IS_CONTEXT (context), NULL);
-  g_return_val_if_fail (tu, NULL);
+  g_return_val_if_fail (tu != NULL, NULL);
   g_return_val_if_fail (!file || G_IS_FILE (file), NULL);
 
   ret = g_object_new (IDE_TYPE_CLANG_TRANSLATION_UNIT,
@@ -152,6 +154,27 @@ _ide_clang_translation_unit_new (IdeContext        *context,
   return ret;
 }
 
+/*
+ * Units loaded from a saved AST have no source behind them, so they
+ * cannot be used for code completion.
+ */
+void
+_ide_clang_translation_unit_set_from_ast (IdeClangTranslationUnit *self,
+                                          gboolean                 from_ast)
+{
+  g_return_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self));
+
+  self->from_ast = !!from_ast;
+}
+
+gboolean
+_ide_clang_translation_unit_get_from_ast (IdeClangTranslationUnit *self)
+{
+  g_return_val_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self), FALSE);
+
+  return self->from_ast;
+}
+
 static IdeDiagnosticSeverity
 translate_severity (enum CXDiagnosticSeverity severity)
 {
@@ -373,7 +396,7 @@ ide_clang_translation_unit_get_diagnostics_for_file (IdeClangTranslationUnit *se
 
   if (!g_hash_table_contains (self->diagnostics, file))
     {
-      CXTranslationUnit tu = ide_ref_ptr_get (self->native);
+      CXTranslationUnit tu;
       IdeContext *context;
       IdeProject *project;
       IdeVcs *vcs;
@@ -398,9 +421,15 @@ ide_clang_translation_unit_get_diagnostics_for_file (IdeClangTranslationUnit *se
       workdir = ide_vcs_get_working_directory (vcs);
       workpath = g_file_get_path (workdir);
 
+      /*
+       * The parse worker holds this lock when collecting diagnostics, so
+       * it must be taken before the project lock.
+       */
+      tu = _ide_clang_unit_lock (self->native);
+
       ide_project_reader_lock (project);
 
-      count = clang_getNumDiagnostics (tu);
+      count = tu != NULL ? clang_getNumDiagnostics (tu) : 0;
       for (i = 0; i < count; i++)
         {
           CXDiagnostic cxdiag;
@@ -439,6 +468,7 @@ ide_clang_translation_unit_get_diagnostics_for_file (IdeClangTranslationUnit *se
         }
 
       ide_project_reader_unlock (project);
+      _ide_clang_unit_unlock (self->native);
 
       g_hash_table_insert (self->diagnostics, g_object_ref (file), ide_diagnostics_new (diags));
     }
@@ -469,12 +499,12 @@ ide_clang_translation_unit_get_serial (IdeClangTranslationUnit *self)
 
 static void
 ide_clang_translation_unit_set_native (IdeClangTranslationUnit *self,
-                                       CXTranslationUnit        native)
+                                       IdeRefPtr               *native)
 {
   g_assert (IDE_IS_CLANG_TRANSLATION_UNIT (self));
 
   if (native != NULL)
-    self->native = ide_ref_ptr_new (native, (GDestroyNotify)clang_disposeTranslationUnit);
+    self->native = ide_ref_ptr_ref (native);
 }
 
 static void
@@ -546,7 +576,7 @@ ide_clang_translation_unit_set_property (GObject      *object,
       break;
 
     case PROP_NATIVE:
-      ide_clang_translation_unit_set_native (self, g_value_get_pointer (value));
+      ide_clang_translation_unit_set_native (self, g_value_get_boxed (value));
       break;
 
     default:
@@ -578,10 +608,11 @@ ide_clang_translation_unit_class_init (IdeClangTranslationUnitClass *klass)
                          (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
   properties [PROP_NATIVE] =
-    g_param_spec_pointer ("native",
-                          "Native",
-                          "The native translation unit pointer.",
-                          (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+    g_param_spec_boxed ("native",
+                        "Native",
+                        "The native translation unit pointer.",
+                        IDE_TYPE_REF_PTR,
+                        (G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
   properties [PROP_SERIAL] =
     g_param_spec_int64 ("serial",
@@ -626,13 +657,6 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
   g_assert (state);
   g_assert (state->unsaved_files);
 
-  tu = ide_ref_ptr_get (self->native);
-
-  /*
-   * FIXME: Not thread safe! We should probably add a "Pending" flag or something that is
-   *        similar to g_input_stream_set_pending().
-   */
-
   if (!state->path)
     {
       /* implausable to reach here, anyway */
@@ -672,12 +696,27 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
         }
     }
 
-  results = clang_codeCompleteAt (tu,
-                                  state->path,
-                                  state->line + 1,
-                                  state->line_offset + 1,
-                                  ufs, j,
-                                  clang_defaultCodeCompleteOptions ());
+  /* The translation unit must not be reparsed while completing */
+  if (NULL != (tu = _ide_clang_unit_lock (self->native)))
+    results = clang_codeCompleteAt (tu,
+                                    state->path,
+                                    state->line + 1,
+                                    state->line_offset + 1,
+                                    ufs, j,
+                                    clang_defaultCodeCompleteOptions ());
+  else
+    results = NULL;
+  _ide_clang_unit_unlock (self->native);
+
+  /* Translation units loaded from an AST file cannot be completed */
+  if (results == NULL)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_FAILED,
+                               _("Failed to complete code at location"));
+      goto cleanup;
+    }
 
   /*
    * encapsulate in refptr so we don't need to malloc lots of little strings.
@@ -696,6 +735,7 @@ ide_clang_translation_unit_code_complete_worker (GTask        *task,
 
   g_task_return_pointer (task, ar, (GDestroyNotify)g_ptr_array_unref);
 
+cleanup:
   /* cleanup malloc'd state */
   for (i = 0; i < j; i++)
     g_free ((gchar *)ufs [i].Filename);
@@ -871,10 +911,10 @@ get_symbol_kind (CXCursor        cursor,
   return kind;
 }
 
-IdeSymbol *
-ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
-                                          IdeSourceLocation        *location,
-                                          GError                  **error)
+static IdeSymbol *
+ide_clang_translation_unit_lookup_symbol_locked (IdeClangTranslationUnit *self,
+                                                 CXTranslationUnit        tu,
+                                                 IdeSourceLocation       *location)
 {
   g_autofree gchar *filename = NULL;
   g_autofree gchar *workpath = NULL;
@@ -882,7 +922,6 @@ ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
   g_autoptr(IdeSourceLocation) declaration = NULL;
   g_autoptr(IdeSourceLocation) definition = NULL;
   g_autoptr(IdeSourceLocation) canonical = NULL;
-  CXTranslationUnit tu;
   IdeSymbolKind symkind = 0;
   IdeSymbolFlags symflags = 0;
   IdeProject *project;
@@ -901,10 +940,9 @@ ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
 
   IDE_ENTRY;
 
-  g_return_val_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self), NULL);
-  g_return_val_if_fail (location != NULL, NULL);
-
-  tu = ide_ref_ptr_get (self->native);
+  g_assert (IDE_IS_CLANG_TRANSLATION_UNIT (self));
+  g_assert (tu != NULL);
+  g_assert (location != NULL);
 
   context = ide_object_get_context (IDE_OBJECT (self));
   project = ide_context_get_project (context);
@@ -935,6 +973,28 @@ ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
       cxrange = clang_getCursorExtent (tmpcursor);
       tmploc = clang_getRangeStart (cxrange);
       definition = create_location (self, project, workpath, tmploc);
+
+      /*
+       * The referenced cursor is often only a declaration from a header.
+       * The definition may live in a translation unit that we have not
+       * parsed, so check the project-wide index for it.
+       */
+      if (!clang_isCursorDefinition (tmpcursor))
+        {
+          g_auto(CXString) usr = { 0 };
+          IdeClangXrefService *xref;
+          IdeSourceLocation *indexed;
+
+          usr = clang_getCursorUSR (tmpcursor);
+          xref = ide_context_get_service_typed (context, IDE_TYPE_CLANG_XREF_SERVICE);
+
+          if (xref != NULL &&
+              NULL != (indexed = ide_clang_xref_service_find_definition (xref, clang_getCString (usr))))
+            {
+              declaration = g_steal_pointer (&definition);
+              definition = indexed;
+            }
+        }
     }
 
   symkind = get_symbol_kind (cursor, &symflags);
@@ -978,6 +1038,24 @@ ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
   IDE_RETURN (ret);
 }
 
+IdeSymbol *
+ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
+                                          IdeSourceLocation        *location,
+                                          GError                  **error)
+{
+  CXTranslationUnit tu;
+  IdeSymbol *ret = NULL;
+
+  g_return_val_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self), NULL);
+  g_return_val_if_fail (location != NULL, NULL);
+
+  if (NULL != (tu = _ide_clang_unit_lock (self->native)))
+    ret = ide_clang_translation_unit_lookup_symbol_locked (self, tu, location);
+  _ide_clang_unit_unlock (self->native);
+
+  return ret;
+}
+
 static IdeSymbol *
 create_symbol (CXCursor         cursor,
                GetSymbolsState *state)
@@ -1066,6 +1144,7 @@ ide_clang_translation_unit_get_symbols (IdeClangTranslationUnit *self,
                                         IdeFile                 *file)
 {
   GetSymbolsState state = { 0 };
+  CXTranslationUnit tu;
   CXCursor cursor;
 
   g_return_val_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self), NULL);
@@ -1075,10 +1154,14 @@ ide_clang_translation_unit_get_symbols (IdeClangTranslationUnit *self,
   state.file = file;
   state.path = g_file_get_path (ide_file_get_file (file));
 
-  cursor = clang_getTranslationUnitCursor (ide_ref_ptr_get (self->native));
-  clang_visitChildren (cursor,
-                       ide_clang_translation_unit_get_symbols__visitor_cb,
-                       &state);
+  if (NULL != (tu = _ide_clang_unit_lock (self->native)))
+    {
+      cursor = clang_getTranslationUnitCursor (tu);
+      clang_visitChildren (cursor,
+                           ide_clang_translation_unit_get_symbols__visitor_cb,
+                           &state);
+    }
+  _ide_clang_unit_unlock (self->native);
 
   g_ptr_array_sort (state.ar, sort_symbols_by_name);
 
@@ -0,0 +1,253 @@
+/* ide-clang-worker.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-clang-worker"
+
+#include <clang-c/Index.h>
+
+#include "ide-clang-private.h"
+#include "ide-clang-worker.h"
+
+/*
+ * IdeClangWorker runs inside of gnome-builder-worker processes spawned by
+ * the IdeWorkerManager. It exports an object on the private D-Bus
+ * connection to the IDE that performs libclang work on its behalf, so a
+ * crash inside of libclang only takes down the worker, which is then
+ * respawned.
+ */
+
+#define CLANG_WORKER_INTERFACE "org.gnome.builder.plugins.clang"
+#define CLANG_WORKER_PATH      "/"
+
+struct _IdeClangWorker
+{
+  GObject          parent_instance;
+
+  CXIndex          index;
+  GDBusConnection *connection;
+  guint            registration_id;
+};
+
+typedef struct
+{
+  GDBusMethodInvocation  *invocation;
+  gchar                  *source_filename;
+  gchar                  *workpath;
+  gchar                  *cache_path;
+  gchar                 **argv;
+} IndexRequest;
+
+static void worker_iface_init (IdeWorkerInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (IdeClangWorker, ide_clang_worker, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (IDE_TYPE_WORKER, worker_iface_init))
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" CLANG_WORKER_INTERFACE "'>"
+  "    <method name='Index'>"
+  "      <arg type='s' name='source_filename' direction='in'/>"
+  "      <arg type='s' name='workpath' direction='in'/>"
+  "      <arg type='s' name='cache_path' direction='in'/>"
+  "      <arg type='as' name='argv' direction='in'/>"
+  "      <arg type='v' name='index' direction='out'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+static void
+index_request_free (gpointer data)
+{
+  IndexRequest *request = data;
+
+  g_clear_object (&request->invocation);
+  g_clear_pointer (&request->source_filename, g_free);
+  g_clear_pointer (&request->workpath, g_free);
+  g_clear_pointer (&request->cache_path, g_free);
+  g_clear_pointer (&request->argv, g_strfreev);
+  g_slice_free (IndexRequest, request);
+}
+
+static void
+ide_clang_worker_index_worker (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+  IdeClangWorker *self = source_object;
+  IndexRequest *request = task_data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CLANG_WORKER (self));
+  g_assert (request != NULL);
+
+  ret = _ide_clang_xref_index_file (self->index,
+                                    request->source_filename,
+                                    request->workpath,
+                                    request->cache_path,
+                                    (const gchar * const *)request->argv,
+                                    NULL,
+                                    &error);
+
+  /* Replies may be sent from any thread */
+  if (ret == NULL)
+    g_dbus_method_invocation_take_error (g_steal_pointer (&request->invocation), error);
+  else
+    g_dbus_method_invocation_return_value (g_steal_pointer (&request->invocation),
+                                           g_variant_new ("(v)", ret));
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_clang_worker_method_call (GDBusConnection       *connection,
+                              const gchar           *sender,
+                              const gchar           *object_path,
+                              const gchar           *interface_name,
+                              const gchar           *method_name,
+                              GVariant              *parameters,
+                              GDBusMethodInvocation *invocation,
+                              gpointer               user_data)
+{
+  IdeClangWorker *self = user_data;
+
+  g_assert (IDE_IS_CLANG_WORKER (self));
+  g_assert (G_IS_DBUS_METHOD_INVOCATION (invocation));
+
+  if (g_strcmp0 (method_name, "Index") == 0)
+    {
+      g_autoptr(GTask) task = NULL;
+      IndexRequest *request;
+
+      request = g_slice_new0 (IndexRequest);
+      request->invocation = invocation;
+      g_variant_get (parameters,
+                     "(sss^as)",
+                     &request->source_filename,
+                     &request->workpath,
+                     &request->cache_path,
+                     &request->argv);
+
+      task = g_task_new (self, NULL, NULL, NULL);
+      g_task_set_source_tag (task, ide_clang_worker_method_call);
+      g_task_set_task_data (task, request, index_request_free);
+      g_task_run_in_thread (task, ide_clang_worker_index_worker);
+
+      return;
+    }
+
+  g_dbus_method_invocation_return_error (invocation,
+                                         G_DBUS_ERROR,
+                                         G_DBUS_ERROR_UNKNOWN_METHOD,
+                                         "No such method \"%s\"",
+                                         method_name);
+}
+
+static const GDBusInterfaceVTable vtable = {
+  ide_clang_worker_method_call,
+};
+
+static void
+ide_clang_worker_register_service (IdeWorker       *worker,
+                                   GDBusConnection *connection)
+{
+  IdeClangWorker *self = (IdeClangWorker *)worker;
+  g_autoptr(GDBusNodeInfo) info = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (IDE_IS_CLANG_WORKER (self));
+  g_assert (G_IS_DBUS_CONNECTION (connection));
+
+  info = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  g_assert (info != NULL);
+
+  g_set_object (&self->connection, connection);
+
+  /* Only the worker process needs an index, not the proxy side */
+  self->index = clang_createIndex (0, 0);
+  clang_CXIndex_setGlobalOptions (self->index,
+                                  CXGlobalOpt_ThreadBackgroundPriorityForAll);
+
+  self->registration_id =
+    g_dbus_connection_register_object (connection,
+                                       CLANG_WORKER_PATH,
+                                       info->interfaces [0],
+                                       &vtable,
+                                       self,
+                                       NULL,
+                                       &error);
+
+  if (self->registration_id == 0)
+    g_warning ("Failed to register clang worker: %s", error->message);
+}
+
+static GDBusProxy *
+ide_clang_worker_create_proxy (IdeWorker        *worker,
+                               GDBusConnection  *connection,
+                               GError          **error)
+{
+  g_assert (IDE_IS_CLANG_WORKER (worker));
+  g_assert (G_IS_DBUS_CONNECTION (connection));
+
+  return g_dbus_proxy_new_sync (connection,
+                                (G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+                                 G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+                                 G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START_AT_CONSTRUCTION),
+                                NULL,
+                                NULL,
+                                CLANG_WORKER_PATH,
+                                CLANG_WORKER_INTERFACE,
+                                NULL,
+                                error);
+}
+
+static void
+ide_clang_worker_finalize (GObject *object)
+{
+  IdeClangWorker *self = (IdeClangWorker *)object;
+
+  if (self->registration_id != 0)
+    g_dbus_connection_unregister_object (self->connection, self->registration_id);
+
+  g_clear_object (&self->connection);
+  g_clear_pointer (&self->index, clang_disposeIndex);
+
+  G_OBJECT_CLASS (ide_clang_worker_parent_class)->finalize (object);
+}
+
+static void
+ide_clang_worker_class_init (IdeClangWorkerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_clang_worker_finalize;
+}
+
+static void
+worker_iface_init (IdeWorkerInterface *iface)
+{
+  iface->create_proxy = ide_clang_worker_create_proxy;
+  iface->register_service = ide_clang_worker_register_service;
+}
+
+static void
+ide_clang_worker_init (IdeClangWorker *self)
+{
+}
@@ -0,0 +1,1432 @@
+/* ide-clang-xref-service.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-clang-xref-service"
+
+#include <clang-c/Index.h>
+#include <egg-counter.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "ide-clang-private.h"
+#include "ide-clang-xref-service.h"
+
+/*
+ * This service maintains a project-wide cross-reference index. Every
+ * source file in the project is run through clang_indexSourceFile(), and
+ * the declarations and definitions found within the project tree are
+ * merged into an in-memory table keyed by USR. That lets us jump to the
+ * definition of a symbol in a translation unit that has not been parsed.
+ *
+ * Indexing happens in a pool of clang worker processes (see
+ * ide-clang-worker.c) so that libclang crashing on a file does not take
+ * the IDE down with it, and so that several files can be indexed at once.
+ * Files are routed to workers by filename. When workers are unavailable,
+ * such as when running as a command line tool, files are indexed on the
+ * indexer thread pool instead.
+ *
+ * The results for each translation unit are also written to the cache
+ * directory as a GVariant, along with the modification time of every
+ * file that contributed to them. On the next startup, translation units
+ * whose files have not changed are loaded from the cache by mapping the
+ * file instead of being indexed again. Once the project has been crawled,
+ * the caches of files that are no longer part of it are removed.
+ *
+ * Results are grouped by the file they were found in, and a file is only
+ * merged again when its modification time changes. That keeps headers
+ * that are included by many translation units from being churned.
+ */
+
+#define MAX_WORKERS        4
+#define XREF_CACHE_VERSION 2
+#define XREF_CACHE_TYPE    "(usa(sta(ssuuyy)))"
+
+struct _IdeClangXrefService
+{
+  IdeObject     parent_instance;
+
+  CXIndex       index;
+  GCancellable *cancellable;
+  gchar        *cache_dir;
+
+  /* Interned USRs, names and paths */
+  GStringChunk *strings;
+
+  /* USR → XrefSymbol */
+  GHashTable   *symbols;
+
+  /* Interned path → XrefFile */
+  GHashTable   *files;
+
+  /* Files waiting to be indexed, and a set to avoid queuing them twice */
+  GQueue        queue;
+  GHashTable   *queued;
+
+  /* Files that crashed a worker process, until they are saved again */
+  GHashTable   *failed;
+
+  guint         n_workers;
+  guint         n_active;
+};
+
+typedef struct
+{
+  const gchar *path;
+  guint        line;
+  guint        column;
+  guint        flags;
+} XrefRecord;
+
+typedef struct
+{
+  const gchar   *usr;
+  const gchar   *name;
+  IdeSymbolKind  kind;
+  GArray        *records;
+} XrefSymbol;
+
+typedef struct
+{
+  guint64    mtime;
+
+  /* XrefSymbols with records in this file */
+  GPtrArray *symbols;
+} XrefFile;
+
+typedef struct
+{
+  gchar     *source_filename;
+  gchar     *workpath;
+  gchar     *cache_path;
+  gchar    **argv;
+  gboolean   out_of_process;
+} IndexRequest;
+
+typedef struct
+{
+  gchar      *cache_dir;
+
+  /* Names of the cache files to keep */
+  GHashTable *keep;
+} PruneRequest;
+
+typedef struct
+{
+  gchar           *path;
+  guint64          mtime;
+  GVariantBuilder *records;
+} IndexFile;
+
+typedef struct
+{
+  GCancellable *cancellable;
+  const gchar  *workpath;
+
+  /* CXFile → IndexFile, or NULL for files outside of the project */
+  GHashTable   *files;
+  GPtrArray    *ordered;
+} IndexState;
+
+static void service_iface_init (IdeServiceInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (IdeClangXrefService, ide_clang_xref_service, IDE_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (IDE_TYPE_SERVICE, service_iface_init))
+
+EGG_DEFINE_COUNTER (IndexedFiles,
+                    "Clang",
+                    "Indexed Files",
+                    "Number of translation units run through the clang indexer.")
+
+EGG_DEFINE_COUNTER (CachedFiles,
+                    "Clang",
+                    "Cached Index Files",
+                    "Number of translation units loaded from the index cache.")
+
+EGG_DEFINE_COUNTER (PrunedFiles,
+                    "Clang",
+                    "Pruned Index Files",
+                    "Number of index cache files removed for files no longer in the project.")
+
+static const gchar *source_suffixes[] = {
+  ".c", ".cc", ".cpp", ".cxx", ".c++", ".m", ".mm",
+};
+
+static const gchar *header_suffixes[] = {
+  ".h", ".hh", ".hpp", ".hxx", ".h++",
+};
+
+static gboolean
+has_suffix (const gchar  *name,
+            const gchar **suffixes,
+            guint         n_suffixes)
+{
+  for (guint i = 0; i < n_suffixes; i++)
+    {
+      if (g_str_has_suffix (name, suffixes [i]))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+xref_symbol_free (gpointer data)
+{
+  XrefSymbol *symbol = data;
+
+  g_clear_pointer (&symbol->records, g_array_unref);
+  g_slice_free (XrefSymbol, symbol);
+}
+
+static void
+xref_file_free (gpointer data)
+{
+  XrefFile *file = data;
+
+  g_clear_pointer (&file->symbols, g_ptr_array_unref);
+  g_slice_free (XrefFile, file);
+}
+
+static void
+index_request_free (gpointer data)
+{
+  IndexRequest *request = data;
+
+  g_clear_pointer (&request->source_filename, g_free);
+  g_clear_pointer (&request->workpath, g_free);
+  g_clear_pointer (&request->cache_path, g_free);
+  g_clear_pointer (&request->argv, g_strfreev);
+  g_slice_free (IndexRequest, request);
+}
+
+static void
+prune_request_free (gpointer data)
+{
+  PruneRequest *request = data;
+
+  g_clear_pointer (&request->cache_dir, g_free);
+  g_clear_pointer (&request->keep, g_hash_table_unref);
+  g_slice_free (PruneRequest, request);
+}
+
+static void
+index_file_free (gpointer data)
+{
+  IndexFile *file = data;
+
+  g_clear_pointer (&file->path, g_free);
+  g_clear_pointer (&file->records, g_variant_builder_unref);
+  g_slice_free (IndexFile, file);
+}
+
+static IdeSymbolKind
+get_symbol_kind (CXIdxEntityKind kind)
+{
+  switch (kind)
+    {
+    case CXIdxEntity_Function:
+      return IDE_SYMBOL_FUNCTION;
+
+    case CXIdxEntity_ObjCInstanceMethod:
+    case CXIdxEntity_ObjCClassMethod:
+    case CXIdxEntity_CXXInstanceMethod:
+    case CXIdxEntity_CXXStaticMethod:
+      return IDE_SYMBOL_METHOD;
+
+    case CXIdxEntity_CXXConstructor:
+      return IDE_SYMBOL_CONSTRUCTOR;
+
+    case CXIdxEntity_Variable:
+    case CXIdxEntity_CXXStaticVariable:
+      return IDE_SYMBOL_VARIABLE;
+
+    case CXIdxEntity_Field:
+    case CXIdxEntity_ObjCIvar:
+      return IDE_SYMBOL_FIELD;
+
+    case CXIdxEntity_ObjCProperty:
+      return IDE_SYMBOL_PROPERTY;
+
+    case CXIdxEntity_EnumConstant:
+      return IDE_SYMBOL_ENUM_VALUE;
+
+    case CXIdxEntity_Enum:
+      return IDE_SYMBOL_ENUM;
+
+    case CXIdxEntity_Struct:
+      return IDE_SYMBOL_STRUCT;
+
+    case CXIdxEntity_Union:
+      return IDE_SYMBOL_UNION;
+
+    case CXIdxEntity_ObjCClass:
+    case CXIdxEntity_CXXClass:
+      return IDE_SYMBOL_CLASS;
+
+    case CXIdxEntity_ObjCProtocol:
+    case CXIdxEntity_CXXInterface:
+      return IDE_SYMBOL_INTERFACE;
+
+    case CXIdxEntity_CXXNamespace:
+    case CXIdxEntity_CXXNamespaceAlias:
+      return IDE_SYMBOL_NAMESPACE;
+
+    default:
+      return IDE_SYMBOL_NONE;
+    }
+}
+
+static IndexFile *
+index_state_get_file (IndexState *state,
+                      CXIdxLoc    loc,
+                      guint      *line,
+                      guint      *column)
+{
+  g_auto(CXString) cxname = { 0 };
+  CXIdxClientFile client_file = NULL;
+  CXFile cxfile = NULL;
+  IndexFile *file = NULL;
+  const gchar *name;
+  gpointer value;
+
+  clang_indexLoc_getFileLocation (loc, &client_file, &cxfile, line, column, NULL);
+
+  if (cxfile == NULL)
+    return NULL;
+
+  if (g_hash_table_lookup_extended (state->files, cxfile, NULL, &value))
+    return value;
+
+  cxname = clang_getFileName (cxfile);
+  name = clang_getCString (cxname);
+
+  /* We only index what lives within the project tree */
+  if (name != NULL && g_str_has_prefix (name, state->workpath))
+    {
+      file = g_slice_new0 (IndexFile);
+      file->path = g_strdup (name);
+      file->mtime = MAX (0, _ide_clang_get_mtime_usec (name));
+      file->records = g_variant_builder_new (G_VARIANT_TYPE ("a(ssuuyy)"));
+      g_ptr_array_add (state->ordered, file);
+    }
+
+  g_hash_table_insert (state->files, cxfile, file);
+
+  return file;
+}
+
+static void
+index_state_add (IndexState             *state,
+                 const CXIdxEntityInfo  *entity,
+                 CXIdxLoc                loc,
+                 IdeClangXrefFlags       flags)
+{
+  IndexFile *file;
+  guint line = 0;
+  guint column = 0;
+
+  if (entity == NULL ||
+      entity->USR == NULL || *entity->USR == '\0' ||
+      entity->name == NULL || *entity->name == '\0')
+    return;
+
+  if (!(file = index_state_get_file (state, loc, &line, &column)))
+    return;
+
+  if (line > 0) line--;
+  if (column > 0) column--;
+
+  g_variant_builder_add (file->records,
+                         "(ssuuyy)",
+                         entity->USR,
+                         entity->name,
+                         line,
+                         column,
+                         (guint8)get_symbol_kind (entity->kind),
+                         (guint8)flags);
+}
+
+static int
+index_abort_query (CXClientData  client_data,
+                   void         *reserved)
+{
+  IndexState *state = client_data;
+
+  return g_cancellable_is_cancelled (state->cancellable);
+}
+
+static void
+index_declaration (CXClientData         client_data,
+                   const CXIdxDeclInfo *info)
+{
+  index_state_add (client_data,
+                   info->entityInfo,
+                   info->loc,
+                   info->isDefinition ? IDE_CLANG_XREF_DEFINITION
+                                      : IDE_CLANG_XREF_DECLARATION);
+}
+
+static IndexerCallbacks index_callbacks = {
+  .abortQuery = index_abort_query,
+  .indexDeclaration = index_declaration,
+};
+
+static GVariant *
+ide_clang_xref_service_load_cache (const gchar *cache_path,
+                                   const gchar *flags)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GVariant) files = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  const gchar *cached_flags = NULL;
+  const gchar *path;
+  GVariantIter iter;
+  guint32 version = 0;
+  guint64 mtime;
+
+  g_assert (cache_path != NULL);
+  g_assert (flags != NULL);
+
+  if (!(mapped = g_mapped_file_new (cache_path, FALSE, NULL)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (XREF_CACHE_TYPE), bytes, FALSE);
+  g_variant_ref_sink (variant);
+
+  g_variant_get (variant, "(u&s@a(sta(ssuuyy)))", &version, &cached_flags, &files);
+
+  if (version != XREF_CACHE_VERSION || g_strcmp0 (cached_flags, flags) != 0)
+    return NULL;
+
+  /* Every file that contributed to the results must be unchanged */
+  g_variant_iter_init (&iter, files);
+  while (g_variant_iter_next (&iter, "(&st@a(ssuuyy))", &path, &mtime, NULL))
+    {
+      if (_ide_clang_get_mtime_usec (path) != (gint64)mtime)
+        return NULL;
+    }
+
+  return g_steal_pointer (&variant);
+}
+
+static void
+ide_clang_xref_service_save_cache (const gchar *cache_path,
+                                   GVariant    *variant)
+{
+  g_autofree gchar *dir = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (cache_path != NULL);
+  g_assert (variant != NULL);
+
+  dir = g_path_get_dirname (cache_path);
+
+  if (g_mkdir_with_parents (dir, 0750) != 0)
+    return;
+
+  if (!g_file_set_contents (cache_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_debug ("Failed to save index cache: %s", error->message);
+}
+
+/*
+ * Runs @source_filename through the clang indexer and collects the records
+ * found within @workpath. The results are saved to @cache_path.
+ *
+ * This is used both from the indexer thread pool and from the clang worker
+ * processes, so it must not touch any state of the service.
+ *
+ * Returns: (transfer full): A #GVariant of type %XREF_CACHE_TYPE.
+ */
+GVariant *
+_ide_clang_xref_index_file (CXIndex              index,
+                            const gchar         *source_filename,
+                            const gchar         *workpath,
+                            const gchar         *cache_path,
+                            const gchar * const *argv,
+                            GCancellable        *cancellable,
+                            GError             **error)
+{
+  g_autoptr(GPtrArray) ordered = NULL;
+  g_autoptr(GHashTable) files = NULL;
+  g_autofree gchar *flags = NULL;
+  GVariantBuilder builder;
+  CXIndexAction action;
+  IndexState state = { 0 };
+  gboolean has_source = FALSE;
+  GVariant *ret;
+  int code;
+
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (source_filename != NULL, NULL);
+  g_return_val_if_fail (workpath != NULL, NULL);
+  g_return_val_if_fail (argv != NULL, NULL);
+
+  EGG_COUNTER_INC (IndexedFiles);
+
+  flags = g_strjoinv ("\n", (gchar **)argv);
+  files = g_hash_table_new (NULL, NULL);
+  ordered = g_ptr_array_new_with_free_func (index_file_free);
+
+  state.cancellable = cancellable;
+  state.workpath = workpath;
+  state.files = files;
+  state.ordered = ordered;
+
+  action = clang_IndexAction_create (index);
+  code = clang_indexSourceFile (action,
+                                &state,
+                                &index_callbacks,
+                                sizeof index_callbacks,
+                                CXIndexOpt_None,
+                                source_filename,
+                                argv,
+                                g_strv_length ((gchar **)argv),
+                                NULL,
+                                0,
+                                NULL,
+                                CXTranslationUnit_None);
+  clang_IndexAction_dispose (action);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return NULL;
+
+  if (code != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_FAILED,
+                   "Failed to index \"%s\"",
+                   source_filename);
+      return NULL;
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (XREF_CACHE_TYPE));
+  g_variant_builder_add (&builder, "u", XREF_CACHE_VERSION);
+  g_variant_builder_add (&builder, "s", flags);
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(sta(ssuuyy))"));
+
+  for (guint i = 0; i < ordered->len; i++)
+    {
+      IndexFile *file = g_ptr_array_index (ordered, i);
+
+      if (g_strcmp0 (file->path, source_filename) == 0)
+        has_source = TRUE;
+
+      g_variant_builder_add (&builder,
+                             "(st@a(ssuuyy))",
+                             file->path,
+                             file->mtime,
+                             g_variant_builder_end (file->records));
+    }
+
+  /*
+   * Always track the source file itself, even when nothing was found in
+   * it, so that stale records are cleared and the cache is invalidated
+   * when it changes.
+   */
+  if (!has_source)
+    {
+      gint64 mtime = _ide_clang_get_mtime_usec (source_filename);
+
+      if (mtime >= 0)
+        g_variant_builder_add (&builder,
+                               "(st@a(ssuuyy))",
+                               source_filename,
+                               (guint64)mtime,
+                               g_variant_new_array (G_VARIANT_TYPE ("(ssuuyy)"), NULL, 0));
+    }
+
+  g_variant_builder_close (&builder);
+
+  ret = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  if (cache_path != NULL)
+    ide_clang_xref_service_save_cache (cache_path, ret);
+
+  return ret;
+}
+
+static void
+ide_clang_xref_service_index_worker (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  IdeClangXrefService *self = source_object;
+  IndexRequest *request = task_data;
+  g_autoptr(GPtrArray) built_argv = NULL;
+  g_autofree gchar *flags = NULL;
+  const gchar *llvm_flags;
+  GError *error = NULL;
+  GVariant *ret;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (request != NULL);
+  g_assert (request->argv != NULL);
+
+  built_argv = g_ptr_array_new ();
+  if (NULL != (llvm_flags = _ide_clang_discover_llvm_flags ()))
+    g_ptr_array_add (built_argv, g_strdup (llvm_flags));
+  for (guint i = 0; request->argv [i] != NULL; i++)
+    g_ptr_array_add (built_argv, g_steal_pointer (&request->argv [i]));
+  g_ptr_array_add (built_argv, NULL);
+
+  g_free (request->argv);
+  request->argv = (gchar **)g_ptr_array_free (g_steal_pointer (&built_argv), FALSE);
+
+  flags = g_strjoinv ("\n", request->argv);
+
+  if (NULL != (ret = ide_clang_xref_service_load_cache (request->cache_path, flags)))
+    {
+      EGG_COUNTER_INC (CachedFiles);
+      g_task_return_pointer (task, ret, (GDestroyNotify)g_variant_unref);
+      IDE_EXIT;
+    }
+
+  /* Let the caller hand the file off to a worker process */
+  if (request->out_of_process)
+    {
+      g_task_return_pointer (task, NULL, NULL);
+      IDE_EXIT;
+    }
+
+  ret = _ide_clang_xref_index_file (self->index,
+                                    request->source_filename,
+                                    request->workpath,
+                                    request->cache_path,
+                                    (const gchar * const *)request->argv,
+                                    cancellable,
+                                    &error);
+
+  if (ret == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, ret, (GDestroyNotify)g_variant_unref);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_remove_file (IdeClangXrefService *self,
+                                    const gchar         *path)
+{
+  XrefFile *file;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (path != NULL);
+
+  if (!(file = g_hash_table_lookup (self->files, path)))
+    return;
+
+  for (guint i = 0; i < file->symbols->len; i++)
+    {
+      XrefSymbol *symbol = g_ptr_array_index (file->symbols, i);
+      GArray *records = symbol->records;
+      guint j = 0;
+
+      /* Paths are interned, so we can compare them by address */
+      for (guint k = 0; k < records->len; k++)
+        {
+          const XrefRecord *record = &g_array_index (records, XrefRecord, k);
+
+          if (record->path != path)
+            g_array_index (records, XrefRecord, j++) = *record;
+        }
+
+      g_array_set_size (records, j);
+    }
+
+  g_hash_table_remove (self->files, path);
+}
+
+static void
+ide_clang_xref_service_merge (IdeClangXrefService *self,
+                              GVariant            *variant)
+{
+  g_autoptr(GVariant) files = NULL;
+  GVariantIter iter;
+  GVariant *records;
+  const gchar *path;
+  guint64 mtime;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (variant != NULL);
+
+  g_variant_get (variant, "(us@a(sta(ssuuyy)))", NULL, NULL, &files);
+
+  g_variant_iter_init (&iter, files);
+  while (g_variant_iter_loop (&iter, "(&st@a(ssuuyy))", &path, &mtime, &records))
+    {
+      const gchar *interned;
+      const gchar *usr;
+      const gchar *name;
+      GVariantIter riter;
+      XrefFile *file;
+      guint line;
+      guint column;
+      guint8 kind;
+      guint8 flags;
+
+      interned = g_string_chunk_insert_const (self->strings, path);
+
+      if ((file = g_hash_table_lookup (self->files, interned)) && file->mtime == mtime)
+        continue;
+
+      ide_clang_xref_service_remove_file (self, interned);
+
+      file = g_slice_new0 (XrefFile);
+      file->mtime = mtime;
+      file->symbols = g_ptr_array_new ();
+      g_hash_table_insert (self->files, (gchar *)interned, file);
+
+      g_variant_iter_init (&riter, records);
+      while (g_variant_iter_next (&riter, "(&s&suuyy)", &usr, &name, &line, &column, &kind, &flags))
+        {
+          XrefRecord record;
+          XrefSymbol *symbol;
+
+          if (!(symbol = g_hash_table_lookup (self->symbols, usr)))
+            {
+              symbol = g_slice_new0 (XrefSymbol);
+              symbol->usr = g_string_chunk_insert_const (self->strings, usr);
+              symbol->name = g_string_chunk_insert_const (self->strings, name);
+              symbol->kind = kind;
+              symbol->records = g_array_new (FALSE, FALSE, sizeof (XrefRecord));
+              g_hash_table_insert (self->symbols, (gchar *)symbol->usr, symbol);
+            }
+
+          /* Records for this file are appended together */
+          if (symbol->records->len == 0 ||
+              g_array_index (symbol->records, XrefRecord, symbol->records->len - 1).path != interned)
+            g_ptr_array_add (file->symbols, symbol);
+
+          record.path = interned;
+          record.line = line;
+          record.column = column;
+          record.flags = flags;
+
+          g_array_append_val (symbol->records, record);
+        }
+    }
+}
+
+static void ide_clang_xref_service_pump (IdeClangXrefService *self);
+
+static void
+ide_clang_xref_service_index_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  IdeClangXrefService *self = (IdeClangXrefService *)object;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (self->n_active > 0);
+
+  self->n_active--;
+
+  if (!(variant = g_task_propagate_pointer (G_TASK (result), &error)))
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        IDE_EXIT;
+      g_debug ("%s", error->message);
+    }
+  else
+    ide_clang_xref_service_merge (self, variant);
+
+  ide_clang_xref_service_pump (self);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_call_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  GDBusProxy *proxy = (GDBusProxy *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  IdeClangXrefService *self;
+  IndexRequest *request;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_DBUS_PROXY (proxy));
+  g_assert (G_IS_TASK (task));
+
+  self = g_task_get_source_object (task);
+  request = g_task_get_task_data (task);
+
+  if (!(reply = g_dbus_proxy_call_finish (proxy, result, &error)))
+    {
+      /*
+       * If the worker went away while indexing this file, it most likely
+       * crashed on it. The worker is respawned for us, but don't feed it
+       * the same file again until it has been modified.
+       */
+      if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY) ||
+          g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CLOSED))
+        {
+          g_warning ("Clang worker exited while indexing \"%s\"", request->source_filename);
+          g_hash_table_add (self->failed, g_strdup (request->source_filename));
+        }
+
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  g_variant_get (reply, "(v)", &variant);
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE (XREF_CACHE_TYPE)))
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_INVALID_DATA,
+                               "Clang worker replied with an invalid index");
+      IDE_EXIT;
+    }
+
+  g_task_return_pointer (task,
+                         g_steal_pointer (&variant),
+                         (GDestroyNotify)g_variant_unref);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_get_worker_cb (GObject      *object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  IdeApplication *app = (IdeApplication *)object;
+  g_autoptr(GDBusProxy) proxy = NULL;
+  g_autoptr(GTask) task = user_data;
+  IndexRequest *request;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_APPLICATION (app));
+  g_assert (G_IS_TASK (task));
+
+  request = g_task_get_task_data (task);
+
+  if (!(proxy = ide_application_get_worker_finish (app, result, &error)))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  g_dbus_proxy_call (proxy,
+                     "Index",
+                     g_variant_new ("(sss^as)",
+                                    request->source_filename,
+                                    request->workpath,
+                                    request->cache_path,
+                                    request->argv),
+                     G_DBUS_CALL_FLAGS_NONE,
+                     G_MAXINT,
+                     g_task_get_cancellable (task),
+                     ide_clang_xref_service_call_cb,
+                     g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_load_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  IdeClangXrefService *self = (IdeClangXrefService *)object;
+  g_autoptr(GTask) task = user_data;
+  IndexRequest *request;
+  GVariant *variant;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  request = g_task_get_task_data (task);
+
+  if (NULL != (variant = g_task_propagate_pointer (G_TASK (result), &error)))
+    {
+      g_task_return_pointer (task, variant, (GDestroyNotify)g_variant_unref);
+      IDE_EXIT;
+    }
+
+  if (error != NULL)
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  /* Nothing in the cache, so index the file in a worker process */
+  ide_application_get_worker_for_key_async (IDE_APPLICATION_DEFAULT,
+                                            "clang-plugin",
+                                            self->n_workers,
+                                            request->source_filename,
+                                            g_task_get_cancellable (task),
+                                            ide_clang_xref_service_get_worker_cb,
+                                            g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_get_build_flags_cb (GObject      *object,
+                                           GAsyncResult *result,
+                                           gpointer      user_data)
+{
+  IdeBuildSystem *build_system = (IdeBuildSystem *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GTask) load_task = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeClangXrefService *self;
+  IndexRequest *request;
+  gchar **argv;
+
+  g_assert (IDE_IS_BUILD_SYSTEM (build_system));
+  g_assert (G_IS_TASK (task));
+
+  self = g_task_get_source_object (task);
+  request = g_task_get_task_data (task);
+
+  if (!(argv = ide_build_system_get_build_flags_finish (build_system, result, &error)))
+    argv = g_new0 (gchar *, 1);
+
+  request->argv = argv;
+
+  /*
+   * The cache is checked on the indexer thread pool. When there is a
+   * cache miss, the file is either indexed right there or handed off to
+   * a worker process, depending on request->out_of_process.
+   */
+  load_task = g_task_new (self,
+                          g_task_get_cancellable (task),
+                          ide_clang_xref_service_load_cb,
+                          g_steal_pointer (&task));
+  g_task_set_source_tag (load_task, ide_clang_xref_service_get_build_flags_cb);
+  g_task_set_priority (load_task, G_PRIORITY_LOW);
+  g_task_set_task_data (load_task, request, NULL);
+
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER,
+                             load_task,
+                             ide_clang_xref_service_index_worker);
+}
+
+static gchar *
+ide_clang_xref_service_get_cache_path (IdeClangXrefService *self,
+                                       const gchar         *path)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autofree gchar *name = NULL;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (path != NULL);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (const guchar *)path, -1);
+
+  name = g_strdup_printf ("%s.xref", g_checksum_get_string (checksum));
+
+  return g_build_filename (self->cache_dir, name, NULL);
+}
+
+static void
+ide_clang_xref_service_prune_worker (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  PruneRequest *request = task_data;
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GFile) directory = NULL;
+  gpointer infoptr;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (request != NULL);
+
+  directory = g_file_new_for_path (request->cache_dir);
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          cancellable,
+                                          NULL);
+
+  if (enumerator == NULL)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      const gchar *name = g_file_info_get_name (info);
+
+      if (g_str_has_suffix (name, ".xref") && !g_hash_table_contains (request->keep, name))
+        {
+          g_autofree gchar *path = g_build_filename (request->cache_dir, name, NULL);
+
+          EGG_COUNTER_INC (PrunedFiles);
+          g_unlink (path);
+        }
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Removes the caches of files that are no longer part of the project.
+ * Caches are keyed by the path of the file, so they would otherwise be
+ * left behind when files are removed or renamed. Headers are only
+ * indexed when they are saved and are not loaded from the cache on
+ * startup, so their caches are removed too.
+ */
+static void
+ide_clang_xref_service_prune_cache (IdeClangXrefService *self,
+                                    GPtrArray           *files)
+{
+  g_autoptr(GTask) task = NULL;
+  PruneRequest *request;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (files != NULL);
+
+  request = g_slice_new0 (PruneRequest);
+  request->cache_dir = g_strdup (self->cache_dir);
+  request->keep = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (guint i = 0; i < files->len; i++)
+    {
+      g_autofree gchar *path = g_file_get_path (g_ptr_array_index (files, i));
+      g_autofree gchar *cache_path = NULL;
+
+      if (path == NULL)
+        continue;
+
+      cache_path = ide_clang_xref_service_get_cache_path (self, path);
+      g_hash_table_add (request->keep, g_path_get_basename (cache_path));
+    }
+
+  task = g_task_new (self, self->cancellable, NULL, NULL);
+  g_task_set_source_tag (task, ide_clang_xref_service_prune_cache);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_set_task_data (task, request, prune_request_free);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER,
+                             task,
+                             ide_clang_xref_service_prune_worker);
+}
+
+static gboolean
+ide_clang_xref_service_use_workers (void)
+{
+  GApplication *app = g_application_get_default ();
+
+  return IDE_IS_APPLICATION (app) &&
+         ide_application_get_mode (IDE_APPLICATION (app)) == IDE_APPLICATION_MODE_PRIMARY;
+}
+
+static void
+ide_clang_xref_service_pump (IdeClangXrefService *self)
+{
+  g_autofree gchar *workpath = NULL;
+  IdeBuildSystem *build_system;
+  gboolean out_of_process;
+  IdeContext *context;
+  GFile *workdir;
+  guint max_active;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+
+  if (self->cancellable == NULL || g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  /*
+   * Worker processes let us index as many files as there are workers at
+   * once. Otherwise, we are limited to the single indexer thread.
+   */
+  out_of_process = ide_clang_xref_service_use_workers ();
+  max_active = out_of_process ? self->n_workers : 1;
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+  workpath = g_file_get_path (workdir);
+
+  while (self->n_active < max_active && self->queue.length > 0)
+    {
+      g_autoptr(IdeFile) ide_file = NULL;
+      g_autoptr(GFile) file = NULL;
+      g_autoptr(GTask) task = NULL;
+      g_autofree gchar *path = NULL;
+      IndexRequest *request;
+
+      file = g_queue_pop_head (&self->queue);
+      g_hash_table_remove (self->queued, file);
+
+      path = g_file_get_path (file);
+
+      if (g_hash_table_contains (self->failed, path))
+        continue;
+
+      ide_file = ide_file_new (context, file);
+
+      request = g_slice_new0 (IndexRequest);
+      request->source_filename = g_steal_pointer (&path);
+      request->workpath = g_strconcat (workpath, G_DIR_SEPARATOR_S, NULL);
+      request->cache_path = ide_clang_xref_service_get_cache_path (self, request->source_filename);
+      request->out_of_process = out_of_process;
+
+      task = g_task_new (self, self->cancellable, ide_clang_xref_service_index_cb, NULL);
+      g_task_set_source_tag (task, ide_clang_xref_service_pump);
+      g_task_set_priority (task, G_PRIORITY_LOW);
+      g_task_set_task_data (task, request, index_request_free);
+
+      self->n_active++;
+
+      ide_build_system_get_build_flags_async (build_system,
+                                              ide_file,
+                                              self->cancellable,
+                                              ide_clang_xref_service_get_build_flags_cb,
+                                              g_steal_pointer (&task));
+    }
+}
+
+/**
+ * ide_clang_xref_service_queue_file:
+ * @self: An #IdeClangXrefService
+ * @file: A #GFile
+ *
+ * Queues @file to be indexed. If the file has not changed since it was
+ * last indexed, the results are loaded from the cache instead.
+ */
+void
+ide_clang_xref_service_queue_file (IdeClangXrefService *self,
+                                   GFile               *file)
+{
+  g_return_if_fail (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  if (g_hash_table_contains (self->queued, file))
+    return;
+
+  g_hash_table_add (self->queued, file);
+  g_queue_push_tail (&self->queue, g_object_ref (file));
+
+  ide_clang_xref_service_pump (self);
+}
+
+static void
+ide_clang_xref_service_crawl_cb (IdeDirectoryCrawler *crawler,
+                                 GFile               *directory,
+                                 const gchar         *relative_path,
+                                 GFileInfo           *directory_info,
+                                 GPtrArray           *children,
+                                 gpointer             user_data)
+{
+  GPtrArray *files = user_data;
+
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (crawler));
+  g_assert (G_IS_FILE (directory));
+  g_assert (children != NULL);
+  g_assert (files != NULL);
+
+  for (guint i = 0; i < children->len; i++)
+    {
+      GFileInfo *file_info = g_ptr_array_index (children, i);
+      const gchar *name = g_file_info_get_name (file_info);
+
+      if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_REGULAR &&
+          has_suffix (name, source_suffixes, G_N_ELEMENTS (source_suffixes)))
+        g_ptr_array_add (files, g_file_get_child (directory, name));
+    }
+}
+
+static void
+ide_clang_xref_service_crawl_done_cb (GObject      *object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  IdeDirectoryCrawler *crawler = (IdeDirectoryCrawler *)object;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(IdeClangXrefService) self = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  gpointer *data = user_data;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (crawler));
+
+  self = data[0];
+  files = data[1];
+  g_free (data);
+
+  if (!ide_directory_crawler_crawl_finish (crawler, result, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+      IDE_EXIT;
+    }
+
+  IDE_TRACE_MSG ("Queuing %u files for indexing", files->len);
+
+  for (guint i = 0; i < files->len; i++)
+    ide_clang_xref_service_queue_file (self, g_ptr_array_index (files, i));
+
+  ide_clang_xref_service_prune_cache (self, files);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_buffer_saved (IdeClangXrefService *self,
+                                     IdeBuffer           *buffer,
+                                     IdeBufferManager    *buffer_manager)
+{
+  g_autofree gchar *name = NULL;
+  IdeContext *context;
+  GFile *workdir;
+  GFile *file;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+  file = ide_file_get_file (ide_buffer_get_file (buffer));
+  name = g_file_get_basename (file);
+
+  /*
+   * Headers are indexed on their own when saved. The translation units
+   * that include them notice the change the next time they are loaded
+   * from the cache.
+   */
+  if (g_file_has_prefix (file, workdir) &&
+      (has_suffix (name, source_suffixes, G_N_ELEMENTS (source_suffixes)) ||
+       has_suffix (name, header_suffixes, G_N_ELEMENTS (header_suffixes))))
+    {
+      g_autofree gchar *path = g_file_get_path (file);
+
+      /* Give files that crashed a worker another chance */
+      g_hash_table_remove (self->failed, path);
+
+      ide_clang_xref_service_queue_file (self, file);
+    }
+}
+
+static void
+ide_clang_xref_service_context_loaded (IdeService *service)
+{
+  IdeClangXrefService *self = (IdeClangXrefService *)service;
+  g_autoptr(IdeDirectoryCrawler) crawler = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  IdeBufferManager *buffer_manager;
+  IdeContext *context;
+  IdeProject *project;
+  IdeVcs *vcs;
+  gpointer *data;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_XREF_SERVICE (self));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  project = ide_context_get_project (context);
+  buffer_manager = ide_context_get_buffer_manager (context);
+  vcs = ide_context_get_vcs (context);
+
+  self->cache_dir = g_build_filename (g_get_user_cache_dir (),
+                                      ide_get_program_name (),
+                                      "clang-xref",
+                                      ide_project_get_id (project),
+                                      NULL);
+
+  g_signal_connect_object (buffer_manager,
+                           "buffer-saved",
+                           G_CALLBACK (ide_clang_xref_service_buffer_saved),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+
+  crawler = ide_directory_crawler_new (ide_vcs_get_working_directory (vcs));
+  ide_directory_crawler_set_vcs (crawler, vcs);
+  ide_directory_crawler_subscribe (crawler,
+                                   ide_clang_xref_service_crawl_cb,
+                                   g_ptr_array_ref (files),
+                                   (GDestroyNotify)g_ptr_array_unref);
+
+  data = g_new0 (gpointer, 2);
+  data[0] = g_object_ref (self);
+  data[1] = g_ptr_array_ref (files);
+
+  ide_directory_crawler_crawl_async (crawler,
+                                     self->cancellable,
+                                     ide_clang_xref_service_crawl_done_cb,
+                                     data);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_start (IdeService *service)
+{
+  IdeClangXrefService *self = (IdeClangXrefService *)service;
+
+  g_return_if_fail (IDE_IS_CLANG_XREF_SERVICE (self));
+  g_return_if_fail (self->index == NULL);
+
+  self->cancellable = g_cancellable_new ();
+
+  self->index = clang_createIndex (0, 0);
+  clang_CXIndex_setGlobalOptions (self->index,
+                                  CXGlobalOpt_ThreadBackgroundPriorityForAll);
+}
+
+static void
+ide_clang_xref_service_stop (IdeService *service)
+{
+  IdeClangXrefService *self = (IdeClangXrefService *)service;
+
+  g_return_if_fail (IDE_IS_CLANG_XREF_SERVICE (self));
+
+  g_cancellable_cancel (self->cancellable);
+
+  g_hash_table_remove_all (self->queued);
+  g_queue_foreach (&self->queue, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&self->queue);
+}
+
+static void
+ide_clang_xref_service_finalize (GObject *object)
+{
+  IdeClangXrefService *self = (IdeClangXrefService *)object;
+
+  IDE_ENTRY;
+
+  g_queue_foreach (&self->queue, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&self->queue);
+
+  g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->cache_dir, g_free);
+  g_clear_pointer (&self->queued, g_hash_table_unref);
+  g_clear_pointer (&self->failed, g_hash_table_unref);
+  g_clear_pointer (&self->files, g_hash_table_unref);
+  g_clear_pointer (&self->symbols, g_hash_table_unref);
+  g_clear_pointer (&self->strings, g_string_chunk_free);
+  g_clear_pointer (&self->index, clang_disposeIndex);
+
+  G_OBJECT_CLASS (ide_clang_xref_service_parent_class)->finalize (object);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_xref_service_class_init (IdeClangXrefServiceClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_clang_xref_service_finalize;
+}
+
+static void
+service_iface_init (IdeServiceInterface *iface)
+{
+  iface->context_loaded = ide_clang_xref_service_context_loaded;
+  iface->start = ide_clang_xref_service_start;
+  iface->stop = ide_clang_xref_service_stop;
+}
+
+static void
+ide_clang_xref_service_init (IdeClangXrefService *self)
+{
+  g_queue_init (&self->queue);
+
+  self->strings = g_string_chunk_new (4096 * 4);
+  self->symbols = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, xref_symbol_free);
+  self->files = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, xref_file_free);
+  self->queued = g_hash_table_new (g_file_hash, (GEqualFunc)g_file_equal);
+  self->failed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->n_workers = CLAMP (g_get_num_processors () / 2, 1, MAX_WORKERS);
+}
+
+static IdeSourceLocation *
+create_location (IdeClangXrefService *self,
+                 const XrefRecord    *record)
+{
+  g_autoptr(IdeFile) file = NULL;
+  IdeContext *context;
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  file = ide_file_new_for_path (context, record->path);
+
+  return ide_source_location_new (file, record->line, record->column, 0);
+}
+
+/**
+ * ide_clang_xref_service_find_definition:
+ * @self: An #IdeClangXrefService
+ * @usr: the unified symbol resolution of a symbol
+ *
+ * Locates the definition of @usr, which may be in a translation unit
+ * that has not been parsed.
+ *
+ * Returns: (transfer full) (nullable): An #IdeSourceLocation or %NULL.
+ */
+IdeSourceLocation *
+ide_clang_xref_service_find_definition (IdeClangXrefService *self,
+                                        const gchar         *usr)
+{
+  XrefSymbol *symbol;
+
+  g_return_val_if_fail (IDE_IS_CLANG_XREF_SERVICE (self), NULL);
+
+  if (usr == NULL || !(symbol = g_hash_table_lookup (self->symbols, usr)))
+    return NULL;
+
+  for (guint i = 0; i < symbol->records->len; i++)
+    {
+      const XrefRecord *record = &g_array_index (symbol->records, XrefRecord, i);
+
+      if ((record->flags & IDE_CLANG_XREF_DEFINITION) != 0)
+        return create_location (self, record);
+    }
+
+  return NULL;
+}
@@ -0,0 +1,43 @@
+/* ide-clang-xref-service.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_CLANG_XREF_SERVICE_H
+#define IDE_CLANG_XREF_SERVICE_H
+
+#include <ide.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_CLANG_XREF_SERVICE (ide_clang_xref_service_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeClangXrefService, ide_clang_xref_service, IDE, CLANG_XREF_SERVICE, IdeObject)
+
+typedef enum
+{
+  IDE_CLANG_XREF_DECLARATION = 1 << 0,
+  IDE_CLANG_XREF_DEFINITION  = 1 << 1,
+} IdeClangXrefFlags;
+
+void               ide_clang_xref_service_queue_file      (IdeClangXrefService *self,
+                                                           GFile               *file);
+IdeSourceLocation *ide_clang_xref_service_find_definition (IdeClangXrefService *self,
+                                                           const gchar         *usr);
+
+G_END_DECLS
+
+#endif /* IDE_CLANG_XREF_SERVICE_H */
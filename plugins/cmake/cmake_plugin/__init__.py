@@ -30,6 +30,7 @@ _NINJA_NAMES = [ 'ninja-build', 'ninja' ]
 
 class CMakeBuildSystem(Ide.Object, Ide.BuildSystem, Gio.AsyncInitable):
     project_file = GObject.Property(type=Gio.File)
+    _compile_commands = None
 
     def do_get_id(self):
         return 'cmake'
@@ -55,6 +56,50 @@ class CMakeBuildSystem(Ide.Object, Ide.BuildSystem, Gio.AsyncInitable):
     def do_get_priority(self):
         return 200
 
+    def do_get_build_flags_async(self, ifile, cancellable, callback, data=None):
+        task = Gio.Task.new(self, cancellable, callback)
+        task.ifile = ifile
+        task.build_flags = []
+
+        # The compile commands are written by cmake during the CONFIGURE
+        # phase, so make sure that has completed first.
+        build_manager = self.get_context().get_build_manager()
+        build_manager.execute_async(Ide.BuildPhase.CONFIGURE,
+                                    cancellable,
+                                    self._get_build_flags_cb,
+                                    task)
+
+    def do_get_build_flags_finish(self, result):
+        if result.propagate_boolean():
+            return result.build_flags
+
+    def _get_build_flags_cb(self, build_manager, result, task):
+        try:
+            build_manager.execute_finish(result)
+        except Exception as err:
+            task.return_error(err)
+            return
+
+        config = build_manager.get_pipeline().get_configuration()
+        commands_file = Gio.File.new_for_path(path.join(self.get_builddir(config), 'compile_commands.json'))
+
+        if self._compile_commands is None:
+            self._compile_commands = Ide.CompileCommands.new()
+        self._compile_commands.load_async(commands_file,
+                                          task.get_cancellable(),
+                                          self._load_compile_commands_cb,
+                                          task)
+
+    def _load_compile_commands_cb(self, compile_commands, result, task):
+        try:
+            compile_commands.load_finish(result)
+            task.build_flags, _ = compile_commands.lookup(task.ifile)
+        except GLib.Error as e:
+            if not e.matches(Gio.io_error_quark(), Gio.IOErrorEnum.NOT_FOUND):
+                task.return_error(e)
+                return
+        task.return_boolean(True)
+
 
 class CMakePipelineAddin(Ide.Object, Ide.BuildPipelineAddin):
     """
@@ -104,6 +149,7 @@ class CMakePipelineAddin(Ide.Object, Ide.BuildPipelineAddin):
         config_launcher.push_argv('-G')
         config_launcher.push_argv('Ninja')
         config_launcher.push_argv('-DCMAKE_INSTALL_PREFIX={}'.format(config.props.prefix))
+        config_launcher.push_argv('-DCMAKE_EXPORT_COMPILE_COMMANDS=1')
         config_opts = config.get_config_opts()
         if config_opts:
             _, config_opts = GLib.shell_parse_argv(config_opts)
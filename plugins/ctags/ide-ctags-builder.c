@@ -18,11 +18,17 @@
 
 #define G_LOG_DOMAIN "ide-ctags-builder"
 
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
 #include "ide-ctags-builder.h"
 
 struct _IdeCtagsBuilder
 {
-  IdeObject  parent;
+  IdeObject    parent;
+  IdeProgress *progress;
 };
 
 typedef struct
@@ -30,9 +36,37 @@ typedef struct
   GFile *directory;
   GFile *destination;
   gchar *ctags;
+  guint  max_jobs;
   guint  recursive : 1;
 } BuildTaskData;
 
+typedef struct
+{
+  GFile   *directory;
+  GFile   *destination;
+  GString *filenames;
+} BuildJob;
+
+typedef struct
+{
+  GFile *file;
+  GFile *tags_file;
+  gchar *ctags;
+} UpdateFileTaskData;
+
+typedef struct
+{
+  GFile         *destination;
+  GArray        *jobs;
+  const gchar   *ctags;
+  GCancellable  *cancellable;
+  IdeProgress   *progress;
+  volatile gint  next_job;
+  volatile gint  n_completed;
+  volatile gint  n_failed;
+  guint          recursive : 1;
+} BuildState;
+
 static void tags_builder_iface_init (IdeTagsBuilderInterface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (IdeCtagsBuilder, ide_ctags_builder, IDE_TYPE_OBJECT,
@@ -52,9 +86,35 @@ build_task_data_free (gpointer data)
   g_slice_free (BuildTaskData, task_data);
 }
 
+static void
+update_file_task_data_free (gpointer data)
+{
+  UpdateFileTaskData *task_data = data;
+
+  g_clear_object (&task_data->file);
+  g_clear_object (&task_data->tags_file);
+  g_clear_pointer (&task_data->ctags, g_free);
+
+  g_slice_free (UpdateFileTaskData, task_data);
+}
+
+static void
+ide_ctags_builder_finalize (GObject *object)
+{
+  IdeCtagsBuilder *self = (IdeCtagsBuilder *)object;
+
+  g_clear_object (&self->progress);
+
+  G_OBJECT_CLASS (ide_ctags_builder_parent_class)->finalize (object);
+}
+
 static void
 ide_ctags_builder_class_init (IdeCtagsBuilderClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_ctags_builder_finalize;
+
   ignored = g_hash_table_new (g_str_hash, g_str_equal);
 
   /* TODO: We need a really fast, *THREAD-SAFE* access to determine
@@ -74,6 +134,7 @@ ide_ctags_builder_class_init (IdeCtagsBuilderClass *klass)
 static void
 ide_ctags_builder_init (IdeCtagsBuilder *self)
 {
+  self->progress = ide_progress_new ();
 }
 
 IdeTagsBuilder *
@@ -86,54 +147,50 @@ ide_ctags_builder_new (IdeContext *context)
                        NULL);
 }
 
-static gboolean
-ide_ctags_builder_build (IdeCtagsBuilder *self,
-                         const gchar     *ctags,
-                         GFile           *directory,
-                         GFile           *destination,
-                         gboolean         recursive,
-                         GCancellable    *cancellable)
+/**
+ * ide_ctags_builder_get_progress:
+ *
+ * Gets the #IdeProgress that is updated as directories are indexed
+ * while building tags. This may be used from any thread.
+ *
+ * Returns: (transfer none): An #IdeProgress.
+ */
+IdeProgress *
+ide_ctags_builder_get_progress (IdeCtagsBuilder *self)
 {
-  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
-  g_autoptr(IdeSubprocess) subprocess = NULL;
-  g_autoptr(GPtrArray) directories = NULL;
-  g_autoptr(GPtrArray) dest_directories = NULL;
-  g_autoptr(GFile) tags_file = NULL;
-  g_autoptr(GFileEnumerator) enumerator = NULL;
-  g_autoptr(GError) error = NULL;
+  g_return_val_if_fail (IDE_IS_CTAGS_BUILDER (self), NULL);
+
+  return self->progress;
+}
+
+/*
+ * Creates a launcher for ctags that reads the files to index from stdin,
+ * relative to @directory.
+ */
+static IdeSubprocessLauncher *
+ide_ctags_builder_create_launcher (const gchar     *ctags,
+                                   GFile           *directory,
+                                   GSubprocessFlags flags)
+{
+  IdeSubprocessLauncher *launcher;
   g_autofree gchar *cwd = NULL;
-  g_autofree gchar *dest_dir = NULL;
   g_autofree gchar *options_path = NULL;
-  g_autofree gchar *tags_path = NULL;
-  g_autoptr(GString) filenames = NULL;
-  GOutputStream *stdin_stream;
-  gpointer infoptr;
 
-  g_assert (IDE_IS_CTAGS_BUILDER (self));
+  g_assert (ctags != NULL);
   g_assert (G_IS_FILE (directory));
-  g_assert (G_IS_FILE (destination));
 
-  dest_dir = g_file_get_path (destination);
-  if (0 != g_mkdir_with_parents (dest_dir, 0750))
-    return FALSE;
-
-  tags_file = g_file_get_child (destination, "tags");
-  tags_path = g_file_get_path (tags_file);
   cwd = g_file_get_path (directory);
   options_path = g_build_filename (g_get_user_config_dir (),
                                    ide_get_program_name (),
                                    "ctags.conf",
                                    NULL);
-  directories = g_ptr_array_new_with_free_func (g_object_unref);
-  dest_directories = g_ptr_array_new_with_free_func (g_object_unref);
-  filenames = g_string_new (NULL);
 
   launcher = ide_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDIN_PIPE |
-                                          G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+                                          G_SUBPROCESS_FLAGS_STDERR_SILENCE |
+                                          flags);
 
   ide_subprocess_launcher_set_cwd (launcher, cwd);
   ide_subprocess_launcher_setenv (launcher, "TMPDIR", cwd, TRUE);
-  ide_subprocess_launcher_set_stdout_file_path (launcher, tags_path);
 
   ide_subprocess_launcher_push_argv (launcher, ctags);
   ide_subprocess_launcher_push_argv (launcher, "-f");
@@ -154,10 +211,51 @@ ide_ctags_builder_build (IdeCtagsBuilder *self,
       ide_subprocess_launcher_push_argv (launcher, options_path);
     }
 
-  /* Read filenames from stdin, which we will provided below */
+  /* Read filenames from stdin, which the caller will provide */
   ide_subprocess_launcher_push_argv (launcher, "-L");
   ide_subprocess_launcher_push_argv (launcher, "-");
 
+  return launcher;
+}
+
+static gboolean
+ide_ctags_builder_run_ctags (const gchar  *ctags,
+                             GFile        *directory,
+                             GFile        *destination,
+                             const gchar  *filenames,
+                             gsize         filenames_len,
+                             GCancellable *cancellable)
+{
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autoptr(GFile) tags_file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *dest_dir = NULL;
+  g_autofree gchar *tags_path = NULL;
+  g_autofree gchar *tmp_path = NULL;
+  GOutputStream *stdin_stream;
+
+  g_assert (ctags != NULL);
+  g_assert (G_IS_FILE (directory));
+  g_assert (G_IS_FILE (destination));
+  g_assert (filenames != NULL);
+
+  dest_dir = g_file_get_path (destination);
+  if (0 != g_mkdir_with_parents (dest_dir, 0750))
+    return FALSE;
+
+  tags_file = g_file_get_child (destination, "tags");
+  tags_path = g_file_get_path (tags_file);
+
+  /*
+   * Write to a temporary file so that a cancelled (or failed) build does
+   * not leave a truncated tags file behind for the service to load.
+   */
+  tmp_path = g_strdup_printf ("%s.tmp", tags_path);
+
+  launcher = ide_ctags_builder_create_launcher (ctags, directory, 0);
+  ide_subprocess_launcher_set_stdout_file_path (launcher, tmp_path);
+
   subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, &error);
 
   if (subprocess == NULL)
@@ -167,77 +265,203 @@ ide_ctags_builder_build (IdeCtagsBuilder *self,
     }
 
   stdin_stream = ide_subprocess_get_stdin_pipe (subprocess);
+  g_output_stream_write_all (stdin_stream, filenames, filenames_len, NULL, cancellable, NULL);
+  g_output_stream_close (stdin_stream, NULL, NULL);
 
-  /*
-   * We do our own recursive building of ctags instead of --recursive=yes
-   * so that we can have smaller files to update. This helps on larger
-   * projects where we would have to rescan the whole project after a
-   * file is saved.
-   *
-   * Additionally, while walking the file-system tree, we append files
-   * to stdin of our ctags process to tell it to process them.
-   */
+  if (!ide_subprocess_wait_check (subprocess, cancellable, &error))
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          /* Stop ctags now rather than letting it finish in the background */
+          ide_subprocess_force_exit (subprocess);
+          ide_subprocess_wait (subprocess, NULL, NULL);
+        }
+      else
+        g_warning ("%s", error->message);
 
-  enumerator = g_file_enumerate_children (directory,
-                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
-                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                          cancellable,
-                                          &error);
+      g_unlink (tmp_path);
 
-  if (enumerator == NULL)
-    IDE_GOTO (finish_subprocess);
+      return FALSE;
+    }
 
-  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, cancellable, &error)))
+  if (g_rename (tmp_path, tags_path) != 0)
     {
-      g_autoptr(GFileInfo) info = infoptr;
-      const gchar *name;
-      GFileType type;
+      g_unlink (tmp_path);
+      return FALSE;
+    }
+
+  return TRUE;
+}
 
-      name = g_file_info_get_name (info);
-      type = g_file_info_get_file_type (info);
+static void
+ide_ctags_builder_crawl_cb (IdeDirectoryCrawler *crawler,
+                            GFile               *directory,
+                            const gchar         *relative_path,
+                            GFileInfo           *directory_info,
+                            GPtrArray           *children,
+                            gpointer             user_data)
+{
+  BuildState *state = user_data;
+  BuildJob job = { 0 };
+  guint i;
 
-      if (g_hash_table_contains (ignored, name))
-        continue;
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (crawler));
+  g_assert (G_IS_FILE (directory));
+  g_assert (relative_path != NULL);
+  g_assert (children != NULL);
+  g_assert (state != NULL);
+
+  job.directory = g_object_ref (directory);
+  job.destination = (*relative_path == '\0')
+    ? g_object_ref (state->destination)
+    : g_file_resolve_relative_path (state->destination, relative_path);
+  job.filenames = g_string_new (NULL);
+
+  /*
+   * Iterate backwards so that we can prune ignored (or, when not
+   * recursive, all) directories from being crawled.
+   */
+  for (i = children->len; i > 0; i--)
+    {
+      GFileInfo *info = g_ptr_array_index (children, i - 1);
+      const gchar *name = g_file_info_get_name (info);
+      GFileType type = g_file_info_get_file_type (info);
 
       if (type == G_FILE_TYPE_DIRECTORY)
         {
-          if (recursive)
-            {
-              g_ptr_array_add (directories, g_file_get_child (directory, name));
-              g_ptr_array_add (dest_directories, g_file_get_child (destination, name));
-            }
+          if (!state->recursive || g_hash_table_contains (ignored, name))
+            g_ptr_array_remove_index (children, i - 1);
         }
-      else if (type == G_FILE_TYPE_REGULAR)
+      else if (type == G_FILE_TYPE_REGULAR && !g_hash_table_contains (ignored, name))
         {
-          g_string_append_printf (filenames, "%s\n", name);
+          g_string_append_printf (job.filenames, "%s\n", name);
         }
     }
 
-  g_output_stream_write_all (stdin_stream, filenames->str, filenames->len, NULL, NULL, NULL);
+  g_array_append_val (state->jobs, job);
+}
 
-finish_subprocess:
-  g_output_stream_close (stdin_stream, NULL, NULL);
+static void
+clear_build_job (gpointer data)
+{
+  BuildJob *job = data;
 
-  if (!ide_subprocess_wait_check (subprocess, NULL, &error))
+  g_clear_object (&job->directory);
+  g_clear_object (&job->destination);
+  if (job->filenames != NULL)
+    g_string_free (job->filenames, TRUE);
+  job->filenames = NULL;
+}
+
+static gpointer
+ide_ctags_builder_run_jobs (gpointer data)
+{
+  BuildState *state = data;
+  guint n_jobs;
+  guint i;
+
+  g_assert (state != NULL);
+
+  n_jobs = state->jobs->len;
+
+  /*
+   * Each thread claims the next pending job until they run out. The
+   * threads spend nearly all of their time waiting on ctags.
+   */
+  while ((i = g_atomic_int_add (&state->next_job, 1)) < n_jobs)
     {
-      g_warning ("%s", error->message);
-      return FALSE;
+      const BuildJob *job = &g_array_index (state->jobs, BuildJob, i);
+      guint n_completed;
+
+      if (g_cancellable_is_cancelled (state->cancellable))
+        break;
+
+      if (!ide_ctags_builder_run_ctags (state->ctags,
+                                        job->directory,
+                                        job->destination,
+                                        job->filenames->str,
+                                        job->filenames->len,
+                                        state->cancellable))
+        g_atomic_int_inc (&state->n_failed);
+
+      n_completed = g_atomic_int_add (&state->n_completed, 1) + 1;
+      ide_progress_set_fraction (state->progress, (gdouble)n_completed / (gdouble)n_jobs);
     }
 
-  for (guint i = 0; i < directories->len; i++)
-    {
-      GFile *child = g_ptr_array_index (directories, i);
-      GFile *dest_child = g_ptr_array_index (dest_directories, i);
+  return NULL;
+}
 
-      g_assert (G_IS_FILE (child));
-      g_assert (G_IS_FILE (dest_child));
+static gboolean
+ide_ctags_builder_build (IdeCtagsBuilder *self,
+                         const gchar     *ctags,
+                         GFile           *directory,
+                         GFile           *destination,
+                         gboolean         recursive,
+                         guint            max_jobs,
+                         GCancellable    *cancellable)
+{
+  g_autoptr(IdeDirectoryCrawler) crawler = NULL;
+  g_autoptr(GPtrArray) threads = NULL;
+  BuildState state = { 0 };
+  gboolean ret = TRUE;
+  guint n_threads;
+  guint i;
+
+  g_assert (IDE_IS_CTAGS_BUILDER (self));
+  g_assert (G_IS_FILE (directory));
+  g_assert (G_IS_FILE (destination));
 
-      if (!ide_ctags_builder_build (self, ctags, child, dest_child, recursive, cancellable))
-        return FALSE;
+  /*
+   * We do our own recursive building of ctags instead of --recursive=yes
+   * so that we can have smaller files to update. This helps on larger
+   * projects where we would have to rescan the whole project after a
+   * file is saved.
+   *
+   * The tree is walked in parallel by the crawler, which gives us the
+   * list of files to feed to each ctags process on stdin.
+   */
+  state.destination = destination;
+  state.recursive = !!recursive;
+  state.ctags = ctags;
+  state.cancellable = cancellable;
+  state.progress = self->progress;
+  state.jobs = g_array_new (FALSE, FALSE, sizeof (BuildJob));
+  g_array_set_clear_func (state.jobs, clear_build_job);
+
+  ide_progress_set_message (self->progress, _("Indexing symbols"));
+  ide_progress_set_fraction (self->progress, 0.0);
+
+  crawler = ide_directory_crawler_new (directory);
+  ide_directory_crawler_set_follow_symlinks (crawler, FALSE);
+  ide_directory_crawler_subscribe (crawler, ide_ctags_builder_crawl_cb, &state, NULL);
+
+  if (!ide_directory_crawler_crawl (crawler, cancellable, NULL))
+    {
+      g_array_unref (state.jobs);
+      return FALSE;
     }
 
-  return TRUE;
+  /*
+   * Run a ctags process per directory, up to @max_jobs at a time. The
+   * calling thread runs jobs too, so we only need @max_jobs - 1 threads.
+   */
+  n_threads = MIN (max_jobs, state.jobs->len);
+  threads = g_ptr_array_new ();
+
+  for (i = 1; i < n_threads; i++)
+    g_ptr_array_add (threads, g_thread_new ("ctags-builder", ide_ctags_builder_run_jobs, &state));
+
+  ide_ctags_builder_run_jobs (&state);
+
+  for (i = 0; i < threads->len; i++)
+    g_thread_join (g_ptr_array_index (threads, i));
+
+  if (state.n_failed > 0 || g_cancellable_is_cancelled (cancellable))
+    ret = FALSE;
+
+  g_array_unref (state.jobs);
+
+  return ret;
 }
 
 static void
@@ -248,6 +472,7 @@ ide_ctags_builder_build_worker (GTask        *task,
 {
   BuildTaskData *task_data = task_data_ptr;
   IdeCtagsBuilder *self = source_object;
+  g_autofree gchar *ctags_path = NULL;
   const gchar *ctags;
 
   IDE_ENTRY;
@@ -257,7 +482,7 @@ ide_ctags_builder_build_worker (GTask        *task,
   g_assert (G_IS_FILE (task_data->directory));
 
   ctags = task_data->ctags;
-  if (!g_find_program_in_path (ctags))
+  if (NULL == (ctags_path = g_find_program_in_path (ctags)))
     ctags = "ctags";
 
   ide_ctags_builder_build (self,
@@ -265,13 +490,49 @@ ide_ctags_builder_build_worker (GTask        *task,
                            task_data->directory,
                            task_data->destination,
                            task_data->recursive,
+                           task_data->max_jobs,
                            cancellable);
 
-  g_task_return_boolean (task, TRUE);
+  if (!g_task_return_error_if_cancelled (task))
+    g_task_return_boolean (task, TRUE);
 
   IDE_EXIT;
 }
 
+/*
+ * The destination directory for the tags should match the hierarchy
+ * of the projects source tree, but be based in something like
+ * ~/.cache/gnome-builder/tags/$project_id/ so that they can be reused
+ * even between configuration changes. Primarily, we want to avoid
+ * putting things in the source tree.
+ */
+static GFile *
+ide_ctags_builder_get_destination (IdeCtagsBuilder *self,
+                                   GFile           *directory)
+{
+  g_autofree gchar *destination_path = NULL;
+  g_autofree gchar *relative_path = NULL;
+  IdeContext *context;
+  const gchar *project_id;
+  GFile *workdir;
+
+  g_assert (IDE_IS_CTAGS_BUILDER (self));
+  g_assert (G_IS_FILE (directory));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  project_id = ide_project_get_id (ide_context_get_project (context));
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+  relative_path = g_file_get_relative_path (workdir, directory);
+  destination_path = g_build_filename (g_get_user_cache_dir (),
+                                       ide_get_program_name (),
+                                       "tags",
+                                       project_id,
+                                       relative_path,
+                                       NULL);
+
+  return g_file_new_for_path (destination_path);
+}
+
 static void
 ide_ctags_builder_build_async (IdeTagsBuilder      *builder,
                                GFile               *directory_or_file,
@@ -283,12 +544,7 @@ ide_ctags_builder_build_async (IdeTagsBuilder      *builder,
   IdeCtagsBuilder *self = (IdeCtagsBuilder *)builder;
   g_autoptr(GTask) task = NULL;
   g_autoptr(GSettings) settings = NULL;
-  g_autofree gchar *destination_path = NULL;
-  g_autofree gchar *relative_path = NULL;
   BuildTaskData *task_data;
-  IdeContext *context;
-  const gchar *project_id;
-  GFile *workdir;
 
   IDE_ENTRY;
 
@@ -301,26 +557,12 @@ ide_ctags_builder_build_async (IdeTagsBuilder      *builder,
   task_data->ctags = g_settings_get_string (settings, "ctags-path");
   task_data->directory = g_object_ref (directory_or_file);
   task_data->recursive = recursive;
-  task_data->ctags = g_strdup ("ctags");
+  task_data->max_jobs = g_settings_get_int (settings, "ctags-max-jobs");
 
-  /*
-   * The destination directory for the tags should match the hierarchy
-   * of the projects source tree, but be based in something like
-   * ~/.cache/gnome-builder/tags/$project_id/ so that they can be reused
-   * even between configuration changes. Primarily, we want to avoid
-   * putting things in the source tree.
-   */
-  context = ide_object_get_context (IDE_OBJECT (self));
-  project_id = ide_project_get_id (ide_context_get_project (context));
-  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
-  relative_path = g_file_get_relative_path (workdir, directory_or_file);
-  destination_path = g_build_filename (g_get_user_cache_dir (),
-                                       ide_get_program_name (),
-                                       "tags",
-                                       project_id,
-                                       relative_path,
-                                       NULL);
-  task_data->destination = g_file_new_for_path (destination_path);
+  if (task_data->max_jobs == 0)
+    task_data->max_jobs = g_get_num_processors ();
+
+  task_data->destination = ide_ctags_builder_get_destination (self, directory_or_file);
 
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, ide_ctags_builder_build_async);
@@ -353,3 +595,257 @@ tags_builder_iface_init (IdeTagsBuilderInterface *iface)
   iface->build_async = ide_ctags_builder_build_async;
   iface->build_finish = ide_ctags_builder_build_finish;
 }
+
+static gboolean
+tags_line_has_path (const gchar *line,
+                    const gchar *relative_path)
+{
+  const gchar *path;
+  gsize len;
+
+  if (!(path = strchr (line, '\t')))
+    return FALSE;
+
+  path++;
+  len = strlen (relative_path);
+
+  return strncmp (path, relative_path, len) == 0 && path [len] == '\t';
+}
+
+static gint
+compare_lines (gconstpointer a,
+               gconstpointer b)
+{
+  return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+/*
+ * Replaces the lines for @relative_path within @tags_file with @tags,
+ * keeping the file sorted.
+ */
+static gboolean
+ide_ctags_builder_splice_tags_file (GFile        *tags_file,
+                                    const gchar  *relative_path,
+                                    gchar        *tags,
+                                    gsize         tags_len,
+                                    GError      **error)
+{
+  g_autoptr(GPtrArray) lines = NULL;
+  g_autoptr(GString) str = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *dir = NULL;
+  g_autofree gchar *contents = NULL;
+  IdeLineReader reader;
+  gsize len = 0;
+  gchar *line;
+  gsize line_len;
+
+  g_assert (G_IS_FILE (tags_file));
+  g_assert (relative_path != NULL);
+  g_assert (tags != NULL);
+
+  path = g_file_get_path (tags_file);
+  dir = g_path_get_dirname (path);
+
+  if (0 != g_mkdir_with_parents (dir, 0750))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "%s", g_strerror (errno));
+      return FALSE;
+    }
+
+  lines = g_ptr_array_new ();
+
+  /* A missing tags file just means there was nothing indexed yet */
+  if (g_file_get_contents (path, &contents, &len, NULL))
+    {
+      ide_line_reader_init (&reader, contents, len);
+
+      while ((line = ide_line_reader_next (&reader, &line_len)))
+        {
+          line [line_len] = '\0';
+
+          if (*line != '\0' && !tags_line_has_path (line, relative_path))
+            g_ptr_array_add (lines, line);
+        }
+    }
+
+  ide_line_reader_init (&reader, tags, tags_len);
+
+  while ((line = ide_line_reader_next (&reader, &line_len)))
+    {
+      line [line_len] = '\0';
+
+      /* Keep the existing header, if any */
+      if (*line == '\0' || (*line == '!' && contents != NULL))
+        continue;
+
+      g_ptr_array_add (lines, line);
+    }
+
+  g_ptr_array_sort (lines, compare_lines);
+
+  str = g_string_new (NULL);
+
+  for (guint i = 0; i < lines->len; i++)
+    {
+      g_string_append (str, g_ptr_array_index (lines, i));
+      g_string_append_c (str, '\n');
+    }
+
+  return g_file_set_contents (path, str->str, str->len, error);
+}
+
+static void
+ide_ctags_builder_update_file_worker (GTask        *task,
+                                      gpointer      source_object,
+                                      gpointer      task_data_ptr,
+                                      GCancellable *cancellable)
+{
+  UpdateFileTaskData *task_data = task_data_ptr;
+  GFile *file = task_data->file;
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *stdin_buf = NULL;
+  g_autofree gchar *stdout_buf = NULL;
+  g_autofree gchar *copy = NULL;
+  g_autofree gchar *ctags_path = NULL;
+  const gchar *ctags;
+  gsize len;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CTAGS_BUILDER (source_object));
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE (task_data->tags_file));
+
+  ctags = task_data->ctags;
+  if (NULL == (ctags_path = g_find_program_in_path (ctags)))
+    ctags = "ctags";
+
+  directory = g_file_get_parent (file);
+  name = g_file_get_basename (file);
+
+  launcher = ide_ctags_builder_create_launcher (ctags, directory, G_SUBPROCESS_FLAGS_STDOUT_PIPE);
+  stdin_buf = g_strdup_printf ("%s\n", name);
+
+  if (NULL == (subprocess = ide_subprocess_launcher_spawn (launcher, cancellable, &error)) ||
+      !ide_subprocess_communicate_utf8 (subprocess, stdin_buf, cancellable, &stdout_buf, NULL, &error) ||
+      !ide_subprocess_check_exit_status (subprocess, &error))
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  if (stdout_buf == NULL)
+    stdout_buf = g_strdup ("");
+
+  /* Splicing parses the lines in place, so keep the output intact */
+  len = strlen (stdout_buf);
+  copy = g_strndup (stdout_buf, len);
+
+  if (!ide_ctags_builder_splice_tags_file (task_data->tags_file, name, copy, len, &error))
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      IDE_EXIT;
+    }
+
+  g_task_return_pointer (task,
+                         g_bytes_new_take (g_steal_pointer (&stdout_buf), len),
+                         (GDestroyNotify)g_bytes_unref);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_ctags_builder_update_file_async:
+ * @self: An #IdeCtagsBuilder
+ * @file: a source file within the project
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Runs ctags on @file only and replaces the entries for @file in the
+ * tags file of its directory, without indexing the rest of the
+ * directory again.
+ */
+void
+ide_ctags_builder_update_file_async (IdeCtagsBuilder     *self,
+                                     GFile               *file,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GSettings) settings = NULL;
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GFile) destination = NULL;
+  UpdateFileTaskData *task_data;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_CTAGS_BUILDER (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  settings = g_settings_new ("org.gnome.builder.code-insight");
+
+  /* Resolve the tags file here, since the context is not safe to use from the worker */
+  directory = g_file_get_parent (file);
+  destination = ide_ctags_builder_get_destination (self, directory);
+
+  task_data = g_slice_new0 (UpdateFileTaskData);
+  task_data->file = g_object_ref (file);
+  task_data->tags_file = g_file_get_child (destination, "tags");
+  task_data->ctags = g_settings_get_string (settings, "ctags-path");
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_ctags_builder_update_file_async);
+  g_task_set_task_data (task, task_data, update_file_task_data_free);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, ide_ctags_builder_update_file_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_ctags_builder_update_file_finish:
+ * @self: An #IdeCtagsBuilder
+ * @result: A #GAsyncResult
+ * @tags_file: (out) (optional): the tags file that was updated
+ * @error: A location for a #GError, or %NULL
+ *
+ * Completes an asynchronous request to ide_ctags_builder_update_file_async().
+ *
+ * Returns: (transfer full): The ctags output for the file, which can be
+ *   used with ide_ctags_index_splice() to update an existing index.
+ */
+GBytes *
+ide_ctags_builder_update_file_finish (IdeCtagsBuilder  *self,
+                                      GAsyncResult     *result,
+                                      GFile           **tags_file,
+                                      GError          **error)
+{
+  GBytes *ret;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_CTAGS_BUILDER (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  ret = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (tags_file != NULL)
+    {
+      UpdateFileTaskData *task_data = g_task_get_task_data (G_TASK (result));
+
+      *tags_file = g_object_ref (task_data->tags_file);
+    }
+
+  IDE_RETURN (ret);
+}
@@ -205,14 +205,14 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
     {
       g_autofree gchar *copy = g_strdup (self->current_word);
       IdeCtagsIndex *index = g_ptr_array_index (self->indexes, i);
-      const IdeCtagsIndexEntry *entries = NULL;
+      g_autoptr(GArray) entries = NULL;
       guint tmp_len = word_len;
-      gsize n_entries = 0;
       gchar gdata_key[64];
 
       /*
        * Make sure we hold a reference to the index for the lifetime of the results.
-       * When the results are released, so could our indexes.
+       * When the results are released, so could our indexes. The strings of the
+       * entries copied into the items belong to the index.
        */
       g_snprintf (gdata_key, sizeof gdata_key, "ctags-%d", i);
       g_object_set_data_full (G_OBJECT (self->results), gdata_key,
@@ -220,16 +220,16 @@ ide_ctags_completion_provider_populate (GtkSourceCompletionProvider *provider,
 
       while (entries == NULL && *copy)
         {
-          if (!(entries = ide_ctags_index_lookup_prefix (index, copy, &n_entries)))
+          if (!(entries = ide_ctags_index_lookup_prefix (index, copy)))
             copy [--tmp_len] = '\0';
         }
 
-      if ((entries == NULL) || (n_entries == 0))
+      if (entries == NULL)
         continue;
 
-      for (j = 0; j < n_entries; j++)
+      for (j = 0; j < entries->len; j++)
         {
-          const IdeCtagsIndexEntry *entry = &entries [j];
+          const IdeCtagsIndexEntry *entry = &g_array_index (entries, IdeCtagsIndexEntry, j);
           IdeCtagsCompletionItem *item;
 
           if (g_hash_table_contains (completions, entry->name))
@@ -27,11 +27,25 @@ struct _IdeCtagsHighlighter
 {
   IdeObject           parent_instance;
 
+  /*
+   * Indexes are immutable, but the array is replaced from the main thread
+   * while compute_spans may be reading it, so it is guarded by mutex along
+   * with the path of the buffer's file.
+   */
+  GMutex              mutex;
   GPtrArray          *indexes;
+  gchar              *file_path;
+
   IdeCtagsService    *service;
   IdeHighlightEngine *engine;
 };
 
+typedef struct
+{
+  GPtrArray   *indexes;
+  const gchar *file_path;
+} SpansLookup;
+
 static void highlighter_iface_init (IdeHighlighterInterface *iface);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (IdeCtagsHighlighter,
@@ -41,34 +55,6 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (IdeCtagsHighlighter,
                                 G_IMPLEMENT_INTERFACE (IDE_TYPE_HIGHLIGHTER,
                                                        highlighter_iface_init))
 
-static inline gboolean
-accepts_char (gunichar ch)
-{
-  return (ch == '_' || g_unichar_isalnum (ch));
-}
-
-static gboolean
-select_next_word (GtkTextIter *begin,
-                  GtkTextIter *end)
-{
-  g_assert (begin);
-  g_assert (end);
-
-  *end = *begin;
-
-  while (!accepts_char (gtk_text_iter_get_char (begin)))
-    if (!gtk_text_iter_forward_char (begin))
-      return FALSE;
-
-  *end = *begin;
-
-  while (accepts_char (gtk_text_iter_get_char (end)))
-    if (!gtk_text_iter_forward_char (end))
-      return !gtk_text_iter_equal (begin, end);
-
-  return TRUE;
-}
-
 static const gchar *
 get_tag_from_kind (IdeCtagsIndexEntryKind kind)
 {
@@ -100,33 +86,60 @@ get_tag_from_kind (IdeCtagsIndexEntryKind kind)
 }
 
 static const gchar *
-get_tag (IdeCtagsHighlighter *self,
-         IdeFile             *file,
-         const gchar         *word)
+lookup_tag (GPtrArray   *indexes,
+            const gchar *file_path,
+            const gchar *word)
 {
-  const gchar *file_path = ide_file_get_path (file);
-  const IdeCtagsIndexEntry *entries;
-  gsize n_entries;
   gsize i;
   gsize j;
 
-  for (i = 0; i < self->indexes->len; i++)
+  for (i = 0; i < indexes->len; i++)
     {
-      IdeCtagsIndex *item = g_ptr_array_index (self->indexes, i);
-      entries = ide_ctags_index_lookup_prefix (item, word, &n_entries);
-      if ((entries == NULL) || (n_entries == 0))
+      IdeCtagsIndex *item = g_ptr_array_index (indexes, i);
+      g_autoptr(GArray) entries = NULL;
+      const IdeCtagsIndexEntry *first;
+
+      entries = ide_ctags_index_lookup_prefix (item, word);
+      if (entries == NULL)
         continue;
 
-      for (j = 0; j < n_entries; j++)
-        if (ide_str_equal0 (entries[j].path, file_path))
-          return get_tag_from_kind (entries[j].kind);
+      for (j = 0; j < entries->len; j++)
+        {
+          const IdeCtagsIndexEntry *entry = &g_array_index (entries, IdeCtagsIndexEntry, j);
+
+          if (ide_str_equal0 (entry->path, file_path))
+            return get_tag_from_kind (entry->kind);
+        }
+
+      first = &g_array_index (entries, IdeCtagsIndexEntry, 0);
 
-      return get_tag_from_kind (entries[0].kind);
+      return get_tag_from_kind (first->kind);
     }
 
   return NULL;
 }
 
+static const gchar *
+get_tag (IdeHighlighter *highlighter,
+         const gchar    *word,
+         gpointer        user_data)
+{
+  IdeCtagsHighlighter *self = (IdeCtagsHighlighter *)highlighter;
+
+  /* Only the main thread replaces the array, so no locking is needed here */
+  return lookup_tag (self->indexes, user_data, word);
+}
+
+static const gchar *
+get_tag_for_spans (IdeHighlighter *highlighter,
+                   const gchar    *word,
+                   gpointer        user_data)
+{
+  SpansLookup *lookup = user_data;
+
+  return lookup_tag (lookup->indexes, lookup->file_path, word);
+}
+
 static void
 ide_ctags_highlighter_real_update (IdeHighlighter       *highlighter,
                                    IdeHighlightCallback  callback,
@@ -135,11 +148,8 @@ ide_ctags_highlighter_real_update (IdeHighlighter       *highlighter,
                                    GtkTextIter          *location)
 {
   GtkTextBuffer *text_buffer;
-  GtkSourceBuffer *source_buffer;
   IdeBuffer *buffer;
   IdeFile *file;
-  GtkTextIter begin;
-  GtkTextIter end;
 
   g_assert (IDE_IS_CTAGS_HIGHLIGHTER (highlighter));
   g_assert (callback != NULL);
@@ -149,55 +159,46 @@ ide_ctags_highlighter_real_update (IdeHighlighter       *highlighter,
 
   if (!(text_buffer = gtk_text_iter_get_buffer (range_begin)) ||
       !IDE_IS_BUFFER (text_buffer) ||
-      !(source_buffer = GTK_SOURCE_BUFFER (text_buffer)) ||
       !(buffer = IDE_BUFFER (text_buffer)) ||
       !(file = ide_buffer_get_file (buffer)))
     return;
 
-  begin = end = *location = *range_begin;
-
-  while (gtk_text_iter_compare (&begin, range_end) < 0)
-    {
-      if (!select_next_word (&begin, &end))
-        goto completed;
+  ide_highlighter_scan_words (highlighter, callback, range_begin, range_end, location,
+                              get_tag, (gpointer)ide_file_get_path (file));
+}
 
-      if (gtk_text_iter_compare (&begin, range_end) >= 0)
-        goto completed;
+static GArray *
+ide_ctags_highlighter_real_compute_spans (IdeHighlighter  *highlighter,
+                                          const gchar     *text,
+                                          GCancellable    *cancellable,
+                                          GError         **error)
+{
+  IdeCtagsHighlighter *self = (IdeCtagsHighlighter *)highlighter;
+  g_autofree gchar *file_path = NULL;
+  g_autoptr(GPtrArray) indexes = NULL;
+  SpansLookup lookup;
 
-      g_assert (!gtk_text_iter_equal (&begin, &end));
+  g_assert (IDE_IS_CTAGS_HIGHLIGHTER (self));
+  g_assert (text != NULL);
 
-      if (!gtk_source_buffer_iter_has_context_class (source_buffer, &begin, "string") &&
-          !gtk_source_buffer_iter_has_context_class (source_buffer, &begin, "path") &&
-          !gtk_source_buffer_iter_has_context_class (source_buffer, &begin, "comment"))
-        {
-          const gchar *tag;
-          gchar *word;
-
-          word = gtk_text_iter_get_slice (&begin, &end);
-          tag = get_tag (IDE_CTAGS_HIGHLIGHTER (highlighter), file, word);
-          g_free (word);
-
-          if (tag != NULL)
-            {
-              if (callback (&begin, &end, tag) == IDE_HIGHLIGHT_STOP)
-                {
-                  *location = end;
-                  return;
-                }
-            }
-        }
+  g_mutex_lock (&self->mutex);
+  indexes = g_ptr_array_ref (self->indexes);
+  file_path = g_strdup (self->file_path);
+  g_mutex_unlock (&self->mutex);
 
-      begin = end;
-    }
+  lookup.indexes = indexes;
+  lookup.file_path = file_path;
 
-completed:
-  *location = *range_end;
+  return ide_highlighter_scan_text_words (highlighter, text, cancellable,
+                                          get_tag_for_spans, &lookup, error);
 }
 
 void
 ide_ctags_highlighter_add_index (IdeCtagsHighlighter *self,
                                  IdeCtagsIndex       *index)
 {
+  g_autoptr(GPtrArray) indexes = NULL;
+  gboolean replaced = FALSE;
   GFile *file;
   gsize i;
 
@@ -212,26 +213,55 @@ ide_ctags_highlighter_add_index (IdeCtagsHighlighter *self,
 
   file = ide_ctags_index_get_file (index);
 
+  /* Copy the array so that compute_spans can keep using the previous one */
+  indexes = g_ptr_array_new_full (self->indexes->len + 1, g_object_unref);
+
   for (i = 0; i < self->indexes->len; i++)
     {
       IdeCtagsIndex *item = g_ptr_array_index (self->indexes, i);
       GFile *item_file = ide_ctags_index_get_file (item);
 
-      if (g_file_equal (item_file, file))
+      /* Take over the existing slot in the index to preserve ordering. */
+      if (!replaced && g_file_equal (item_file, file))
         {
-          /* Steal the existing slot in the index to preserve ordering. */
-          g_ptr_array_index (self->indexes, i) = g_object_ref (index);
-          g_object_unref (item);
-
-          IDE_EXIT;
+          item = index;
+          replaced = TRUE;
         }
+
+      g_ptr_array_add (indexes, g_object_ref (item));
     }
 
-  g_ptr_array_add (self->indexes, g_object_ref (index));
+  if (!replaced)
+    g_ptr_array_add (indexes, g_object_ref (index));
+
+  g_mutex_lock (&self->mutex);
+  g_ptr_array_unref (self->indexes);
+  self->indexes = g_steal_pointer (&indexes);
+  g_mutex_unlock (&self->mutex);
 
   IDE_EXIT;
 }
 
+static void
+ide_ctags_highlighter_buffer_notify_file (IdeCtagsHighlighter *self,
+                                          GParamSpec          *pspec,
+                                          IdeBuffer           *buffer)
+{
+  g_autofree gchar *file_path = NULL;
+  IdeFile *file;
+
+  g_assert (IDE_IS_CTAGS_HIGHLIGHTER (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if ((file = ide_buffer_get_file (buffer)))
+    file_path = g_strdup (ide_file_get_path (file));
+
+  g_mutex_lock (&self->mutex);
+  g_free (self->file_path);
+  self->file_path = g_steal_pointer (&file_path);
+  g_mutex_unlock (&self->mutex);
+}
+
 static void
 ide_ctags_highlighter_real_set_engine (IdeHighlighter      *highlighter,
                                        IdeHighlightEngine  *engine)
@@ -239,12 +269,24 @@ ide_ctags_highlighter_real_set_engine (IdeHighlighter      *highlighter,
   IdeCtagsHighlighter *self = (IdeCtagsHighlighter *)highlighter;
   IdeContext *context;
   IdeCtagsService *service;
+  IdeBuffer *buffer;
 
   g_return_if_fail (IDE_IS_CTAGS_HIGHLIGHTER (self));
   g_return_if_fail (IDE_IS_HIGHLIGHT_ENGINE (engine));
 
   self->engine = engine;
 
+  /* compute_spans cannot get the path from the buffer within its thread */
+  if ((buffer = ide_highlight_engine_get_buffer (engine)))
+    {
+      g_signal_connect_object (buffer,
+                               "notify::file",
+                               G_CALLBACK (ide_ctags_highlighter_buffer_notify_file),
+                               self,
+                               G_CONNECT_SWAPPED);
+      ide_ctags_highlighter_buffer_notify_file (self, NULL, buffer);
+    }
+
   context = ide_object_get_context (IDE_OBJECT (self));
   service = ide_context_get_service_typed (context, IDE_TYPE_CTAGS_SERVICE);
 
@@ -265,6 +307,8 @@ ide_ctags_highlighter_finalize (GObject *object)
     }
 
   g_clear_pointer (&self->indexes, g_ptr_array_unref);
+  g_clear_pointer (&self->file_path, g_free);
+  g_mutex_clear (&self->mutex);
 
   G_OBJECT_CLASS (ide_ctags_highlighter_parent_class)->finalize (object);
 }
@@ -285,6 +329,7 @@ ide_ctags_highlighter_class_finalize (IdeCtagsHighlighterClass *klass)
 static void
 ide_ctags_highlighter_init (IdeCtagsHighlighter *self)
 {
+  g_mutex_init (&self->mutex);
   self->indexes = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
@@ -293,6 +338,7 @@ highlighter_iface_init (IdeHighlighterInterface *iface)
 {
   iface->update = ide_ctags_highlighter_real_update;
   iface->set_engine = ide_ctags_highlighter_real_set_engine;
+  iface->compute_spans = ide_ctags_highlighter_real_compute_spans;
 }
 
 void
@@ -20,22 +20,46 @@
 
 #include <egg-counter.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <ide.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "ide-ctags-index.h"
 
+/*
+ * The index is a sorted array of fixed-width records which refer to their
+ * strings by offset into a string table. Both are either mapped from the
+ * binary index or built in memory when parsing or splicing, and entries
+ * are only created for the results of a lookup.
+ */
+typedef struct
+{
+  guint32 name;
+  guint32 path;
+  guint32 pattern;
+  guint32 keyval;
+  guint8  kind;
+  guint8  padding[3];
+} IdeCtagsIndexRecord;
+
 struct _IdeCtagsIndex
 {
-  IdeObject  parent_instance;
+  IdeObject                  parent_instance;
 
-  GArray    *index;
-  GBytes    *buffer;
-  GFile     *file;
-  gchar     *path_root;
+  GBytes                    *records_bytes;
+  GBytes                    *strings_bytes;
+  const IdeCtagsIndexRecord *records;
+  const gchar               *strings;
+  guint32                    n_records;
+  guint32                    strings_length;
 
-  guint64    mtime;
+  GFile                     *file;
+  gchar                     *path_root;
+
+  guint64                    mtime;
+  /* Splices since the string table was last compacted */
+  guint                      n_splices;
 };
 
 enum {
@@ -58,32 +82,43 @@ EGG_DEFINE_COUNTER (heap_size, "IdeCtagsIndex", "Heap Size", "Size of index stri
 
 static GParamSpec *properties [LAST_PROP];
 
-static gint
-ide_ctags_index_entry_compare_keyword (gconstpointer a,
-                                       gconstpointer b)
-{
-  const IdeCtagsIndexEntry *entrya = a;
-  const IdeCtagsIndexEntry *entryb = b;
-
-  return g_strcmp0 (entrya->name, entryb->name);
-}
+/*
+ * Parsing large tags files is expensive, so after the first parse we
+ * write a binary copy of the index next to the tags file which can be
+ * mapped directly on the next load. The layout is:
+ *
+ *   IdeCtagsIndexHeader
+ *   IdeCtagsIndexRecord[n_entries], sorted like the in-memory index
+ *   string table of NUL terminated strings, shared between records
+ *
+ * The file is only used by this machine, so everything is stored in
+ * host byte order. The modification time of the tags file is kept in
+ * microseconds, since ctags can rewrite it more than once per second.
+ */
+#define IDE_CTAGS_INDEX_MAGIC   "IDECTAGS"
+#define IDE_CTAGS_INDEX_VERSION 2
+#define IDE_CTAGS_INDEX_NONE    G_MAXUINT32
+
+/*
+ * Splicing appends the strings of the updated file to a copy of the
+ * string table, leaving the strings of replaced records behind. After
+ * this many splices, the strings are interned into a new table instead.
+ */
+#define IDE_CTAGS_INDEX_MAX_SPLICES 8
 
-static gint
-ide_ctags_index_entry_compare_prefix (gconstpointer a,
-                                      gconstpointer b)
+typedef struct
 {
-  const IdeCtagsIndexEntry *entrya = a;
-  const IdeCtagsIndexEntry *entryb = b;
-
-  /*
-   * With bsearch(), the first element is always the key.
-   */
-
-  if (g_str_has_prefix (entryb->name, entrya->name))
-    return 0;
-  else
-    return g_strcmp0 (entrya->name, entryb->name);
-}
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint64 tags_mtime;
+  guint64 tags_size;
+  guint32 n_entries;
+  guint32 strings_length;
+} IdeCtagsIndexHeader;
+
+G_STATIC_ASSERT (sizeof (IdeCtagsIndexHeader) == 40);
+G_STATIC_ASSERT (sizeof (IdeCtagsIndexRecord) == 20);
 
 gint
 ide_ctags_index_entry_compare (gconstpointer a,
@@ -102,6 +137,69 @@ ide_ctags_index_entry_compare (gconstpointer a,
   return ret;
 }
 
+static inline const gchar *
+get_string (const gchar *strings,
+            gsize        strings_length,
+            guint32      offset)
+{
+  /*
+   * The string table is always terminated, so any offset within it is a
+   * valid string. That way a corrupted binary index cannot make us read
+   * past the mapping, without having to check every record at load time.
+   */
+  if G_UNLIKELY (offset >= strings_length)
+    return "";
+
+  return &strings [offset];
+}
+
+static inline const gchar *
+ide_ctags_index_get_string (IdeCtagsIndex *self,
+                            guint32        offset)
+{
+  return get_string (self->strings, self->strings_length, offset);
+}
+
+/*
+ * Compares records like ide_ctags_index_entry_compare(), with both
+ * records referring to @strings.
+ */
+static gint
+ide_ctags_index_record_compare (const gchar               *strings,
+                                gsize                      strings_length,
+                                const IdeCtagsIndexRecord *a,
+                                const IdeCtagsIndexRecord *b)
+{
+  gint ret;
+
+  if (((ret = strcmp (get_string (strings, strings_length, a->name),
+                      get_string (strings, strings_length, b->name))) == 0) &&
+      ((ret = (a->kind - b->kind)) == 0) &&
+      ((ret = strcmp (get_string (strings, strings_length, a->pattern),
+                      get_string (strings, strings_length, b->pattern))) == 0) &&
+      ((ret = strcmp (get_string (strings, strings_length, a->path),
+                      get_string (strings, strings_length, b->path))) == 0))
+    return 0;
+
+  return ret;
+}
+
+static void
+ide_ctags_index_record_to_entry (IdeCtagsIndex             *self,
+                                 const IdeCtagsIndexRecord *record,
+                                 IdeCtagsIndexEntry        *entry)
+{
+  memset (entry, 0, sizeof *entry);
+
+  entry->name = ide_ctags_index_get_string (self, record->name);
+  entry->path = ide_ctags_index_get_string (self, record->path);
+  entry->pattern = ide_ctags_index_get_string (self, record->pattern);
+  entry->keyval = record->keyval != IDE_CTAGS_INDEX_NONE
+                ? ide_ctags_index_get_string (self, record->keyval)
+                : NULL;
+  entry->kind = (IdeCtagsIndexEntryKind)record->kind;
+}
+
 static inline gchar *
 forward_to_tab (gchar *iter)
 {
@@ -183,32 +281,21 @@ ide_ctags_index_parse_line (gchar              *line,
   return TRUE;
 }
 
-static void
-ide_ctags_index_build_index (GTask        *task,
-                             gpointer      source_object,
-                             gpointer      task_data,
-                             GCancellable *cancellable)
+/*
+ * Parses @contents in place, which must be @length bytes followed by a
+ * trailing NUL byte. The resulting entries point into @contents.
+ */
+static GArray *
+ide_ctags_index_parse (gchar *contents,
+                       gsize  length)
 {
-  IdeCtagsIndex *self = source_object;
   IdeLineReader reader;
-  GError *error = NULL;
-  GArray *index = NULL;
-  gchar *contents = NULL;
+  GArray *index;
   gchar *line;
-  gsize length = 0;
   gsize line_length;
 
-  IDE_ENTRY;
-
-  g_assert (G_IS_TASK (task));
-  g_assert (IDE_IS_CTAGS_INDEX (self));
-  g_assert (G_IS_FILE (self->file));
-
-  if (!g_file_load_contents (self->file, cancellable, &contents, &length, NULL, &error))
-    IDE_GOTO (failure);
-
-  if (length > G_MAXSSIZE)
-    IDE_GOTO (failure);
+  g_assert (contents != NULL);
+  g_assert (contents [length] == '\0');
 
   index = g_array_new (FALSE, FALSE, sizeof (IdeCtagsIndexEntry));
 
@@ -239,19 +326,377 @@ ide_ctags_index_build_index (GTask        *task,
 
   g_array_sort (index, ide_ctags_index_entry_compare);
 
-  self->index = index;
-  self->buffer = g_bytes_new_take (contents, length);
+  return index;
+}
+
+static guint32
+ide_ctags_index_intern (GHashTable  *offsets,
+                        GByteArray  *strings,
+                        const gchar *str)
+{
+  gpointer offset;
+
+  if (str == NULL)
+    return IDE_CTAGS_INDEX_NONE;
+
+  /* Offsets are stored +1 so that 0 means missing */
+  if (!(offset = g_hash_table_lookup (offsets, str)))
+    {
+      offset = GUINT_TO_POINTER (strings->len + 1);
+      g_byte_array_append (strings, (const guint8 *)str, strlen (str) + 1);
+      g_hash_table_insert (offsets, (gchar *)str, offset);
+    }
+
+  return GPOINTER_TO_UINT (offset) - 1;
+}
+
+/*
+ * Appends the strings of @entry to @strings, sharing those that were
+ * already interned through @offsets, and fills @record to refer to them.
+ * The strings must outlive @offsets.
+ */
+static gboolean
+ide_ctags_index_encode (GHashTable                *offsets,
+                        GByteArray                *strings,
+                        const IdeCtagsIndexEntry  *entry,
+                        IdeCtagsIndexRecord       *record)
+{
+  memset (record, 0, sizeof *record);
+
+  record->name = ide_ctags_index_intern (offsets, strings, entry->name);
+  record->path = ide_ctags_index_intern (offsets, strings, entry->path);
+  record->pattern = ide_ctags_index_intern (offsets, strings, entry->pattern);
+  record->keyval = ide_ctags_index_intern (offsets, strings, entry->keyval);
+  record->kind = entry->kind;
+
+  /* Offsets must fit, and not collide with IDE_CTAGS_INDEX_NONE */
+  return strings->len < IDE_CTAGS_INDEX_NONE;
+}
+
+static void
+ide_ctags_index_buffer_free (gpointer data)
+{
+  GBytes *bytes = data;
+
+  EGG_COUNTER_SUB (heap_size, (gint64)g_bytes_get_size (bytes));
+  g_bytes_unref (bytes);
+}
+
+/*
+ * Wraps @bytes, which must be allocated on the heap, so that its size is
+ * counted in the heap size for as long as it is alive. Mapped indexes are
+ * not counted, since the kernel can drop their pages at any time.
+ */
+static GBytes *
+ide_ctags_index_buffer_new (GBytes *bytes)
+{
+  gsize length;
+  gconstpointer data;
+
+  g_assert (bytes != NULL);
 
-  EGG_COUNTER_ADD (index_entries, (gint64)index->len);
+  data = g_bytes_get_data (bytes, &length);
   EGG_COUNTER_ADD (heap_size, (gint64)length);
 
+  return g_bytes_new_with_free_func (data, length, ide_ctags_index_buffer_free, bytes);
+}
+
+static void
+ide_ctags_index_set_data (IdeCtagsIndex *self,
+                          GBytes        *records,
+                          GBytes        *strings)
+{
+  gsize records_length;
+  gsize strings_length;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (self->records_bytes == NULL);
+  g_assert (self->strings_bytes == NULL);
+  g_assert (records != NULL);
+  g_assert (strings != NULL);
+
+  self->records_bytes = records;
+  self->strings_bytes = strings;
+  self->records = g_bytes_get_data (records, &records_length);
+  self->strings = g_bytes_get_data (strings, &strings_length);
+  self->n_records = records_length / sizeof (IdeCtagsIndexRecord);
+  self->strings_length = strings_length;
+
+  g_assert (self->strings_length > 0);
+  g_assert (self->strings [self->strings_length - 1] == '\0');
+
+  EGG_COUNTER_ADD (index_entries, (gint64)self->n_records);
+}
+
+/*
+ * Takes ownership of @records and @strings, which are allocated on the
+ * heap while parsing or splicing.
+ */
+static void
+ide_ctags_index_take_data (IdeCtagsIndex *self,
+                           GArray        *records,
+                           GByteArray    *strings)
+{
+  gsize records_length;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (records != NULL);
+  g_assert (strings != NULL);
+
+  /* Always have a terminated string table, even when empty */
+  if (strings->len == 0)
+    g_byte_array_append (strings, (const guint8 *)"", 1);
+
+  records_length = records->len * sizeof (IdeCtagsIndexRecord);
+
+  ide_ctags_index_set_data (self,
+                            ide_ctags_index_buffer_new (g_bytes_new_take (g_array_free (records, FALSE),
+                                                                          records_length)),
+                            ide_ctags_index_buffer_new (g_byte_array_free_to_bytes (strings)));
+}
+
+/*
+ * Converts @entries, which must be sorted, into records with a string
+ * table in which duplicates such as the path are shared.
+ */
+static gboolean
+ide_ctags_index_take_entries (IdeCtagsIndex  *self,
+                              GArray         *entries,
+                              GError        **error)
+{
+  g_autoptr(GHashTable) offsets = NULL;
+  GByteArray *strings;
+  GArray *records;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (entries != NULL);
+
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  strings = g_byte_array_new ();
+  records = g_array_sized_new (FALSE, FALSE, sizeof (IdeCtagsIndexRecord), entries->len);
+
+  for (guint i = 0; i < entries->len; i++)
+    {
+      const IdeCtagsIndexEntry *entry = &g_array_index (entries, IdeCtagsIndexEntry, i);
+      IdeCtagsIndexRecord record;
+
+      if (!ide_ctags_index_encode (offsets, strings, entry, &record))
+        {
+          g_byte_array_unref (strings);
+          g_array_unref (records);
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_NOT_SUPPORTED,
+                       "tags file is too large to index");
+          return FALSE;
+        }
+
+      g_array_append_val (records, record);
+    }
+
+  ide_ctags_index_take_data (self, records, strings);
+
+  return TRUE;
+}
+
+/*
+ * Tags files we generate live in our cache directory, so the binary index
+ * can be placed right next to them. Tags files found elsewhere (such as
+ * within the project tree) get a location within the cache directory so
+ * that we do not litter the users source tree.
+ */
+static gchar *
+ide_ctags_index_get_binary_path (IdeCtagsIndex *self)
+{
+  g_autofree gchar *cache_dir = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *name = NULL;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+
+  if (!(path = g_file_get_path (self->file)))
+    return NULL;
+
+  cache_dir = g_build_filename (g_get_user_cache_dir (), ide_get_program_name (), NULL);
+
+  if (g_str_has_prefix (path, cache_dir) && path [strlen (cache_dir)] == G_DIR_SEPARATOR)
+    return g_strdup_printf ("%s.idx", path);
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, path, -1);
+  name = g_strdup_printf ("%s.idx", checksum);
+
+  return g_build_filename (cache_dir, "ctags-index", name, NULL);
+}
+
+/*
+ * Maps the binary index at @path, if it was written for the tags file as
+ * it is now. Only the header is checked, so that loading does not touch
+ * the records until they are looked up.
+ */
+static gboolean
+ide_ctags_index_load_binary (IdeCtagsIndex *self,
+                             const gchar   *path,
+                             guint64        tags_mtime,
+                             guint64        tags_size)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  const IdeCtagsIndexHeader *header;
+  const gchar *contents;
+  gsize records_length;
+  gsize length;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (path != NULL);
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, NULL)))
+    return FALSE;
+
+  contents = g_mapped_file_get_contents (mapped);
+  length = g_mapped_file_get_length (mapped);
+
+  if (contents == NULL || length < sizeof *header)
+    return FALSE;
+
+  header = (const IdeCtagsIndexHeader *)(gconstpointer)contents;
+
+  if (memcmp (header->magic, IDE_CTAGS_INDEX_MAGIC, sizeof header->magic) != 0 ||
+      header->version != IDE_CTAGS_INDEX_VERSION ||
+      header->byte_order != G_BYTE_ORDER ||
+      header->tags_mtime != tags_mtime ||
+      header->tags_size != tags_size ||
+      header->strings_length == 0 ||
+      (length - sizeof *header) / sizeof (IdeCtagsIndexRecord) < header->n_entries)
+    return FALSE;
+
+  records_length = header->n_entries * sizeof (IdeCtagsIndexRecord);
+
+  /* A truncated (or extended) file cannot be trusted */
+  if (length - sizeof *header - records_length != header->strings_length ||
+      contents [length - 1] != '\0')
+    return FALSE;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+
+  ide_ctags_index_set_data (self,
+                            g_bytes_new_from_bytes (bytes, sizeof *header, records_length),
+                            g_bytes_new_from_bytes (bytes, sizeof *header + records_length, header->strings_length));
+
+  return TRUE;
+}
+
+static gboolean
+ide_ctags_index_write_binary (IdeCtagsIndex  *self,
+                              const gchar    *path,
+                              guint64         tags_mtime,
+                              guint64         tags_size,
+                              GError        **error)
+{
+  g_autoptr(GByteArray) contents = NULL;
+  g_autofree gchar *dir = NULL;
+  IdeCtagsIndexHeader header = { { 0 } };
+  gsize records_length;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (path != NULL);
+
+  records_length = self->n_records * sizeof (IdeCtagsIndexRecord);
+
+  memcpy (header.magic, IDE_CTAGS_INDEX_MAGIC, sizeof header.magic);
+  header.version = IDE_CTAGS_INDEX_VERSION;
+  header.byte_order = G_BYTE_ORDER;
+  header.tags_mtime = tags_mtime;
+  header.tags_size = tags_size;
+  header.n_entries = self->n_records;
+  header.strings_length = self->strings_length;
+
+  contents = g_byte_array_sized_new (sizeof header + records_length + self->strings_length);
+  g_byte_array_append (contents, (const guint8 *)&header, sizeof header);
+  g_byte_array_append (contents, (const guint8 *)self->records, records_length);
+  g_byte_array_append (contents, (const guint8 *)self->strings, self->strings_length);
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0750);
+
+  return g_file_set_contents (path, (const gchar *)contents->data, contents->len, error);
+}
+
+static void
+ide_ctags_index_build_index (GTask        *task,
+                             gpointer      source_object,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+  IdeCtagsIndex *self = source_object;
+  g_autoptr(GFileInfo) info = NULL;
+  g_autofree gchar *binary_path = NULL;
+  GError *error = NULL;
+  GArray *entries = NULL;
+  gchar *contents = NULL;
+  gsize length = 0;
+  guint64 tags_mtime;
+  guint64 tags_size;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (G_IS_FILE (self->file));
+
+  if (!(info = g_file_query_info (self->file,
+                                  G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC","
+                                  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                  G_FILE_QUERY_INFO_NONE,
+                                  cancellable,
+                                  &error)))
+    IDE_GOTO (failure);
+
+  tags_mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+               g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  tags_size = g_file_info_get_size (info);
+  binary_path = ide_ctags_index_get_binary_path (self);
+
+  if (binary_path != NULL &&
+      ide_ctags_index_load_binary (self, binary_path, tags_mtime, tags_size))
+    {
+      IDE_TRACE_MSG ("Loaded binary ctags index from %s", binary_path);
+      g_task_return_boolean (task, TRUE);
+      IDE_EXIT;
+    }
+
+  if (!g_file_load_contents (self->file, cancellable, &contents, &length, NULL, &error))
+    IDE_GOTO (failure);
+
+  if (length > G_MAXSSIZE)
+    IDE_GOTO (failure);
+
+  entries = ide_ctags_index_parse (contents, length);
+
+  /* The records get their own copy of the strings, so the text can go */
+  if (!ide_ctags_index_take_entries (self, entries, &error))
+    IDE_GOTO (failure);
+
+  g_clear_pointer (&entries, g_array_unref);
+  g_clear_pointer (&contents, g_free);
+
+  /* Save the binary index so that the next load can map it */
+  if (binary_path != NULL)
+    {
+      g_autoptr(GError) write_error = NULL;
+
+      if (!ide_ctags_index_write_binary (self, binary_path, tags_mtime, tags_size, &write_error))
+        g_debug ("Failed to write binary ctags index: %s", write_error->message);
+    }
+
   g_task_return_boolean (task, TRUE);
 
   IDE_EXIT;
 
 failure:
   g_clear_pointer (&contents, g_free);
-  g_clear_pointer (&index, g_array_unref);
+  g_clear_pointer (&entries, g_array_unref);
 
   if (error != NULL)
     g_task_return_error (task, error);
@@ -356,18 +801,14 @@ ide_ctags_index_finalize (GObject *object)
 {
   IdeCtagsIndex *self = (IdeCtagsIndex *)object;
 
-  if (self->index != NULL)
-    EGG_COUNTER_SUB (index_entries, (gint64)self->index->len);
+  EGG_COUNTER_SUB (index_entries, (gint64)self->n_records);
 
-  if (self->buffer != NULL)
-    {
-      gsize len = g_bytes_get_size (self->buffer);
-      EGG_COUNTER_SUB (heap_size, (gint64)len);
-    }
+  self->records = NULL;
+  self->strings = NULL;
 
   g_clear_object (&self->file);
-  g_clear_pointer (&self->index, g_array_unref);
-  g_clear_pointer (&self->buffer, g_bytes_unref);
+  g_clear_pointer (&self->records_bytes, g_bytes_unref);
+  g_clear_pointer (&self->strings_bytes, g_bytes_unref);
   g_clear_pointer (&self->path_root, g_free);
 
   G_OBJECT_CLASS (ide_ctags_index_parent_class)->finalize (object);
@@ -506,72 +947,77 @@ ide_ctags_index_get_size (IdeCtagsIndex *self)
 {
   g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), 0);
 
-  if (self->index != NULL)
-    return self->index->len;
+  return self->n_records;
+}
 
-  return 0;
+/*
+ * Creates entries for the records in [@begin, @end), which point into the
+ * string table of @self.
+ */
+static GArray *
+ide_ctags_index_create_entries (IdeCtagsIndex *self,
+                                guint32        begin,
+                                guint32        end)
+{
+  GArray *ret;
+
+  g_assert (IDE_IS_CTAGS_INDEX (self));
+  g_assert (begin <= end);
+  g_assert (end <= self->n_records);
+
+  ret = g_array_sized_new (FALSE, FALSE, sizeof (IdeCtagsIndexEntry), end - begin);
+  g_array_set_size (ret, end - begin);
+
+  for (guint32 i = begin; i < end; i++)
+    ide_ctags_index_record_to_entry (self,
+                                     &self->records [i],
+                                     &g_array_index (ret, IdeCtagsIndexEntry, i - begin));
+
+  return ret;
 }
 
-static const IdeCtagsIndexEntry *
+static GArray *
 ide_ctags_index_lookup_full (IdeCtagsIndex *self,
                              const gchar   *keyword,
-                             gsize         *length,
-                             GCompareFunc   compare_func)
+                             gboolean       prefix)
 {
-  IdeCtagsIndexEntry key = { 0 };
-  IdeCtagsIndexEntry *ret;
+  gsize keyword_len;
+  guint32 begin = 0;
+  guint32 end;
 
   g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), NULL);
   g_return_val_if_fail (keyword != NULL, NULL);
 
-  if (length != NULL)
-    *length = 0;
-
-  if ((self->index == NULL) || (self->index->data == NULL) || (self->index->len == 0))
-    return NULL;
-
-  key.name = keyword;
-
-  ret = bsearch (&key,
-                 self->index->data,
-                 self->index->len,
-                 sizeof (IdeCtagsIndexEntry),
-                 compare_func);
+  /*
+   * Records are sorted by name, so find the first one that does not sort
+   * before @keyword. All matches follow it, whether exact or by prefix.
+   */
+  end = self->n_records;
 
-  if (ret != NULL)
+  while (begin < end)
     {
-      IdeCtagsIndexEntry *last;
-      IdeCtagsIndexEntry *first;
-      gsize count = 0;
-      gsize i;
+      guint32 mid = begin + (end - begin) / 2;
 
-      first = &g_array_index (self->index, IdeCtagsIndexEntry, 0);
-      last = &g_array_index (self->index, IdeCtagsIndexEntry, self->index->len - 1);
+      if (strcmp (ide_ctags_index_get_string (self, self->records [mid].name), keyword) < 0)
+        begin = mid + 1;
+      else
+        end = mid;
+    }
 
-      /*
-       * We might be smack in the middle of a group of items that match this keyword.
-       * So let's walk backwards to the first match, being careful not to access the
-       * array out of bounds.
-       */
-      while ((ret > first) && (compare_func (&key, &ret [-1]) == 0))
-        ret--;
+  keyword_len = strlen (keyword);
 
-      /*
-       * Now count how many index entries match this.
-       */
-      for (i = 0; &ret[i] <= last; i++)
-        {
-          if (compare_func (&key, &ret [i]) == 0)
-            count++;
-          else
-            break;
-        }
+  for (end = begin; end < self->n_records; end++)
+    {
+      const gchar *name = ide_ctags_index_get_string (self, self->records [end].name);
 
-      if (length != NULL)
-        *length = count;
+      if (prefix ? strncmp (name, keyword, keyword_len) != 0 : strcmp (name, keyword) != 0)
+        break;
     }
 
-  return ret;
+  if (begin == end)
+    return NULL;
+
+  return ide_ctags_index_create_entries (self, begin, end);
 }
 
 gchar *
@@ -607,22 +1053,40 @@ ide_ctags_index_entry_free (IdeCtagsIndexEntry *entry)
   g_slice_free (IdeCtagsIndexEntry, entry);
 }
 
-const IdeCtagsIndexEntry *
+/**
+ * ide_ctags_index_lookup:
+ * @self: An #IdeCtagsIndex
+ * @keyword: the name to look for
+ *
+ * Finds the entries named @keyword. The strings of the entries belong to
+ * @self, so they are valid for as long as @self is alive.
+ *
+ * Returns: (transfer full) (nullable) (element-type Ide.CtagsIndexEntry): An
+ *   array of entries, or %NULL if there are none.
+ */
+GArray *
 ide_ctags_index_lookup (IdeCtagsIndex *self,
-                        const gchar   *keyword,
-                        gsize         *length)
+                        const gchar   *keyword)
 {
-  return ide_ctags_index_lookup_full (self, keyword, length,
-                                      ide_ctags_index_entry_compare_keyword);
+  return ide_ctags_index_lookup_full (self, keyword, FALSE);
 }
 
-const IdeCtagsIndexEntry *
+/**
+ * ide_ctags_index_lookup_prefix:
+ * @self: An #IdeCtagsIndex
+ * @keyword: the prefix of the names to look for
+ *
+ * Like ide_ctags_index_lookup(), but finds the entries with a name
+ * starting with @keyword.
+ *
+ * Returns: (transfer full) (nullable) (element-type Ide.CtagsIndexEntry): An
+ *   array of entries, or %NULL if there are none.
+ */
+GArray *
 ide_ctags_index_lookup_prefix (IdeCtagsIndex *self,
-                               const gchar   *keyword,
-                               gsize         *length)
+                               const gchar   *keyword)
 {
-  return ide_ctags_index_lookup_full (self, keyword, length,
-                                      ide_ctags_index_entry_compare_prefix);
+  return ide_ctags_index_lookup_full (self, keyword, TRUE);
 }
 
 void
@@ -644,11 +1108,12 @@ ide_ctags_index_get_mtime (IdeCtagsIndex *self)
  * @self: A #IdeCtagsIndex
  * @relative_path: A path relative to the indexes base_path.
  *
- * This will return a GPtrArray of #IdeCtagsIndex pointers. These
- * pointers are const and should not be modified or freed.
+ * This will return a GArray of the entries matching the relative path.
+ * The strings of the entries belong to @self, so they are valid for as
+ * long as @self is alive.
  *
  * The container is owned by the caller and should be freed by the
- * caller with g_ptr_array_unref().
+ * caller with g_array_unref().
  *
  * Note that this function is not indexed, and therefore is O(n)
  * running time with `n` is the number of items in the index.
@@ -656,23 +1121,28 @@ ide_ctags_index_get_mtime (IdeCtagsIndex *self)
  * Returns: (transfer container) (element-type Ide.CtagsIndexEntry): An array
  *   of items matching the relative path.
  */
-GPtrArray *
+GArray *
 ide_ctags_index_find_with_path (IdeCtagsIndex *self,
                                 const gchar   *relative_path)
 {
-  GPtrArray *ar;
+  GArray *ar;
 
   g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), NULL);
   g_return_val_if_fail (relative_path != NULL, NULL);
 
-  ar = g_ptr_array_new ();
+  ar = g_array_new (FALSE, FALSE, sizeof (IdeCtagsIndexEntry));
 
-  for (guint i = 0; i < self->index->len; i++)
+  for (guint32 i = 0; i < self->n_records; i++)
     {
-      IdeCtagsIndexEntry *entry = &g_array_index (self->index, IdeCtagsIndexEntry, i);
+      const IdeCtagsIndexRecord *record = &self->records [i];
+
+      if (g_str_equal (ide_ctags_index_get_string (self, record->path), relative_path))
+        {
+          IdeCtagsIndexEntry entry;
 
-      if (g_str_equal (entry->path, relative_path))
-        g_ptr_array_add (ar, entry);
+          ide_ctags_index_record_to_entry (self, record, &entry);
+          g_array_append_val (ar, entry);
+        }
     }
 
   return ar;
@@ -683,5 +1153,151 @@ ide_ctags_index_get_is_empty (IdeCtagsIndex *self)
 {
   g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), FALSE);
 
-  return self->index == NULL || self->index->len == 0;
+  return self->n_records == 0;
+}
+
+/**
+ * ide_ctags_index_splice:
+ * @self: An #IdeCtagsIndex
+ * @relative_path: the path of the source file, as found in the tags file
+ * @tags: the output of ctags for @relative_path
+ * @mtime: the mtime of the updated tags file
+ *
+ * Creates a new index containing the entries of @self, except that the
+ * entries for @relative_path are replaced with those parsed from @tags.
+ * This allows updating the index after a single file was changed without
+ * parsing the whole tags file again.
+ *
+ * @self is not modified, since entries may still be in use by others. The
+ * new index gets a copy of the string table of @self with the strings of
+ * @tags appended, and the strings are interned into a new table once too
+ * many replaced strings could have accumulated.
+ *
+ * Returns: (transfer full): A new #IdeCtagsIndex.
+ */
+IdeCtagsIndex *
+ide_ctags_index_splice (IdeCtagsIndex *self,
+                        const gchar   *relative_path,
+                        GBytes        *tags,
+                        guint64        mtime)
+{
+  IdeCtagsIndex *ret;
+  g_autoptr(GHashTable) offsets = NULL;
+  g_autoptr(GByteArray) strings = NULL;
+  g_autoptr(GArray) added = NULL;
+  g_autoptr(GArray) kept = NULL;
+  g_autoptr(GArray) records = NULL;
+  g_autofree gchar *contents = NULL;
+  gboolean compact;
+  gsize length;
+  guint i = 0;
+  guint j = 0;
+
+  g_return_val_if_fail (IDE_IS_CTAGS_INDEX (self), NULL);
+  g_return_val_if_fail (relative_path != NULL, NULL);
+  g_return_val_if_fail (tags != NULL, NULL);
+
+  ret = g_object_new (IDE_TYPE_CTAGS_INDEX,
+                      "file", self->file,
+                      "path-root", self->path_root,
+                      "mtime", mtime,
+                      NULL);
+
+  /* Entries are parsed in place, so we need our own terminated copy */
+  length = g_bytes_get_size (tags);
+  contents = g_malloc (length + 1);
+  memcpy (contents, g_bytes_get_data (tags, NULL), length);
+  contents [length] = '\0';
+
+  added = ide_ctags_index_parse (contents, length);
+
+  compact = self->n_splices + 1 >= IDE_CTAGS_INDEX_MAX_SPLICES;
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  strings = g_byte_array_sized_new (compact ? 0 : self->strings_length + length);
+  kept = g_array_sized_new (FALSE, FALSE, sizeof (IdeCtagsIndexRecord), self->n_records);
+
+  /* Without compacting, the records of @self stay valid as they are */
+  if (!compact)
+    g_byte_array_append (strings, (const guint8 *)self->strings, self->strings_length);
+
+  for (guint32 k = 0; k < self->n_records; k++)
+    {
+      const IdeCtagsIndexRecord *record = &self->records [k];
+      IdeCtagsIndexEntry entry;
+      IdeCtagsIndexRecord copy;
+
+      if (g_str_equal (ide_ctags_index_get_string (self, record->path), relative_path))
+        continue;
+
+      if (!compact)
+        {
+          g_array_append_val (kept, *record);
+          continue;
+        }
+
+      ide_ctags_index_record_to_entry (self, record, &entry);
+
+      if (!ide_ctags_index_encode (offsets, strings, &entry, &copy))
+        goto too_large;
+
+      g_array_append_val (kept, copy);
+    }
+
+  records = g_array_sized_new (FALSE, FALSE, sizeof (IdeCtagsIndexRecord), kept->len + added->len);
+
+  {
+    g_autoptr(GArray) encoded = NULL;
+    const gchar *base;
+
+    encoded = g_array_sized_new (FALSE, FALSE, sizeof (IdeCtagsIndexRecord), added->len);
+
+    for (guint k = 0; k < added->len; k++)
+      {
+        IdeCtagsIndexRecord record;
+
+        if (!ide_ctags_index_encode (offsets, strings,
+                                     &g_array_index (added, IdeCtagsIndexEntry, k),
+                                     &record))
+          goto too_large;
+
+        g_array_append_val (encoded, record);
+      }
+
+    /*
+     * Both arrays are sorted, so merge them. The string table will not
+     * grow anymore, so it is safe to compare through it now.
+     */
+    base = (const gchar *)strings->data;
+
+    while (i < kept->len || j < encoded->len)
+      {
+        const IdeCtagsIndexRecord *a = i < kept->len ? &g_array_index (kept, IdeCtagsIndexRecord, i) : NULL;
+        const IdeCtagsIndexRecord *b = j < encoded->len ? &g_array_index (encoded, IdeCtagsIndexRecord, j) : NULL;
+
+        if (b == NULL || (a != NULL && ide_ctags_index_record_compare (base, strings->len, a, b) <= 0))
+          {
+            g_array_append_val (records, *a);
+            i++;
+          }
+        else
+          {
+            g_array_append_val (records, *b);
+            j++;
+          }
+      }
+  }
+
+  ret->n_splices = compact ? 0 : self->n_splices + 1;
+  ide_ctags_index_take_data (ret, g_steal_pointer (&records), g_steal_pointer (&strings));
+
+  return ret;
+
+too_large:
+  /* Offsets would not fit, so keep the entries we had */
+  g_warning ("Too many ctags to update index for %s", relative_path);
+  ide_ctags_index_set_data (ret,
+                            g_bytes_ref (self->records_bytes),
+                            g_bytes_ref (self->strings_bytes));
+
+  return ret;
 }
@@ -66,7 +66,7 @@ void                      ide_ctags_index_load_async    (IdeCtagsIndex
 gboolean                  ide_ctags_index_load_finish   (IdeCtagsIndex            *index,
                                                          GAsyncResult             *result,
                                                          GError                  **error);
-GPtrArray                *ide_ctags_index_find_with_path(IdeCtagsIndex           *self,
+GArray                   *ide_ctags_index_find_with_path(IdeCtagsIndex           *self,
                                                          const gchar             *relative_path);
 gchar                    *ide_ctags_index_resolve_path  (IdeCtagsIndex            *self,
                                                          const gchar              *path);
@@ -74,13 +74,15 @@ GFile                    *ide_ctags_index_get_file      (IdeCtagsIndex
 gboolean                  ide_ctags_index_get_is_empty  (IdeCtagsIndex            *self);
 gsize                     ide_ctags_index_get_size      (IdeCtagsIndex            *self);
 const gchar              *ide_ctags_index_get_path_root (IdeCtagsIndex            *self);
-const IdeCtagsIndexEntry *ide_ctags_index_lookup        (IdeCtagsIndex            *self,
-                                                         const gchar              *keyword,
-                                                         gsize                    *length);
-const IdeCtagsIndexEntry *ide_ctags_index_lookup_prefix (IdeCtagsIndex            *self,
-                                                         const gchar              *keyword,
-                                                         gsize                    *length);
+GArray                   *ide_ctags_index_lookup        (IdeCtagsIndex            *self,
+                                                         const gchar              *keyword);
+GArray                   *ide_ctags_index_lookup_prefix (IdeCtagsIndex            *self,
+                                                         const gchar              *keyword);
 guint64                   ide_ctags_index_get_mtime     (IdeCtagsIndex            *self);
+IdeCtagsIndex            *ide_ctags_index_splice        (IdeCtagsIndex            *self,
+                                                         const gchar              *relative_path,
+                                                         GBytes                   *tags,
+                                                         guint64                   mtime);
 gint                      ide_ctags_index_entry_compare (gconstpointer             a,
                                                          gconstpointer             b);
 IdeCtagsIndexEntry       *ide_ctags_index_entry_copy    (const IdeCtagsIndexEntry *entry);
@@ -37,6 +37,8 @@ struct _IdeCtagsService
   GPtrArray        *highlighters;
   GPtrArray        *completions;
   GHashTable       *build_timeout_by_dir;
+  GHashTable       *spliced;
+  IdeProgress      *progress;
 
   guint             queued_miner_handler;
   guint             miner_active : 1;
@@ -49,11 +51,30 @@ typedef struct
   guint  recursive;
 } MineInfo;
 
+enum {
+  PROP_0,
+  PROP_PROGRESS,
+  LAST_PROP
+};
+
 static void service_iface_init (IdeServiceInterface *iface);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (IdeCtagsService, ide_ctags_service, IDE_TYPE_OBJECT, 0,
                                 G_IMPLEMENT_INTERFACE (IDE_TYPE_SERVICE, service_iface_init))
 
+static GParamSpec *properties [LAST_PROP];
+
+static void
+ide_ctags_service_set_progress (IdeCtagsService *self,
+                                IdeProgress     *progress)
+{
+  g_assert (IDE_IS_CTAGS_SERVICE (self));
+  g_assert (!progress || IDE_IS_PROGRESS (progress));
+
+  if (g_set_object (&self->progress, progress))
+    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_PROGRESS]);
+}
+
 static void
 ide_ctags_service_build_index_init_cb (GObject      *object,
                                        GAsyncResult *result,
@@ -149,6 +170,18 @@ ide_ctags_service_build_index_cb (EggTaskCache  *cache,
   g_assert (G_IS_FILE (key));
   g_assert (G_IS_TASK (task));
 
+  /*
+   * If we updated this index incrementally after a save, we already have
+   * the new contents in memory and can avoid parsing the tags file again.
+   */
+  if ((index = g_hash_table_lookup (self->spliced, file)))
+    {
+      g_task_return_pointer (task, g_object_ref (index), g_object_unref);
+      g_hash_table_remove (self->spliced, file);
+      index = NULL;
+      IDE_EXIT;
+    }
+
   path_root = resolve_path_root (self, file);
   index = ide_ctags_index_new (file, path_root, get_file_mtime (file));
 
@@ -276,14 +309,43 @@ ide_ctags_service_load_tags (IdeCtagsService *self,
   g_timeout_add (0, do_load, pair);
 }
 
+static void
+ide_ctags_service_mine_cb (IdeDirectoryCrawler *crawler,
+                           GFile               *directory,
+                           const gchar         *relative_path,
+                           GFileInfo           *directory_info,
+                           GPtrArray           *children,
+                           gpointer             user_data)
+{
+  IdeCtagsService *self = user_data;
+
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (crawler));
+  g_assert (G_IS_FILE (directory));
+  g_assert (children != NULL);
+  g_assert (IDE_IS_CTAGS_SERVICE (self));
+
+  for (guint i = 0; i < children->len; i++)
+    {
+      GFileInfo *file_info = g_ptr_array_index (children, i);
+      const gchar *name = g_file_info_get_name (file_info);
+
+      if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_REGULAR &&
+          (g_strcmp0 (name, "tags") == 0 || g_strcmp0 (name, ".tags") == 0))
+        {
+          g_autoptr(GFile) child = g_file_get_child (directory, name);
+
+          ide_ctags_service_load_tags (self, child);
+        }
+    }
+}
+
 static void
 ide_ctags_service_mine_directory (IdeCtagsService *self,
                                   GFile           *directory,
                                   gboolean         recurse,
                                   GCancellable    *cancellable)
 {
-  GFileEnumerator *enumerator = NULL;
-  gpointer infoptr;
+  g_autoptr(IdeDirectoryCrawler) crawler = NULL;
   GFile *child;
 
   g_assert (IDE_IS_CTAGS_SERVICE (self));
@@ -293,51 +355,26 @@ ide_ctags_service_mine_directory (IdeCtagsService *self,
   if (g_cancellable_is_cancelled (cancellable))
     return;
 
-  child = g_file_get_child (directory, "tags");
-  if (g_file_query_file_type (child, 0, cancellable) == G_FILE_TYPE_REGULAR)
-    ide_ctags_service_load_tags (self, child);
-  g_clear_object (&child);
-
-  child = g_file_get_child (directory, ".tags");
-  if (g_file_query_file_type (child, 0, cancellable) == G_FILE_TYPE_REGULAR)
-    ide_ctags_service_load_tags (self, child);
-  g_clear_object (&child);
-
   if (!recurse)
-    return;
-
-  enumerator = g_file_enumerate_children (directory,
-                                          G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK","
-                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
-                                          G_FILE_QUERY_INFO_NONE,
-                                          cancellable,
-                                          NULL);
-
-  if (!enumerator)
-    return;
-
-  while ((infoptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
     {
-      g_autoptr(GFileInfo) file_info = infoptr;
-      GFileType type = g_file_info_get_file_type (file_info);
+      child = g_file_get_child (directory, "tags");
+      if (g_file_query_file_type (child, 0, cancellable) == G_FILE_TYPE_REGULAR)
+        ide_ctags_service_load_tags (self, child);
+      g_clear_object (&child);
 
-      if (g_file_info_get_is_symlink (file_info))
-        continue;
+      child = g_file_get_child (directory, ".tags");
+      if (g_file_query_file_type (child, 0, cancellable) == G_FILE_TYPE_REGULAR)
+        ide_ctags_service_load_tags (self, child);
+      g_clear_object (&child);
 
-      if (type == G_FILE_TYPE_DIRECTORY)
-        {
-          const gchar *name = g_file_info_get_name (file_info);
-
-          child = g_file_get_child (directory, name);
-          ide_ctags_service_mine_directory (self, child, recurse, cancellable);
-          g_clear_object (&child);
-        }
+      return;
     }
 
-  g_file_enumerator_close (enumerator, cancellable, NULL);
-
-  g_object_unref (enumerator);
+  /* Tags of symlinked directories are found from their real location */
+  crawler = ide_directory_crawler_new (directory);
+  ide_directory_crawler_set_follow_symlinks (crawler, FALSE);
+  ide_directory_crawler_subscribe (crawler, ide_ctags_service_mine_cb, self, NULL);
+  ide_directory_crawler_crawl (crawler, cancellable, NULL);
 }
 
 static void
@@ -455,6 +492,11 @@ build_system_tags_cb (GObject      *object,
 
   g_assert (IDE_IS_TAGS_BUILDER (builder));
 
+  /* Only clear the progress if a newer build has not replaced it */
+  if (IDE_IS_CTAGS_BUILDER (builder) &&
+      self->progress == ide_ctags_builder_get_progress (IDE_CTAGS_BUILDER (builder)))
+    ide_ctags_service_set_progress (self, NULL);
+
   ide_ctags_service_queue_mine (self);
 }
 
@@ -482,6 +524,9 @@ restart_miner (gpointer user_data)
   else
     tags_builder = ide_ctags_builder_new (context);
 
+  if (IDE_IS_CTAGS_BUILDER (tags_builder))
+    ide_ctags_service_set_progress (self, ide_ctags_builder_get_progress (IDE_CTAGS_BUILDER (tags_builder)));
+
   ide_tags_builder_build_async (tags_builder,
                                 directory,
                                 self->needs_recursive_mine,
@@ -518,12 +563,71 @@ ide_ctags_service_queue_build_for_directory (IdeCtagsService *self,
     }
 }
 
+static void
+ide_ctags_service_update_file_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  IdeCtagsBuilder *builder = (IdeCtagsBuilder *)object;
+  g_autofree gpointer *data = user_data;
+  g_autoptr(IdeCtagsService) self = data[0];
+  g_autoptr(GFile) file = data[1];
+  g_autoptr(GFile) tags_file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *name = NULL;
+  IdeCtagsIndex *prev;
+  IdeCtagsIndex *index;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CTAGS_BUILDER (builder));
+  g_assert (IDE_IS_CTAGS_SERVICE (self));
+  g_assert (G_IS_FILE (file));
+
+  if (!(bytes = ide_ctags_builder_update_file_finish (builder, result, &tags_file, &error)))
+    {
+      g_autoptr(GFile) parent = g_file_get_parent (file);
+
+      /* Fallback to indexing the whole directory */
+      g_debug ("%s", error->message);
+      ide_ctags_service_queue_build_for_directory (self, parent);
+      IDE_EXIT;
+    }
+
+  if (!(prev = egg_task_cache_peek (self->indexes, tags_file)))
+    {
+      ide_ctags_service_load_tags (self, tags_file);
+      IDE_EXIT;
+    }
+
+  name = g_file_get_basename (file);
+  index = ide_ctags_index_splice (prev, name, bytes, get_file_mtime (tags_file));
+  g_hash_table_insert (self->spliced, g_object_ref (tags_file), index);
+
+  egg_task_cache_evict (self->indexes, tags_file);
+  egg_task_cache_get_async (self->indexes,
+                            tags_file,
+                            TRUE,
+                            self->cancellable,
+                            ide_ctags_service_tags_loaded_cb,
+                            g_object_ref (self));
+
+  IDE_EXIT;
+}
+
 static void
 ide_ctags_service_buffer_saved (IdeCtagsService  *self,
                                 IdeBuffer        *buffer,
                                 IdeBufferManager *buffer_manager)
 {
+  g_autoptr(IdeTagsBuilder) builder = NULL;
   g_autoptr(GFile) parent = NULL;
+  IdeBuildSystem *build_system;
+  IdeContext *context;
+  gpointer *data;
+  GFile *workdir;
+  GFile *file;
 
   IDE_ENTRY;
 
@@ -531,8 +635,34 @@ ide_ctags_service_buffer_saved (IdeCtagsService  *self,
   g_assert (IDE_IS_BUFFER (buffer));
   g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
 
-  parent = g_file_get_parent (ide_file_get_file (ide_buffer_get_file (buffer)));
-  ide_ctags_service_queue_build_for_directory (self, parent);
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+  workdir = ide_vcs_get_working_directory (ide_context_get_vcs (context));
+  file = ide_file_get_file (ide_buffer_get_file (buffer));
+  parent = g_file_get_parent (file);
+
+  /*
+   * Build systems that generate their own tags get the whole directory
+   * rebuilt, as do files outside of the project tree. Otherwise we only
+   * run ctags on the saved file and splice the result into the index.
+   */
+  if (IDE_IS_TAGS_BUILDER (build_system) || !g_file_has_prefix (file, workdir))
+    {
+      ide_ctags_service_queue_build_for_directory (self, parent);
+      IDE_EXIT;
+    }
+
+  builder = ide_ctags_builder_new (context);
+
+  data = g_new0 (gpointer, 2);
+  data[0] = g_object_ref (self);
+  data[1] = g_object_ref (file);
+
+  ide_ctags_builder_update_file_async (IDE_CTAGS_BUILDER (builder),
+                                       file,
+                                       self->cancellable,
+                                       ide_ctags_service_update_file_cb,
+                                       data);
 
   IDE_EXIT;
 }
@@ -599,18 +729,49 @@ ide_ctags_service_finalize (GObject *object)
   g_clear_pointer (&self->highlighters, g_ptr_array_unref);
   g_clear_pointer (&self->completions, g_ptr_array_unref);
   g_clear_pointer (&self->build_timeout_by_dir, g_hash_table_unref);
+  g_clear_pointer (&self->spliced, g_hash_table_unref);
+  g_clear_object (&self->progress);
 
   G_OBJECT_CLASS (ide_ctags_service_parent_class)->finalize (object);
 
   IDE_EXIT;
 }
 
+static void
+ide_ctags_service_get_property (GObject    *object,
+                                guint       prop_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+  IdeCtagsService *self = IDE_CTAGS_SERVICE (object);
+
+  switch (prop_id)
+    {
+    case PROP_PROGRESS:
+      g_value_set_object (value, ide_ctags_service_get_progress (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
 static void
 ide_ctags_service_class_init (IdeCtagsServiceClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->finalize = ide_ctags_service_finalize;
+  object_class->get_property = ide_ctags_service_get_property;
+
+  properties [PROP_PROGRESS] =
+    g_param_spec_object ("progress",
+                         "Progress",
+                         "The progress of indexing symbols, or NULL when not indexing.",
+                         IDE_TYPE_PROGRESS,
+                         (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
 }
 
 static void
@@ -636,6 +797,10 @@ ide_ctags_service_init (IdeCtagsService *self)
                                                       (GEqualFunc)g_file_equal,
                                                       g_object_unref, NULL);
 
+  self->spliced = g_hash_table_new_full ((GHashFunc)g_file_hash,
+                                         (GEqualFunc)g_file_equal,
+                                         g_object_unref, g_object_unref);
+
   self->indexes = egg_task_cache_new ((GHashFunc)g_file_hash,
                                       (GEqualFunc)g_file_equal,
                                       g_object_ref,
@@ -656,6 +821,22 @@ _ide_ctags_service_register_type (GTypeModule *module)
   ide_ctags_service_register_type (module);
 }
 
+/**
+ * ide_ctags_service_get_progress:
+ *
+ * Gets the #IdeProgress of the tags build that is currently running, so
+ * that the UI can show that symbols are being indexed.
+ *
+ * Returns: (transfer none) (nullable): An #IdeProgress or %NULL.
+ */
+IdeProgress *
+ide_ctags_service_get_progress (IdeCtagsService *self)
+{
+  g_return_val_if_fail (IDE_IS_CTAGS_SERVICE (self), NULL);
+
+  return self->progress;
+}
+
 /**
  * ide_ctags_service_get_indexes:
  *
@@ -40,7 +40,8 @@ void ide_ctags_service_register_completion    (IdeCtagsService            *self,
 void ide_ctags_service_unregister_completion  (IdeCtagsService            *self,
                                                IdeCtagsCompletionProvider *completion);
 
-GPtrArray *ide_ctags_service_get_indexes (IdeCtagsService *self);
+GPtrArray   *ide_ctags_service_get_indexes  (IdeCtagsService *self);
+IdeProgress *ide_ctags_service_get_progress (IdeCtagsService *self);
 
 G_END_DECLS
 
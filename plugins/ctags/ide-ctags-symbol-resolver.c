@@ -317,15 +317,15 @@ ide_ctags_symbol_resolver_lookup_symbol_async (IdeSymbolResolver   *resolver,
   for (i = 0; i < indexes->len; i++)
     {
       IdeCtagsIndex *index = g_ptr_array_index (indexes, i);
-      const IdeCtagsIndexEntry *entries;
-      gsize count;
+      g_autoptr(GArray) entries = NULL;
       gsize j;
 
-      entries = ide_ctags_index_lookup (index, keyword, &count);
+      if (!(entries = ide_ctags_index_lookup (index, keyword)))
+        continue;
 
-      for (j = 0; j < count; j++)
+      for (j = 0; j < entries->len; j++)
         {
-          const IdeCtagsIndexEntry *entry = &entries [j];
+          const IdeCtagsIndexEntry *entry = &g_array_index (entries, IdeCtagsIndexEntry, j);
           IdeCtagsIndexEntry *copy;
           LookupSymbol *lookup;
           g_autoptr(GFile) other_file = NULL;
@@ -532,7 +532,7 @@ ide_ctags_symbol_resolver_get_symbol_tree_worker (GTask        *task,
       IdeCtagsIndex *index = g_ptr_array_index (state->indexes, i);
       const gchar *base_path = ide_ctags_index_get_path_root (index);
       g_autoptr(GFile) base_dir = NULL;
-      g_autoptr(GPtrArray) entries = NULL;
+      g_autoptr(GArray) entries = NULL;
       g_autofree gchar *relative_path = NULL;
       g_autoptr(GHashTable) keymap = NULL;
       g_autoptr(GPtrArray) tmp = NULL;
@@ -561,7 +561,7 @@ ide_ctags_symbol_resolver_get_symbol_tree_worker (GTask        *task,
 
       for (guint j = 0; j < entries->len; j++)
         {
-          const IdeCtagsIndexEntry *entry = g_ptr_array_index (entries, j);
+          const IdeCtagsIndexEntry *entry = &g_array_index (entries, IdeCtagsIndexEntry, j);
           g_autoptr(IdeCtagsSymbolNode) node = NULL;
 
           switch (entry->kind)
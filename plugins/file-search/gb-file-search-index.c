@@ -29,8 +29,14 @@ struct _GbFileSearchIndex
 {
   IdeObject     parent_instance;
 
-  GFile        *root_directory;
-  Fuzzy        *fuzzy;
+  GFile           *root_directory;
+  Fuzzy           *fuzzy;
+
+  /*
+   * Remembers the matches of the previous query so that typing another
+   * character only needs to rescore those.
+   */
+  FuzzyRefinement *refinement;
 };
 
 G_DEFINE_TYPE (GbFileSearchIndex, gb_file_search_index, IDE_TYPE_OBJECT)
@@ -64,6 +70,7 @@ gb_file_search_index_finalize (GObject *object)
   GbFileSearchIndex *self = (GbFileSearchIndex *)object;
 
   g_clear_object (&self->root_directory);
+  g_clear_pointer (&self->refinement, fuzzy_refinement_free);
   g_clear_pointer (&self->fuzzy, fuzzy_unref);
 
   G_OBJECT_CLASS (gb_file_search_index_parent_class)->finalize (object);
@@ -131,84 +138,492 @@ gb_file_search_index_init (GbFileSearchIndex *self)
 {
 }
 
+/*
+ * The index is persisted to ~/.cache/gnome-builder/file-search/ so that we
+ * do not need to crawl the whole tree every time the project is opened. The
+ * file is named after the project id and a checksum of the root directory,
+ * since several checkouts of a project share the same id. Along with the serialized Fuzzy index, we store a record for every
+ * directory containing its modification time, the ignore stamp of the VCS
+ * and the names of the files and directories it contained that were not
+ * ignored. When loading, only directories whose mtime or ignore rules have
+ * changed need to be enumerated again; everything else is a single stat().
+ */
+#define INDEX_CACHE_VERSION 2
+#define INDEX_CACHE_TYPE    "(ua(sxtasas)v)"
+#define INDEX_DIR_ATTRIBUTES \
+  G_FILE_ATTRIBUTE_ID_FILE"," \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED"," \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+typedef struct
+{
+  GFile *directory;
+  gchar *cache_path;
+} BuildTaskData;
+
+typedef struct
+{
+  IdeVcs          *vcs;
+  GCancellable    *cancellable;
+  GHashTable      *cached_dirs;
+  GPtrArray       *inserted;
+  GPtrArray       *removed;
+  GVariantBuilder  dirs;
+  guint            changed : 1;
+} IndexBuild;
+
+/*
+ * The directories from the root down to the one being updated, used to
+ * stop at symlinks that lead back into one of them.
+ */
+typedef struct _IndexBuildAncestor
+{
+  const struct _IndexBuildAncestor *parent;
+  const gchar                      *id;
+} IndexBuildAncestor;
+
 static void
-populate_from_dir (Fuzzy        *fuzzy,
-                   IdeVcs       *vcs,
-                   const gchar  *relpath,
-                   GFile        *directory,
-                   GCancellable *cancellable)
+build_task_data_free (gpointer data)
 {
-  GFileEnumerator *enumerator;
-  GPtrArray *children = NULL;
-  gpointer file_info_ptr;
+  BuildTaskData *task_data = data;
 
-  g_assert (fuzzy != NULL);
-  g_assert (G_IS_FILE (directory));
-  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+  g_clear_object (&task_data->directory);
+  g_clear_pointer (&task_data->cache_path, g_free);
+  g_slice_free (BuildTaskData, task_data);
+}
+
+static gchar *
+join_relpath (const gchar *relpath,
+              const gchar *name)
+{
+  if (*relpath == '\0')
+    return g_strdup (name);
+  return g_build_filename (relpath, name, NULL);
+}
+
+static gint64
+get_mtime (GFileInfo *file_info)
+{
+  return (g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC) +
+         g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static void
+index_build_remove_dir (IndexBuild  *build,
+                        const gchar *relpath)
+{
+  g_autofree const gchar **files = NULL;
+  g_autofree const gchar **subdirs = NULL;
+  GVariant *record;
+  guint i;
 
-  if (ide_vcs_is_ignored (vcs, directory, NULL))
+  g_assert (build != NULL);
+  g_assert (relpath != NULL);
+
+  build->changed = TRUE;
+
+  if (NULL == (record = g_hash_table_lookup (build->cached_dirs, relpath)))
     return;
 
-  enumerator = g_file_enumerate_children (directory,
-                                          G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
-                                          G_FILE_QUERY_INFO_NONE,
-                                          cancellable,
-                                          NULL);
+  g_variant_get (record, "(&sxt^a&s^a&s)", NULL, NULL, NULL, &files, &subdirs);
+
+  for (i = 0; files [i] != NULL; i++)
+    g_ptr_array_add (build->removed, join_relpath (relpath, files [i]));
+
+  for (i = 0; subdirs [i] != NULL; i++)
+    {
+      g_autofree gchar *path = join_relpath (relpath, subdirs [i]);
+
+      index_build_remove_dir (build, path);
+    }
+}
+
+static GFileInfo *
+index_build_info_new (const gchar *name,
+                      GFileType    file_type)
+{
+  GFileInfo *info = g_file_info_new ();
+
+  g_file_info_set_name (info, name);
+  g_file_info_set_display_name (info, name);
+  g_file_info_set_file_type (info, file_type);
+
+  return info;
+}
+
+/*
+ * Listings do not follow symlinks so that most types come from the
+ * directory entry. Give symlinks the type of their target instead,
+ * dropping those that are dangling.
+ */
+static void
+index_build_resolve_symlinks (IndexBuild *build,
+                              GFile      *directory,
+                              GPtrArray  *infos)
+{
+  g_assert (build != NULL);
+  g_assert (G_IS_FILE (directory));
+  g_assert (infos != NULL);
+
+  for (guint i = infos->len; i > 0; i--)
+    {
+      GFileInfo *file_info = g_ptr_array_index (infos, i - 1);
+      g_autoptr(GFile) child = NULL;
+      GFileType file_type;
+
+      if (g_file_info_get_file_type (file_info) != G_FILE_TYPE_SYMBOLIC_LINK)
+        continue;
+
+      child = g_file_get_child (directory, g_file_info_get_name (file_info));
+      file_type = g_file_query_file_type (child, G_FILE_QUERY_INFO_NONE, build->cancellable);
+
+      if (file_type == G_FILE_TYPE_UNKNOWN)
+        g_ptr_array_remove_index (infos, i - 1);
+      else
+        g_file_info_set_file_type (file_info, file_type);
+    }
+}
+
+static void
+index_build_update_dir (IndexBuild               *build,
+                        const IndexBuildAncestor *ancestors,
+                        const gchar              *relpath,
+                        GFile                    *directory)
+{
+  IndexBuildAncestor self_ancestor;
+  const gchar *id;
+  g_autoptr(GFileInfo) dir_info = NULL;
+  g_autoptr(GPtrArray) infos = NULL;
+  g_autoptr(GPtrArray) files = NULL;
+  g_autoptr(GPtrArray) subdirs = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  g_autofree gboolean *ignored = NULL;
+  g_autofree const gchar **cached_files = NULL;
+  g_autofree const gchar **cached_subdirs = NULL;
+  GVariant *record;
+  gint64 mtime;
+  gint64 cached_mtime = 0;
+  guint64 ignore_stamp;
+  guint64 cached_ignore_stamp = 0;
+  guint i;
+
+  g_assert (build != NULL);
+  g_assert (relpath != NULL);
+  g_assert (G_IS_FILE (directory));
 
-  if (enumerator == NULL)
+  if (g_cancellable_is_cancelled (build->cancellable))
     return;
 
-  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+  record = g_hash_table_lookup (build->cached_dirs, relpath);
+
+  dir_info = g_file_query_info (directory,
+                                INDEX_DIR_ATTRIBUTES,
+                                G_FILE_QUERY_INFO_NONE,
+                                build->cancellable,
+                                NULL);
+
+  if (dir_info == NULL)
     {
-      g_autoptr(GFileInfo) file_info = file_info_ptr;
-      g_autofree gchar *path = NULL;
-      g_autoptr(GFile) file = NULL;
-      const gchar *name;
+      if (record != NULL)
+        index_build_remove_dir (build, relpath);
+      return;
+    }
 
-      name = g_file_info_get_display_name (file_info);
-      file = g_file_get_child (directory, name);
+  /* Symlinked directories that loop back are not indexed again */
+  id = g_file_info_get_attribute_string (dir_info, G_FILE_ATTRIBUTE_ID_FILE);
 
-      if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY)
+  for (const IndexBuildAncestor *iter = ancestors; iter != NULL && id != NULL; iter = iter->parent)
+    {
+      if (g_strcmp0 (iter->id, id) == 0)
         {
-          if (children == NULL)
-            children = g_ptr_array_new_with_free_func (g_object_unref);
-          g_ptr_array_add (children, g_object_ref (file));
-          continue;
+          if (record != NULL)
+            index_build_remove_dir (build, relpath);
+          return;
         }
+    }
+
+  self_ancestor.parent = ancestors;
+  self_ancestor.id = id;
+
+  mtime = get_mtime (dir_info);
+  infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+  /* Taken before filtering so that a racing change is seen next time */
+  ignore_stamp = ide_vcs_get_ignore_stamp (build->vcs, directory);
+
+  if (record != NULL)
+    g_variant_get (record, "(&sxt^a&s^a&s)",
+                   NULL, &cached_mtime, &cached_ignore_stamp, &cached_files, &cached_subdirs);
+
+  if (record != NULL && cached_mtime == mtime && cached_ignore_stamp == ignore_stamp)
+    {
+      /*
+       * Nothing was added or removed directly within this directory, and
+       * the rules that filtered the previous listing are the same, so we
+       * can reuse it. Subdirectories still need to be checked since their
+       * changes do not propagate to our mtime.
+       */
+      for (i = 0; cached_files [i] != NULL; i++)
+        g_ptr_array_add (infos, index_build_info_new (cached_files [i], G_FILE_TYPE_REGULAR));
+
+      for (i = 0; cached_subdirs [i] != NULL; i++)
+        g_ptr_array_add (infos, index_build_info_new (cached_subdirs [i], G_FILE_TYPE_DIRECTORY));
+    }
+  else
+    {
+      g_autoptr(GFileEnumerator) enumerator = NULL;
+      gpointer file_info_ptr;
+
+      build->changed = TRUE;
+
+      enumerator = g_file_enumerate_children (directory,
+                                              G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                              G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
+                                              G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                              build->cancellable,
+                                              NULL);
+
+      if (enumerator == NULL)
+        {
+          if (record != NULL)
+            index_build_remove_dir (build, relpath);
+          return;
+        }
+
+      while ((file_info_ptr = g_file_enumerator_next_file (enumerator, build->cancellable, NULL)))
+        g_ptr_array_add (infos, file_info_ptr);
+
+      index_build_resolve_symlinks (build, directory, infos);
+    }
+
+  /*
+   * Filter the whole listing at once. A reused listing is checked as well,
+   * in case the VCS does not provide an ignore stamp.
+   */
+  ignored = g_new0 (gboolean, infos->len + 1);
+  ide_vcs_is_ignored_batch (build->vcs, directory, infos, ignored, NULL);
+
+  files = g_ptr_array_new_with_free_func (g_free);
+  subdirs = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < infos->len; i++)
+    {
+      GFileInfo *file_info = g_ptr_array_index (infos, i);
+      const gchar *name = g_file_info_get_display_name (file_info);
 
-      if (ide_vcs_is_ignored (vcs, file, NULL))
+      if (ignored [i])
         continue;
 
-      if (relpath != NULL)
-        name = path = g_build_filename (relpath, name, NULL);
+      if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY)
+        g_ptr_array_add (subdirs, g_strdup (name));
+      else
+        g_ptr_array_add (files, g_strdup (name));
+    }
+
+  /*
+   * Diff against the previous listing (if any) so that we only touch
+   * the entries in the index that actually changed.
+   */
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
 
-      fuzzy_insert (fuzzy, name, NULL);
+  for (i = 0; i < files->len; i++)
+    g_hash_table_add (seen, g_ptr_array_index (files, i));
+
+  if (record != NULL)
+    {
+      for (i = 0; cached_files [i] != NULL; i++)
+        {
+          if (!g_hash_table_remove (seen, cached_files [i]))
+            {
+              g_ptr_array_add (build->removed, join_relpath (relpath, cached_files [i]));
+              build->changed = TRUE;
+            }
+        }
     }
 
-  g_clear_object (&enumerator);
+  for (i = 0; i < files->len; i++)
+    {
+      const gchar *name = g_ptr_array_index (files, i);
+
+      if (g_hash_table_contains (seen, name))
+        {
+          g_ptr_array_add (build->inserted, join_relpath (relpath, name));
+          build->changed = TRUE;
+        }
+    }
 
-  if (children != NULL)
+  if (record != NULL)
     {
-      gsize i;
+      g_hash_table_remove_all (seen);
+
+      for (i = 0; i < subdirs->len; i++)
+        g_hash_table_add (seen, g_ptr_array_index (subdirs, i));
 
-      for (i = 0; i < children->len; i++)
+      for (i = 0; cached_subdirs [i] != NULL; i++)
         {
-          g_autofree gchar *path = NULL;
-          g_autofree gchar *name = NULL;
-          GFile *child;
+          if (!g_hash_table_contains (seen, cached_subdirs [i]))
+            {
+              g_autofree gchar *path = join_relpath (relpath, cached_subdirs [i]);
+
+              index_build_remove_dir (build, path);
+            }
+        }
+    }
+
+  g_ptr_array_add (files, NULL);
+  g_ptr_array_add (subdirs, NULL);
 
-          child = g_ptr_array_index (children, i);
-          name = g_file_get_basename (child);
+  g_variant_builder_add (&build->dirs,
+                         "(sxt^as^as)",
+                         relpath,
+                         mtime,
+                         ignore_stamp,
+                         (const gchar * const *)files->pdata,
+                         (const gchar * const *)subdirs->pdata);
 
-          if (relpath != NULL)
-            path = g_build_filename (relpath, name, NULL);
+  for (i = 0; i < subdirs->len - 1; i++)
+    {
+      const gchar *name = g_ptr_array_index (subdirs, i);
+      g_autofree gchar *path = join_relpath (relpath, name);
+      g_autoptr(GFile) child = g_file_get_child (directory, name);
 
-          populate_from_dir (fuzzy, vcs, path ? path : name, child, cancellable);
+      index_build_update_dir (build, &self_ancestor, path, child);
+    }
+}
+
+static void
+index_build_crawl_cb (IdeDirectoryCrawler *crawler,
+                      GFile               *directory,
+                      const gchar         *relative_path,
+                      GFileInfo           *directory_info,
+                      GPtrArray           *children,
+                      gpointer             user_data)
+{
+  IndexBuild *build = user_data;
+  g_autoptr(GPtrArray) files = NULL;
+  g_autoptr(GPtrArray) subdirs = NULL;
+  guint i;
+
+  g_assert (IDE_IS_DIRECTORY_CRAWLER (crawler));
+  g_assert (G_IS_FILE (directory));
+  g_assert (relative_path != NULL);
+  g_assert (G_IS_FILE_INFO (directory_info));
+  g_assert (children != NULL);
+  g_assert (build != NULL);
+
+  files = g_ptr_array_new ();
+  subdirs = g_ptr_array_new ();
+
+  for (i = 0; i < children->len; i++)
+    {
+      GFileInfo *file_info = g_ptr_array_index (children, i);
+      const gchar *name = g_file_info_get_display_name (file_info);
+      GFileType file_type = g_file_info_get_file_type (file_info);
+
+      if (file_type == G_FILE_TYPE_DIRECTORY)
+        {
+          g_ptr_array_add (subdirs, (gchar *)name);
+          continue;
         }
+
+      /* Dangling symlinks, or symlinks the crawler did not enter to avoid a loop */
+      if (file_type == G_FILE_TYPE_SYMBOLIC_LINK)
+        continue;
+
+      g_ptr_array_add (files, (gchar *)name);
+      g_ptr_array_add (build->inserted, join_relpath (relative_path, name));
     }
 
-  g_clear_pointer (&children, g_ptr_array_unref);
+  g_ptr_array_add (files, NULL);
+  g_ptr_array_add (subdirs, NULL);
+
+  /*
+   * The mtime of @directory_info was queried when the parent directory
+   * was enumerated, before @directory itself was enumerated, so any
+   * change racing with the crawl will be picked up on the next load.
+   */
+  g_variant_builder_add (&build->dirs,
+                         "(sxt^as^as)",
+                         relative_path,
+                         get_mtime (directory_info),
+                         ide_vcs_get_ignore_stamp (build->vcs, directory),
+                         (const gchar * const *)files->pdata,
+                         (const gchar * const *)subdirs->pdata);
+}
+
+static Fuzzy *
+gb_file_search_index_load (const gchar *cache_path,
+                           GHashTable  *cached_dirs)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GVariant) dirs = NULL;
+  g_autoptr(GVariant) fuzzy_variant = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  GVariantIter iter;
+  GVariant *record;
+  Fuzzy *fuzzy;
+  guint32 version = 0;
+
+  g_assert (cache_path != NULL);
+  g_assert (cached_dirs != NULL);
+
+  if (NULL == (mapped = g_mapped_file_new (cache_path, FALSE, NULL)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (INDEX_CACHE_TYPE), bytes, FALSE);
+  g_variant_ref_sink (variant);
+
+  g_variant_get (variant, "(u@a(sxtasas)v)", &version, &dirs, &fuzzy_variant);
+
+  if (version != INDEX_CACHE_VERSION)
+    return NULL;
+
+  if (NULL == (fuzzy = fuzzy_new_from_variant (fuzzy_variant)))
+    return NULL;
+
+  /* The keys are owned by the records, which are owned by the table. */
+  g_variant_iter_init (&iter, dirs);
+  while ((record = g_variant_iter_next_value (&iter)))
+    {
+      const gchar *relpath = NULL;
+
+      g_variant_get_child (record, 0, "&s", &relpath);
+      g_hash_table_insert (cached_dirs, (gchar *)relpath, record);
+    }
+
+  return fuzzy;
+}
+
+static void
+gb_file_search_index_save (const gchar *cache_path,
+                           Fuzzy       *fuzzy,
+                           GVariant    *dirs)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *cache_dir = NULL;
+
+  g_assert (cache_path != NULL);
+  g_assert (fuzzy != NULL);
+  g_assert (dirs != NULL);
+
+  variant = g_variant_new ("(u@a(sxtasas)v)",
+                           INDEX_CACHE_VERSION,
+                           dirs,
+                           fuzzy_to_variant (fuzzy));
+  g_variant_ref_sink (variant);
+
+  cache_dir = g_path_get_dirname (cache_path);
+  g_mkdir_with_parents (cache_dir, 0750);
+
+  if (!g_file_set_contents (cache_path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    g_warning ("Failed to save file index: %s", error->message);
 }
 
 static void
@@ -218,36 +633,100 @@ gb_file_search_index_builder (GTask        *task,
                               GCancellable *cancellable)
 {
   GbFileSearchIndex *self = source_object;
+  BuildTaskData *data = task_data;
   g_autoptr(GTimer) timer = NULL;
-  GFile *directory = task_data;
+  g_autoptr(GVariant) dirs = NULL;
+  IndexBuild build = { 0 };
   IdeContext *context;
-  IdeVcs *vcs;
   Fuzzy *fuzzy;
   gdouble elapsed;
+  guint i;
 
   g_assert (G_IS_TASK (task));
   g_assert (GB_IS_FILE_SEARCH_INDEX (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
-  g_assert (G_IS_FILE (directory));
+  g_assert (data != NULL);
+  g_assert (G_IS_FILE (data->directory));
 
   context = ide_object_get_context (IDE_OBJECT (self));
-  vcs = ide_context_get_vcs (context);
 
   timer = g_timer_new ();
 
-  fuzzy = fuzzy_new (FALSE);
-  fuzzy_begin_bulk_insert (fuzzy);
-  populate_from_dir (fuzzy, vcs, NULL, directory, cancellable);
-  fuzzy_end_bulk_insert (fuzzy);
+  build.vcs = ide_context_get_vcs (context);
+  build.cancellable = cancellable;
+  build.cached_dirs = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             NULL,
+                                             (GDestroyNotify)g_variant_unref);
+  build.inserted = g_ptr_array_new_with_free_func (g_free);
+  build.removed = g_ptr_array_new_with_free_func (g_free);
+  g_variant_builder_init (&build.dirs, G_VARIANT_TYPE ("a(sxtasas)"));
+
+  fuzzy = gb_file_search_index_load (data->cache_path, build.cached_dirs);
+
+  if (fuzzy == NULL)
+    {
+      g_autoptr(IdeDirectoryCrawler) crawler = NULL;
+
+      /*
+       * Nothing to start from, so crawl the whole tree in parallel. The
+       * crawler takes care of filtering ignored files for us.
+       */
+      g_hash_table_remove_all (build.cached_dirs);
+      fuzzy = fuzzy_new (FALSE);
+      build.changed = TRUE;
+
+      crawler = ide_directory_crawler_new (data->directory);
+      ide_directory_crawler_set_vcs (crawler, build.vcs);
+      ide_directory_crawler_set_attributes (crawler,
+                                            G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
+                                            INDEX_DIR_ATTRIBUTES);
+      ide_directory_crawler_subscribe (crawler, index_build_crawl_cb, &build, NULL);
+      ide_directory_crawler_crawl (crawler, cancellable, NULL);
+    }
+  else
+    {
+      index_build_update_dir (&build, NULL, "", data->directory);
+    }
+
+  dirs = g_variant_ref_sink (g_variant_builder_end (&build.dirs));
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      fuzzy_unref (fuzzy);
+      goto cleanup;
+    }
+
+  /* Tombstone every removed path in a single pass over the index */
+  fuzzy_remove_many (fuzzy,
+                     (const gchar * const *)build.removed->pdata,
+                     build.removed->len);
+
+  if (build.inserted->len > 0)
+    {
+      fuzzy_begin_bulk_insert (fuzzy);
+      for (i = 0; i < build.inserted->len; i++)
+        fuzzy_insert (fuzzy, g_ptr_array_index (build.inserted, i), NULL);
+      fuzzy_end_bulk_insert (fuzzy);
+    }
+
+  if (build.changed)
+    gb_file_search_index_save (data->cache_path, fuzzy, dirs);
 
   self->fuzzy = fuzzy;
 
   g_timer_stop (timer);
   elapsed = g_timer_elapsed (timer, NULL);
 
-  g_message ("File index built in %lf seconds.", elapsed);
+  g_message ("File index built in %lf seconds (%u added, %u removed).",
+             elapsed, build.inserted->len, build.removed->len);
 
   g_task_return_boolean (task, TRUE);
+
+cleanup:
+  g_clear_pointer (&build.cached_dirs, g_hash_table_unref);
+  g_clear_pointer (&build.inserted, g_ptr_array_unref);
+  g_clear_pointer (&build.removed, g_ptr_array_unref);
 }
 
 void
@@ -257,6 +736,12 @@ gb_file_search_index_build_async (GbFileSearchIndex   *self,
                                   gpointer             user_data)
 {
   g_autoptr(GTask) task = NULL;
+  g_autofree gchar *root_uri = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *name = NULL;
+  BuildTaskData *task_data;
+  IdeContext *context;
+  const gchar *project_id;
 
   g_return_if_fail (GB_IS_FILE_SEARCH_INDEX (self));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
@@ -272,7 +757,21 @@ gb_file_search_index_build_async (GbFileSearchIndex   *self,
       return;
     }
 
-  g_task_set_task_data (task, g_object_ref (self->root_directory), g_object_unref);
+  context = ide_object_get_context (IDE_OBJECT (self));
+  project_id = ide_project_get_id (ide_context_get_project (context));
+  root_uri = g_file_get_uri (self->root_directory);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, root_uri, -1);
+  name = g_strdup_printf ("%s-%s", project_id, checksum);
+
+  task_data = g_slice_new0 (BuildTaskData);
+  task_data->directory = g_object_ref (self->root_directory);
+  task_data->cache_path = g_build_filename (g_get_user_cache_dir (),
+                                            ide_get_program_name (),
+                                            "file-search",
+                                            name,
+                                            NULL);
+
+  g_task_set_task_data (task, task_data, build_task_data_free);
   g_task_run_in_thread (task, gb_file_search_index_builder);
 }
 
@@ -326,7 +825,14 @@ gb_file_search_index_populate (GbFileSearchIndex *self,
         g_string_append_unichar (delimited, ch);
     }
 
-  ar = fuzzy_match (self->fuzzy, delimited->str, max_matches);
+  if (self->refinement == NULL ||
+      fuzzy_refinement_get_fuzzy (self->refinement) != self->fuzzy)
+    {
+      g_clear_pointer (&self->refinement, fuzzy_refinement_free);
+      self->refinement = fuzzy_refinement_new (self->fuzzy);
+    }
+
+  ar = fuzzy_refinement_match (self->refinement, delimited->str, max_matches);
 
   for (i = 0; i < ar->len; i++)
     {
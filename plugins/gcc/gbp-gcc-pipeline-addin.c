@@ -20,13 +20,6 @@
 
 #include "gbp-gcc-pipeline-addin.h"
 
-#define ERROR_FORMAT_REGEX              \
-  "(?<filename>[a-zA-Z0-9\\-\\.\\/]+):" \
-  "(?<line>\\d+):"                      \
-  "(?<column>\\d+): "                   \
-  "(?<level>[\\w\\s]+): "               \
-  "(?<message>.*)"
-
 struct _GbpGccPipelineAddin
 {
   IdeObject parent_instance;
@@ -43,7 +36,7 @@ gbp_gcc_pipeline_addin_load (IdeBuildPipelineAddin *addin,
   g_assert (IDE_IS_BUILD_PIPELINE (pipeline));
 
   self->error_format_id = ide_build_pipeline_add_error_format (pipeline,
-                                                               ERROR_FORMAT_REGEX,
+                                                               IDE_BUILD_ERROR_FORMAT_GCC,
                                                                G_REGEX_CASELESS);
 }
 
@@ -24,6 +24,7 @@
 #include <libgit2-glib/ggit.h>
 
 #include "ide-git-buffer-change-monitor.h"
+#include "ide-git-line-state.h"
 #include "ide-git-vcs.h"
 
 /**
@@ -41,6 +42,10 @@
  * Upon completion of the diff, the results will be passed back to the primary thread and the
  * state updated for use by line change renderer in the source view.
  *
+ * The state is stored as one byte per line so that lookups from the gutter are cheap. Edits to
+ * the buffer shift the state immediately, marking touched lines as changed and new lines as
+ * added, so that the gutter stays close to correct until the next diff completes.
+ *
  * TODO: Move the thread work into ide_thread_pool?
  */
 
@@ -54,7 +59,7 @@ struct _IdeGitBufferChangeMonitor
   IdeBuffer              *buffer;
 
   GgitRepository         *repository;
-  GHashTable             *state;
+  GByteArray             *state;
 
   GgitBlob               *cached_blob;
 
@@ -62,18 +67,17 @@ struct _IdeGitBufferChangeMonitor
 
   guint                   state_dirty : 1;
   guint                   in_calculation : 1;
-  guint                   delete_range_requires_recalculation : 1;
   guint                   is_child_of_workdir : 1;
 };
 
 typedef struct
 {
-  GgitRepository *repository;
-  GHashTable     *state;
-  GFile          *file;
-  GBytes         *content;
-  GgitBlob       *blob;
-  guint           is_child_of_workdir : 1;
+  GgitRepository    *repository;
+  GByteArray        *state;
+  GFile             *file;
+  IdeBufferSnapshot *snapshot;
+  GgitBlob          *blob;
+  guint              is_child_of_workdir : 1;
 } DiffTask;
 
 G_DEFINE_TYPE (IdeGitBufferChangeMonitor,
@@ -103,12 +107,12 @@ diff_task_free (gpointer data)
       g_clear_object (&diff->file);
       g_clear_object (&diff->blob);
       g_clear_object (&diff->repository);
-      g_clear_pointer (&diff->state, g_hash_table_unref);
-      g_clear_pointer (&diff->content, g_bytes_unref);
+      g_clear_pointer (&diff->state, g_byte_array_unref);
+      g_clear_pointer (&diff->snapshot, ide_buffer_snapshot_unref);
     }
 }
 
-static GHashTable *
+static GByteArray *
 ide_git_buffer_change_monitor_calculate_finish (IdeGitBufferChangeMonitor  *self,
                                                 GAsyncResult               *result,
                                                 GError                    **error)
@@ -166,8 +170,8 @@ ide_git_buffer_change_monitor_calculate_async (IdeGitBufferChangeMonitor *self,
   diff = g_slice_new0 (DiffTask);
   diff->file = g_object_ref (gfile);
   diff->repository = g_object_ref (self->repository);
-  diff->state = g_hash_table_new (g_direct_hash, g_direct_equal);
-  diff->content = ide_buffer_get_content (self->buffer);
+  diff->state = g_byte_array_new ();
+  diff->snapshot = ide_buffer_get_snapshot (self->buffer);
   diff->blob = self->cached_blob ? g_object_ref (self->cached_blob) : NULL;
 
   g_task_set_task_data (task, diff, diff_task_free);
@@ -182,8 +186,7 @@ ide_git_buffer_change_monitor_get_change (IdeBufferChangeMonitor *monitor,
                                           const GtkTextIter      *iter)
 {
   IdeGitBufferChangeMonitor *self = (IdeGitBufferChangeMonitor *)monitor;
-  gpointer key;
-  gpointer value;
+  guint line;
 
   g_return_val_if_fail (IDE_IS_GIT_BUFFER_CHANGE_MONITOR (self), IDE_BUFFER_LINE_CHANGE_NONE);
   g_return_val_if_fail (iter, IDE_BUFFER_LINE_CHANGE_NONE);
@@ -198,10 +201,12 @@ ide_git_buffer_change_monitor_get_change (IdeBufferChangeMonitor *monitor,
       return IDE_BUFFER_LINE_CHANGE_NONE;
     }
 
-  key = GINT_TO_POINTER (gtk_text_iter_get_line (iter) + 1);
-  value = g_hash_table_lookup (self->state, key);
+  line = gtk_text_iter_get_line (iter);
+
+  if (line < self->state->len)
+    return self->state->data [line];
 
-  return GPOINTER_TO_INT (value);
+  return IDE_BUFFER_LINE_CHANGE_NONE;
 }
 
 static void
@@ -220,13 +225,15 @@ ide_git_buffer_change_monitor__calculate_cb (GObject      *object,
                                              gpointer      user_data_unused)
 {
   IdeGitBufferChangeMonitor *self = (IdeGitBufferChangeMonitor *)object;
-  g_autoptr(GHashTable) ret = NULL;
+  g_autoptr(GByteArray) ret = NULL;
   g_autoptr(GError) error = NULL;
+  DiffTask *diff;
 
   g_assert (IDE_IS_GIT_BUFFER_CHANGE_MONITOR (self));
 
   self->in_calculation = FALSE;
 
+  diff = g_task_get_task_data (G_TASK (result));
   ret = ide_git_buffer_change_monitor_calculate_finish (self, result, &error);
 
   if (!ret)
@@ -234,10 +241,17 @@ ide_git_buffer_change_monitor__calculate_cb (GObject      *object,
       if (!g_error_matches (error, GGIT_ERROR, GGIT_ERROR_NOTFOUND))
         g_message ("%s", error->message);
     }
-  else
+  else if (self->state == NULL ||
+           (self->buffer != NULL &&
+            ide_buffer_snapshot_get_change_count (diff->snapshot) == ide_buffer_get_change_count (self->buffer)))
     {
-      g_clear_pointer (&self->state, g_hash_table_unref);
-      self->state = g_hash_table_ref (ret);
+      /*
+       * Only replace the state if the buffer has not changed since the snapshot was taken.
+       * Otherwise the lines will not match up, and the state we shifted as the buffer was
+       * edited is closer to correct until the next diff completes.
+       */
+      g_clear_pointer (&self->state, g_byte_array_unref);
+      self->state = g_byte_array_ref (ret);
     }
 
   ide_buffer_change_monitor_emit_changed (IDE_BUFFER_CHANGE_MONITOR (self));
@@ -268,35 +282,14 @@ ide_git_buffer_change_monitor_recalculate (IdeGitBufferChangeMonitor *self)
                                                  NULL);
 }
 
-static void
-ide_git_buffer_change_monitor__buffer_delete_range_after_cb (IdeGitBufferChangeMonitor *self,
-                                                             GtkTextIter               *begin,
-                                                             GtkTextIter               *end,
-                                                             IdeBuffer                 *buffer)
-{
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_GIT_BUFFER_CHANGE_MONITOR (self));
-  g_assert (begin);
-  g_assert (end);
-  g_assert (IDE_IS_BUFFER (buffer));
-
-  if (self->delete_range_requires_recalculation)
-    {
-      self->delete_range_requires_recalculation = FALSE;
-      ide_git_buffer_change_monitor_recalculate (self);
-    }
-
-  IDE_EXIT;
-}
-
 static void
 ide_git_buffer_change_monitor__buffer_delete_range_cb (IdeGitBufferChangeMonitor *self,
                                                        GtkTextIter               *begin,
                                                        GtkTextIter               *end,
                                                        IdeBuffer                 *buffer)
 {
-  IdeBufferLineChange change;
+  guint begin_line;
+  guint end_line;
 
   IDE_ENTRY;
 
@@ -306,31 +299,21 @@ ide_git_buffer_change_monitor__buffer_delete_range_cb (IdeGitBufferChangeMonitor
   g_assert (IDE_IS_BUFFER (buffer));
 
   /*
-   * We need to recalculate the diff when text is deleted if:
-   *
-   * 1) The range includes a newline.
-   * 2) The current line change is set to NONE.
-   *
-   * Technically we need to do it on every change to be more correct, but that wastes a lot of
-   * power. So instead, we'll be a bit lazy about it here and pick up the other changes on a much
-   * more conservative timeout, generated by ide_git_buffer_change_monitor__buffer_changed_cb().
+   * Shift the state to account for the removed lines right away, and mark the line containing
+   * the deletion as changed. The next diff, which is queued from
+   * ide_git_buffer_change_monitor__buffer_changed_after_cb(), will correct any inaccuracies.
    */
 
-  if (gtk_text_iter_get_line (begin) != gtk_text_iter_get_line (end))
-    IDE_GOTO (recalculate);
+  if (self->state == NULL)
+    IDE_EXIT;
 
-  change = ide_git_buffer_change_monitor_get_change (IDE_BUFFER_CHANGE_MONITOR (self), begin);
-  if (change == IDE_BUFFER_LINE_CHANGE_NONE)
-    IDE_GOTO (recalculate);
+  begin_line = gtk_text_iter_get_line (begin);
+  end_line = gtk_text_iter_get_line (end);
 
-  IDE_EXIT;
+  if (end_line > begin_line)
+    ide_git_line_state_remove_lines (self->state, begin_line + 1, end_line - begin_line);
 
-recalculate:
-  /*
-   * We need to wait for the delete to occur, so mark it as necessary and let
-   * ide_git_buffer_change_monitor__buffer_delete_range_after_cb perform the operation.
-   */
-  self->delete_range_requires_recalculation = TRUE;
+  ide_git_line_state_mark_changed (self->state, begin_line);
 
   IDE_EXIT;
 }
@@ -342,7 +325,9 @@ ide_git_buffer_change_monitor__buffer_insert_text_after_cb (IdeGitBufferChangeMo
                                                             gint                       len,
                                                             IdeBuffer                 *buffer)
 {
-  IdeBufferLineChange change;
+  guint begin_line;
+  guint end_line;
+  guint n_lines;
 
   IDE_ENTRY;
 
@@ -352,27 +337,27 @@ ide_git_buffer_change_monitor__buffer_insert_text_after_cb (IdeGitBufferChangeMo
   g_assert (IDE_IS_BUFFER (buffer));
 
   /*
-   * We need to recalculate the diff when text is inserted if:
-   *
-   * 1) A newline is included in the text.
-   * 2) The line currently has flags of NONE.
-   *
-   * Technically we need to do it on every change to be more correct, but that wastes a lot of
-   * power. So instead, we'll be a bit lazy about it here and pick up the other changes on a much
-   * more conservative timeout, generated by ide_git_buffer_change_monitor__buffer_changed_cb().
+   * As with deletions, shift the state right away so the gutter does not lag behind the
+   * buffer. Any lines that were inserted are marked as added, and the line the text was
+   * inserted into is marked as changed.
    */
 
-  if (NULL != memmem (text, len, "\n", 1))
-    IDE_GOTO (recalculate);
+  if (self->state == NULL)
+    IDE_EXIT;
 
-  change = ide_git_buffer_change_monitor_get_change (IDE_BUFFER_CHANGE_MONITOR (self), location);
-  if (change == IDE_BUFFER_LINE_CHANGE_NONE)
-    IDE_GOTO (recalculate);
+  /*
+   * @location now points past the inserted text, so work back to the line it was inserted
+   * at. A line remembered before the default handler could be stale by now, as other
+   * handlers may have edited the buffer in between.
+   */
+  end_line = gtk_text_iter_get_line (location);
+  n_lines = MIN (end_line, ide_git_line_state_count_lines (text, len));
+  begin_line = end_line - n_lines;
 
-  IDE_EXIT;
+  if (n_lines > 0)
+    ide_git_line_state_insert_lines (self->state, begin_line + 1, n_lines);
 
-recalculate:
-  ide_git_buffer_change_monitor_recalculate (self);
+  ide_git_line_state_mark_changed (self->state, begin_line);
 
   IDE_EXIT;
 }
@@ -471,6 +456,29 @@ ide_git_buffer_change_monitor_set_buffer (IdeBufferChangeMonitor *monitor,
   IDE_EXIT;
 }
 
+static void
+diff_state_set (GByteArray          *state,
+                gint                 lineno,
+                IdeBufferLineChange  change)
+{
+  guint line;
+
+  g_assert (state != NULL);
+
+  /* Line numbers from the diff are 1-based */
+  if (lineno < 1)
+    return;
+
+  line = lineno - 1;
+
+  ide_git_line_state_grow (state, line + 1);
+
+  if (state->data [line] != IDE_BUFFER_LINE_CHANGE_NONE)
+    state->data [line] = IDE_BUFFER_LINE_CHANGE_CHANGED;
+  else
+    state->data [line] = change;
+}
+
 static gint
 diff_line_cb (GgitDiffDelta *delta,
               GgitDiffHunk  *hunk,
@@ -478,7 +486,7 @@ diff_line_cb (GgitDiffDelta *delta,
               gpointer       user_data)
 {
   GgitDiffLineType type;
-  GHashTable *hash = user_data;
+  GByteArray *state = user_data;
   gint new_lineno;
   gint old_lineno;
   gint adjust;
@@ -486,7 +494,7 @@ diff_line_cb (GgitDiffDelta *delta,
   g_return_val_if_fail (delta, GGIT_ERROR_GIT_ERROR);
   g_return_val_if_fail (hunk, GGIT_ERROR_GIT_ERROR);
   g_return_val_if_fail (line, GGIT_ERROR_GIT_ERROR);
-  g_return_val_if_fail (hash, GGIT_ERROR_GIT_ERROR);
+  g_return_val_if_fail (state, GGIT_ERROR_GIT_ERROR);
 
   type = ggit_diff_line_get_origin (line);
 
@@ -499,27 +507,13 @@ diff_line_cb (GgitDiffDelta *delta,
   switch (type)
     {
     case GGIT_DIFF_LINE_ADDITION:
-      if (g_hash_table_lookup (hash, GINT_TO_POINTER (new_lineno)))
-        g_hash_table_replace (hash,
-                              GINT_TO_POINTER (new_lineno),
-                              GINT_TO_POINTER (IDE_BUFFER_LINE_CHANGE_CHANGED));
-      else
-        g_hash_table_insert (hash,
-                             GINT_TO_POINTER (new_lineno),
-                             GINT_TO_POINTER (IDE_BUFFER_LINE_CHANGE_ADDED));
+      diff_state_set (state, new_lineno, IDE_BUFFER_LINE_CHANGE_ADDED);
       break;
 
     case GGIT_DIFF_LINE_DELETION:
       adjust = (ggit_diff_hunk_get_new_start (hunk) - ggit_diff_hunk_get_old_start (hunk));
       old_lineno += adjust;
-      if (g_hash_table_lookup (hash, GINT_TO_POINTER (old_lineno)))
-        g_hash_table_replace (hash,
-                              GINT_TO_POINTER (old_lineno),
-                              GINT_TO_POINTER (IDE_BUFFER_LINE_CHANGE_CHANGED));
-      else
-        g_hash_table_insert (hash,
-                             GINT_TO_POINTER (old_lineno),
-                             GINT_TO_POINTER (IDE_BUFFER_LINE_CHANGE_DELETED));
+      diff_state_set (state, old_lineno, IDE_BUFFER_LINE_CHANGE_DELETED);
       break;
 
     case GGIT_DIFF_LINE_CONTEXT:
@@ -545,6 +539,7 @@ ide_git_buffer_change_monitor_calculate_threaded (IdeGitBufferChangeMonitor  *se
 {
   g_autofree gchar *relative_path = NULL;
   g_autoptr(GFile) workdir = NULL;
+  g_autoptr(GBytes) content = NULL;
   const guint8 *data;
   gsize data_len = 0;
 
@@ -553,7 +548,7 @@ ide_git_buffer_change_monitor_calculate_threaded (IdeGitBufferChangeMonitor  *se
   g_assert (G_IS_FILE (diff->file));
   g_assert (diff->state);
   g_assert (GGIT_IS_REPOSITORY (diff->repository));
-  g_assert (diff->content);
+  g_assert (diff->snapshot);
   g_assert (!diff->blob || GGIT_IS_BLOB (diff->blob));
   g_assert (error);
   g_assert (!*error);
@@ -646,7 +641,9 @@ ide_git_buffer_change_monitor_calculate_threaded (IdeGitBufferChangeMonitor  *se
       return FALSE;
     }
 
-  data = g_bytes_get_data (diff->content, &data_len);
+  /* Only now do we need the contents as a single block of memory */
+  content = ide_buffer_snapshot_get_bytes (diff->snapshot);
+  data = g_bytes_get_data (content, &data_len);
 
   ggit_diff_blob_to_buffer (diff->blob, relative_path, data, data_len, relative_path,
                             NULL, NULL, NULL, NULL, diff_line_cb, (gpointer)diff->state, error);
@@ -674,8 +671,8 @@ ide_git_buffer_change_monitor_worker (gpointer data)
       if (!ide_git_buffer_change_monitor_calculate_threaded (self, diff, &error))
         g_task_return_error (task, error);
       else
-        g_task_return_pointer (task, g_hash_table_ref (diff->state),
-                               (GDestroyNotify)g_hash_table_unref);
+        g_task_return_pointer (task, g_byte_array_ref (diff->state),
+                               (GDestroyNotify)g_byte_array_unref);
 
       g_object_unref (task);
     }
@@ -700,6 +697,7 @@ ide_git_buffer_change_monitor_dispose (GObject *object)
   g_clear_object (&self->vcs_signal_group);
   g_clear_object (&self->cached_blob);
   g_clear_object (&self->repository);
+  g_clear_pointer (&self->state, g_byte_array_unref);
 
   G_OBJECT_CLASS (ide_git_buffer_change_monitor_parent_class)->dispose (object);
 }
@@ -776,11 +774,6 @@ ide_git_buffer_change_monitor_init (IdeGitBufferChangeMonitor *self)
                                    G_CALLBACK (ide_git_buffer_change_monitor__buffer_delete_range_cb),
                                    self,
                                    G_CONNECT_SWAPPED);
-  egg_signal_group_connect_object (self->signal_group,
-                                   "delete-range",
-                                   G_CALLBACK (ide_git_buffer_change_monitor__buffer_delete_range_after_cb),
-                                   self,
-                                   G_CONNECT_SWAPPED | G_CONNECT_AFTER);
   egg_signal_group_connect_object (self->signal_group,
                                    "changed",
                                    G_CALLBACK (ide_git_buffer_change_monitor__buffer_changed_after_cb),
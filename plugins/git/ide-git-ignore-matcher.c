@@ -0,0 +1,926 @@
+/* ide-git-ignore-matcher.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-git-ignore-matcher"
+
+#include <string.h>
+
+#include "ide-git-ignore-matcher.h"
+
+/*
+ * This is a compiled form of the .gitignore hierarchy for a working tree.
+ *
+ * Each directory's .gitignore is parsed once into a list of patterns and
+ * cached by its path relative to the working directory. To check the
+ * entries of a directory, we collect the pattern lists for every level
+ * from the root down to that directory and evaluate the whole listing
+ * against them, rather than asking libgit2 about each file (which has to
+ * resolve the path and walk the attribute stack every time).
+ *
+ * Precedence follows git: deeper .gitignore files win over shallower ones,
+ * which win over $GIT_DIR/info/exclude, which wins over core.excludesFile.
+ * Within a single file the last matching pattern wins.
+ *
+ * Every compiled file remembers the modification time it was loaded
+ * with, and is loaded again when that changes. To keep matching from
+ * querying every ancestor .gitignore for each directory, a compiled file
+ * is only checked again once RECHECK_INTERVAL has passed. Editing any
+ * .gitignore, $GIT_DIR/info/exclude or core.excludesFile is therefore
+ * picked up shortly after without having to monitor the working tree,
+ * and ide_git_ignore_matcher_invalidate() drops everything right away.
+ *
+ * The compiled files are reference counted so they can be used without
+ * holding the lock while another thread replaces them. Files are queried
+ * and loaded without holding the lock.
+ */
+
+#define RECHECK_INTERVAL G_USEC_PER_SEC
+
+typedef struct
+{
+  volatile gint  ref_count;
+  GPtrArray     *patterns;
+  /* Microseconds, or -1 if the file did not exist */
+  gint64         mtime;
+  /* Monotonic time of the last check for changes, guarded by the mutex */
+  gint64         checked_at;
+} PatternFile;
+
+struct _IdeGitIgnoreMatcher
+{
+  GMutex       mutex;
+  GFile       *working_directory;
+  GFile       *info_exclude_file;
+  GFile       *excludes_file;
+  PatternFile *info_exclude;
+  PatternFile *excludes;
+  GHashTable  *by_dir;
+};
+
+typedef struct
+{
+  gchar *pattern;
+  guint  negate : 1;
+  guint  dir_only : 1;
+  guint  anchored : 1;
+} Pattern;
+
+enum {
+  MATCH_NONE = -1,
+  MATCH_INCLUDED = 0,
+  MATCH_IGNORED = 1,
+};
+
+static void
+pattern_free (gpointer data)
+{
+  Pattern *p = data;
+
+  g_free (p->pattern);
+  g_slice_free (Pattern, p);
+}
+
+static void
+parse_patterns (GPtrArray *patterns,
+                gchar     *contents)
+{
+  g_auto(GStrv) lines = NULL;
+
+  g_assert (patterns != NULL);
+  g_assert (contents != NULL);
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (guint i = 0; lines [i] != NULL; i++)
+    {
+      gchar *line = lines [i];
+      gsize len = strlen (line);
+      Pattern *p;
+
+      if (len > 0 && line [len - 1] == '\r')
+        line [--len] = '\0';
+
+      /* Trailing spaces are ignored unless they are escaped */
+      while (len > 0 && line [len - 1] == ' ' && !(len > 1 && line [len - 2] == '\\'))
+        line [--len] = '\0';
+
+      if (len == 0 || line [0] == '#')
+        continue;
+
+      p = g_slice_new0 (Pattern);
+
+      if (line [0] == '!')
+        {
+          p->negate = TRUE;
+          line++;
+          len--;
+        }
+
+      if (len > 0 && line [len - 1] == '/')
+        {
+          p->dir_only = TRUE;
+          line [--len] = '\0';
+        }
+
+      /* A slash anywhere but the end anchors to the .gitignore location */
+      if (strchr (line, '/') != NULL)
+        {
+          p->anchored = TRUE;
+
+          if (line [0] == '/')
+            {
+              line++;
+              len--;
+            }
+        }
+
+      if (len == 0)
+        {
+          pattern_free (p);
+          continue;
+        }
+
+      p->pattern = g_strndup (line, len);
+
+      g_ptr_array_add (patterns, p);
+    }
+}
+
+static gint64
+get_mtime (GFile *file)
+{
+  g_autoptr(GFileInfo) info = NULL;
+
+  g_assert (G_IS_FILE (file));
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+
+  if (info == NULL)
+    return -1;
+
+  return (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC) +
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static PatternFile *
+pattern_file_ref (PatternFile *pf)
+{
+  g_assert (pf != NULL);
+  g_assert (pf->ref_count > 0);
+
+  g_atomic_int_inc (&pf->ref_count);
+
+  return pf;
+}
+
+static void
+pattern_file_unref (PatternFile *pf)
+{
+  g_assert (pf != NULL);
+  g_assert (pf->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&pf->ref_count))
+    {
+      g_clear_pointer (&pf->patterns, g_ptr_array_unref);
+      g_slice_free (PatternFile, pf);
+    }
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PatternFile, pattern_file_unref)
+
+static PatternFile *
+pattern_file_new (GFile  *file,
+                  gint64  mtime)
+{
+  g_autofree gchar *contents = NULL;
+  PatternFile *pf;
+
+  pf = g_slice_new0 (PatternFile);
+  pf->ref_count = 1;
+  pf->patterns = g_ptr_array_new_with_free_func (pattern_free);
+  pf->mtime = mtime;
+
+  if (file != NULL &&
+      mtime != -1 &&
+      g_file_load_contents (file, NULL, &contents, NULL, NULL, NULL))
+    parse_patterns (pf->patterns, contents);
+
+  return pf;
+}
+
+/*
+ * Returns a reference to @pf if it was checked for changes recently
+ * enough to be used as is. The caller must hold the lock.
+ */
+static PatternFile *
+pattern_file_get_fresh_locked (PatternFile *pf,
+                               gint64       now)
+{
+  if (pf != NULL && now - pf->checked_at < RECHECK_INTERVAL)
+    return pattern_file_ref (pf);
+
+  return NULL;
+}
+
+/*
+ * Returns the compiled form of @file, reusing @stale if it has not changed
+ * since it was compiled. This queries the file system, so it must be called
+ * without holding the lock.
+ */
+static PatternFile *
+pattern_file_revalidate (PatternFile *stale,
+                         GFile       *file)
+{
+  gint64 mtime;
+
+  mtime = file != NULL ? get_mtime (file) : -1;
+
+  if (stale != NULL && stale->mtime == mtime)
+    return pattern_file_ref (stale);
+
+  return pattern_file_new (file, mtime);
+}
+
+/*
+ * A small implementation of git's wildmatch() supporting "*", "?",
+ * "[...]" classes, backslash escapes and "**" path segments. Matching is
+ * done on bytes, which is sufficient for the ASCII metacharacters.
+ */
+static gboolean
+wildmatch (const gchar *pattern_start,
+           const gchar *p,
+           const gchar *t)
+{
+  for (; *p != '\0'; p++, t++)
+    {
+      switch (*p)
+        {
+        case '\\':
+          if (p [1] != '\0')
+            p++;
+          if (*t != *p)
+            return FALSE;
+          break;
+
+        case '?':
+          if (*t == '\0' || *t == '/')
+            return FALSE;
+          break;
+
+        case '[':
+          {
+            const gchar *c = p + 1;
+            gboolean negated = FALSE;
+            gboolean matched = FALSE;
+
+            if (*t == '\0' || *t == '/')
+              return FALSE;
+
+            if (*c == '!' || *c == '^')
+              {
+                negated = TRUE;
+                c++;
+              }
+
+            /* A leading ']' is taken literally */
+            if (*c == ']')
+              {
+                matched |= (*t == ']');
+                c++;
+              }
+
+            for (; *c != '\0' && *c != ']'; c++)
+              {
+                if (c [1] == '-' && c [2] != '\0' && c [2] != ']')
+                  {
+                    if ((guchar)*t >= (guchar)c [0] && (guchar)*t <= (guchar)c [2])
+                      matched = TRUE;
+                    c += 2;
+                  }
+                else if (*c == *t)
+                  {
+                    matched = TRUE;
+                  }
+              }
+
+            /* Unterminated class, treat the '[' literally */
+            if (*c != ']')
+              {
+                if (*t != '[')
+                  return FALSE;
+                break;
+              }
+
+            if (matched == negated)
+              return FALSE;
+
+            p = c;
+          }
+          break;
+
+        case '*':
+          if (p [1] == '*' &&
+              (p == pattern_start || p [-1] == '/') &&
+              (p [2] == '/' || p [2] == '\0'))
+            {
+              /* A trailing double star matches everything within */
+              if (p [2] == '\0')
+                return TRUE;
+
+              /* "**" followed by "/" matches zero or more directories */
+              for (;;)
+                {
+                  if (wildmatch (pattern_start, p + 3, t))
+                    return TRUE;
+                  if (NULL == (t = strchr (t, '/')))
+                    return FALSE;
+                  t++;
+                }
+            }
+
+          while (p [1] == '*')
+            p++;
+          p++;
+
+          /* Trailing "*" matches the rest of the component */
+          if (*p == '\0')
+            return strchr (t, '/') == NULL;
+
+          for (;; t++)
+            {
+              if (wildmatch (pattern_start, p, t))
+                return TRUE;
+              if (*t == '\0' || *t == '/')
+                return FALSE;
+            }
+
+        default:
+          if (*t != *p)
+            return FALSE;
+          break;
+        }
+    }
+
+  return *t == '\0';
+}
+
+static gint
+match_patterns (GPtrArray   *patterns,
+                const gchar *path,
+                const gchar *name,
+                gboolean     is_dir)
+{
+  g_assert (patterns != NULL);
+  g_assert (path != NULL);
+  g_assert (name != NULL);
+
+  for (guint i = patterns->len; i > 0; i--)
+    {
+      const Pattern *p = g_ptr_array_index (patterns, i - 1);
+
+      if (p->dir_only && !is_dir)
+        continue;
+
+      if (wildmatch (p->pattern, p->pattern, p->anchored ? path : name))
+        return p->negate ? MATCH_INCLUDED : MATCH_IGNORED;
+    }
+
+  return MATCH_NONE;
+}
+
+IdeGitIgnoreMatcher *
+ide_git_ignore_matcher_new (GFile       *working_directory,
+                            GFile       *git_directory,
+                            const gchar *excludes_file)
+{
+  IdeGitIgnoreMatcher *self;
+
+  g_return_val_if_fail (G_IS_FILE (working_directory), NULL);
+  g_return_val_if_fail (!git_directory || G_IS_FILE (git_directory), NULL);
+
+  self = g_slice_new0 (IdeGitIgnoreMatcher);
+  g_mutex_init (&self->mutex);
+  self->working_directory = g_object_ref (working_directory);
+  self->by_dir = g_hash_table_new_full (g_str_hash,
+                                        g_str_equal,
+                                        g_free,
+                                        (GDestroyNotify)pattern_file_unref);
+
+  if (git_directory != NULL)
+    self->info_exclude_file = g_file_resolve_relative_path (git_directory, "info/exclude");
+
+  if (excludes_file != NULL && *excludes_file != '\0')
+    {
+      g_autofree gchar *expanded = NULL;
+
+      if (g_str_has_prefix (excludes_file, "~/"))
+        excludes_file = expanded = g_build_filename (g_get_home_dir (), excludes_file + 2, NULL);
+
+      self->excludes_file = g_file_new_for_path (excludes_file);
+    }
+  else
+    {
+      g_autofree gchar *path = NULL;
+
+      path = g_build_filename (g_get_user_config_dir (), "git", "ignore", NULL);
+      self->excludes_file = g_file_new_for_path (path);
+    }
+
+  return self;
+}
+
+void
+ide_git_ignore_matcher_free (IdeGitIgnoreMatcher *self)
+{
+  if (self != NULL)
+    {
+      g_clear_object (&self->working_directory);
+      g_clear_object (&self->info_exclude_file);
+      g_clear_object (&self->excludes_file);
+      g_clear_pointer (&self->info_exclude, pattern_file_unref);
+      g_clear_pointer (&self->excludes, pattern_file_unref);
+      g_clear_pointer (&self->by_dir, g_hash_table_unref);
+      g_mutex_clear (&self->mutex);
+      g_slice_free (IdeGitIgnoreMatcher, self);
+    }
+}
+
+/**
+ * ide_git_ignore_matcher_invalidate:
+ *
+ * Drops all of the compiled ignore files so that they are loaded again
+ * the next time they are needed. Changes to the ignore files themselves
+ * are noticed within a second without this, but calling it when they are
+ * known to have changed picks them up right away and releases the memory
+ * of directories that no longer exist. This is safe to call while other
+ * threads are matching.
+ */
+void
+ide_git_ignore_matcher_invalidate (IdeGitIgnoreMatcher *self)
+{
+  g_return_if_fail (self != NULL);
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_remove_all (self->by_dir);
+  g_clear_pointer (&self->info_exclude, pattern_file_unref);
+  g_clear_pointer (&self->excludes, pattern_file_unref);
+  g_mutex_unlock (&self->mutex);
+}
+
+/*
+ * Stores @pf, which the caller gives up, in @slot as just checked for
+ * changes. If another thread stored one it checked since, that one is
+ * kept instead. Returns a reference to the one in @slot.
+ */
+static PatternFile *
+pattern_file_store_locked (PatternFile **slot,
+                           PatternFile  *pf,
+                           gint64        now)
+{
+  g_assert (slot != NULL);
+  g_assert (pf != NULL);
+
+  if (*slot != NULL && *slot != pf && (*slot)->checked_at >= now)
+    {
+      pattern_file_unref (pf);
+      return pattern_file_ref (*slot);
+    }
+
+  if (*slot != pf)
+    {
+      g_clear_pointer (slot, pattern_file_unref);
+      *slot = pattern_file_ref (pf);
+    }
+
+  pf->checked_at = now;
+
+  return pf;
+}
+
+/*
+ * The pattern files that apply to a directory, ordered from the lowest
+ * precedence to the highest, along with the length of the directory each
+ * one belongs to.
+ */
+typedef struct
+{
+  GPtrArray *files;
+  GArray    *base_lengths;
+} Levels;
+
+static void
+levels_clear (Levels *levels)
+{
+  g_clear_pointer (&levels->files, g_ptr_array_unref);
+  g_clear_pointer (&levels->base_lengths, g_array_unref);
+}
+
+static void
+ide_git_ignore_matcher_get_levels (IdeGitIgnoreMatcher *self,
+                                   const gchar         *relative_dir,
+                                   Levels              *levels)
+{
+  g_autoptr(GArray) checked = NULL;
+  g_autoptr(GPtrArray) stale = NULL;
+  gint64 now;
+  gsize dir_len;
+  gsize root_len = 0;
+
+  g_assert (self != NULL);
+  g_assert (relative_dir != NULL);
+  g_assert (levels != NULL);
+
+  dir_len = strlen (relative_dir);
+
+  levels->files = g_ptr_array_new_with_free_func ((GDestroyNotify)pattern_file_unref);
+  levels->base_lengths = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  /* The length of the base path for every level, root first */
+  g_array_append_val (levels->base_lengths, root_len);
+  for (gsize i = 0; i < dir_len; i++)
+    {
+      if (relative_dir [i] == '/')
+        g_array_append_val (levels->base_lengths, i);
+    }
+  if (dir_len > 0)
+    g_array_append_val (levels->base_lengths, dir_len);
+
+  /* The levels to check for changes, and what they were compiled to */
+  checked = g_array_new (FALSE, FALSE, sizeof (guint));
+  stale = g_ptr_array_new ();
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&self->mutex);
+  for (guint i = 0; i < levels->base_lengths->len; i++)
+    {
+      g_autofree gchar *key = NULL;
+      PatternFile *pf;
+      PatternFile *fresh;
+
+      key = g_strndup (relative_dir, g_array_index (levels->base_lengths, gsize, i));
+      pf = g_hash_table_lookup (self->by_dir, key);
+      fresh = pattern_file_get_fresh_locked (pf, now);
+
+      g_ptr_array_add (levels->files, fresh);
+
+      if (fresh == NULL)
+        {
+          g_array_append_val (checked, i);
+          g_ptr_array_add (stale, pf != NULL ? pattern_file_ref (pf) : NULL);
+        }
+    }
+  g_mutex_unlock (&self->mutex);
+
+  if (checked->len == 0)
+    return;
+
+  for (guint j = 0; j < checked->len; j++)
+    {
+      guint i = g_array_index (checked, guint, j);
+      gsize base_len = g_array_index (levels->base_lengths, gsize, i);
+      g_autofree gchar *key = g_strndup (relative_dir, base_len);
+      g_autofree gchar *path = g_build_filename (key, ".gitignore", NULL);
+      g_autoptr(GFile) file = g_file_resolve_relative_path (self->working_directory, path);
+
+      g_ptr_array_index (levels->files, i) = pattern_file_revalidate (g_ptr_array_index (stale, j), file);
+    }
+
+  g_mutex_lock (&self->mutex);
+  for (guint j = 0; j < checked->len; j++)
+    {
+      guint i = g_array_index (checked, guint, j);
+      gsize base_len = g_array_index (levels->base_lengths, gsize, i);
+      g_autofree gchar *key = g_strndup (relative_dir, base_len);
+      PatternFile *slot;
+
+      /* The table takes back the reference, replacing the entry if stale */
+      if (NULL != (slot = g_hash_table_lookup (self->by_dir, key)))
+        pattern_file_ref (slot);
+      g_ptr_array_index (levels->files, i) =
+        pattern_file_store_locked (&slot, g_ptr_array_index (levels->files, i), now);
+      g_hash_table_insert (self->by_dir, g_steal_pointer (&key), slot);
+    }
+  g_mutex_unlock (&self->mutex);
+
+  for (guint j = 0; j < stale->len; j++)
+    {
+      PatternFile *pf = g_ptr_array_index (stale, j);
+
+      if (pf != NULL)
+        pattern_file_unref (pf);
+    }
+}
+
+/*
+ * Matches @path, relative to the working directory, against @levels and
+ * then the global excludes, which @levels does not include.
+ */
+static gint
+ide_git_ignore_matcher_match_one (Levels      *levels,
+                                  PatternFile *info_exclude,
+                                  PatternFile *excludes,
+                                  const gchar *path,
+                                  const gchar *name,
+                                  gboolean     is_dir)
+{
+  gint result = MATCH_NONE;
+
+  g_assert (levels != NULL);
+  g_assert (path != NULL);
+  g_assert (name != NULL);
+
+  if (g_strcmp0 (name, ".git") == 0)
+    return MATCH_IGNORED;
+
+  for (guint j = levels->files->len; result == MATCH_NONE && j > 0; j--)
+    {
+      const PatternFile *pf = g_ptr_array_index (levels->files, j - 1);
+      gsize base_len = g_array_index (levels->base_lengths, gsize, j - 1);
+      const gchar *relative = base_len > 0 ? path + base_len + 1 : path;
+
+      result = match_patterns (pf->patterns, relative, name, is_dir);
+    }
+
+  if (result == MATCH_NONE)
+    result = match_patterns (info_exclude->patterns, path, name, is_dir);
+
+  if (result == MATCH_NONE)
+    result = match_patterns (excludes->patterns, path, name, is_dir);
+
+  return result;
+}
+
+static PatternFile *
+ide_git_ignore_matcher_get_file (IdeGitIgnoreMatcher  *self,
+                                 PatternFile         **slot,
+                                 GFile                *file,
+                                 gint64                now)
+{
+  g_autoptr(PatternFile) stale = NULL;
+  PatternFile *ret;
+
+  g_assert (self != NULL);
+  g_assert (slot != NULL);
+
+  g_mutex_lock (&self->mutex);
+  if (NULL == (ret = pattern_file_get_fresh_locked (*slot, now)) && *slot != NULL)
+    stale = pattern_file_ref (*slot);
+  g_mutex_unlock (&self->mutex);
+
+  if (ret != NULL)
+    return ret;
+
+  ret = pattern_file_revalidate (stale, file);
+
+  g_mutex_lock (&self->mutex);
+  ret = pattern_file_store_locked (slot, ret, now);
+  g_mutex_unlock (&self->mutex);
+
+  return ret;
+}
+
+static void
+ide_git_ignore_matcher_get_global (IdeGitIgnoreMatcher  *self,
+                                   PatternFile         **info_exclude,
+                                   PatternFile         **excludes)
+{
+  gint64 now;
+
+  g_assert (self != NULL);
+
+  now = g_get_monotonic_time ();
+
+  *info_exclude = ide_git_ignore_matcher_get_file (self, &self->info_exclude, self->info_exclude_file, now);
+  *excludes = ide_git_ignore_matcher_get_file (self, &self->excludes, self->excludes_file, now);
+}
+
+/**
+ * ide_git_ignore_matcher_match:
+ * @self: An #IdeGitIgnoreMatcher
+ * @relative_dir: the directory containing @file_infos, relative to the
+ *   working directory, or "" for the working directory itself
+ * @file_infos: (element-type GFileInfo): the children of @relative_dir
+ * @ignored: (array): a location for a result per element of @file_infos
+ *
+ * Checks every element of @file_infos against the compiled ignore rules.
+ * @relative_dir is assumed to not be ignored itself.
+ *
+ * This function is thread-safe.
+ *
+ * Returns: %TRUE if successful.
+ */
+gboolean
+ide_git_ignore_matcher_match (IdeGitIgnoreMatcher *self,
+                              const gchar         *relative_dir,
+                              GPtrArray           *file_infos,
+                              gboolean            *ignored)
+{
+  g_autoptr(PatternFile) info_exclude = NULL;
+  g_autoptr(PatternFile) excludes = NULL;
+  g_autoptr(GString) path = NULL;
+  Levels levels;
+  gsize dir_len;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (relative_dir != NULL, FALSE);
+  g_return_val_if_fail (file_infos != NULL, FALSE);
+  g_return_val_if_fail (ignored != NULL, FALSE);
+
+  dir_len = strlen (relative_dir);
+
+  ide_git_ignore_matcher_get_levels (self, relative_dir, &levels);
+  ide_git_ignore_matcher_get_global (self, &info_exclude, &excludes);
+
+  path = g_string_new (relative_dir);
+  if (dir_len > 0)
+    g_string_append_c (path, '/');
+
+  for (guint i = 0; i < file_infos->len; i++)
+    {
+      GFileInfo *info = g_ptr_array_index (file_infos, i);
+      const gchar *name = g_file_info_get_name (info);
+      gboolean is_dir = g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY;
+
+      g_string_truncate (path, dir_len > 0 ? dir_len + 1 : 0);
+      g_string_append (path, name);
+
+      ignored [i] = MATCH_IGNORED == ide_git_ignore_matcher_match_one (&levels,
+                                                                       info_exclude,
+                                                                       excludes,
+                                                                       path->str,
+                                                                       name,
+                                                                       is_dir);
+    }
+
+  levels_clear (&levels);
+
+  return TRUE;
+}
+
+/**
+ * ide_git_ignore_matcher_is_ignored:
+ * @self: An #IdeGitIgnoreMatcher
+ * @relative_path: a path relative to the working directory
+ * @file_type: the type of @relative_path, or %G_FILE_TYPE_UNKNOWN
+ *
+ * Checks a single path against the compiled ignore rules. Unlike
+ * ide_git_ignore_matcher_match(), the parent directories of
+ * @relative_path are checked too, as git does not look inside of
+ * ignored directories.
+ *
+ * If @file_type is %G_FILE_TYPE_UNKNOWN, the file is only queried when
+ * the result depends on whether it is a directory.
+ *
+ * This function is thread-safe.
+ *
+ * Returns: %TRUE if @relative_path is ignored.
+ */
+gboolean
+ide_git_ignore_matcher_is_ignored (IdeGitIgnoreMatcher *self,
+                                   const gchar         *relative_path,
+                                   GFileType            file_type)
+{
+  g_autoptr(PatternFile) info_exclude = NULL;
+  g_autoptr(PatternFile) excludes = NULL;
+  g_autofree gchar *dir = NULL;
+  const gchar *name;
+  const gchar *slash;
+  Levels levels;
+  gint result;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (relative_path != NULL, FALSE);
+
+  if (*relative_path == '\0')
+    return FALSE;
+
+  slash = strrchr (relative_path, '/');
+
+  if (slash == NULL)
+    {
+      dir = g_strdup ("");
+      name = relative_path;
+    }
+  else
+    {
+      dir = g_strndup (relative_path, slash - relative_path);
+      name = slash + 1;
+
+      if (ide_git_ignore_matcher_is_ignored (self, dir, G_FILE_TYPE_DIRECTORY))
+        return TRUE;
+    }
+
+  ide_git_ignore_matcher_get_levels (self, dir, &levels);
+  ide_git_ignore_matcher_get_global (self, &info_exclude, &excludes);
+
+  if (file_type != G_FILE_TYPE_UNKNOWN)
+    {
+      result = ide_git_ignore_matcher_match_one (&levels, info_exclude, excludes, relative_path, name,
+                                                 file_type == G_FILE_TYPE_DIRECTORY);
+    }
+  else
+    {
+      gint as_file;
+      gint as_dir;
+
+      as_file = ide_git_ignore_matcher_match_one (&levels, info_exclude, excludes, relative_path, name, FALSE);
+      as_dir = ide_git_ignore_matcher_match_one (&levels, info_exclude, excludes, relative_path, name, TRUE);
+
+      /* Only directory patterns care, so we rarely need to query the file */
+      if (as_file == as_dir)
+        {
+          result = as_file;
+        }
+      else
+        {
+          g_autoptr(GFile) file = g_file_resolve_relative_path (self->working_directory, relative_path);
+
+          if (g_file_query_file_type (file, 0, NULL) == G_FILE_TYPE_DIRECTORY)
+            result = as_dir;
+          else
+            result = as_file;
+        }
+    }
+
+  levels_clear (&levels);
+
+  return result == MATCH_IGNORED;
+}
+
+static inline guint64
+stamp_combine (guint64 stamp,
+               gint64  mtime)
+{
+  /* FNV-1a over the modification times */
+  for (guint i = 0; i < sizeof mtime; i++)
+    {
+      stamp ^= ((guint64)mtime >> (i * 8)) & 0xFF;
+      stamp *= G_GUINT64_CONSTANT (1099511628211);
+    }
+
+  return stamp;
+}
+
+/**
+ * ide_git_ignore_matcher_get_stamp:
+ * @self: An #IdeGitIgnoreMatcher
+ * @relative_dir: a directory relative to the working directory, or ""
+ *   for the working directory itself
+ *
+ * Gets a value derived from the modification times of every ignore file
+ * that applies to the children of @relative_dir. It changes whenever one
+ * of them is created, edited or removed.
+ *
+ * This function is thread-safe.
+ *
+ * Returns: the stamp for @relative_dir
+ */
+guint64
+ide_git_ignore_matcher_get_stamp (IdeGitIgnoreMatcher *self,
+                                  const gchar         *relative_dir)
+{
+  g_autoptr(PatternFile) info_exclude = NULL;
+  g_autoptr(PatternFile) excludes = NULL;
+  guint64 stamp = G_GUINT64_CONSTANT (14695981039346656037);
+  Levels levels;
+
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (relative_dir != NULL, 0);
+
+  ide_git_ignore_matcher_get_levels (self, relative_dir, &levels);
+  ide_git_ignore_matcher_get_global (self, &info_exclude, &excludes);
+
+  for (guint i = 0; i < levels.files->len; i++)
+    {
+      const PatternFile *pf = g_ptr_array_index (levels.files, i);
+
+      stamp = stamp_combine (stamp, pf->mtime);
+    }
+
+  stamp = stamp_combine (stamp, info_exclude->mtime);
+  stamp = stamp_combine (stamp, excludes->mtime);
+
+  levels_clear (&levels);
+
+  return stamp;
+}
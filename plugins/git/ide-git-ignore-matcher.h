@@ -0,0 +1,47 @@
+/* ide-git-ignore-matcher.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_GIT_IGNORE_MATCHER_H
+#define IDE_GIT_IGNORE_MATCHER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _IdeGitIgnoreMatcher IdeGitIgnoreMatcher;
+
+IdeGitIgnoreMatcher *ide_git_ignore_matcher_new        (GFile               *working_directory,
+                                                        GFile               *git_directory,
+                                                        const gchar         *excludes_file);
+void                 ide_git_ignore_matcher_free       (IdeGitIgnoreMatcher *self);
+void                 ide_git_ignore_matcher_invalidate (IdeGitIgnoreMatcher *self);
+gboolean             ide_git_ignore_matcher_match      (IdeGitIgnoreMatcher *self,
+                                                        const gchar         *relative_dir,
+                                                        GPtrArray           *file_infos,
+                                                        gboolean            *ignored);
+gboolean             ide_git_ignore_matcher_is_ignored (IdeGitIgnoreMatcher *self,
+                                                        const gchar         *relative_path,
+                                                        GFileType            file_type);
+guint64              ide_git_ignore_matcher_get_stamp  (IdeGitIgnoreMatcher *self,
+                                                        const gchar         *relative_dir);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (IdeGitIgnoreMatcher, ide_git_ignore_matcher_free)
+
+G_END_DECLS
+
+#endif /* IDE_GIT_IGNORE_MATCHER_H */
@@ -0,0 +1,128 @@
+/* ide-git-line-state.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-git-line-state"
+
+#include <ide.h>
+#include <string.h>
+
+#include "ide-git-line-state.h"
+
+/*
+ * The line state of IdeGitBufferChangeMonitor is one IdeBufferLineChange
+ * byte per line. Lines past the end of the array are unchanged. These
+ * helpers shift the state as the buffer is edited, until the next diff
+ * replaces it.
+ */
+
+void
+ide_git_line_state_grow (GByteArray *state,
+                         guint       len)
+{
+  guint old_len = state->len;
+
+  if (len > old_len)
+    {
+      g_byte_array_set_size (state, len);
+      memset (&state->data [old_len], IDE_BUFFER_LINE_CHANGE_NONE, len - old_len);
+    }
+}
+
+void
+ide_git_line_state_mark_changed (GByteArray *state,
+                                 guint       line)
+{
+  g_assert (state != NULL);
+
+  ide_git_line_state_grow (state, line + 1);
+
+  if (state->data [line] == IDE_BUFFER_LINE_CHANGE_NONE)
+    state->data [line] = IDE_BUFFER_LINE_CHANGE_CHANGED;
+}
+
+void
+ide_git_line_state_insert_lines (GByteArray *state,
+                                 guint       line,
+                                 guint       n_lines)
+{
+  guint old_len;
+
+  g_assert (state != NULL);
+
+  ide_git_line_state_grow (state, line);
+
+  old_len = state->len;
+  g_byte_array_set_size (state, old_len + n_lines);
+  memmove (&state->data [line + n_lines], &state->data [line], old_len - line);
+  memset (&state->data [line], IDE_BUFFER_LINE_CHANGE_ADDED, n_lines);
+}
+
+void
+ide_git_line_state_remove_lines (GByteArray *state,
+                                 guint       line,
+                                 guint       n_lines)
+{
+  g_assert (state != NULL);
+
+  if (line >= state->len)
+    return;
+
+  g_byte_array_remove_range (state, line, MIN (n_lines, state->len - line));
+}
+
+/*
+ * Counts the line breaks in @text the way GtkTextBuffer does, where "\r\n"
+ * is a single break, and "\r" and U+2029 PARAGRAPH SEPARATOR are breaks too.
+ */
+guint
+ide_git_line_state_count_lines (const gchar *text,
+                                gsize        len)
+{
+  guint n_lines = 0;
+
+  g_assert (text != NULL || len == 0);
+
+  for (gsize i = 0; i < len; i++)
+    {
+      switch (text [i])
+        {
+        case '\r':
+          if (i + 1 < len && text [i + 1] == '\n')
+            i++;
+          n_lines++;
+          break;
+
+        case '\n':
+          n_lines++;
+          break;
+
+        case '\xE2':
+          if (i + 2 < len && text [i + 1] == '\x80' && text [i + 2] == '\xA9')
+            {
+              i += 2;
+              n_lines++;
+            }
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  return n_lines;
+}
@@ -0,0 +1,41 @@
+/* ide-git-line-state.h
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_GIT_LINE_STATE_H
+#define IDE_GIT_LINE_STATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void  ide_git_line_state_grow         (GByteArray  *state,
+                                       guint        len);
+void  ide_git_line_state_mark_changed (GByteArray  *state,
+                                       guint        line);
+void  ide_git_line_state_insert_lines (GByteArray  *state,
+                                       guint        line,
+                                       guint        n_lines);
+void  ide_git_line_state_remove_lines (GByteArray  *state,
+                                       guint        line,
+                                       guint        n_lines);
+guint ide_git_line_state_count_lines  (const gchar *text,
+                                       gsize        len);
+
+G_END_DECLS
+
+#endif /* IDE_GIT_LINE_STATE_H */
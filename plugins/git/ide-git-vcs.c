@@ -23,6 +23,7 @@
 #include <libgit2-glib/ggit.h>
 
 #include "ide-git-buffer-change-monitor.h"
+#include "ide-git-ignore-matcher.h"
 #include "ide-git-vcs.h"
 #include "ide-git-vcs-config.h"
 
@@ -38,6 +39,13 @@ struct _IdeGitVcs
   GFile          *working_directory;
   GFileMonitor   *monitor;
 
+  /*
+   * Compiled .gitignore rules used by is_ignored() and is_ignored_batch().
+   * This is created once when the repository is first loaded and is
+   * thread-safe.
+   */
+  IdeGitIgnoreMatcher *ignore_matcher;
+
   guint           changed_timeout;
 
   guint           reloading : 1;
@@ -292,6 +300,9 @@ ide_git_vcs__monitor_changed_cb (IdeGitVcs         *self,
 
   g_assert (IDE_IS_GIT_VCS (self));
 
+  if (self->ignore_matcher != NULL)
+    ide_git_ignore_matcher_invalidate (self->ignore_matcher);
+
   if (self->changed_timeout != 0)
     g_source_remove (self->changed_timeout);
 
@@ -342,6 +353,31 @@ ide_git_vcs_load_monitor (IdeGitVcs  *self,
   return ret;
 }
 
+static void
+ide_git_vcs_load_ignore_matcher (IdeGitVcs      *self,
+                                 GgitRepository *repository)
+{
+  g_autoptr(GgitConfig) config = NULL;
+  g_autoptr(GgitConfig) snapshot = NULL;
+  g_autoptr(GFile) location = NULL;
+  const gchar *excludes_file = NULL;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (GGIT_IS_REPOSITORY (repository));
+  g_assert (self->working_directory != NULL);
+
+  location = ggit_repository_get_location (repository);
+
+  if (NULL != (config = ggit_repository_get_config (repository, NULL)) &&
+      NULL != (snapshot = ggit_config_snapshot (config, NULL)))
+    excludes_file = ggit_config_get_string (snapshot, "core.excludesfile", NULL);
+
+  g_atomic_pointer_set (&self->ignore_matcher,
+                        ide_git_ignore_matcher_new (self->working_directory,
+                                                    location,
+                                                    excludes_file));
+}
+
 static void
 ide_git_vcs_reload_worker (GTask        *task,
                            gpointer      source_object,
@@ -370,6 +406,11 @@ ide_git_vcs_reload_worker (GTask        *task,
   g_set_object (&self->repository, repository1);
   g_set_object (&self->change_monitor_repository, repository2);
 
+  if (self->ignore_matcher == NULL)
+    ide_git_vcs_load_ignore_matcher (self, repository1);
+  else
+    ide_git_ignore_matcher_invalidate (self->ignore_matcher);
+
   if (!ide_git_vcs_load_monitor (self, &error))
     {
       g_task_return_error (task, error);
@@ -430,6 +471,7 @@ ide_git_vcs_is_ignored (IdeVcs  *vcs,
 {
   g_autofree gchar *name = NULL;
   IdeGitVcs *self = (IdeGitVcs *)vcs;
+  IdeGitIgnoreMatcher *matcher;
   gboolean ret = FALSE;
 
   g_assert (IDE_IS_GIT_VCS (self));
@@ -439,10 +481,69 @@ ide_git_vcs_is_ignored (IdeVcs  *vcs,
   if (g_strcmp0 (name, ".git") == 0)
     return TRUE;
 
-  if (name != NULL)
-    return ggit_repository_path_is_ignored (self->repository, name, error);
+  if (name == NULL)
+    return ret;
 
-  return ret;
+  /* Use the same rules as is_ignored_batch() so that both always agree */
+  if (NULL != (matcher = g_atomic_pointer_get (&self->ignore_matcher)))
+    return ide_git_ignore_matcher_is_ignored (matcher, name, G_FILE_TYPE_UNKNOWN);
+
+  return ggit_repository_path_is_ignored (self->repository, name, error);
+}
+
+static gboolean
+ide_git_vcs_is_ignored_batch (IdeVcs     *vcs,
+                              GFile      *directory,
+                              GPtrArray  *file_infos,
+                              gboolean   *ignored,
+                              GError    **error)
+{
+  IdeGitVcs *self = (IdeGitVcs *)vcs;
+  g_autofree gchar *relative_dir = NULL;
+  IdeGitIgnoreMatcher *matcher;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (G_IS_FILE (directory));
+  g_assert (file_infos != NULL);
+  g_assert (ignored != NULL);
+
+  matcher = g_atomic_pointer_get (&self->ignore_matcher);
+
+  if (g_file_equal (directory, self->working_directory))
+    relative_dir = g_strdup ("");
+  else
+    relative_dir = g_file_get_relative_path (self->working_directory, directory);
+
+  /* Nothing outside of the working tree is ignored */
+  if (matcher == NULL || relative_dir == NULL)
+    {
+      memset (ignored, 0, sizeof (gboolean) * file_infos->len);
+      return TRUE;
+    }
+
+  return ide_git_ignore_matcher_match (matcher, relative_dir, file_infos, ignored);
+}
+
+static guint64
+ide_git_vcs_get_ignore_stamp (IdeVcs *vcs,
+                              GFile  *directory)
+{
+  IdeGitVcs *self = (IdeGitVcs *)vcs;
+  g_autofree gchar *relative_dir = NULL;
+  IdeGitIgnoreMatcher *matcher;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+  g_assert (G_IS_FILE (directory));
+
+  if (NULL == (matcher = g_atomic_pointer_get (&self->ignore_matcher)))
+    return 0;
+
+  if (g_file_equal (directory, self->working_directory))
+    relative_dir = g_strdup ("");
+  else if (NULL == (relative_dir = g_file_get_relative_path (self->working_directory, directory)))
+    return 0;
+
+  return ide_git_ignore_matcher_get_stamp (matcher, relative_dir);
 }
 
 static gchar *
@@ -502,13 +603,24 @@ ide_git_vcs_dispose (GObject *object)
 
   g_clear_object (&self->change_monitor_repository);
   g_clear_object (&self->repository);
-  g_clear_object (&self->working_directory);
 
   G_OBJECT_CLASS (ide_git_vcs_parent_class)->dispose (object);
 
   IDE_EXIT;
 }
 
+static void
+ide_git_vcs_finalize (GObject *object)
+{
+  IdeGitVcs *self = (IdeGitVcs *)object;
+
+  /* Released here rather than dispose since they are used from threads */
+  g_clear_pointer (&self->ignore_matcher, ide_git_ignore_matcher_free);
+  g_clear_object (&self->working_directory);
+
+  G_OBJECT_CLASS (ide_git_vcs_parent_class)->finalize (object);
+}
+
 static void
 ide_git_vcs_get_property (GObject    *object,
                           guint       prop_id,
@@ -542,6 +654,8 @@ ide_git_vcs_init_iface (IdeVcsInterface *iface)
   iface->get_working_directory = ide_git_vcs_get_working_directory;
   iface->get_buffer_change_monitor = ide_git_vcs_get_buffer_change_monitor;
   iface->is_ignored = ide_git_vcs_is_ignored;
+  iface->is_ignored_batch = ide_git_vcs_is_ignored_batch;
+  iface->get_ignore_stamp = ide_git_vcs_get_ignore_stamp;
   iface->get_config = ide_git_vcs_get_config;
   iface->get_branch_name = ide_git_vcs_get_branch_name;
 }
@@ -552,6 +666,7 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = ide_git_vcs_dispose;
+  object_class->finalize = ide_git_vcs_finalize;
   object_class->get_property = ide_git_vcs_get_property;
 
   g_object_class_override_property (object_class, PROP_BRANCH_NAME, "branch-name");
@@ -44,20 +44,9 @@ def execInRuntime(runtime, *args, **kwargs):
     _, stdout, stderr = proc.communicate_utf8(None, None)
     return stdout
 
-def extract_flags(command: str, builddir: str):
-    flags = GLib.shell_parse_argv(command)[1] # Raises on failure
-    wanted_flags = []
-    for flag in flags:
-        if flag.startswith('-I'):
-            # All paths are relative to build
-            abspath = path.normpath(path.join(builddir, flag[2:]))
-            wanted_flags.append('-I' + abspath)
-        elif flag.startswith(('-isystem', '-W', '-D')):
-            wanted_flags.append(flag)
-    return wanted_flags
-
 class MesonBuildSystem(Ide.Object, Ide.BuildSystem, Gio.AsyncInitable):
     project_file = GObject.Property(type=Gio.File)
+    _compile_commands = None
 
     def do_get_id(self):
         return 'meson'
@@ -104,67 +93,83 @@ class MesonBuildSystem(Ide.Object, Ide.BuildSystem, Gio.AsyncInitable):
             return result.build_flags
 
     def _get_build_flags_cb(self, build_manager, result, task):
+        try:
+            build_manager.execute_finish(result)
+        except Exception as err:
+            task.return_error(err)
+            return
+
         config = build_manager.get_pipeline().get_configuration()
-        builddir = build_manager.get_pipeline().get_builddir()
-        commands_file = path.join(self.get_builddir(config), 'compile_commands.json')
-        runtime = config.get_runtime()
+        commands_file = Gio.File.new_for_path(path.join(self.get_builddir(config), 'compile_commands.json'))
+
+        # The compile commands are indexed once and only reloaded when
+        # the file has changed, so this is cheap for every file after
+        # the first one.
+        if self._compile_commands is None:
+            self._compile_commands = Ide.CompileCommands.new()
+        self._compile_commands.load_async(commands_file,
+                                          task.get_cancellable(),
+                                          self._load_compile_commands_cb,
+                                          task)
+
+    def _load_compile_commands_cb(self, compile_commands, result, task):
+        try:
+            compile_commands.load_finish(result)
+        except GLib.Error as e:
+            task.return_error(GLib.Error('Failed to load meson compile commands: {}'.format(e.message)))
+            return
 
-        def build_flags_thread():
-            try:
-                with open(commands_file) as f:
-                    commands = json.loads(f.read(), encoding='utf-8')
-            except (json.JSONDecodeError, FileNotFoundError, UnicodeDecodeError) as e:
-                task.return_error(GLib.Error('Failed to decode meson json: {}'.format(e)))
+        try:
+            task.build_flags, _ = compile_commands.lookup(task.ifile)
+            task.return_boolean(True)
+            return
+        except GLib.Error as e:
+            if not e.matches(Gio.io_error_quark(), Gio.IOErrorEnum.NOT_FOUND):
+                task.return_error(e)
                 return
 
-            infile = task.ifile.get_path()
-            for c in commands:
-                filepath = path.normpath(path.join(c['directory'], c['file']))
-                if filepath == infile:
-                    try:
-                        task.build_flags = extract_flags(c['command'], builddir)
-                    except GLib.Error as e:
-                        task.return_error(e)
-                        return
+        if not task.ifile.get_path().endswith('.vala'):
+            print('Meson: Warning: No flags found')
+            task.return_boolean(True)
+            return
+
+        build_manager = self.get_context().get_build_manager()
+        builddir = build_manager.get_pipeline().get_builddir()
+        runtime = build_manager.get_pipeline().get_configuration().get_runtime()
+
+        def build_flags_thread():
+            # We didn't find anything in the compile_commands.json, so now try to use
+            # the compdb from ninja and see if it has anything useful for us.
+            ninja = None
+            for name in _NINJA_NAMES:
+                if runtime.contains_program_in_path(name):
+                    ninja = name
                     break
+            if ninja:
+                ret = execInRuntime(runtime, ninja, '-t', 'compdb', 'vala_COMPILER', directory=builddir)
+                try:
+                    commands = json.loads(ret, encoding='utf-8')
+                except Exception as e:
+                    task.return_error(GLib.Error('Failed to decode ninja json: {}'.format(e)))
+                    return
 
-            if infile.endswith('.vala'):
-                # We didn't find anything in the compile_commands.json, so now try to use
-                # the compdb from ninja and see if it has anything useful for us.
-                ninja = None
-                for name in _NINJA_NAMES:
-                    if runtime.contains_program_in_path(name):
-                        ninja = name
-                        break
-                if ninja:
-                    ret = execInRuntime(runtime, ninja, '-t', 'compdb', 'vala_COMPILER', directory=builddir)
+                for c in commands:
                     try:
-                        commands = json.loads(ret, encoding='utf-8')
-                    except Exception as e:
-                        task.return_error(GLib.Error('Failed to decode ninja json: {}'.format(e)))
+                        _, argv = GLib.shell_parse_argv(c['command'])
+                        # TODO: It would be nice to filter these arguments a bit,
+                        #       but the vala plugin should handle that fine.
+                        task.build_flags = argv
+                        task.return_boolean(True)
                         return
-
-                    for c in commands:
-                        try:
-                            _, argv = GLib.shell_parse_argv(c['command'])
-                            # TODO: It would be nice to filter these arguments a bit,
-                            #       but the vala plugin should handle that fine.
-                            task.build_flags = argv
-                            task.return_boolean(True)
-                            return
-                        except:
-                            pass
+                    except:
+                        pass
 
             print('Meson: Warning: No flags found')
 
             task.return_boolean(True)
 
-        try:
-            build_manager.execute_finish(result)
-            thread = threading.Thread(target=build_flags_thread)
-            thread.start()
-        except Exception as err:
-            task.return_error(err)
+        thread = threading.Thread(target=build_flags_thread)
+        thread.start()
 
     def do_get_build_targets_async(self, cancellable, callback, data=None):
         task = Gio.Task.new(self, cancellable, callback)
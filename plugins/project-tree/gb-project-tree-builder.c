@@ -118,6 +118,8 @@ build_file (GbProjectTreeBuilder *self,
             IdeTreeNode          *node)
 {
   g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) file_infos = NULL;
+  g_autofree gboolean *ignored = NULL;
   GbProjectFile *project_file;
   gpointer file_info_ptr;
   IdeVcs *vcs;
@@ -125,6 +127,7 @@ build_file (GbProjectTreeBuilder *self,
   IdeTree *tree;
   gint count = 0;
   gboolean show_ignored_files;
+  guint i;
 
   g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
   g_return_if_fail (IDE_IS_TREE_NODE (node));
@@ -156,24 +159,30 @@ build_file (GbProjectTreeBuilder *self,
   if (enumerator == NULL)
     return;
 
+  file_infos = g_ptr_array_new_with_free_func (g_object_unref);
+
   while ((file_info_ptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    g_ptr_array_add (file_infos, file_info_ptr);
+
+  ignored = g_new0 (gboolean, file_infos->len + 1);
+  ide_vcs_is_ignored_batch (vcs, file, file_infos, ignored, NULL);
+
+  for (i = 0; i < file_infos->len; i++)
     {
-      g_autoptr(GFileInfo) item_file_info = file_info_ptr;
+      GFileInfo *item_file_info = g_ptr_array_index (file_infos, i);
       g_autoptr(GFile) item_file = NULL;
       g_autoptr(GbProjectFile) item = NULL;
       IdeTreeNode *child;
       const gchar *name;
       const gchar *display_name;
       const gchar *icon_name;
-      gboolean ignored;
+
+      if (ignored [i] && !show_ignored_files)
+        continue;
 
       name = g_file_info_get_name (item_file_info);
       item_file = g_file_get_child (file, name);
 
-      ignored = ide_vcs_is_ignored (vcs, item_file, NULL);
-      if (ignored && !show_ignored_files)
-        continue;
-
       item = gb_project_file_new (item_file, item_file_info);
 
       display_name = gb_project_file_get_display_name (item);
@@ -183,7 +192,7 @@ build_file (GbProjectTreeBuilder *self,
                             "icon-name", icon_name,
                             "text", display_name,
                             "item", item,
-                            "use-dim-label", ignored,
+                            "use-dim-label", ignored [i],
                             NULL);
 
       ide_tree_node_insert_sorted (node, child, compare_nodes_func, self);
@@ -40,6 +40,9 @@ LINE1 = re.compile('(.*):(\d+):(.*)')
 LINE2 = re.compile('(.*)-(\d+)-(.*)')
 KEYWORDS = ['FIXME:', 'XXX:', 'TODO:']
 
+# Keep the command line of each grep well below ARG_MAX
+MAX_FILES_PER_GREP = 500
+
 class TodoWorkbenchAddin(GObject.Object, Ide.WorkbenchAddin):
     workbench = None
     panel = None
@@ -114,62 +117,99 @@ class TodoWorkbenchAddin(GObject.Object, Ide.WorkbenchAddin):
         """
         Mine a file or directory.
 
-        We use a simple grep command to do the work for us rather than
+        Directories are walked with Ide.DirectoryCrawler, which skips
+        files ignored by the version control system, and the files found
+        are handed to grep to do the actual searching for us rather than
         trying to write anything too complex that would just approximate
         the same thing anyway.
         """
-        args = ['grep', '-A', '5', '-I', '-H', '-n', '-r']
-        for keyword in KEYWORDS:
-            args.append('-e')
-            args.append(keyword)
-        args.append(file.get_path())
-        p = subprocess.Popen(args, stdout=subprocess.PIPE)
+        vcs = self.workbench.get_context().get_vcs()
 
-        def communicate(proc):
-            stdout, _ = proc.communicate()
-            lines = stdout.decode('utf-8').splitlines()
-            stdout = None
-            skip = False
+        def worker():
+            if file.query_file_type(Gio.FileQueryInfoFlags.NONE, None) == Gio.FileType.DIRECTORY:
+                paths = self._collect_files(vcs, file)
+            else:
+                paths = [file.get_path()]
 
             items = []
-            item = TodoItem()
+            for i in range(0, len(paths), MAX_FILES_PER_GREP):
+                items.extend(self._grep(paths[i:i + MAX_FILES_PER_GREP]))
 
-            for line in lines:
-                # Skip long lines, like from SVG files
-                if not line.strip() or len(line) > 1024:
-                    continue
+            GLib.idle_add(self._post_from_main, (items, prepend))
 
-                if line.startswith('--'):
-                    if item.props.file and not skip:
-                        items.append(item)
-                    item = TodoItem()
-                    skip = False
-                    continue
+        threading.Thread(target=worker, name='todo-thread').start()
+
+    def _collect_files(self, vcs, directory):
+        paths = []
 
-                # If there is no file, then we haven't reached the x:x: line
-                regex = LINE1 if not item.props.file else LINE2
-                try:
-                    (filename, line, message) = regex.match(line).groups()
-                    skip = self.should_skip(filename)
-                except Exception as ex:
+        # Called from the crawler threads, but never concurrently
+        def on_directory(crawler, directory, relative_path, directory_info, children):
+            for info in children:
+                name = info.get_name()
+                if info.get_file_type() != Gio.FileType.REGULAR:
+                    continue
+                if self.should_skip(name) or self._is_ignored_pattern(name):
                     continue
+                paths.append(directory.get_child(name).get_path())
 
-                if not item.props.file:
-                    item.props.file = Gio.File.new_for_path(filename)
-                    item.props.line = int(line)
+        crawler = Ide.DirectoryCrawler.new(directory)
+        crawler.set_vcs(vcs)
+        crawler.subscribe(on_directory)
+        crawler.crawl(None)
 
-                # XXX: not efficient use of roundtrips to/from pygobject
-                if item.props.message:
-                    item.props.message += '\n' + message
-                else:
-                    item.props.message = message
+        return paths
 
-            if item.props.file and not skip:
-                items.append(item)
+    def _grep(self, paths):
+        args = ['grep', '-A', '5', '-I', '-H', '-n']
+        for keyword in KEYWORDS:
+            args.append('-e')
+            args.append(keyword)
+        args.append('--')
+        args.extend(paths)
 
-            GLib.idle_add(self._post_from_main, (items, prepend))
+        p = subprocess.Popen(args, stdout=subprocess.PIPE)
+        stdout, _ = p.communicate()
+        lines = stdout.decode('utf-8', errors='replace').splitlines()
+        stdout = None
+        skip = False
+
+        items = []
+        item = TodoItem()
+
+        for line in lines:
+            # Skip long lines, like from SVG files
+            if not line.strip() or len(line) > 1024:
+                continue
+
+            if line.startswith('--'):
+                if item.props.file and not skip:
+                    items.append(item)
+                item = TodoItem()
+                skip = False
+                continue
+
+            # If there is no file, then we haven't reached the x:x: line
+            regex = LINE1 if not item.props.file else LINE2
+            try:
+                (filename, line, message) = regex.match(line).groups()
+                skip = self.should_skip(filename)
+            except Exception as ex:
+                continue
+
+            if not item.props.file:
+                item.props.file = Gio.File.new_for_path(filename)
+                item.props.line = int(line)
+
+            # XXX: not efficient use of roundtrips to/from pygobject
+            if item.props.message:
+                item.props.message += '\n' + message
+            else:
+                item.props.message = message
+
+        if item.props.file and not skip:
+            items.append(item)
 
-        threading.Thread(target=communicate, args=[p], name='todo-thread').start()
+        return items
 
 class TodoItem(GObject.Object):
     message = GObject.Property(type=str)
@@ -4,14 +4,45 @@
 
 #include "util/ide-line-reader.h"
 
+#define SENTINEL_KEY "test-fuzzy sentinel key"
+
+static guint
+find_id (Fuzzy       *fuzzy,
+         const gchar *key)
+{
+  GArray *ar;
+  guint id = G_MAXUINT;
+
+  ar = fuzzy_match (fuzzy, key, 0);
+
+  for (guint i = 0; ar != NULL && i < ar->len; i++)
+    {
+      FuzzyMatch *m = &g_array_index (ar, FuzzyMatch, i);
+
+      if (g_strcmp0 (m->key, key) == 0)
+        id = m->id;
+    }
+
+  g_clear_pointer (&ar, g_array_unref);
+
+  g_assert_cmpint (id, !=, G_MAXUINT);
+
+  return id;
+}
+
 int
 main (int argc,
       char *argv[])
 {
   IdeLineReader reader;
+  FuzzyRefinement *refinement;
   const gchar *param;
+  GPtrArray *keys;
+  GVariant *variant;
+  Fuzzy *restored;
   Fuzzy *fuzzy;
   GArray *ar;
+  guint n_keys = 0;
   gchar *contents;
   gchar *line;
   gsize len;
@@ -42,7 +73,13 @@ main (int argc,
   while ((line = ide_line_reader_next (&reader, &line_len)))
     {
       line [line_len] = '\0';
-      fuzzy_insert (fuzzy, line, NULL);
+
+      /* Empty keys are not indexed */
+      if (*line != '\0')
+        {
+          fuzzy_insert (fuzzy, line, NULL);
+          n_keys++;
+        }
     }
   fuzzy_end_bulk_insert (fuzzy);
   g_print ("Built.\n");
@@ -74,6 +111,11 @@ main (int argc,
 
   g_print ("%d matches\n", ar->len);
 
+  /* The keys point into the index, so copy them before changing it */
+  keys = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < ar->len; i++)
+    g_ptr_array_add (keys, g_strdup (g_array_index (ar, FuzzyMatch, i).key));
+
   g_print ("Testing removal\n");
 
   for (guint i = 0; i < ar->len; i++)
@@ -87,8 +129,66 @@ main (int argc,
   ar = fuzzy_match (fuzzy, param, 0);
   g_assert (ar == NULL || ar->len == 0);
   g_clear_pointer (&ar, g_array_unref);
+
+  for (guint i = 0; i < keys->len; i++)
+    g_assert (!fuzzy_contains (fuzzy, g_ptr_array_index (keys, i)));
+
+  g_print ("Testing batch removal\n");
+
+  refinement = fuzzy_refinement_new (fuzzy);
+
+  ar = fuzzy_refinement_match (refinement, param, 0);
+  g_assert (ar == NULL || ar->len == 0);
+  g_clear_pointer (&ar, g_array_unref);
+
+  /* Removed keys leave tombstones, so reinserted keys get new ids */
+  for (guint i = 0; i < keys->len; i++)
+    fuzzy_insert (fuzzy, g_ptr_array_index (keys, i), NULL);
+
+  /* The insertions bumped the generation, so no stale survivors are used */
+  ar = fuzzy_refinement_match (refinement, param, 0);
+  g_assert_cmpint (ar->len, ==, keys->len);
+  for (guint i = 0; i < ar->len; i++)
+    g_assert_cmpint (g_array_index (ar, FuzzyMatch, i).id, >=, n_keys);
+  g_clear_pointer (&ar, g_array_unref);
+
+  fuzzy_remove_many (fuzzy, (const gchar * const *)keys->pdata, keys->len);
+
+  ar = fuzzy_match (fuzzy, param, 0);
+  g_assert (ar == NULL || ar->len == 0);
+  g_clear_pointer (&ar, g_array_unref);
+
+  /* Likewise for the removal */
+  ar = fuzzy_refinement_match (refinement, param, 0);
+  g_assert (ar == NULL || ar->len == 0);
+  g_clear_pointer (&ar, g_array_unref);
+
+  fuzzy_refinement_free (refinement);
+
+  g_print ("Testing serialization\n");
+
+  /* Appended after both sets of tombstones */
+  fuzzy_insert (fuzzy, SENTINEL_KEY, NULL);
+  g_assert_cmpint (find_id (fuzzy, SENTINEL_KEY), ==, n_keys + keys->len);
+
+  variant = g_variant_ref_sink (fuzzy_to_variant (fuzzy));
+  restored = fuzzy_new_from_variant (variant);
+  g_assert (restored != NULL);
+
+  /* Tombstones are compacted away when serializing */
+  g_assert_cmpint (find_id (restored, SENTINEL_KEY), ==, n_keys - keys->len);
+
+  /* Only the sentinel could still match, never a removed key */
+  ar = fuzzy_match (restored, param, 0);
+  for (guint i = 0; ar != NULL && i < ar->len; i++)
+    g_assert_cmpstr (g_array_index (ar, FuzzyMatch, i).key, ==, SENTINEL_KEY);
+  g_clear_pointer (&ar, g_array_unref);
+
   g_print ("success.\n");
 
+  g_variant_unref (variant);
+  g_ptr_array_unref (keys);
+  fuzzy_unref (restored);
   fuzzy_unref (fuzzy);
 
   return 0;
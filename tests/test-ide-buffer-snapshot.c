@@ -0,0 +1,369 @@
+/* test-ide-buffer-snapshot.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+#include "buffers/ide-buffer-snapshot-private.h"
+
+/* Must match ide-buffer-snapshot.c */
+#define CHUNK_SIZE     4096
+#define MAX_CHUNK_SIZE (CHUNK_SIZE * 2)
+
+/* é, ☃ and 😀 take two, three and four bytes */
+#define E_ACUTE "\xc3\xa9"
+#define SNOWMAN "\xe2\x98\x83"
+#define SMILE   "\xf0\x9f\x98\x80"
+
+/*
+ * The rope is checked against a plain string that receives the same
+ * edits, using character offsets like IdeBuffer does.
+ */
+static void
+model_insert (GString     *model,
+              gint         offset,
+              const gchar *text)
+{
+  g_string_insert (model, g_utf8_offset_to_pointer (model->str, offset) - model->str, text);
+}
+
+static void
+model_delete (GString *model,
+              gint     begin_offset,
+              gint     end_offset)
+{
+  const gchar *begin = g_utf8_offset_to_pointer (model->str, begin_offset);
+  const gchar *end = g_utf8_offset_to_pointer (model->str, end_offset);
+
+  g_string_erase (model, begin - model->str, end - begin);
+}
+
+static void
+rope_insert (IdeBufferRope *rope,
+             GString       *model,
+             gint           offset,
+             const gchar   *text)
+{
+  ide_buffer_rope_insert (rope, offset, text, strlen (text));
+  model_insert (model, offset, text);
+}
+
+static void
+rope_delete (IdeBufferRope *rope,
+             GString       *model,
+             gint           begin_offset,
+             gint           end_offset)
+{
+  ide_buffer_rope_delete (rope, begin_offset, end_offset);
+  model_delete (model, begin_offset, end_offset);
+}
+
+static void
+check_snapshot (IdeBufferSnapshot *snapshot,
+                const gchar       *expected)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  gsize expected_len = strlen (expected);
+  gsize total = 0;
+  guint n_chunks;
+
+  bytes = ide_buffer_snapshot_get_bytes (snapshot);
+  g_assert_cmpuint (g_bytes_get_size (bytes), ==, expected_len);
+  g_assert_cmpuint (ide_buffer_snapshot_get_length (snapshot), ==, expected_len);
+  g_assert (memcmp (g_bytes_get_data (bytes, NULL), expected, expected_len) == 0);
+
+  n_chunks = ide_buffer_snapshot_get_n_chunks (snapshot);
+
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      const gchar *data;
+      gsize len;
+
+      data = ide_buffer_snapshot_get_chunk (snapshot, i, &len);
+
+      /* Chunks never split a UTF-8 sequence */
+      g_assert (g_utf8_validate (data, len, NULL));
+      g_assert_cmpuint (len, <=, MAX_CHUNK_SIZE);
+      g_assert (memcmp (data, expected + total, len) == 0);
+
+      total += len;
+    }
+
+  g_assert_cmpuint (total, ==, expected_len);
+}
+
+static void
+check_rope (IdeBufferRope *rope,
+            GString       *model)
+{
+  g_autoptr(IdeBufferSnapshot) snapshot = NULL;
+
+  snapshot = ide_buffer_rope_snapshot (rope, 0, FALSE);
+  check_snapshot (snapshot, model->str);
+}
+
+static gchar *
+repeat (const gchar *str,
+        guint        count)
+{
+  GString *ret = g_string_new (NULL);
+
+  for (guint i = 0; i < count; i++)
+    g_string_append (ret, str);
+
+  return g_string_free (ret, FALSE);
+}
+
+static void
+test_chunk_boundaries (void)
+{
+  g_autoptr(GString) model = NULL;
+  g_autofree gchar *text = NULL;
+  g_autofree gchar *large = NULL;
+  IdeBufferRope *rope;
+
+  /* Three full chunks of ASCII, so characters and bytes line up */
+  text = repeat ("0123456789abcdef", CHUNK_SIZE * 3 / 16);
+  model = g_string_new (text);
+  rope = ide_buffer_rope_new (text, strlen (text));
+  check_rope (rope, model);
+
+  /* Right at, before and after the boundaries between chunks */
+  rope_insert (rope, model, CHUNK_SIZE, "[at]");
+  check_rope (rope, model);
+  rope_insert (rope, model, CHUNK_SIZE - 1, "[before]");
+  check_rope (rope, model);
+  rope_insert (rope, model, CHUNK_SIZE * 2 + 13, "[after]");
+  check_rope (rope, model);
+
+  /* At both ends of the rope */
+  rope_insert (rope, model, 0, "[start]");
+  rope_insert (rope, model, g_utf8_strlen (model->str, -1), "[end]");
+  check_rope (rope, model);
+
+  /* Deletions spanning one, two and three chunks */
+  rope_delete (rope, model, CHUNK_SIZE - 10, CHUNK_SIZE + 10);
+  check_rope (rope, model);
+  rope_delete (rope, model, 100, CHUNK_SIZE * 2);
+  check_rope (rope, model);
+
+  /* More than fits in a chunk, forcing it to be split */
+  large = repeat ("xyz", MAX_CHUNK_SIZE / 2);
+  rope_insert (rope, model, 50, large);
+  check_rope (rope, model);
+
+  /* Everything, and then start over */
+  rope_delete (rope, model, 0, g_utf8_strlen (model->str, -1));
+  check_rope (rope, model);
+  g_assert_cmpuint (model->len, ==, 0);
+
+  rope_insert (rope, model, 0, "again");
+  check_rope (rope, model);
+
+  ide_buffer_rope_free (rope);
+}
+
+static void
+test_multibyte (void)
+{
+  g_autoptr(GString) model = NULL;
+  g_autofree gchar *text = NULL;
+  g_autofree gchar *large = NULL;
+  IdeBufferRope *rope;
+  gint n_chars;
+
+  /*
+   * Ten bytes per repetition, so the initial split at CHUNK_SIZE falls
+   * within a sequence and must be moved back to its start.
+   */
+  text = repeat ("a" E_ACUTE SNOWMAN SMILE, CHUNK_SIZE * 3 / 10);
+  model = g_string_new (text);
+  rope = ide_buffer_rope_new (text, strlen (text));
+  check_rope (rope, model);
+
+  n_chars = g_utf8_strlen (model->str, -1);
+
+  /* Offsets are characters, not bytes */
+  for (gint offset = n_chars / 3 - 4; offset < n_chars / 3 + 4; offset++)
+    {
+      rope_insert (rope, model, offset, SMILE);
+      check_rope (rope, model);
+    }
+
+  for (gint offset = n_chars / 2 + 4; offset > n_chars / 2 - 4; offset--)
+    {
+      rope_delete (rope, model, offset - 1, offset + 1);
+      check_rope (rope, model);
+    }
+
+  /* Forces a split of mostly four byte characters */
+  large = repeat (SMILE, MAX_CHUNK_SIZE / 4 + 1);
+  rope_insert (rope, model, 1, large);
+  check_rope (rope, model);
+
+  n_chars = g_utf8_strlen (model->str, -1);
+  rope_delete (rope, model, 3, n_chars - 3);
+  check_rope (rope, model);
+
+  ide_buffer_rope_free (rope);
+}
+
+static void
+test_slice (void)
+{
+  g_autoptr(IdeBufferSnapshot) snapshot = NULL;
+  g_autoptr(GString) model = NULL;
+  g_autofree gchar *text = NULL;
+  IdeBufferRope *rope;
+  gint n_chars;
+
+  text = repeat (SNOWMAN "b" E_ACUTE, CHUNK_SIZE);
+  model = g_string_new (text);
+  rope = ide_buffer_rope_new (text, strlen (text));
+  snapshot = ide_buffer_rope_snapshot (rope, 0, TRUE);
+  n_chars = g_utf8_strlen (text, -1);
+
+  for (gint begin = 0; begin < n_chars; begin += 997)
+    {
+      for (gint end = begin; end < n_chars; end += 1511)
+        {
+          g_autofree gchar *slice = NULL;
+          g_autofree gchar *expected = NULL;
+          const gchar *b = g_utf8_offset_to_pointer (text, begin);
+          const gchar *e = g_utf8_offset_to_pointer (text, end);
+
+          slice = ide_buffer_snapshot_get_slice (snapshot, begin, end);
+          expected = g_strndup (b, e - b);
+          g_assert_cmpstr (slice, ==, expected);
+        }
+    }
+
+  /* The trailing newline is part of the snapshot, but not of the rope */
+  g_string_append_c (model, '\n');
+  check_snapshot (snapshot, model->str);
+
+  ide_buffer_rope_free (rope);
+}
+
+static void
+test_snapshots (void)
+{
+  g_autoptr(IdeBufferSnapshot) before = NULL;
+  g_autoptr(IdeBufferSnapshot) during = NULL;
+  g_autoptr(GString) model = NULL;
+  g_autofree gchar *text = NULL;
+  g_autofree gchar *before_text = NULL;
+  g_autofree gchar *during_text = NULL;
+  IdeBufferRope *rope;
+
+  text = repeat ("line " SNOWMAN "\n", CHUNK_SIZE / 4);
+  model = g_string_new (text);
+  rope = ide_buffer_rope_new (text, strlen (text));
+
+  before = ide_buffer_rope_snapshot (rope, 1, FALSE);
+  before_text = g_strdup (model->str);
+  g_assert_cmpuint (ide_buffer_snapshot_get_change_count (before), ==, 1);
+
+  /* Edits after a snapshot must copy the chunks it shares */
+  rope_insert (rope, model, 10, "inserted");
+  rope_delete (rope, model, CHUNK_SIZE - 5, CHUNK_SIZE + 5);
+
+  during = ide_buffer_rope_snapshot (rope, 2, FALSE);
+  during_text = g_strdup (model->str);
+
+  rope_insert (rope, model, 10, E_ACUTE);
+  rope_delete (rope, model, 0, 5);
+  rope_insert (rope, model, g_utf8_strlen (model->str, -1), "tail");
+
+  check_snapshot (before, before_text);
+  check_snapshot (during, during_text);
+  check_rope (rope, model);
+
+  /* Snapshots outlive the rope */
+  ide_buffer_rope_free (rope);
+
+  check_snapshot (before, before_text);
+  check_snapshot (during, during_text);
+}
+
+static void
+test_random (void)
+{
+  static const gchar *pieces[] = { "a", "bc", "\n", E_ACUTE, SNOWMAN, SMILE, "    " };
+  g_autoptr(GPtrArray) snapshots = NULL;
+  g_autoptr(GPtrArray) expected = NULL;
+  g_autoptr(GString) model = NULL;
+  IdeBufferRope *rope;
+
+  snapshots = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_buffer_snapshot_unref);
+  expected = g_ptr_array_new_with_free_func (g_free);
+  model = g_string_new (NULL);
+  rope = ide_buffer_rope_new (NULL, 0);
+
+  for (guint i = 0; i < 2000; i++)
+    {
+      gint n_chars = g_utf8_strlen (model->str, -1);
+
+      if (n_chars == 0 || g_test_rand_int_range (0, 3) > 0)
+        {
+          g_autoptr(GString) text = g_string_new (NULL);
+          gint count = g_test_rand_int_range (1, g_test_rand_bit () ? 20 : 3000);
+
+          for (gint j = 0; j < count; j++)
+            g_string_append (text, pieces [g_test_rand_int_range (0, G_N_ELEMENTS (pieces))]);
+
+          rope_insert (rope, model, g_test_rand_int_range (0, n_chars + 1), text->str);
+        }
+      else
+        {
+          gint begin = g_test_rand_int_range (0, n_chars);
+          gint end = MIN (n_chars, begin + g_test_rand_int_range (1, g_test_rand_bit () ? 10 : 5000));
+
+          rope_delete (rope, model, begin, end);
+        }
+
+      if (i % 50 == 0)
+        {
+          g_ptr_array_add (snapshots, ide_buffer_rope_snapshot (rope, i, FALSE));
+          g_ptr_array_add (expected, g_strdup (model->str));
+        }
+
+      if (i % 10 == 0)
+        check_rope (rope, model);
+    }
+
+  check_rope (rope, model);
+
+  for (guint i = 0; i < snapshots->len; i++)
+    check_snapshot (g_ptr_array_index (snapshots, i), g_ptr_array_index (expected, i));
+
+  ide_buffer_rope_free (rope);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/BufferSnapshot/chunk-boundaries", test_chunk_boundaries);
+  g_test_add_func ("/Ide/BufferSnapshot/multibyte", test_multibyte);
+  g_test_add_func ("/Ide/BufferSnapshot/slice", test_slice);
+  g_test_add_func ("/Ide/BufferSnapshot/snapshots", test_snapshots);
+  g_test_add_func ("/Ide/BufferSnapshot/random", test_random);
+  return g_test_run ();
+}
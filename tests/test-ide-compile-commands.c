@@ -0,0 +1,186 @@
+/* test-ide-compile-commands.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+
+static IdeCompileCommands *
+load_fixture (const gchar *name)
+{
+  g_autoptr(IdeCompileCommands) commands = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autofree gchar *path = NULL;
+
+  path = g_build_filename (TEST_DATA_DIR, "compile-commands", name, NULL);
+  file = g_file_new_for_path (path);
+
+  commands = ide_compile_commands_new ();
+  g_assert (ide_compile_commands_load (commands, file, NULL, &error));
+  g_assert_no_error (error);
+
+  return g_steal_pointer (&commands);
+}
+
+static void
+check_lookup (IdeCompileCommands  *commands,
+              const gchar         *path,
+              const gchar         *directory,
+              const gchar * const *expected)
+{
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  g_autoptr(GFile) dir = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *dir_path = NULL;
+  g_auto(GStrv) flags = NULL;
+
+  flags = ide_compile_commands_lookup (commands, file, &dir, &error);
+  g_assert_no_error (error);
+  g_assert (flags != NULL);
+
+  for (guint i = 0; expected [i] != NULL; i++)
+    {
+      if (flags [i] == NULL)
+        g_error ("%s: missing \"%s\"", path, expected [i]);
+      g_assert_cmpstr (flags [i], ==, expected [i]);
+    }
+
+  g_assert_cmpint (g_strv_length (flags), ==, g_strv_length ((gchar **)expected));
+
+  dir_path = g_file_get_path (dir);
+  g_assert_cmpstr (dir_path, ==, directory);
+}
+
+static void
+check_not_found (IdeCompileCommands *commands,
+                 const gchar        *path)
+{
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  g_autoptr(GError) error = NULL;
+  g_auto(GStrv) flags = NULL;
+
+  flags = ide_compile_commands_lookup (commands, file, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert (flags == NULL);
+}
+
+static void
+test_command (void)
+{
+  static const gchar *main_flags[] = {
+    "-I/home/user/project/include",
+    "-I/home/user/project/build/inc",
+    "-isystem", "/usr/include/foo",
+    "-include", "/home/user/project/build/config.h",
+    "-DNAME=value",
+    "-D", "FOO",
+    "-Wall",
+    "-fPIC",
+    "-std=gnu11",
+    NULL
+  };
+  g_autoptr(IdeCompileCommands) commands = NULL;
+
+  commands = load_fixture ("command.json");
+
+  /*
+   * The file is relative to the directory, unknown keys with nested values
+   * are skipped, and only the first command for a file is used.
+   */
+  check_lookup (commands, "/home/user/project/src/main.c", "/home/user/project/build", main_flags);
+
+  /* Entries without a command are not indexed */
+  check_not_found (commands, "/home/user/project/src/no-command.c");
+  check_not_found (commands, "/home/user/project/src/missing.c");
+}
+
+static void
+test_decode_string (void)
+{
+  /* ☃, the surrogate pair 😀, and \t within quotes */
+  static const gchar *cafe_flags[] = {
+    "-DSNOWMAN=\xe2\x98\x83",
+    "-DSMILE=\xf0\x9f\x98\x80",
+    "-DTAB=a\tb",
+    NULL
+  };
+  g_autoptr(IdeCompileCommands) commands = NULL;
+
+  commands = load_fixture ("command.json");
+
+  /* The file name uses é and the directory escapes its slashes */
+  check_lookup (commands, "/home/user/project/src/caf\xc3\xa9.c", "/home/user/project/build", cafe_flags);
+}
+
+static void
+test_arguments (void)
+{
+  static const gchar *util_flags[] = {
+    "-I/home/user/project/include",
+    "-iquote", "/home/user/project/src",
+    "-DPATH=\"/usr/share\"",
+    "-Wextra",
+    "-march=native",
+    "-x", "c",
+    NULL
+  };
+  static const gchar *empty_flags[] = { NULL };
+  g_autoptr(IdeCompileCommands) commands = NULL;
+
+  commands = load_fixture ("arguments.json");
+
+  /* Arguments are not passed through the shell, so quotes are kept */
+  check_lookup (commands, "/home/user/project/src/util.c", "/home/user/project", util_flags);
+  check_lookup (commands, "/home/user/project/src/empty.c", "/home/user/project", empty_flags);
+}
+
+static void
+test_invalid (void)
+{
+  g_autoptr(IdeCompileCommands) commands = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFile) source = NULL;
+  g_autofree gchar *path = NULL;
+  g_auto(GStrv) flags = NULL;
+
+  commands = ide_compile_commands_new ();
+  source = g_file_new_for_path ("/home/user/project/a.c");
+
+  flags = ide_compile_commands_lookup (commands, source, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED);
+  g_assert (flags == NULL);
+  g_clear_error (&error);
+
+  path = g_build_filename (TEST_DATA_DIR, "compile-commands", "truncated.json", NULL);
+  file = g_file_new_for_path (path);
+
+  g_assert (!ide_compile_commands_load (commands, file, NULL, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/CompileCommands/command", test_command);
+  g_test_add_func ("/Ide/CompileCommands/decode_string", test_decode_string);
+  g_test_add_func ("/Ide/CompileCommands/arguments", test_arguments);
+  g_test_add_func ("/Ide/CompileCommands/invalid", test_invalid);
+  return g_test_run ();
+}
@@ -16,12 +16,243 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <ide.h>
+#include <libpeas/peas.h>
+#include <string.h>
 
-#include "ctags/ide-ctags-index.h"
+#include "ide-ctags-builder.h"
+#include "ide-ctags-index.h"
+
+void _ide_ctags_index_register_type (GTypeModule *module);
+
+/* The index is a dynamic type, so it needs a module to register it with */
+typedef GTypeModule      TestModule;
+typedef GTypeModuleClass TestModuleClass;
+
+G_DEFINE_TYPE (TestModule, test_module, G_TYPE_TYPE_MODULE)
 
 static GMainLoop *main_loop;
 
+static gboolean
+test_module_load (GTypeModule *module)
+{
+  return TRUE;
+}
+
+static void
+test_module_unload (GTypeModule *module)
+{
+}
+
+static void
+test_module_class_init (TestModuleClass *klass)
+{
+  GTypeModuleClass *module_class = G_TYPE_MODULE_CLASS (klass);
+
+  module_class->load = test_module_load;
+  module_class->unload = test_module_unload;
+}
+
+static void
+test_module_init (TestModule *self)
+{
+}
+
+static void
+write_file (const gchar *dir,
+            const gchar *name,
+            const gchar *contents)
+{
+  g_autofree gchar *path = g_build_filename (dir, name, NULL);
+  g_autofree gchar *parent = g_path_get_dirname (path);
+  g_autoptr(GError) error = NULL;
+
+  g_assert_cmpint (g_mkdir_with_parents (parent, 0750), ==, 0);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+}
+
+static gchar *
+read_file (GFile *file)
+{
+  g_autoptr(GError) error = NULL;
+  gchar *contents = NULL;
+
+  g_file_load_contents (file, NULL, &contents, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  return contents;
+}
+
+static void
+remove_tree (GFile *file)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  gpointer infoptr;
+
+  enumerator = g_file_enumerate_children (file,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          NULL,
+                                          NULL);
+
+  while (enumerator != NULL &&
+         NULL != (infoptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      g_autoptr(GFile) child = g_file_get_child (file, g_file_info_get_name (info));
+
+      remove_tree (child);
+    }
+
+  g_file_delete (file, NULL, NULL);
+}
+
+static void
+async_result_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  GAsyncResult **ret = user_data;
+
+  *ret = g_object_ref (result);
+}
+
+static IdeContext *
+create_context (GFile *project_dir)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  PeasEngine *engine = peas_engine_get_default ();
+  PeasPluginInfo *plugin_info;
+  IdeContext *context;
+
+  /* The directory plugin provides the fallback VCS and build system */
+  if (!(plugin_info = peas_engine_get_plugin_info (engine, "directory-plugin")))
+    {
+      peas_engine_prepend_search_path (engine, "resource:///org/gnome/builder/plugins", NULL);
+      plugin_info = peas_engine_get_plugin_info (engine, "directory-plugin");
+    }
+
+  g_assert (plugin_info != NULL);
+  g_assert (peas_engine_load_plugin (engine, plugin_info));
+
+  ide_context_new_async (project_dir, NULL, async_result_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CONTEXT (context));
+
+  return context;
+}
+
+static GBytes *
+update_file (IdeCtagsBuilder  *builder,
+             GFile            *file,
+             GFile           **tags_file)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  GBytes *bytes;
+
+  ide_ctags_builder_update_file_async (builder, file, NULL, async_result_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  bytes = ide_ctags_builder_update_file_finish (builder, result, tags_file, &error);
+  g_assert_no_error (error);
+  g_assert (bytes != NULL);
+
+  return bytes;
+}
+
+static gboolean
+bytes_contains (GBytes      *bytes,
+                const gchar *needle)
+{
+  g_autofree gchar *str = g_strndup (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+
+  return strstr (str, needle) != NULL;
+}
+
+static IdeCtagsIndex *
+load_index (GFile *tags_file)
+{
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeCtagsIndex *index;
+
+  index = ide_ctags_index_new (tags_file, NULL, 0);
+  g_async_initable_init_async (G_ASYNC_INITABLE (index),
+                               G_PRIORITY_DEFAULT,
+                               NULL,
+                               async_result_cb,
+                               &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_async_initable_init_finish (G_ASYNC_INITABLE (index), result, &error);
+  g_assert_no_error (error);
+
+  return index;
+}
+
+static gboolean
+index_contains (IdeCtagsIndex *index,
+                const gchar   *name)
+{
+  g_autoptr(GArray) entries = ide_ctags_index_lookup (index, name);
+
+  return entries != NULL;
+}
+
+static guint64
+get_mtime (GFile *file)
+{
+  g_autoptr(GFileInfo) info = NULL;
+  g_autoptr(GError) error = NULL;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            &error);
+  g_assert_no_error (error);
+
+  return g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static void
+set_mtime (GFile   *file,
+           guint64  mtime)
+{
+  g_autoptr(GFileInfo) info = g_file_info_new ();
+  g_autoptr(GError) error = NULL;
+
+  g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime / G_USEC_PER_SEC);
+  g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, mtime % G_USEC_PER_SEC);
+  g_file_set_attributes_from_info (file, info, G_FILE_QUERY_INFO_NONE, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static gchar *
+get_binary_path (GFile *tags_file)
+{
+  g_autofree gchar *path = g_file_get_path (tags_file);
+  g_autofree gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, path, -1);
+  g_autofree gchar *name = g_strdup_printf ("%s.idx", checksum);
+
+  return g_build_filename (g_get_user_cache_dir (), ide_get_program_name (), "ctags-index", name, NULL);
+}
+
 static void
 init_cb (GObject      *object,
          GAsyncResult *result,
@@ -29,8 +260,7 @@ init_cb (GObject      *object,
 {
   GAsyncInitable *initable = (GAsyncInitable *)object;
   IdeCtagsIndex *index = (IdeCtagsIndex *)object;
-  const IdeCtagsIndexEntry *entries;
-  gsize n_entries = 0xFFFFFFFF;
+  GArray *entries;
   GError *error = NULL;
   gboolean ret;
   gsize i;
@@ -46,27 +276,38 @@ init_cb (GObject      *object,
 
   g_assert_cmpint (815, ==, ide_ctags_index_get_size (index));
 
-  entries = ide_ctags_index_lookup (index, "__NOTHING_SHOULD_MATCH_THIS__", &n_entries);
-  g_assert_cmpint (n_entries, ==, 0);
+  entries = ide_ctags_index_lookup (index, "__NOTHING_SHOULD_MATCH_THIS__");
   g_assert (entries == NULL);
 
-  entries = ide_ctags_index_lookup (index, "IdeBuildResult", &n_entries);
-  g_assert_cmpint (n_entries, ==, 2);
+  entries = ide_ctags_index_lookup (index, "IdeBuildResult");
   g_assert (entries != NULL);
+  g_assert_cmpint (entries->len, ==, 2);
   for (i = 0; i < 2; i++)
-    g_assert_cmpstr (entries [i].name, ==, "IdeBuildResult");
+    g_assert_cmpstr (g_array_index (entries, IdeCtagsIndexEntry, i).name, ==, "IdeBuildResult");
+  g_array_unref (entries);
 
-  entries = ide_ctags_index_lookup (index, "IdeDiagnosticProvider.functions", &n_entries);
-  g_assert_cmpint (n_entries, ==, 1);
+  entries = ide_ctags_index_lookup (index, "IdeDiagnosticProvider.functions");
   g_assert (entries != NULL);
-  g_assert_cmpstr (entries->name, ==, "IdeDiagnosticProvider.functions");
-  g_assert_cmpint (entries->kind, ==, IDE_CTAGS_INDEX_ENTRY_ANCHOR);
+  g_assert_cmpint (entries->len, ==, 1);
+  g_assert_cmpstr (g_array_index (entries, IdeCtagsIndexEntry, 0).name, ==, "IdeDiagnosticProvider.functions");
+  g_assert_cmpint (g_array_index (entries, IdeCtagsIndexEntry, 0).kind, ==, IDE_CTAGS_INDEX_ENTRY_ANCHOR);
+  g_array_unref (entries);
+
+  /* Lookups must not match on a prefix of the name */
+  entries = ide_ctags_index_lookup (index, "IdeDiagnosticProvider");
+  if (entries != NULL)
+    {
+      for (i = 0; i < entries->len; i++)
+        g_assert_cmpstr (g_array_index (entries, IdeCtagsIndexEntry, i).name, ==, "IdeDiagnosticProvider");
+      g_array_unref (entries);
+    }
 
-  entries = ide_ctags_index_lookup_prefix (index, "Ide", &n_entries);
-  g_assert_cmpint (n_entries, ==, 815);
+  entries = ide_ctags_index_lookup_prefix (index, "Ide");
   g_assert (entries != NULL);
+  g_assert_cmpint (entries->len, ==, 815);
   for (i = 0; i < 815; i++)
-    g_assert (g_str_has_prefix (entries [i].name, "Ide"));
+    g_assert (g_str_has_prefix (g_array_index (entries, IdeCtagsIndexEntry, i).name, "Ide"));
+  g_array_unref (entries);
 
   g_main_loop_quit (main_loop);
 }
@@ -83,7 +324,7 @@ test_ctags_basic (void)
   path = g_build_filename (TEST_DATA_DIR, "project1", "tags", NULL);
   test_file = g_file_new_for_path (path);
 
-  index = ide_ctags_index_new (test_file);
+  index = ide_ctags_index_new (test_file, NULL, 0);
 
   g_async_initable_init_async (G_ASYNC_INITABLE (index),
                                G_PRIORITY_DEFAULT,
@@ -98,11 +339,246 @@ test_ctags_basic (void)
   g_object_unref (test_file);
 }
 
+static void
+test_ctags_update_file (void)
+{
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(IdeTagsBuilder) builder = NULL;
+  g_autoptr(GFile) project_dir = NULL;
+  g_autoptr(GFile) file_a = NULL;
+  g_autoptr(GFile) file_b = NULL;
+  g_autoptr(GFile) tags_file = NULL;
+  g_autoptr(GFile) other_tags_file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *ctags = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  g_autofree gchar *expected = NULL;
+  g_autofree gchar *tags_path = NULL;
+  g_autofree gchar *contents = NULL;
+
+  if (!(ctags = g_find_program_in_path ("ctags")))
+    {
+      g_test_skip ("ctags is not installed");
+      return;
+    }
+
+  tmpdir = g_dir_make_tmp ("test-ide-ctags-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  write_file (tmpdir, "src/a.c", "int first_function (void) { return 0; }\n");
+  write_file (tmpdir, "src/b.c", "int other_function (void) { return 1; }\n");
+
+  project_dir = g_file_new_for_path (tmpdir);
+  file_a = g_file_resolve_relative_path (project_dir, "src/a.c");
+  file_b = g_file_resolve_relative_path (project_dir, "src/b.c");
+
+  context = create_context (project_dir);
+  builder = ide_ctags_builder_new (context);
+
+  /* The tags file mirrors the source tree within the cache directory */
+  bytes = update_file (IDE_CTAGS_BUILDER (builder), file_a, &tags_file);
+  g_assert (bytes_contains (bytes, "first_function"));
+  g_assert (!bytes_contains (bytes, "other_function"));
+
+  expected = g_build_filename (g_get_user_cache_dir (),
+                               ide_get_program_name (),
+                               "tags",
+                               ide_project_get_id (ide_context_get_project (context)),
+                               "src",
+                               "tags",
+                               NULL);
+  tags_path = g_file_get_path (tags_file);
+  g_assert_cmpstr (tags_path, ==, expected);
+
+  contents = read_file (tags_file);
+  g_assert (strstr (contents, "first_function\ta.c\t") != NULL);
+  g_clear_pointer (&contents, g_free);
+  g_clear_pointer (&bytes, g_bytes_unref);
+
+  /* Other files in the directory are kept when one of them is updated */
+  bytes = update_file (IDE_CTAGS_BUILDER (builder), file_b, &other_tags_file);
+  g_assert (g_file_equal (tags_file, other_tags_file));
+  g_clear_pointer (&bytes, g_bytes_unref);
+
+  write_file (tmpdir, "src/a.c", "int second_function (void) { return 0; }\n");
+  bytes = update_file (IDE_CTAGS_BUILDER (builder), file_a, NULL);
+  g_assert (bytes_contains (bytes, "second_function"));
+
+  contents = read_file (tags_file);
+  g_assert (strstr (contents, "first_function") == NULL);
+  g_assert (strstr (contents, "second_function\ta.c\t") != NULL);
+  g_assert (strstr (contents, "other_function\tb.c\t") != NULL);
+
+  remove_tree (project_dir);
+}
+
+/* Both have the same size, so only the mtime tells them apart */
+#define TAGS_ALPHA "alpha\ta.c\t/^int alpha;$/;\"\tv\n"
+#define TAGS_GAMMA "gamma\ta.c\t/^int gamma;$/;\"\tv\n"
+
+static void
+test_ctags_binary (void)
+{
+  g_autoptr(IdeCtagsIndex) index = NULL;
+  g_autoptr(GFile) dir = NULL;
+  g_autoptr(GFile) tags_file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  g_autofree gchar *binary_path = NULL;
+  guint64 mtime;
+
+  tmpdir = g_dir_make_tmp ("test-ide-ctags-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  dir = g_file_new_for_path (tmpdir);
+  tags_file = g_file_get_child (dir, "tags");
+  binary_path = get_binary_path (tags_file);
+
+  /* Parsing the tags file writes the binary index */
+  write_file (tmpdir, "tags", TAGS_ALPHA);
+  index = load_index (tags_file);
+  g_assert_cmpint (ide_ctags_index_get_size (index), ==, 1);
+  g_assert (index_contains (index, "alpha"));
+  g_assert (g_file_test (binary_path, G_FILE_TEST_IS_REGULAR));
+  g_clear_object (&index);
+
+  /* With the same size and mtime, the binary index is used */
+  mtime = get_mtime (tags_file);
+  write_file (tmpdir, "tags", TAGS_GAMMA);
+  set_mtime (tags_file, mtime);
+
+  index = load_index (tags_file);
+  g_assert_cmpint (ide_ctags_index_get_size (index), ==, 1);
+  g_assert (index_contains (index, "alpha"));
+  g_assert (!index_contains (index, "gamma"));
+  g_clear_object (&index);
+
+  /* A microsecond of difference makes it stale */
+  set_mtime (tags_file, mtime + 1);
+
+  index = load_index (tags_file);
+  g_assert_cmpint (ide_ctags_index_get_size (index), ==, 1);
+  g_assert (!index_contains (index, "alpha"));
+  g_assert (index_contains (index, "gamma"));
+  g_clear_object (&index);
+
+  remove_tree (dir);
+}
+
+static void
+test_ctags_binary_truncated (void)
+{
+  g_autoptr(IdeCtagsIndex) index = NULL;
+  g_autoptr(GFile) dir = NULL;
+  g_autoptr(GFile) tags_file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  g_autofree gchar *binary_path = NULL;
+  g_autofree gchar *contents = NULL;
+  gsize length = 0;
+  guint64 mtime;
+
+  tmpdir = g_dir_make_tmp ("test-ide-ctags-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  dir = g_file_new_for_path (tmpdir);
+  tags_file = g_file_get_child (dir, "tags");
+  binary_path = get_binary_path (tags_file);
+
+  write_file (tmpdir, "tags", TAGS_ALPHA);
+  index = load_index (tags_file);
+  g_assert (index_contains (index, "alpha"));
+  g_clear_object (&index);
+
+  /* Cut the binary index short, while it still matches the tags file */
+  g_file_get_contents (binary_path, &contents, &length, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (length, >, 1);
+  g_file_set_contents (binary_path, contents, length - 1, &error);
+  g_assert_no_error (error);
+
+  mtime = get_mtime (tags_file);
+  write_file (tmpdir, "tags", TAGS_GAMMA);
+  set_mtime (tags_file, mtime);
+
+  /* So the tags file must be parsed again */
+  index = load_index (tags_file);
+  g_assert_cmpint (ide_ctags_index_get_size (index), ==, 1);
+  g_assert (!index_contains (index, "alpha"));
+  g_assert (index_contains (index, "gamma"));
+  g_clear_object (&index);
+
+  remove_tree (dir);
+}
+
+static void
+test_ctags_splice (void)
+{
+  g_autoptr(IdeCtagsIndex) index = NULL;
+  g_autoptr(IdeCtagsIndex) spliced = NULL;
+  g_autoptr(GFile) dir = NULL;
+  g_autoptr(GFile) tags_file = NULL;
+  g_autoptr(GBytes) tags = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *tmpdir = NULL;
+
+  tmpdir = g_dir_make_tmp ("test-ide-ctags-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  dir = g_file_new_for_path (tmpdir);
+  tags_file = g_file_get_child (dir, "tags");
+
+  write_file (tmpdir, "tags",
+              TAGS_ALPHA
+              "beta\tb.c\t/^int beta;$/;\"\tv\n");
+  index = load_index (tags_file);
+  g_assert_cmpint (ide_ctags_index_get_size (index), ==, 2);
+
+  /* Entries of a.c are replaced, and those of b.c kept */
+  tags = g_bytes_new_static (TAGS_GAMMA, strlen (TAGS_GAMMA));
+  spliced = ide_ctags_index_splice (index, "a.c", tags, 0);
+  g_assert_cmpint (ide_ctags_index_get_size (spliced), ==, 2);
+  g_assert (!index_contains (spliced, "alpha"));
+  g_assert (index_contains (spliced, "beta"));
+  g_assert (index_contains (spliced, "gamma"));
+
+  /* The original index is left alone */
+  g_assert (index_contains (index, "alpha"));
+  g_assert (!index_contains (index, "gamma"));
+
+  remove_tree (dir);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
 {
+  g_autoptr(GFile) cache_dir = NULL;
+  g_autofree gchar *cache_path = NULL;
+  GTypeModule *module;
+  gint ret;
+
+  /* Keep the indexes and tags we create out of the users cache */
+  cache_path = g_dir_make_tmp ("test-ide-ctags-cache-XXXXXX", NULL);
+  g_assert (cache_path != NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_path, TRUE);
+
   g_test_init (&argc, &argv, NULL);
+
+  module = g_object_new (test_module_get_type (), NULL);
+  g_type_module_use (module);
+  _ide_ctags_index_register_type (module);
+
   g_test_add_func ("/Ide/CTags/basic", test_ctags_basic);
-  return g_test_run ();
+  g_test_add_func ("/Ide/CTags/binary", test_ctags_binary);
+  g_test_add_func ("/Ide/CTags/binary_truncated", test_ctags_binary_truncated);
+  g_test_add_func ("/Ide/CTags/splice", test_ctags_splice);
+  g_test_add_func ("/Ide/CTags/update_file", test_ctags_update_file);
+  ret = g_test_run ();
+
+  cache_dir = g_file_new_for_path (cache_path);
+  remove_tree (cache_dir);
+
+  return ret;
 }
@@ -0,0 +1,330 @@
+/* test-ide-git-ignore-matcher.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "test-ide-git-ignore-matcher"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "ide-git-ignore-matcher.h"
+
+typedef struct
+{
+  const gchar *path;
+  gboolean     is_dir;
+  gboolean     ignored;
+} IgnoreTest;
+
+static void
+write_file (const gchar *dir,
+            const gchar *name,
+            const gchar *contents)
+{
+  g_autofree gchar *path = g_build_filename (dir, name, NULL);
+  g_autofree gchar *parent = g_path_get_dirname (path);
+  g_autoptr(GError) error = NULL;
+
+  g_assert_cmpint (g_mkdir_with_parents (parent, 0750), ==, 0);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+}
+
+static void
+remove_tree (GFile *file)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  gpointer infoptr;
+
+  enumerator = g_file_enumerate_children (file,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          NULL,
+                                          NULL);
+
+  while (enumerator != NULL &&
+         NULL != (infoptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      g_autoptr(GFile) child = g_file_get_child (file, g_file_info_get_name (info));
+
+      remove_tree (child);
+    }
+
+  g_file_delete (file, NULL, NULL);
+}
+
+static IdeGitIgnoreMatcher *
+create_matcher (gchar **tmpdir)
+{
+  g_autoptr(GFile) workdir = NULL;
+  g_autoptr(GFile) gitdir = NULL;
+  g_autofree gchar *excludes = NULL;
+  g_autoptr(GError) error = NULL;
+
+  *tmpdir = g_dir_make_tmp ("test-ide-git-ignore-matcher-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  write_file (*tmpdir, ".gitignore",
+              "# comments are skipped\n"
+              "*.o\n"
+              "!keep.o\n"
+              "build/\n"
+              "/only-root\n"
+              "doc/**/*.html\n"
+              "**/cache\n"
+              "*.log\n"
+              "\\#hash\n"
+              "[abc].txt\n"
+              "file?.md\n"
+              "!wanted.tmp\n");
+  write_file (*tmpdir, "sub/.gitignore", "!*.log\n");
+  write_file (*tmpdir, ".git/info/exclude", "*.tmp\n!keep.bak\n");
+  write_file (*tmpdir, "excludes", "*.bak\nwanted.tmp\n");
+
+  workdir = g_file_new_for_path (*tmpdir);
+  gitdir = g_file_get_child (workdir, ".git");
+  excludes = g_build_filename (*tmpdir, "excludes", NULL);
+
+  return ide_git_ignore_matcher_new (workdir, gitdir, excludes);
+}
+
+static void
+destroy_matcher (IdeGitIgnoreMatcher *matcher,
+                 gchar               *tmpdir)
+{
+  g_autoptr(GFile) file = g_file_new_for_path (tmpdir);
+
+  ide_git_ignore_matcher_free (matcher);
+  remove_tree (file);
+  g_free (tmpdir);
+}
+
+static void
+check_paths (IdeGitIgnoreMatcher *matcher,
+             const IgnoreTest    *tests,
+             guint                n_tests)
+{
+  for (guint i = 0; i < n_tests; i++)
+    {
+      gboolean ignored;
+
+      ignored = ide_git_ignore_matcher_is_ignored (matcher,
+                                                   tests [i].path,
+                                                   tests [i].is_dir ? G_FILE_TYPE_DIRECTORY
+                                                                    : G_FILE_TYPE_REGULAR);
+
+      if (ignored != tests [i].ignored)
+        g_error ("%s (%s) should %sbe ignored",
+                 tests [i].path,
+                 tests [i].is_dir ? "directory" : "file",
+                 tests [i].ignored ? "" : "not ");
+    }
+}
+
+static void
+test_wildmatch (void)
+{
+  static const IgnoreTest tests[] = {
+    { "a.o", FALSE, TRUE },
+    { "sub/b.o", FALSE, TRUE },
+    { "file1.md", FALSE, TRUE },
+    { "file12.md", FALSE, FALSE },
+    { "a.txt", FALSE, TRUE },
+    { "d.txt", FALSE, FALSE },
+    { "#hash", FALSE, TRUE },
+    { "hash", FALSE, FALSE },
+
+    /* A double star matches zero or more directories */
+    { "doc/x.html", FALSE, TRUE },
+    { "doc/a/b/x.html", FALSE, TRUE },
+    { "other/doc/x.html", FALSE, FALSE },
+    { "cache", TRUE, TRUE },
+    { "a/b/cache", TRUE, TRUE },
+    { "a/b/cache2", TRUE, FALSE },
+
+    /* A trailing slash only matches directories, at any depth */
+    { "build", TRUE, TRUE },
+    { "build", FALSE, FALSE },
+    { "sub/build", TRUE, TRUE },
+
+    /* A leading slash anchors to the directory of the .gitignore */
+    { "only-root", FALSE, TRUE },
+    { "sub/only-root", FALSE, FALSE },
+
+    /* Nothing within an ignored directory can be included again */
+    { "build/keep.o", FALSE, TRUE },
+
+    { ".git", TRUE, TRUE },
+  };
+  IdeGitIgnoreMatcher *matcher;
+  gchar *tmpdir = NULL;
+
+  matcher = create_matcher (&tmpdir);
+  check_paths (matcher, tests, G_N_ELEMENTS (tests));
+  destroy_matcher (matcher, tmpdir);
+}
+
+static void
+test_precedence (void)
+{
+  static const IgnoreTest tests[] = {
+    /* The last matching pattern within a file wins */
+    { "keep.o", FALSE, FALSE },
+
+    /* Deeper .gitignore files win over shallower ones */
+    { "x.log", FALSE, TRUE },
+    { "sub/x.log", FALSE, FALSE },
+    { "sub/deeper/x.log", FALSE, FALSE },
+
+    /* .gitignore wins over info/exclude, which wins over excludesFile */
+    { "x.tmp", FALSE, TRUE },
+    { "wanted.tmp", FALSE, FALSE },
+    { "other.bak", FALSE, TRUE },
+    { "keep.bak", FALSE, FALSE },
+  };
+  IdeGitIgnoreMatcher *matcher;
+  gchar *tmpdir = NULL;
+
+  matcher = create_matcher (&tmpdir);
+  check_paths (matcher, tests, G_N_ELEMENTS (tests));
+  destroy_matcher (matcher, tmpdir);
+}
+
+static void
+test_batch (void)
+{
+  static const IgnoreTest tests[] = {
+    { "x.log", FALSE, FALSE },
+    { "y.o", FALSE, TRUE },
+    { "only-root", FALSE, FALSE },
+    { "build", TRUE, TRUE },
+    { "src", TRUE, FALSE },
+  };
+  g_autoptr(GPtrArray) infos = NULL;
+  IdeGitIgnoreMatcher *matcher;
+  gboolean ignored [G_N_ELEMENTS (tests)];
+  gchar *tmpdir = NULL;
+
+  matcher = create_matcher (&tmpdir);
+
+  infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < G_N_ELEMENTS (tests); i++)
+    {
+      GFileInfo *info = g_file_info_new ();
+
+      g_file_info_set_name (info, tests [i].path);
+      g_file_info_set_file_type (info, tests [i].is_dir ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR);
+      g_ptr_array_add (infos, info);
+    }
+
+  g_assert (ide_git_ignore_matcher_match (matcher, "sub", infos, ignored));
+
+  for (guint i = 0; i < G_N_ELEMENTS (tests); i++)
+    g_assert_cmpint (ignored [i], ==, tests [i].ignored);
+
+  destroy_matcher (matcher, tmpdir);
+}
+
+static void
+test_reload (void)
+{
+  g_autoptr(GFileInfo) info = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *path = NULL;
+  IdeGitIgnoreMatcher *matcher;
+  gchar *tmpdir = NULL;
+  guint64 mtime;
+  guint64 root_stamp;
+  guint64 sub_stamp;
+
+  matcher = create_matcher (&tmpdir);
+
+  root_stamp = ide_git_ignore_matcher_get_stamp (matcher, "");
+  sub_stamp = ide_git_ignore_matcher_get_stamp (matcher, "sub");
+
+  g_assert (!ide_git_ignore_matcher_is_ignored (matcher, "sub/notes.txt", G_FILE_TYPE_REGULAR));
+  g_assert (ide_git_ignore_matcher_is_ignored (matcher, "sub/x.o", G_FILE_TYPE_REGULAR));
+
+  path = g_build_filename (tmpdir, "sub", ".gitignore", NULL);
+  file = g_file_new_for_path (path);
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, 0, NULL, &error);
+  g_assert_no_error (error);
+  mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  /* Make sure the modification time changes, whatever the file system */
+  write_file (tmpdir, "sub/.gitignore", "notes.txt\n!x.o\n");
+  g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime + 1, 0, NULL, &error);
+  g_assert_no_error (error);
+
+  /* Compiled files are only checked again after a while, unless told to */
+  ide_git_ignore_matcher_invalidate (matcher);
+
+  g_assert (ide_git_ignore_matcher_is_ignored (matcher, "sub/notes.txt", G_FILE_TYPE_REGULAR));
+  g_assert (!ide_git_ignore_matcher_is_ignored (matcher, "sub/x.o", G_FILE_TYPE_REGULAR));
+
+  /* Only directories below the edited file get a new stamp */
+  g_assert_cmpuint (ide_git_ignore_matcher_get_stamp (matcher, ""), ==, root_stamp);
+  g_assert_cmpuint (ide_git_ignore_matcher_get_stamp (matcher, "sub"), !=, sub_stamp);
+
+  /* Removing the file drops its patterns */
+  g_assert_cmpint (g_unlink (path), ==, 0);
+  ide_git_ignore_matcher_invalidate (matcher);
+  g_assert (!ide_git_ignore_matcher_is_ignored (matcher, "sub/notes.txt", G_FILE_TYPE_REGULAR));
+
+  destroy_matcher (matcher, tmpdir);
+}
+
+static void
+test_unknown_type (void)
+{
+  IdeGitIgnoreMatcher *matcher;
+  gchar *tmpdir = NULL;
+
+  matcher = create_matcher (&tmpdir);
+
+  write_file (tmpdir, "src/build/Makefile", "");
+  write_file (tmpdir, "src/build.txt", "");
+  write_file (tmpdir, "src/x.o", "");
+
+  /* The type is queried only for "build/", which matches directories */
+  g_assert (ide_git_ignore_matcher_is_ignored (matcher, "src/build", G_FILE_TYPE_UNKNOWN));
+  g_assert (ide_git_ignore_matcher_is_ignored (matcher, "src/build/Makefile", G_FILE_TYPE_UNKNOWN));
+  g_assert (ide_git_ignore_matcher_is_ignored (matcher, "src/x.o", G_FILE_TYPE_UNKNOWN));
+  g_assert (!ide_git_ignore_matcher_is_ignored (matcher, "src/build.txt", G_FILE_TYPE_UNKNOWN));
+
+  /* Files that do not exist are taken to not be directories */
+  g_assert (!ide_git_ignore_matcher_is_ignored (matcher, "src/missing/build", G_FILE_TYPE_UNKNOWN));
+
+  destroy_matcher (matcher, tmpdir);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/Git/IgnoreMatcher/wildmatch", test_wildmatch);
+  g_test_add_func ("/Ide/Git/IgnoreMatcher/precedence", test_precedence);
+  g_test_add_func ("/Ide/Git/IgnoreMatcher/batch", test_batch);
+  g_test_add_func ("/Ide/Git/IgnoreMatcher/reload", test_reload);
+  g_test_add_func ("/Ide/Git/IgnoreMatcher/unknown-type", test_unknown_type);
+  return g_test_run ();
+}
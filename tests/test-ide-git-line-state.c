@@ -0,0 +1,145 @@
+/* test-ide-git-line-state.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "test-ide-git-line-state"
+
+#include <ide.h>
+#include <string.h>
+
+#include "ide-git-line-state.h"
+
+#define N IDE_BUFFER_LINE_CHANGE_NONE
+#define A IDE_BUFFER_LINE_CHANGE_ADDED
+#define C IDE_BUFFER_LINE_CHANGE_CHANGED
+#define D IDE_BUFFER_LINE_CHANGE_DELETED
+
+static GByteArray *
+state_new (const guint8 *lines,
+           guint         n_lines)
+{
+  GByteArray *state = g_byte_array_new ();
+
+  g_byte_array_append (state, lines, n_lines);
+
+  return state;
+}
+
+static void
+check_state (GByteArray   *state,
+             const guint8 *lines,
+             guint         n_lines)
+{
+  g_assert_cmpint (state->len, ==, n_lines);
+
+  for (guint i = 0; i < n_lines; i++)
+    {
+      if (state->data [i] != lines [i])
+        g_error ("line %u should be %u but is %u", i, lines [i], state->data [i]);
+    }
+}
+
+static void
+test_insert_lines (void)
+{
+  static const guint8 initial[] = { N, C, D, N };
+  static const guint8 middle[] = { N, C, A, A, D, N };
+  static const guint8 past_end[] = { N, C, A, A, D, N, N, N, A };
+  g_autoptr(GByteArray) state = state_new (initial, G_N_ELEMENTS (initial));
+
+  /* Lines after the insertion move down */
+  ide_git_line_state_insert_lines (state, 2, 2);
+  check_state (state, middle, G_N_ELEMENTS (middle));
+
+  /* Inserting past the end fills the gap with unchanged lines */
+  ide_git_line_state_insert_lines (state, 8, 1);
+  check_state (state, past_end, G_N_ELEMENTS (past_end));
+}
+
+static void
+test_remove_lines (void)
+{
+  static const guint8 initial[] = { N, C, A, A, D, N };
+  static const guint8 middle[] = { N, D, N };
+  static const guint8 clamped[] = { N };
+  g_autoptr(GByteArray) state = state_new (initial, G_N_ELEMENTS (initial));
+
+  /* Lines after the removal move up */
+  ide_git_line_state_remove_lines (state, 1, 3);
+  check_state (state, middle, G_N_ELEMENTS (middle));
+
+  /* Removing past the end is ignored */
+  ide_git_line_state_remove_lines (state, 10, 2);
+  check_state (state, middle, G_N_ELEMENTS (middle));
+
+  /* Removals running past the end are clamped */
+  ide_git_line_state_remove_lines (state, 1, 10);
+  check_state (state, clamped, G_N_ELEMENTS (clamped));
+}
+
+static void
+test_mark_changed (void)
+{
+  static const guint8 initial[] = { N, A };
+  static const guint8 expected[] = { C, A, N, C };
+  g_autoptr(GByteArray) state = state_new (initial, G_N_ELEMENTS (initial));
+
+  /* Added lines stay added, and the state grows to reach lines past the end */
+  ide_git_line_state_mark_changed (state, 0);
+  ide_git_line_state_mark_changed (state, 1);
+  ide_git_line_state_mark_changed (state, 3);
+  check_state (state, expected, G_N_ELEMENTS (expected));
+}
+
+static void
+test_count_lines (void)
+{
+  static const struct {
+    const gchar *text;
+    guint        n_lines;
+  } tests[] = {
+    { "", 0 },
+    { "abc", 0 },
+    { "\n", 1 },
+    { "a\nb\nc", 2 },
+    { "a\r\nb", 1 },
+    { "a\rb\r", 2 },
+    { "\n\r\n\r", 3 },
+    { "a\xe2\x80\xa9" "b", 1 },
+    { "\xe2\x80\xa8", 0 },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (tests); i++)
+    g_assert_cmpint (ide_git_line_state_count_lines (tests [i].text, strlen (tests [i].text)),
+                     ==,
+                     tests [i].n_lines);
+
+  /* Only @len bytes are considered */
+  g_assert_cmpint (ide_git_line_state_count_lines ("a\nb\n", 2), ==, 1);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/Git/LineState/insert_lines", test_insert_lines);
+  g_test_add_func ("/Ide/Git/LineState/remove_lines", test_remove_lines);
+  g_test_add_func ("/Ide/Git/LineState/mark_changed", test_mark_changed);
+  g_test_add_func ("/Ide/Git/LineState/count_lines", test_count_lines);
+  return g_test_run ();
+}
@@ -0,0 +1,150 @@
+/* test-ide-highlighter.c
+ *
+ * Copyright (C) 2017 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "test-ide-highlighter"
+
+#include <ide.h>
+
+#define TEST_TYPE_HIGHLIGHTER (test_highlighter_get_type())
+
+G_DECLARE_FINAL_TYPE (TestHighlighter, test_highlighter, TEST, HIGHLIGHTER, IdeObject)
+
+struct _TestHighlighter
+{
+  IdeObject parent_instance;
+};
+
+static const gchar *
+test_highlighter_lookup (IdeHighlighter *highlighter,
+                         const gchar    *word,
+                         gpointer        user_data)
+{
+  if (g_str_equal (word, "GObject") || g_str_equal (word, "gchar"))
+    return "def:type";
+
+  if (g_str_equal (word, "g_free") || g_str_equal (word, "größe"))
+    return "def:function";
+
+  return NULL;
+}
+
+static GArray *
+test_highlighter_compute_spans (IdeHighlighter  *highlighter,
+                                const gchar     *text,
+                                GCancellable    *cancellable,
+                                GError         **error)
+{
+  return ide_highlighter_scan_text_words (highlighter, text, cancellable,
+                                          test_highlighter_lookup, NULL, error);
+}
+
+static void
+highlighter_iface_init (IdeHighlighterInterface *iface)
+{
+  iface->compute_spans = test_highlighter_compute_spans;
+}
+
+G_DEFINE_TYPE_WITH_CODE (TestHighlighter, test_highlighter, IDE_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (IDE_TYPE_HIGHLIGHTER, highlighter_iface_init))
+
+static void
+test_highlighter_class_init (TestHighlighterClass *klass)
+{
+}
+
+static void
+test_highlighter_init (TestHighlighter *self)
+{
+}
+
+static void
+check_span (GArray      *spans,
+            guint        index,
+            guint        begin,
+            guint        end,
+            const gchar *style_name)
+{
+  const IdeHighlightSpan *span;
+
+  g_assert_cmpint (index, <, spans->len);
+
+  span = &g_array_index (spans, IdeHighlightSpan, index);
+
+  g_assert_cmpint (span->begin, ==, begin);
+  g_assert_cmpint (span->end, ==, end);
+  g_assert_cmpstr (span->style_name, ==, style_name);
+}
+
+static void
+test_compute_spans (void)
+{
+  g_autoptr(IdeHighlighter) highlighter = NULL;
+  g_autoptr(GArray) spans = NULL;
+  g_autoptr(GError) error = NULL;
+
+  highlighter = g_object_new (TEST_TYPE_HIGHLIGHTER, NULL);
+
+  /* Offsets are in characters, and words are not matched by prefix */
+  spans = ide_highlighter_compute_spans (highlighter,
+                                         "GObject *obj; gchar *größe; GObjectClass x;\n"
+                                         "g_free (größe);",
+                                         NULL,
+                                         &error);
+  g_assert_no_error (error);
+  g_assert (spans != NULL);
+  g_assert_cmpint (spans->len, ==, 5);
+
+  check_span (spans, 0, 0, 7, "def:type");
+  check_span (spans, 1, 14, 19, "def:type");
+  check_span (spans, 2, 21, 26, "def:function");
+  check_span (spans, 3, 44, 50, "def:function");
+  check_span (spans, 4, 52, 57, "def:function");
+}
+
+static void
+test_compute_spans_cancelled (void)
+{
+  g_autoptr(IdeHighlighter) highlighter = NULL;
+  g_autoptr(GCancellable) cancellable = NULL;
+  g_autoptr(GString) text = NULL;
+  g_autoptr(GError) error = NULL;
+  GArray *spans;
+
+  highlighter = g_object_new (TEST_TYPE_HIGHLIGHTER, NULL);
+  cancellable = g_cancellable_new ();
+  g_cancellable_cancel (cancellable);
+
+  /* The scanner only checks for cancellation every so many words */
+  text = g_string_new (NULL);
+  for (guint i = 0; i < 5000; i++)
+    g_string_append (text, "gchar x;\n");
+
+  spans = ide_highlighter_compute_spans (highlighter, text->str, cancellable, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert (spans == NULL);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/Highlighter/compute_spans", test_compute_spans);
+  g_test_add_func ("/Ide/Highlighter/compute_spans_cancelled", test_compute_spans_cancelled);
+  return g_test_run ();
+}